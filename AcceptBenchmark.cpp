@@ -0,0 +1,137 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <atomic>
+#include "EchoServer.h"
+#include "NetwServer.h"
+#include "Metrics.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Opens a burst of connections back to back and closes them once the server has echoed
+ * a byte on each, so every counted connection was accepted.
+ */
+static uint64_t RunStorm(int port, int burst, const std::atomic<bool> &stop, bool &failed) {
+    uint64_t connections{0};
+    std::vector<int> fds{};
+    while (!stop) {
+        for (int i = 0; i < burst; i++) {
+            int fd = ConnectLoopback(port);
+            if (fd < 0) {
+                failed = true;
+                break;
+            }
+            fds.emplace_back(fd);
+        }
+        for (auto fd : fds) {
+            char ch{'x'};
+            if (write(fd, &ch, 1) != 1 || read(fd, &ch, 1) != 1) {
+                failed = true;
+            } else {
+                ++connections;
+            }
+            close(fd);
+        }
+        fds.clear();
+        if (failed) {
+            break;
+        }
+    }
+    return connections;
+}
+
+struct StormResult {
+    double connectionsPerSecond{0};
+    double wakeupsPerConnection{0};
+    bool failed{false};
+};
+
+static StormResult Storm(int port, int seconds, size_t acceptBatch) {
+    constexpr int threads = 8;
+    constexpr int burst = 2;
+    StormResult result{};
+    auto server = NetwServer::Create(port, std::make_shared<EchoServer>());
+    server->SetAcceptBatch(acceptBatch);
+    MetricsRegistry metrics{};
+    server->GetMetrics()->Register(metrics);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> counts{};
+    counts.resize(threads);
+    bool failedThreads[threads]{};
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients{};
+    for (int i = 0; i < threads; i++) {
+        clients.emplace_back([&counts, &failedThreads, &stop, i, port] () {
+            counts[i] = RunStorm(port, burst, stop, failedThreads[i]);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto &client : clients) {
+        client.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    double accepted{0};
+    double wakeups{0};
+    for (const auto &value : metrics.Snapshot()) {
+        if (value.name == "netw_connections_accepted_total") {
+            accepted = value.value;
+        } else if (value.name == "netw_poll_wakeups_total") {
+            wakeups = value.value;
+        }
+    }
+    int res = write(server->GetCommandFd(), "q", 1);
+    serverThread.join();
+
+    uint64_t connections{0};
+    for (int i = 0; i < threads; i++) {
+        connections += counts[i];
+        result.failed = result.failed || failedThreads[i];
+    }
+    result.failed = result.failed || res != 1 || connections == 0 || accepted < connections;
+    result.connectionsPerSecond = connections / elapsed;
+    result.wakeupsPerConnection = accepted > 0 ? wakeups / accepted : 0;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8095;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    bool failed{false};
+    for (size_t batch : {(size_t) 1, netwDefaultAcceptBatch}) {
+        auto result = Storm(port++, seconds, batch);
+        std::cout << "accept batch " << batch << ": " << (uint64_t) result.connectionsPerSecond << " connections/s, "
+                  << result.wakeupsPerConnection << " poll wakeups per connection\n";
+        failed = failed || result.failed;
+    }
+    return failed ? 1 : 0;
+}
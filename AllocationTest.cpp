@@ -0,0 +1,215 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "HttpServer.h"
+#include "HttpRouter.h"
+#include "include/object_pool.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+/*
+ * Runs keep-alive requests and new connections through a router after a warmup, and
+ * checks that the connection, request and coroutine frame objects of the framework are
+ * all recycled, none of them may go to the heap. All heap allocations are counted as
+ * well and reported per request, that includes the request and response data.
+ */
+
+constexpr int warmupRequests = 1000;
+constexpr int keepAliveRequests = 10000;
+constexpr int warmupConnections = 100;
+constexpr int warmupConcurrentConnections = 8;
+constexpr int connections = 1000;
+
+static std::atomic<uint64_t> heapAllocations{0};
+
+void *operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+static task<void> Small(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent("ok", "text/plain");
+    request->Respond(response);
+    co_return;
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * The response is small and has a fixed size, so the client side does not allocate.
+ * Only the date changes between the responses.
+ */
+static bool Request(int fd, const std::string &request, const std::string &expected, std::string &buf) {
+    if (write(fd, request.data(), request.size()) != (ssize_t) request.size()) {
+        return false;
+    }
+    size_t received{0};
+    while (received < expected.size()) {
+        auto rd = read(fd, buf.data() + received, expected.size() - received);
+        if (rd <= 0) {
+            return false;
+        }
+        received += rd;
+    }
+    return std::string_view(buf.data(), received).ends_with("\r\n\r\nok");
+}
+
+static bool RunKeepAlive(int port, int requests, const std::string &request, const std::string &expected, std::string &buf) {
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok{true};
+    for (int i = 0; i < requests && ok; i++) {
+        ok = Request(fd, request, expected, buf);
+    }
+    close(fd);
+    return ok;
+}
+
+static bool RunConnections(int port, int count, const std::string &request, const std::string &expected, std::string &buf) {
+    for (int i = 0; i < count; i++) {
+        int fd = ConnectLoopback(port);
+        if (fd < 0) {
+            return false;
+        }
+        bool ok = Request(fd, request, expected, buf);
+        close(fd);
+        if (!ok) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * Keeps several connections open at once, so that the pools hold more connections
+ * than are ever open at the same time during the test.
+ */
+static bool RunConcurrentConnections(int port, int count, const std::string &request, const std::string &expected, std::string &buf) {
+    std::vector<int> fds{};
+    bool ok{true};
+    for (int i = 0; i < count && ok; i++) {
+        int fd = ConnectLoopback(port);
+        if (fd < 0) {
+            ok = false;
+            break;
+        }
+        fds.emplace_back(fd);
+        ok = Request(fd, request, expected, buf);
+    }
+    for (auto fd : fds) {
+        close(fd);
+    }
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8100;
+    alarm(60);
+    auto server = HttpServer::Create(port);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/", Small);
+    server->SetRouter(router);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bool failed{false};
+    std::string request{"GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+    std::string expected{};
+    std::string buf{};
+    buf.resize(4096);
+    int fd = ConnectLoopback(port);
+    if (fd >= 0 && write(fd, request.data(), request.size()) == (ssize_t) request.size()) {
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd > 0) {
+            expected.assign(buf.data(), rd);
+        }
+    }
+    if (fd >= 0) {
+        close(fd);
+    }
+    if (!expected.ends_with("\r\n\r\nok")) {
+        std::cerr << "Unexpected response: " << expected << "\n";
+        failed = true;
+    }
+
+    if (!failed && (!RunKeepAlive(port, warmupRequests, request, expected, buf) || !RunConnections(port, warmupConnections, request, expected, buf) ||
+                    !RunConcurrentConnections(port, warmupConcurrentConnections, request, expected, buf))) {
+        std::cerr << "Warmup failed\n";
+        failed = true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto poolStart = object_pool_heap_allocation_count();
+    auto heapStart = heapAllocations.load();
+    if (!failed && !RunKeepAlive(port, keepAliveRequests, request, expected, buf)) {
+        std::cerr << "Keep-alive requests failed\n";
+        failed = true;
+    }
+    auto poolKeepAlive = object_pool_heap_allocation_count() - poolStart;
+    auto heapKeepAlive = heapAllocations.load() - heapStart;
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    poolStart = object_pool_heap_allocation_count();
+    heapStart = heapAllocations.load();
+    if (!failed && !RunConnections(port, connections, request, expected, buf)) {
+        std::cerr << "Connections failed\n";
+        failed = true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto poolConnections = object_pool_heap_allocation_count() - poolStart;
+    auto heapConnections = heapAllocations.load() - heapStart;
+
+    server->Stop();
+    serverThread.join();
+
+    std::cout << "keep-alive: " << poolKeepAlive << " framework objects from the heap, "
+              << ((double) heapKeepAlive / keepAliveRequests) << " heap allocations per request\n";
+    std::cout << "new connections: " << poolConnections << " framework objects from the heap, "
+              << ((double) heapConnections / connections) << " heap allocations per connection\n";
+    if (poolKeepAlive > 0 || poolConnections > 0) {
+        std::cerr << "Framework objects were allocated from the heap after the warmup\n";
+        failed = true;
+    }
+    return failed ? 1 : 0;
+}
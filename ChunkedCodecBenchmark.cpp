@@ -0,0 +1,181 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "Http1Protocol.h"
+#include "Http1Chunked.h"
+extern "C" {
+#include <sys/uio.h>
+}
+
+/*
+ * Decodes and encodes a chunked body of small and of large chunks, once with
+ * Http1Chunk and once with the streaming codec. The encoded body arrives in reads of
+ * readSize bytes that are appended to a buffer, like it does from a socket. Encoding
+ * with Http1Chunk gives a string per chunk, the encoder gives the iovecs for writev.
+ */
+
+constexpr size_t bodySize = 4 * 1024 * 1024;
+constexpr size_t readSize = 16384;
+
+static volatile size_t sink{0};
+
+static std::string Payload(size_t size) {
+    std::string payload{};
+    payload.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        payload.push_back((char) ('a' + (i % 26)));
+    }
+    return payload;
+}
+
+static std::string Encoded(const std::string &payload, size_t chunkSize) {
+    std::string encoded{};
+    for (size_t pos = 0; pos < payload.size(); pos += chunkSize) {
+        encoded.append(Http1Chunk(payload.substr(pos, chunkSize), false).GetEncoded());
+    }
+    encoded.append(Http1Chunk("", false).GetEncoded());
+    return encoded;
+}
+
+/*
+ * Http1Chunk takes one chunk at a time from the start of the buffer.
+ */
+static bool DecodeChunk(std::string_view encoded, std::string *body) {
+    std::string buffered{};
+    size_t received{0};
+    for (size_t offset = 0; offset < encoded.size(); offset += readSize) {
+        buffered.append(encoded.substr(offset, readSize));
+        while (true) {
+            Http1Chunk chunk{buffered, true};
+            if (!chunk.IsValid()) {
+                if (!chunk.IsTruncated()) {
+                    return false;
+                }
+                break;
+            }
+            auto data = chunk.GetChunk();
+            buffered.erase(0, chunk.GetConsumedBytes());
+            if (data.empty()) {
+                sink = sink + received;
+                return true;
+            }
+            received += data.size();
+            if (body != nullptr) {
+                body->append(data);
+            }
+        }
+    }
+    return false;
+}
+
+static bool DecodeStreaming(std::string_view encoded, std::string *body) {
+    std::string buffered{};
+    size_t received{0};
+    Http1ChunkedDecoder decoder{};
+    for (size_t offset = 0; offset < encoded.size(); offset += readSize) {
+        buffered.append(encoded.substr(offset, readSize));
+        std::string_view input{buffered};
+        while (true) {
+            auto event = decoder.Decode(input);
+            input.remove_prefix(event.consumed);
+            if (event.type == Http1ChunkedEventType::DATA) {
+                received += event.data.size();
+                if (body != nullptr) {
+                    body->append(event.data);
+                }
+            } else if (event.type == Http1ChunkedEventType::END) {
+                sink = sink + received;
+                return true;
+            } else if (event.type == Http1ChunkedEventType::ERROR) {
+                return false;
+            } else if (event.type == Http1ChunkedEventType::NEED_MORE) {
+                break;
+            }
+        }
+        buffered.erase(0, buffered.size() - input.size());
+    }
+    return false;
+}
+
+static size_t EncodeChunk(const std::string &payload, size_t chunkSize) {
+    size_t bytes{0};
+    for (size_t pos = 0; pos < payload.size(); pos += chunkSize) {
+        bytes += Http1Chunk(payload.substr(pos, chunkSize), false).GetEncoded().size();
+    }
+    bytes += Http1Chunk("", false).GetEncoded().size();
+    return bytes;
+}
+
+static size_t EncodeStreaming(const std::string &payload, size_t chunkSize, std::vector<Http1ChunkSizeLine> &sizeLines, std::vector<struct iovec> &iov) {
+    std::string_view remaining{payload};
+    size_t segments{0};
+    size_t chunks{0};
+    while (!remaining.empty()) {
+        auto size = remaining.size() < chunkSize ? remaining.size() : chunkSize;
+        segments += Http1ChunkedEncoder::Chunk(sizeLines[chunks++], remaining.substr(0, size), iov.data() + segments);
+        remaining.remove_prefix(size);
+    }
+    segments += Http1ChunkedEncoder::End({}, iov.data() + segments);
+    size_t bytes{0};
+    for (size_t i = 0; i < segments; i++) {
+        bytes += iov[i].iov_len;
+    }
+    return bytes;
+}
+
+template <class F> static double Measure(size_t iterations, F func) {
+    func();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sink = sink + func();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return ((double) bodySize * iterations) / (elapsed * 1024 * 1024);
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 20;
+    bool failed{false};
+    auto payload = Payload(bodySize);
+    for (size_t chunkSize : {64, 1024, 65536}) {
+        auto encoded = Encoded(payload, chunkSize);
+        std::string chunkBody{};
+        std::string streamingBody{};
+        if (!DecodeChunk(encoded, &chunkBody) || !DecodeStreaming(encoded, &streamingBody) || chunkBody != payload || streamingBody != payload) {
+            std::cerr << "Decoded body differs for " << chunkSize << " byte chunks\n";
+            failed = true;
+        }
+        auto chunks = (payload.size() + chunkSize - 1) / chunkSize;
+        std::vector<Http1ChunkSizeLine> sizeLines{};
+        sizeLines.resize(chunks);
+        std::vector<struct iovec> iov{};
+        iov.resize(chunks * Http1ChunkedEncoder::chunkSegments + Http1ChunkedEncoder::EndSegments(0));
+        if (EncodeStreaming(payload, chunkSize, sizeLines, iov) != encoded.size() || EncodeChunk(payload, chunkSize) != encoded.size()) {
+            std::cerr << "Encoded size differs for " << chunkSize << " byte chunks\n";
+            failed = true;
+        }
+        std::string reassembled{};
+        for (size_t i = 0; i < chunks * Http1ChunkedEncoder::chunkSegments + Http1ChunkedEncoder::EndSegments(0); i++) {
+            reassembled.append((const char *) iov[i].iov_base, iov[i].iov_len);
+        }
+        if (reassembled != encoded) {
+            std::cerr << "Encoded body differs for " << chunkSize << " byte chunks\n";
+            failed = true;
+        }
+
+        /* Http1Chunk copies the rest of the buffer for every chunk, so it gets fewer rounds */
+        auto chunkIterations = chunkSize < 1024 ? (iterations + 9) / 10 : iterations;
+        auto decodeChunk = Measure(chunkIterations, [&encoded] () { return DecodeChunk(encoded, nullptr) ? 1 : 0; });
+        auto decodeStreaming = Measure(iterations, [&encoded] () { return DecodeStreaming(encoded, nullptr) ? 1 : 0; });
+        auto encodeChunk = Measure(chunkIterations, [&payload, chunkSize] () { return EncodeChunk(payload, chunkSize); });
+        auto encodeStreaming = Measure(iterations, [&payload, chunkSize, &sizeLines, &iov] () { return EncodeStreaming(payload, chunkSize, sizeLines, iov); });
+        std::cout << chunkSize << " byte chunks: decode Http1Chunk " << decodeChunk << " MiB/s, streaming " << decodeStreaming
+                  << " MiB/s, encode Http1Chunk " << encodeChunk << " MiB/s, streaming " << encodeStreaming << " MiB/s\n";
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,181 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "HttpClient.h"
+#include "HttpClientImpl.h"
+#include "Http1Chunked.h"
+#include "NetwServer.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+}
+
+/*
+ * Serves canned responses from a plain socket, with chunked bodies split across
+ * writes, bodies that last until the connection is closed and broken bodies, and checks
+ * the bodies the client reads from them. The last body is pulled in segments by a slow
+ * consumer, and no segment may be much larger than the body buffer of the client.
+ */
+
+constexpr size_t streamSize = 32 * 1024 * 1024;
+
+struct ClientBodyCase {
+    std::string path{};
+    std::vector<std::string> writes{};
+    bool closeAfter{false};
+    std::string body{};
+    bool success{true};
+    bool stream{false};
+};
+
+static std::vector<ClientBodyCase> cases{};
+
+static char PatternAt(size_t offset) {
+    return (char) ('a' + (offset % 26));
+}
+
+static std::string LargeChunked(const std::string &body, size_t chunkSize) {
+    std::string encoded{"HTTP/1.1 200 OK\r\nContent-Type: application/json\r\nTransfer-Encoding: chunked\r\n\r\n"};
+    for (size_t pos = 0; pos < body.size(); pos += chunkSize) {
+        auto chunk = body.substr(pos, chunkSize);
+        encoded.append(Http1ChunkSizeLine(chunk.size()).View());
+        encoded.append(chunk);
+        encoded.append("\r\n");
+    }
+    encoded.append("0\r\n\r\n");
+    return encoded;
+}
+
+static void BuildCases() {
+    cases.push_back({.path = "/length", .writes = {"HTTP/1.1 200 OK\r\nContent-Length: 5\r\n\r\nhello"}, .body = "hello"});
+    cases.push_back({.path = "/chunked", .writes = {"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhe", "llo\r", "\n6;name=value\r\n world\r\n", "0\r\nX-Checksum: 1\r\n", "\r\n"}, .body = "hello world"});
+    cases.push_back({.path = "/chunked-over-length", .writes = {"HTTP/1.1 200 OK\r\nContent-Length: 100\r\nTransfer-Encoding: identity, chunked\r\n\r\n3\r\nabc\r\n0\r\n\r\n"}, .body = "abc"});
+    cases.push_back({.path = "/close", .writes = {"HTTP/1.0 200 OK\r\nContent-Type: text/plain\r\n\r\nuntil", " the end"}, .closeAfter = true, .body = "until the end"});
+    cases.push_back({.path = "/no-content", .writes = {"HTTP/1.1 204 No Content\r\n\r\n"}, .body = ""});
+    cases.push_back({.path = "/bad-size", .writes = {"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\nzz\r\nhello\r\n0\r\n\r\n"}, .success = false});
+    cases.push_back({.path = "/truncated", .writes = {"HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n5\r\nhel"}, .closeAfter = true, .success = false});
+    std::string large{};
+    for (size_t i = 0; i < streamSize; i++) {
+        large.push_back(PatternAt(i));
+    }
+    cases.push_back({.path = "/large", .writes = {LargeChunked(large.substr(0, 1024 * 1024), 65536)}, .body = large.substr(0, 1024 * 1024)});
+    cases.push_back({.path = "/small-chunks", .writes = {LargeChunked(large.substr(0, 65536), 7)}, .body = large.substr(0, 65536)});
+    cases.push_back({.path = "/stream", .writes = {LargeChunked(large, 1024 * 1024)}, .stream = true});
+}
+
+/*
+ * One connection per case, the connections that are not closed by the case stay open
+ * until the end, so the client has to find the end of the body from the framing.
+ */
+static void Serve(const ClientTestServer &server) {
+    std::vector<int> openFds{};
+    for (size_t i = 0; i < cases.size(); i++) {
+        int fd = server.Accept();
+        if (fd < 0) {
+            clientTestFailed = true;
+            break;
+        }
+        auto path = ClientTestReadRequestPath(fd);
+        const ClientBodyCase *found{nullptr};
+        for (const auto &c : cases) {
+            if (c.path == path) {
+                found = &c;
+            }
+        }
+        if (found == nullptr) {
+            std::cerr << "Unexpected request for " << path << "\n";
+            clientTestFailed = true;
+            close(fd);
+            continue;
+        }
+        for (const auto &output : found->writes) {
+            ClientTestWriteAll(fd, output);
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        if (found->closeAfter) {
+            close(fd);
+        } else {
+            openFds.emplace_back(fd);
+        }
+    }
+    for (auto fd : openFds) {
+        close(fd);
+    }
+}
+
+static task<void> Stream(std::shared_ptr<HttpResponse> response, std::string path) {
+    size_t received{0};
+    size_t segments{0};
+    size_t largestSegment{0};
+    bool patternOk{true};
+    while (true) {
+        auto segment = co_await response->NextBodySegment();
+        for (size_t i = 0; i < segment.data.size() && patternOk; i++) {
+            patternOk = segment.data[i] == PatternAt(received + i);
+        }
+        received += segment.data.size();
+        largestSegment = segment.data.size() > largestSegment ? segment.data.size() : largestSegment;
+        ++segments;
+        if (segment.end) {
+            if (!segment.success) {
+                patternOk = false;
+            }
+            break;
+        }
+        /* A consumer that is busy with what it got so far */
+        co_await ClientTestSleep(2);
+    }
+    std::cout << path << ": " << received << " bytes in " << segments << " segments, largest " << largestSegment << " bytes\n";
+    if (!patternOk || received != streamSize || largestSegment > (httpClientBodyBufferMax + netwReadChunkMax)) {
+        std::cerr << path << ": the body was not streamed within the buffer limit\n";
+        clientTestFailed = true;
+    }
+}
+
+static task<void> RunClient(std::shared_ptr<HttpClient> client, int port) {
+    for (const auto &c : cases) {
+        auto request = client->Request("GET", c.path);
+        auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+        if (!responseExpected.has_value() || !responseExpected.value()) {
+            std::cerr << c.path << ": no response\n";
+            clientTestFailed = true;
+            continue;
+        }
+        auto response = responseExpected.value();
+        if (c.stream) {
+            co_await Stream(response, c.path);
+            continue;
+        }
+        auto body = co_await response->ResponseBody();
+        if (body.success != c.success || (c.success && body.body != c.body)) {
+            std::cerr << c.path << ": unexpected body of " << body.body.size() << " bytes" << (body.success ? " (successful)" : " (error)") << "\n";
+            clientTestFailed = true;
+        } else {
+            std::cout << c.path << ": " << body.body.size() << " bytes" << (body.success ? "" : " (error)") << "\n";
+        }
+    }
+    client->Stop();
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8101, 60);
+    BuildCases();
+    ClientTestServer server{};
+    if (!server.Listen(port, 16)) {
+        return 1;
+    }
+    server.Start([&server] () { Serve(server); });
+    auto client = HttpClient::Create();
+    FireAndForget<task<void>>([client, port] () { return RunClient(client, port); });
+    client->Run();
+    server.Stop();
+    return clientTestFailed ? 1 : 0;
+}
@@ -0,0 +1,203 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <atomic>
+#include "HttpClient.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <errno.h>
+}
+
+/*
+ * Injects faults into an upstream of three plain socket servers while requests are sent
+ * one after the other. A server that answers with errors is ejected after a few of
+ * them, and gets requests again after a probe once it has recovered. A server that
+ * slows down is ejected on its latency. When all servers fail, requests fail right away
+ * without reaching them, and once they have recovered the probes bring them back.
+ * With retries on, a request that fails on one server is retried on another. With
+ * hedging on, every request to a server that lags far beyond the hedge delay is hedged
+ * and answered by another server, and the cancelled copies do not eject the lagging
+ * one, so it keeps getting requests after more hedges than the error limit.
+ */
+
+enum class FaultMode {
+    OK,
+    FAIL,
+    SLOW,
+    LAG
+};
+
+struct FaultServer {
+    char name;
+    ClientTestServer listener{};
+    std::atomic<FaultMode> mode{FaultMode::OK};
+    std::atomic<int> requests{0};
+};
+
+constexpr int slowDelay = 100;
+constexpr int lagDelay = 20;
+constexpr int lagHedges = 10;
+constexpr std::chrono::milliseconds ejectionTime{300};
+
+static FaultServer servers[3]{{'A'}, {'B'}, {'C'}};
+
+static void ServeConnection(FaultServer &server, int fd) {
+    std::string buffered{};
+    while (!ClientTestReadHead(fd, buffered).empty()) {
+        ++server.requests;
+        auto mode = server.mode.load();
+        if (mode == FaultMode::SLOW) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(slowDelay));
+        } else if (mode == FaultMode::LAG) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(lagDelay));
+        }
+        std::string response = mode == FaultMode::FAIL ? "HTTP/1.1 503 Service Unavailable\r\nContent-Length: 1\r\n\r\n" : "HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\n";
+        if (!ClientTestWriteAll(fd, response + server.name)) {
+            break;
+        }
+    }
+}
+
+struct FaultPhase {
+    int ok{0};
+    int errors{0};
+    int failedFast{0};
+    int requests[3]{0, 0, 0};
+    int answered[3]{0, 0, 0};
+};
+
+/*
+ * Sends count requests, or fewer when stopServer is given and has got stopRequests.
+ */
+static task<FaultPhase> Run(std::shared_ptr<HttpClient> client, const char *name, int count, int stopServer = -1, int stopRequests = 0) {
+    FaultPhase phase{};
+    int before[3]{};
+    for (int i = 0; i < 3; i++) {
+        before[i] = servers[i].requests;
+    }
+    for (int i = 0; i < count; i++) {
+        if (stopServer >= 0 && (servers[stopServer].requests - before[stopServer]) >= stopRequests) {
+            break;
+        }
+        auto request = client->Request("GET", "/");
+        auto start = std::chrono::steady_clock::now();
+        auto responseExpected = co_await client->ExecuteUpstream("faulty", request);
+        if (!responseExpected.has_value()) {
+            auto elapsed = std::chrono::steady_clock::now() - start;
+            if (responseExpected.error().GetErrno() != EHOSTUNREACH || elapsed > std::chrono::milliseconds(20)) {
+                std::cerr << name << ": " << responseExpected.error().what() << "\n";
+                clientTestFailed = true;
+            }
+            ++phase.failedFast;
+            continue;
+        }
+        if (!responseExpected.value()) {
+            std::cerr << name << ": no response\n";
+            clientTestFailed = true;
+            continue;
+        }
+        auto response = responseExpected.value();
+        auto body = co_await response->ResponseBody();
+        for (int i = 0; i < 3; i++) {
+            if (body.body.size() == 1 && body.body[0] == servers[i].name) {
+                ++phase.answered[i];
+            }
+        }
+        if (response->GetCode() == 200) {
+            ++phase.ok;
+        } else {
+            ++phase.errors;
+        }
+    }
+    for (int i = 0; i < 3; i++) {
+        phase.requests[i] = servers[i].requests - before[i];
+    }
+    std::cout << name << ": " << phase.ok << " ok, " << phase.errors << " errors, " << phase.failedFast << " failed fast, requests A "
+              << phase.requests[0] << " B " << phase.requests[1] << " C " << phase.requests[2] << "\n";
+    co_return phase;
+}
+
+static task<void> RunClient(std::shared_ptr<HttpClient> client) {
+    servers[2].mode = FaultMode::FAIL;
+    auto failing = co_await Run(client, "C failing", 60);
+    if (failing.requests[2] != 5 || failing.errors != 5 || failing.ok != 55) {
+        clientTestFailed = true;
+    }
+
+    servers[2].mode = FaultMode::OK;
+    co_await ClientTestSleep(ejectionTime.count() + 100);
+    auto recovered = co_await Run(client, "C recovered", 40);
+    if (recovered.requests[2] < 5 || recovered.ok != 40) {
+        clientTestFailed = true;
+    }
+
+    servers[1].mode = FaultMode::SLOW;
+    auto slow = co_await Run(client, "B slow", 40);
+    if (slow.requests[1] > 4 || slow.ok != 40) {
+        clientTestFailed = true;
+    }
+
+    for (auto &server : servers) {
+        server.mode = FaultMode::FAIL;
+    }
+    auto down = co_await Run(client, "All failing", 40);
+    if (down.failedFast < 20 || (down.requests[0] + down.requests[1] + down.requests[2]) > 11) {
+        clientTestFailed = true;
+    }
+
+    for (auto &server : servers) {
+        server.mode = FaultMode::OK;
+    }
+    co_await ClientTestSleep(3 * ejectionTime.count());
+    auto back = co_await Run(client, "All recovered", 40);
+    if (back.ok != 40 || back.requests[0] == 0 || back.requests[1] == 0 || back.requests[2] == 0) {
+        clientTestFailed = true;
+    }
+
+    client->SetRetryPolicy({.maxAttempts = 2, .initialBackoff = std::chrono::milliseconds(1), .budgetRatio = 1});
+    servers[0].mode = FaultMode::FAIL;
+    auto retried = co_await Run(client, "A failing with retries", 20);
+    if (retried.ok != 20 || retried.requests[0] == 0 || retried.requests[0] > 5) {
+        clientTestFailed = true;
+    }
+
+    client->SetRetryPolicy({.budgetRatio = 1, .hedgePercentile = 0.5});
+    servers[0].mode = FaultMode::OK;
+    servers[1].mode = FaultMode::LAG;
+    co_await ClientTestSleep(3 * ejectionTime.count());
+    auto hedged = co_await Run(client, "B lagging with hedging", 300, 1, lagHedges);
+    if (hedged.errors != 0 || hedged.failedFast != 0 || hedged.requests[1] < lagHedges || hedged.answered[1] != 0) {
+        clientTestFailed = true;
+    }
+    client->Stop();
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8110, 60);
+    for (int i = 0; i < 3; i++) {
+        auto &server = servers[i];
+        if (!server.listener.Listen(port + i)) {
+            return 1;
+        }
+        server.listener.ServeConnections([&server] (int fd) { ServeConnection(server, fd); });
+    }
+    auto client = HttpClient::Create();
+    client->SetUpstream("faulty", {{"127.0.0.1", port}, {"127.0.0.1", port + 1}, {"127.0.0.1", port + 2}}, {
+        .consecutiveErrors = 5,
+        .latency = std::chrono::milliseconds(slowDelay / 2),
+        .ewmaWeight = 0.3,
+        .ejectionTime = ejectionTime
+    });
+    FireAndForget<task<void>>([client] () { return RunClient(client); });
+    client->Run();
+    for (auto &server : servers) {
+        server.listener.Stop();
+    }
+    return clientTestFailed ? 1 : 0;
+}
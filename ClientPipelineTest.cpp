@@ -0,0 +1,139 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "HttpClient.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+}
+
+/*
+ * Sends a burst of GETs with pipelining on to a plain socket server. The server waits
+ * until all of them have arrived on the first connection before it answers, so they
+ * must have been written back to back, then answers a few and closes the connection.
+ * The rest have to be sent again on a second connection, which is kept alive and used
+ * for one more request afterwards. Each response body is the path of its request, so
+ * responses matched out of order show up.
+ */
+
+constexpr size_t burst = 8;
+constexpr size_t answeredBeforeClose = 3;
+
+static std::atomic<size_t> completed{0};
+static std::atomic<int> connections{0};
+
+/*
+ * Reads until count request heads have arrived, and returns their paths.
+ */
+static std::vector<std::string> ReadRequests(int fd, std::string &buffered, size_t count) {
+    std::vector<std::string> paths{};
+    while (paths.size() < count) {
+        auto head = ClientTestReadHead(fd, buffered);
+        if (head.empty()) {
+            break;
+        }
+        paths.emplace_back(ClientTestRequestPath(head));
+    }
+    return paths;
+}
+
+static std::string Response(const std::string &path) {
+    return "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(path.size()) + "\r\n\r\n" + path;
+}
+
+static void Serve(const ClientTestServer &server) {
+    int fd = server.Accept();
+    ++connections;
+    std::string buffered{};
+    auto paths = ReadRequests(fd, buffered, burst);
+    std::cout << "First connection: " << paths.size() << " requests before the first response\n";
+    if (paths.size() != burst) {
+        clientTestFailed = true;
+    }
+    for (size_t i = 0; i < answeredBeforeClose && i < paths.size(); i++) {
+        ClientTestWriteAll(fd, Response(paths[i]));
+    }
+    close(fd);
+
+    fd = server.Accept();
+    ++connections;
+    buffered.clear();
+    paths = ReadRequests(fd, buffered, burst - answeredBeforeClose);
+    std::cout << "Second connection: " << paths.size() << " requests sent again\n";
+    if (paths.size() != (burst - answeredBeforeClose)) {
+        clientTestFailed = true;
+    }
+    for (const auto &path : paths) {
+        ClientTestWriteAll(fd, Response(path));
+    }
+    paths = ReadRequests(fd, buffered, 1);
+    if (paths.size() != 1) {
+        std::cerr << "The last request did not reuse the second connection\n";
+        clientTestFailed = true;
+    }
+    for (const auto &path : paths) {
+        ClientTestWriteAll(fd, Response(path));
+    }
+    close(fd);
+}
+
+static task<bool> Fetch(std::shared_ptr<HttpClient> client, int port, std::string path) {
+    auto request = client->Request("GET", path);
+    auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+    if (!responseExpected.has_value() || !responseExpected.value()) {
+        std::cerr << path << ": no response\n";
+        co_return false;
+    }
+    auto response = responseExpected.value();
+    auto body = co_await response->ResponseBody();
+    if (!body.success || body.body != path) {
+        std::cerr << path << ": got the response for " << body.body << "\n";
+        co_return false;
+    }
+    co_return true;
+}
+
+static task<void> Last(std::shared_ptr<HttpClient> client, int port) {
+    auto ok = co_await Fetch(client, port, "/last");
+    if (!ok) {
+        clientTestFailed = true;
+    }
+    client->Stop();
+}
+
+static task<void> Burst(std::shared_ptr<HttpClient> client, int port, std::string path) {
+    auto ok = co_await Fetch(client, port, path);
+    if (!ok) {
+        clientTestFailed = true;
+    }
+    if (++completed == burst) {
+        co_await Last(client, port);
+    }
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8103, 30);
+    ClientTestServer server{};
+    if (!server.Listen(port, 16)) {
+        return 1;
+    }
+    server.Start([&server] () { Serve(server); });
+    auto client = HttpClient::Create();
+    client->SetPipelineDepth(burst);
+    for (size_t i = 0; i < burst; i++) {
+        auto path = "/request/" + std::to_string(i);
+        FireAndForget<task<void>>([client, port, path] () { return Burst(client, port, path); });
+    }
+    client->Run();
+    server.Stop();
+    std::cout << completed << " requests on " << connections << " connections\n";
+    return clientTestFailed || connections != 2 ? 1 : 0;
+}
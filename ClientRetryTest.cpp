@@ -0,0 +1,153 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include "HttpClient.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+#include <poll.h>
+}
+
+/*
+ * A plain socket server that answers one request per connection. /flaky is unavailable
+ * the first time, /down always, and one in tailEvery of the /tail requests is held back
+ * for tailDelay. A retry gets through /flaky, and the budget limits how often /down is
+ * tried. The same run of /tail requests is measured without and with hedging, and
+ * hedging has to bring the 99th percentile down, with the copies that lost cancelled.
+ */
+
+constexpr size_t tailRequests = 200;
+constexpr size_t warmupRequests = 20;
+constexpr int tailEvery = 20;
+constexpr int tailDelay = 300;
+constexpr int baseDelay = 2;
+
+static std::atomic<int> tailCount{0};
+static std::atomic<int> flakyHits{0};
+static std::atomic<int> downHits{0};
+static std::atomic<int> cancelled{0};
+
+/*
+ * False when the client closed the connection before the time was up.
+ */
+static bool Delay(int fd, int ms) {
+    struct pollfd pfd{.fd = fd, .events = POLLIN, .revents = 0};
+    if (poll(&pfd, 1, ms) > 0) {
+        char buf[16];
+        if (read(fd, buf, sizeof(buf)) <= 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::string Response(int code, const std::string &body) {
+    return "HTTP/1.1 " + std::to_string(code) + (code == 200 ? " OK" : " Service Unavailable") + "\r\nContent-Length: " + std::to_string(body.size()) + "\r\n\r\n" + body;
+}
+
+static void ServeConnection(int fd) {
+    auto path = ClientTestReadRequestPath(fd);
+    if (path == "/flaky") {
+        ClientTestWriteAll(fd, ++flakyHits == 1 ? Response(503, "busy") : Response(200, "ok"));
+    } else if (path == "/down") {
+        ++downHits;
+        ClientTestWriteAll(fd, Response(503, "busy"));
+    } else if (path.starts_with("/tail/")) {
+        auto delay = (++tailCount % tailEvery) == 0 ? tailDelay : baseDelay;
+        if (Delay(fd, delay)) {
+            ClientTestWriteAll(fd, Response(200, path));
+        } else {
+            ++cancelled;
+        }
+    }
+}
+
+static task<int> Get(std::shared_ptr<HttpClient> client, int port, std::string path, std::string expected) {
+    auto request = client->Request("GET", path);
+    auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+    if (!responseExpected.has_value() || !responseExpected.value()) {
+        std::cerr << path << ": no response\n";
+        clientTestFailed = true;
+        co_return 0;
+    }
+    auto response = responseExpected.value();
+    auto body = co_await response->ResponseBody();
+    if (!body.success || body.body != expected) {
+        std::cerr << path << ": unexpected body " << body.body << "\n";
+        clientTestFailed = true;
+    }
+    co_return response->GetCode();
+}
+
+static task<std::chrono::microseconds> TailPercentile(std::shared_ptr<HttpClient> client, int port, double percentile) {
+    for (size_t i = 0; i < warmupRequests; i++) {
+        auto path = "/tail/warmup/" + std::to_string(i);
+        co_await Get(client, port, path, path);
+    }
+    std::vector<std::chrono::microseconds> latencies{};
+    for (size_t i = 0; i < tailRequests; i++) {
+        auto path = "/tail/" + std::to_string(i);
+        auto start = std::chrono::steady_clock::now();
+        co_await Get(client, port, path, path);
+        latencies.emplace_back(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    co_return latencies[(size_t) (percentile * (latencies.size() - 1))];
+}
+
+static task<void> RunClient(std::shared_ptr<HttpClient> client, int port) {
+    client->SetRetryPolicy({.maxAttempts = 3, .initialBackoff = std::chrono::milliseconds(5)});
+    auto flakyCode = co_await Get(client, port, "/flaky", "ok");
+    std::cout << "/flaky: " << flakyCode << " after " << flakyHits << " attempts\n";
+    if (flakyCode != 200 || flakyHits != 2) {
+        clientTestFailed = true;
+    }
+
+    /* Two retries in the budget and nothing added to it, so the third request is tried once */
+    client->SetRetryPolicy({.maxAttempts = 3, .initialBackoff = std::chrono::milliseconds(5), .budgetRatio = 0, .budgetMax = 2});
+    for (int i = 0; i < 3; i++) {
+        auto downCode = co_await Get(client, port, "/down", "busy");
+        if (downCode != 503) {
+            clientTestFailed = true;
+        }
+    }
+    std::cout << "/down: " << downHits << " attempts for 3 requests\n";
+    if (downHits != 5) {
+        clientTestFailed = true;
+    }
+
+    client->SetRetryPolicy({});
+    auto plain = co_await TailPercentile(client, port, 0.99);
+    auto plainCancelled = cancelled.load();
+    client->SetRetryPolicy({.budgetRatio = 0.2, .hedgePercentile = 0.9});
+    auto hedged = co_await TailPercentile(client, port, 0.99);
+    std::cout << "/tail: p99 " << plain.count() << "us without hedging, " << hedged.count() << "us with hedging, "
+              << (cancelled - plainCancelled) << " slower copies cancelled\n";
+    if (hedged * 2 > plain || cancelled == plainCancelled) {
+        clientTestFailed = true;
+    }
+    client->Stop();
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8105, 60);
+    ClientTestServer server{};
+    if (!server.Listen(port)) {
+        return 1;
+    }
+    server.ServeConnections(ServeConnection);
+    auto client = HttpClient::Create();
+    FireAndForget<task<void>>([client, port] () { return RunClient(client, port); });
+    client->Run();
+    server.Stop();
+    return clientTestFailed ? 1 : 0;
+}
@@ -8,7 +8,7 @@
 
 static std::shared_ptr<HttpServer> server{};
 
-void signal_handler(int signal) {
+void signal_handler(int /* signal */) {
     server->Stop();
 }
 
@@ -0,0 +1,149 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "ClientTestServer.h"
+#include <chrono>
+#include <iostream>
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+std::atomic<bool> clientTestFailed{false};
+
+int ClientTestPort(int argc, char **argv, int defaultPort, unsigned int timeLimit) {
+    alarm(timeLimit);
+    return argc > 1 ? std::stoi(argv[1]) : defaultPort;
+}
+
+bool ClientTestWriteAll(int fd, const std::string &data) {
+    size_t written{0};
+    while (written < data.size()) {
+        auto wr = send(fd, data.data() + written, data.size() - written, MSG_NOSIGNAL);
+        if (wr <= 0) {
+            return false;
+        }
+        written += wr;
+    }
+    return true;
+}
+
+std::string ClientTestReadHead(int fd, std::string &buffered) {
+    char buf[4096];
+    while (true) {
+        auto headEnd = buffered.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            auto head = buffered.substr(0, headEnd + 4);
+            buffered.erase(0, headEnd + 4);
+            return head;
+        }
+        auto rd = read(fd, buf, sizeof(buf));
+        if (rd <= 0) {
+            return {};
+        }
+        buffered.append(buf, rd);
+    }
+}
+
+std::string ClientTestRequestPath(const std::string &head) {
+    auto pathStart = head.find(' ');
+    if (pathStart == std::string::npos) {
+        return {};
+    }
+    auto pathEnd = head.find(' ', pathStart + 1);
+    return head.substr(pathStart + 1, pathEnd - pathStart - 1);
+}
+
+std::string ClientTestReadRequestPath(int fd) {
+    std::string buffered{};
+    return ClientTestRequestPath(ClientTestReadHead(fd, buffered));
+}
+
+task<void> ClientTestSleep(int ms) {
+    func_task<void> delay{[ms] (const auto &resume) {
+        std::thread thread{[resume, ms] () {
+            std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+            resume();
+        }};
+        thread.detach();
+    }};
+    co_await delay;
+}
+
+ClientTestServer::~ClientTestServer() {
+    Stop();
+}
+
+bool ClientTestServer::Listen(int port, int backlog) {
+    listenFd = socket(AF_INET, SOCK_STREAM, 0);
+    int one{1};
+    setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(listenFd, (struct sockaddr *) &addr, sizeof(addr)) != 0 || listen(listenFd, backlog) != 0) {
+        std::cerr << "Unable to listen on port " << port << "\n";
+        close(listenFd);
+        listenFd = -1;
+        return false;
+    }
+    return true;
+}
+
+int ClientTestServer::Accept() const {
+    return accept(listenFd, nullptr, nullptr);
+}
+
+void ClientTestServer::Start(const std::function<void ()> &acceptLoop) {
+    thread = std::thread{acceptLoop};
+}
+
+void ClientTestServer::ServeConnections(const std::function<void (int fd)> &serveConnection) {
+    Start([this, serveConnection] () {
+        while (true) {
+            int fd = Accept();
+            if (fd < 0) {
+                break;
+            }
+            {
+                std::lock_guard lock{mtx};
+                connections.emplace_back(fd);
+            }
+            std::thread connectionThread{[this, serveConnection, fd] () {
+                serveConnection(fd);
+                std::lock_guard lock{mtx};
+                std::erase(connections, fd);
+                close(fd);
+            }};
+            connectionThread.detach();
+        }
+    });
+}
+
+void ClientTestServer::Stop() {
+    if (listenFd < 0) {
+        return;
+    }
+    shutdown(listenFd, SHUT_RDWR);
+    if (thread.joinable()) {
+        thread.join();
+    }
+    while (true) {
+        {
+            std::lock_guard lock{mtx};
+            if (connections.empty()) {
+                break;
+            }
+            for (auto fd : connections) {
+                shutdown(fd, SHUT_RDWR);
+            }
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    close(listenFd);
+    listenFd = -1;
+}
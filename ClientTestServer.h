@@ -0,0 +1,76 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_CLIENTTESTSERVER_H
+#define LIBHTTPTOOLING_CLIENTTESTSERVER_H
+
+#include <string>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "include/task.h"
+
+/*
+ * Plain socket servers for the client tests, for peers that misbehave in ways an
+ * HttpServer would not: stalling, breaking off bodies, closing with requests pending.
+ */
+
+extern std::atomic<bool> clientTestFailed;
+
+/*
+ * The port from the command line or defaultPort. The test is ended by SIGALRM after
+ * timeLimit seconds, so that a hanging client fails the test instead of blocking it.
+ */
+int ClientTestPort(int argc, char **argv, int defaultPort, unsigned int timeLimit);
+
+bool ClientTestWriteAll(int fd, const std::string &data);
+
+/*
+ * Reads until a request head is in buffered, and takes it out with its final empty
+ * line. What was read after the head stays in buffered. Empty when the connection
+ * ended first.
+ */
+std::string ClientTestReadHead(int fd, std::string &buffered);
+
+std::string ClientTestRequestPath(const std::string &head);
+
+/*
+ * The path of the next request on a connection that has one request.
+ */
+std::string ClientTestReadRequestPath(int fd);
+
+/*
+ * Continues on another thread after ms milliseconds.
+ */
+task<void> ClientTestSleep(int ms);
+
+/*
+ * A loopback listener with a thread that either runs a custom accept loop, or serves
+ * each connection on a thread of its own. Stop ends the accept loop, shuts down the
+ * connections that are still served and waits for their threads.
+ */
+class ClientTestServer {
+private:
+    int listenFd{-1};
+    std::thread thread{};
+    std::mutex mtx{};
+    std::vector<int> connections{};
+public:
+    ClientTestServer() = default;
+    ClientTestServer(const ClientTestServer &) = delete;
+    ClientTestServer &operator =(const ClientTestServer &) = delete;
+    ~ClientTestServer();
+    bool Listen(int port, int backlog = 64);
+    /*
+     * The next connection, or -1 once the server is stopped.
+     */
+    int Accept() const;
+    void Start(const std::function<void ()> &acceptLoop);
+    void ServeConnections(const std::function<void (int fd)> &serveConnection);
+    void Stop();
+};
+
+#endif //LIBHTTPTOOLING_CLIENTTESTSERVER_H
@@ -0,0 +1,172 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "HttpClient.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+/*
+ * Runs requests with deadlines against plain socket servers that misbehave: one that
+ * never accepts so that the connection is not established, one that never answers and
+ * one that stops in the middle of the body. Each has to fail close to its deadline,
+ * and the connection has to be closed. A server that answers in time gets through with
+ * the same timeouts, and one that takes longer than the connect limit to answer gets
+ * through with a longer first byte limit, as the connect limit ends with the connect.
+ */
+
+constexpr std::chrono::milliseconds deadline{200};
+constexpr std::chrono::milliseconds slack{800};
+
+/*
+ * Blocks until the client closes the connection.
+ */
+static void WaitForClose(int fd, const std::string &path) {
+    char buf[1024];
+    while (read(fd, buf, sizeof(buf)) > 0) {
+    }
+    std::cout << path << ": the client closed the connection\n";
+}
+
+static void Serve(const ClientTestServer &server) {
+    for (int i = 0; i < 4; i++) {
+        int fd = server.Accept();
+        if (fd < 0) {
+            clientTestFailed = true;
+            break;
+        }
+        auto path = ClientTestReadRequestPath(fd);
+        if (path == "/silent") {
+            WaitForClose(fd, path);
+        } else if (path == "/stall") {
+            ClientTestWriteAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: 100\r\n\r\nonly ten b");
+            WaitForClose(fd, path);
+        } else if (path == "/ok") {
+            ClientTestWriteAll(fd, "HTTP/1.1 200 OK\r\nConnection: close\r\nContent-Length: 2\r\n\r\nok");
+        } else if (path == "/slow") {
+            std::this_thread::sleep_for(deadline * 2);
+            ClientTestWriteAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nslow");
+        } else {
+            std::cerr << "Unexpected request for " << path << "\n";
+            clientTestFailed = true;
+        }
+        close(fd);
+    }
+}
+
+/*
+ * A listener that is never accepted from, with its backlog filled up, drops further
+ * connection attempts so that they stay unanswered.
+ */
+static std::vector<int> FillBacklog(int port) {
+    std::vector<int> fds{};
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    for (int i = 0; i < 4; i++) {
+        int fd = socket(AF_INET, SOCK_STREAM, 0);
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+        connect(fd, (struct sockaddr *) &addr, sizeof(addr));
+        fds.emplace_back(fd);
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    return fds;
+}
+
+static task<void> ExpectTimeout(std::shared_ptr<HttpClient> client, int port, std::string path, HttpRequestTimeouts timeouts) {
+    auto request = client->Request("GET", path);
+    request->SetTimeouts(timeouts);
+    auto start = std::chrono::steady_clock::now();
+    auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+    if (responseExpected.has_value()) {
+        std::cerr << path << ": expected a timeout\n";
+        clientTestFailed = true;
+        co_return;
+    }
+    std::cout << path << ": " << responseExpected.error().what() << " after " << elapsed.count() << "ms\n";
+    if (responseExpected.error().GetErrno() != ETIMEDOUT || elapsed < deadline || elapsed > (deadline + slack)) {
+        clientTestFailed = true;
+    }
+}
+
+static task<void> ExpectBody(std::shared_ptr<HttpClient> client, int port, std::string path, HttpRequestTimeouts timeouts, std::string expected) {
+    auto request = client->Request("GET", path);
+    request->SetTimeouts(timeouts);
+    auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+    if (!responseExpected.has_value() || !responseExpected.value()) {
+        std::cerr << path << ": no response" << (responseExpected.has_value() ? "" : std::string(", ") + responseExpected.error().what()) << "\n";
+        clientTestFailed = true;
+        co_return;
+    }
+    auto response = responseExpected.value();
+    auto body = co_await response->ResponseBody();
+    std::cout << path << ": " << body.body << "\n";
+    if (!body.success || body.body != expected) {
+        clientTestFailed = true;
+    }
+}
+
+static task<void> RunClient(std::shared_ptr<HttpClient> client, int port, int unacceptedPort) {
+    co_await ExpectTimeout(client, unacceptedPort, "/unaccepted", {.connect = deadline});
+    co_await ExpectTimeout(client, port, "/silent", {.firstByte = deadline});
+
+    {
+        auto request = client->Request("GET", "/stall");
+        request->SetTimeouts({.total = deadline});
+        auto start = std::chrono::steady_clock::now();
+        auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+        if (!responseExpected.has_value() || !responseExpected.value()) {
+            std::cerr << "/stall: no response\n";
+            clientTestFailed = true;
+        } else {
+            auto response = responseExpected.value();
+            auto body = co_await response->ResponseBody();
+            auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+            std::cout << "/stall: body of " << body.body.size() << " bytes" << (body.success ? "" : " (error)") << " after " << elapsed.count() << "ms\n";
+            if (body.success || elapsed < deadline || elapsed > (deadline + slack)) {
+                clientTestFailed = true;
+            }
+        }
+    }
+
+    co_await ExpectBody(client, port, "/ok", {}, "ok");
+    co_await ExpectBody(client, port, "/slow", {.connect = deadline, .firstByte = deadline * 4, .total = deadline * 4}, "slow");
+    client->Stop();
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8104, 30);
+    ClientTestServer server{};
+    ClientTestServer unaccepted{};
+    if (!server.Listen(port, 16) || !unaccepted.Listen(port + 1, 0)) {
+        return 1;
+    }
+    auto fillers = FillBacklog(port + 1);
+    server.Start([&server] () { Serve(server); });
+    auto client = HttpClient::Create();
+    client->SetTimeouts({.connect = deadline, .firstByte = deadline, .total = deadline * 2});
+    FireAndForget<task<void>>([client, port] () { return RunClient(client, port, port + 1); });
+    client->Run();
+    server.Stop();
+    for (auto fd : fillers) {
+        close(fd);
+    }
+    unaccepted.Stop();
+    return clientTestFailed ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <optional>
+#include "HttpClient.h"
+#include "Http1Chunked.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+}
+
+/*
+ * Uploads a large body from a source, with the chunked transfer coding and with a
+ * known length, to a plain socket server that stops reading for a while early on. The
+ * source must stop being asked for segments while the server is not reading, and the
+ * server checks the body and replies with the number of bytes it got. A source that
+ * ends before the announced length fails the request.
+ */
+
+constexpr size_t uploadSize = 64 * 1024 * 1024;
+constexpr size_t segmentSize = 64 * 1024;
+constexpr size_t pauseAfter = 1024 * 1024;
+constexpr size_t shortSize = 1024 * 1024;
+
+struct ClientUploadCase {
+    std::string path{};
+    bool chunked{false};
+    size_t announced{0};
+    size_t produce{0};
+    bool success{true};
+};
+
+static std::vector<ClientUploadCase> cases{
+    {.path = "/chunked", .chunked = true, .announced = uploadSize, .produce = uploadSize},
+    {.path = "/length", .chunked = false, .announced = uploadSize, .produce = uploadSize},
+    {.path = "/short", .chunked = false, .announced = uploadSize, .produce = shortSize, .success = false}
+};
+static std::atomic<size_t> produced{0};
+
+static char PatternAt(size_t offset) {
+    return (char) ('a' + (offset % 26));
+}
+
+/*
+ * The source is held back while the server does not read. The kernel may still grow
+ * the receive buffer of the server and take a little more, so the source may move by
+ * at most that buffer and a segment, far from the whole body.
+ */
+static void PauseReading(int fd, const std::string &path, size_t received) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(250));
+    auto early = produced.load();
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto late = produced.load();
+    int receiveBuffer{0};
+    socklen_t len{sizeof(receiveBuffer)};
+    getsockopt(fd, SOL_SOCKET, SO_RCVBUF, &receiveBuffer, &len);
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    std::cout << path << ": produced " << early << " and " << late << " bytes while " << received << " were received\n";
+    if ((late - early) > ((size_t) receiveBuffer + segmentSize) || late >= (uploadSize / 4)) {
+        std::cerr << path << ": the source was not held back while the server did not read\n";
+        clientTestFailed = true;
+    }
+}
+
+/*
+ * Reads the body of one upload, with the pause, and returns the number of body bytes
+ * that matched the pattern, or nothing if the body was broken or ended early.
+ */
+static std::optional<size_t> ReadUpload(int fd, std::string &buffered, bool chunked, size_t length, const std::string &path) {
+    Http1ChunkedDecoder decoder{};
+    size_t received{0};
+    bool paused{false};
+    char buf[65536];
+    while (true) {
+        std::string_view input{buffered};
+        while (chunked) {
+            auto event = decoder.Decode(input);
+            input.remove_prefix(event.consumed);
+            if (event.type == Http1ChunkedEventType::DATA) {
+                for (size_t i = 0; i < event.data.size(); i++) {
+                    if (event.data[i] != PatternAt(received + i)) {
+                        return {};
+                    }
+                }
+                received += event.data.size();
+            } else if (event.type == Http1ChunkedEventType::END) {
+                return received;
+            } else if (event.type == Http1ChunkedEventType::ERROR) {
+                return {};
+            } else if (event.type == Http1ChunkedEventType::NEED_MORE) {
+                break;
+            }
+        }
+        if (!chunked) {
+            auto size = input.size() < (length - received) ? input.size() : (length - received);
+            for (size_t i = 0; i < size; i++) {
+                if (input[i] != PatternAt(received + i)) {
+                    return {};
+                }
+            }
+            received += size;
+            input.remove_prefix(size);
+            if (received == length) {
+                return received;
+            }
+        }
+        buffered.erase(0, buffered.size() - input.size());
+        if (!paused && received >= pauseAfter && path != "/short") {
+            paused = true;
+            PauseReading(fd, path, received);
+        }
+        auto rd = read(fd, buf, sizeof(buf));
+        if (rd <= 0) {
+            return {};
+        }
+        buffered.append(buf, rd);
+    }
+}
+
+static void Serve(const ClientTestServer &server) {
+    std::vector<int> openFds{};
+    for (size_t i = 0; i < cases.size(); i++) {
+        int fd = server.Accept();
+        if (fd < 0) {
+            clientTestFailed = true;
+            break;
+        }
+        std::string buffered{};
+        auto head = ClientTestReadHead(fd, buffered);
+        if (head.empty()) {
+            clientTestFailed = true;
+            close(fd);
+            continue;
+        }
+        auto path = ClientTestRequestPath(head);
+        const ClientUploadCase *found{nullptr};
+        for (const auto &c : cases) {
+            if (c.path == path) {
+                found = &c;
+            }
+        }
+        bool chunked = head.find("Transfer-Encoding: chunked\r\n") != std::string::npos;
+        auto lengthHeader = "Content-Length: " + std::to_string(uploadSize) + "\r\n";
+        if (found == nullptr || chunked != found->chunked || (!chunked && head.find(lengthHeader) == std::string::npos)) {
+            std::cerr << "Unexpected request head:\n" << head;
+            clientTestFailed = true;
+            close(fd);
+            continue;
+        }
+        auto received = ReadUpload(fd, buffered, chunked, uploadSize, path);
+        if (received) {
+            auto count = std::to_string(*received);
+            ClientTestWriteAll(fd, "HTTP/1.1 200 OK\r\nContent-Length: " + std::to_string(count.size()) + "\r\n\r\n" + count);
+            openFds.emplace_back(fd);
+        } else {
+            std::cout << path << ": the upload was broken off\n";
+            close(fd);
+        }
+    }
+    for (auto fd : openFds) {
+        close(fd);
+    }
+}
+
+static task<HttpRequestBodySegment> NextSegment(size_t produce) {
+    auto offset = produced.load();
+    HttpRequestBodySegment segment{};
+    auto size = (produce - offset) < segmentSize ? (produce - offset) : segmentSize;
+    segment.data.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+        segment.data.push_back(PatternAt(offset + i));
+    }
+    produced += size;
+    segment.end = (offset + size) == produce;
+    co_return segment;
+}
+
+static task<void> RunClient(std::shared_ptr<HttpClient> client, int port) {
+    for (const auto &c : cases) {
+        produced = 0;
+        auto request = client->Request("POST", c.path);
+        auto produce = c.produce;
+        HttpRequestBodySource source{[produce] () {
+            return NextSegment(produce);
+        }};
+        if (c.chunked) {
+            request->SetContentSource(source, "application/octet-stream");
+        } else {
+            request->SetContentSource(source, "application/octet-stream", c.announced);
+        }
+        auto responseExpected = co_await client->Execute("127.0.0.1", port, request);
+        if (!responseExpected.has_value() || !responseExpected.value()) {
+            if (c.success) {
+                std::cerr << c.path << ": no response\n";
+                clientTestFailed = true;
+            }
+            continue;
+        }
+        if (!c.success) {
+            std::cerr << c.path << ": unexpected response\n";
+            clientTestFailed = true;
+            continue;
+        }
+        auto response = responseExpected.value();
+        auto body = co_await response->ResponseBody();
+        if (!body.success || body.body != std::to_string(uploadSize)) {
+            std::cerr << c.path << ": the server got " << body.body << " bytes\n";
+            clientTestFailed = true;
+        } else {
+            std::cout << c.path << ": uploaded " << body.body << " bytes\n";
+        }
+    }
+    client->Stop();
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8102, 60);
+    ClientTestServer server{};
+    if (!server.Listen(port, 16)) {
+        return 1;
+    }
+    server.Start([&server] () { Serve(server); });
+    auto client = HttpClient::Create();
+    FireAndForget<task<void>>([client, port] () { return RunClient(client, port); });
+    client->Run();
+    server.Stop();
+    return clientTestFailed ? 1 : 0;
+}
@@ -0,0 +1,140 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <atomic>
+#include "HttpClient.h"
+#include "ClientTestServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+}
+
+/*
+ * Spreads requests from a few concurrent workers over an upstream of plain socket
+ * servers that answer after different delays, keeping connections alive. The fast
+ * servers have to get most of the requests, over no more connections than there are
+ * workers. Halfway the slow server is replaced by another fast one while it has
+ * requests in flight: these have to complete, later requests must not go to it, and
+ * its idle connections have to be closed.
+ */
+
+constexpr size_t totalRequests = 400;
+constexpr size_t updateAfter = 200;
+constexpr size_t concurrency = 8;
+
+struct UpstreamServer {
+    char name;
+    int delay;
+    ClientTestServer listener{};
+    std::atomic<int> requests{0};
+    std::atomic<int> responses{0};
+    std::atomic<int> connections{0};
+    std::atomic<int> open{0};
+    std::atomic<int> before{0};
+    std::atomic<int> after{0};
+};
+
+static UpstreamServer servers[4]{{'A', 1}, {'B', 4}, {'C', 40}, {'D', 1}};
+static std::atomic<bool> updated{false};
+static std::atomic<size_t> started{0};
+static std::atomic<size_t> completed{0};
+static std::atomic<size_t> workersDone{0};
+
+static void ServeConnection(UpstreamServer &server, int fd) {
+    ++server.connections;
+    ++server.open;
+    std::string buffered{};
+    while (!ClientTestReadHead(fd, buffered).empty()) {
+        ++server.requests;
+        std::this_thread::sleep_for(std::chrono::milliseconds(server.delay));
+        if (!ClientTestWriteAll(fd, std::string("HTTP/1.1 200 OK\r\nContent-Length: 1\r\n\r\n") + server.name)) {
+            break;
+        }
+        ++server.responses;
+    }
+    --server.open;
+}
+
+static task<void> Finish(std::shared_ptr<HttpClient> client) {
+    for (int i = 0; i < 200 && servers[2].open > 0; i++) {
+        co_await ClientTestSleep(10);
+    }
+    for (auto &server : servers) {
+        std::cout << server.name << " (" << server.delay << "ms): " << server.before << " requests before and " << server.after
+                  << " after the update, " << server.connections << " connections, " << server.open << " open\n";
+        if (server.connections > (int) concurrency) {
+            std::cerr << server.name << ": connections were not reused\n";
+            clientTestFailed = true;
+        }
+    }
+    if (servers[0].before < 3 * servers[2].before || servers[2].before == 0) {
+        std::cerr << "The requests were not spread by the outstanding requests\n";
+        clientTestFailed = true;
+    }
+    if (servers[2].after > 0 || servers[3].after == 0 || servers[3].before > 0) {
+        std::cerr << "The update did not take effect\n";
+        clientTestFailed = true;
+    }
+    if (servers[2].open > 0) {
+        std::cerr << "The connections to the removed endpoint were not closed\n";
+        clientTestFailed = true;
+    }
+    client->Stop();
+}
+
+static task<void> Worker(std::shared_ptr<HttpClient> client, int port) {
+    while (started++ < totalRequests) {
+        bool afterUpdate = updated;
+        auto request = client->Request("GET", "/");
+        auto responseExpected = co_await client->ExecuteUpstream("replicas", request);
+        if (!responseExpected.has_value() || !responseExpected.value()) {
+            std::cerr << "No response\n";
+            clientTestFailed = true;
+            continue;
+        }
+        auto response = responseExpected.value();
+        auto body = co_await response->ResponseBody();
+        if (!body.success || body.body.size() != 1 || body.body[0] < 'A' || body.body[0] > 'D') {
+            std::cerr << "Unexpected body " << body.body << "\n";
+            clientTestFailed = true;
+            continue;
+        }
+        auto &server = servers[body.body[0] - 'A'];
+        ++(afterUpdate ? server.after : server.before);
+        if (++completed == updateAfter) {
+            std::cout << "C has " << (servers[2].requests - servers[2].responses) << " requests in flight at the update\n";
+            client->SetUpstream("replicas", {{"127.0.0.1", port}, {"127.0.0.1", port + 1}, {"127.0.0.1", port + 3}});
+            updated = true;
+        }
+    }
+    if (++workersDone == concurrency) {
+        co_await Finish(client);
+    }
+}
+
+int main(int argc, char **argv) {
+    int port = ClientTestPort(argc, argv, 8106, 60);
+    for (int i = 0; i < 4; i++) {
+        auto &server = servers[i];
+        if (!server.listener.Listen(port + i)) {
+            return 1;
+        }
+        server.listener.ServeConnections([&server] (int fd) { ServeConnection(server, fd); });
+    }
+    auto client = HttpClient::Create();
+    client->SetUpstream("replicas", {{"127.0.0.1", port}, {"127.0.0.1", port + 1}, {"127.0.0.1", port + 2}});
+    for (size_t i = 0; i < concurrency; i++) {
+        FireAndForget<task<void>>([client, port] () { return Worker(client, port); });
+    }
+    client->Run();
+    for (auto &server : servers) {
+        server.listener.Stop();
+    }
+    return clientTestFailed ? 1 : 0;
+}
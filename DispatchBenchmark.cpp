@@ -0,0 +1,143 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <condition_variable>
+#include "EchoServer.h"
+#include "NetwServer.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static uint64_t RunEcho(int port, const std::atomic<bool> &stop) {
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        return 0;
+    }
+    uint64_t roundTrips{0};
+    std::string message{"ping ping ping ping ping ping ping ping\n"};
+    std::string buf{};
+    buf.resize(message.size());
+    while (!stop) {
+        if (write(fd, message.data(), message.size()) != (ssize_t) message.size()) {
+            break;
+        }
+        size_t received{0};
+        while (received < message.size()) {
+            auto rd = read(fd, buf.data() + received, buf.size() - received);
+            if (rd <= 0) {
+                close(fd);
+                return roundTrips;
+            }
+            received += rd;
+        }
+        ++roundTrips;
+    }
+    close(fd);
+    return roundTrips;
+}
+
+/*
+ * Posts closures to the server run queue one at a time and records the time from the
+ * post until the closure runs.
+ */
+static std::vector<double> MeasureDispatch(NetwServer &server, int samples) {
+    std::vector<double> latencies{};
+    std::mutex mtx{};
+    std::condition_variable cond{};
+    for (int i = 0; i < samples; i++) {
+        bool done{false};
+        double latency{0};
+        auto posted = std::chrono::steady_clock::now();
+        server.Post([&mtx, &cond, &done, &latency, posted] () {
+            auto ran = std::chrono::steady_clock::now();
+            std::lock_guard lock{mtx};
+            latency = std::chrono::duration<double,std::micro>(ran - posted).count();
+            done = true;
+            cond.notify_one();
+        });
+        std::unique_lock lock{mtx};
+        cond.wait(lock, [&done] () { return done; });
+        latencies.emplace_back(latency);
+        lock.unlock();
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    std::sort(latencies.begin(), latencies.end());
+    return latencies;
+}
+
+static double Percentile(const std::vector<double> &sorted, double percentile) {
+    auto index = (size_t) (percentile * sorted.size());
+    if (index >= sorted.size()) {
+        index = sorted.size() - 1;
+    }
+    return sorted[index];
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8093;
+    int samples = argc > 2 ? std::stoi(argv[2]) : 2000;
+    constexpr int connections = 4;
+
+    auto server = NetwServer::Create(port, std::make_shared<EchoServer>());
+    server->SetRunnerThreads(2);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto idle = MeasureDispatch(*server, samples);
+    std::cout << "idle: p50 " << Percentile(idle, 0.5) << " us, p99 " << Percentile(idle, 0.99) << " us, max " << idle.back() << " us\n";
+
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> results{};
+    results.resize(connections);
+    std::vector<std::thread> clients{};
+    for (int i = 0; i < connections; i++) {
+        clients.emplace_back([&results, &stop, i, port] () {
+            results[i] = RunEcho(port, stop);
+        });
+    }
+    auto start = std::chrono::steady_clock::now();
+    auto loaded = MeasureDispatch(*server, samples);
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    stop = true;
+    for (auto &client : clients) {
+        client.join();
+    }
+    uint64_t roundTrips{0};
+    for (auto result : results) {
+        roundTrips += result;
+    }
+    std::cout << "loaded (" << (uint64_t) (roundTrips / elapsed) << " echo/s): p50 " << Percentile(loaded, 0.5) << " us, p99 " << Percentile(loaded, 0.99) << " us, max " << loaded.back() << " us\n";
+
+    int res = write(server->GetCommandFd(), "q", 1);
+    serverThread.join();
+
+    /* Before the wait was decoupled, posted work could sit behind a 10s poll timeout. */
+    return res != 1 || roundTrips == 0 || idle.back() >= 100000.0 ? 1 : 0;
+}
@@ -29,4 +29,7 @@ EchoServer::Create(const std::function<void(const std::string &)> &output, const
 
 void EchoServer::Release(NetwConnectionHandler *handler) {
     delete handler;
-}
\ No newline at end of file
+}
+
+void EchoServer::SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &) {
+}
@@ -11,6 +11,7 @@ class EchoServer : public NetwProtocolHandler {
 public:
     NetwConnectionHandler *Create(const std::function<void (const std::string &)> &output, const std::function<void ()> &close) override;
     void Release(NetwConnectionHandler *) override;
+    void SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &) override;
 };
 
 
@@ -4,18 +4,52 @@
 
 #include "Fd.h"
 #include <cstring>
+#include <cstddef>
 extern "C" {
 #include <unistd.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/ioctl.h>
+#include <sys/uio.h>
+#include <sys/sendfile.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <linux/errqueue.h>
+#include <linux/openat2.h>
+#include <sys/syscall.h>
 };
 
 const char *FdException::what() const noexcept {
     return errorMsg.c_str();
 }
 
+TimeoutException::TimeoutException() : FdException("Timed out", ETIMEDOUT) {
+}
+
+FdError FdError::FromErrno(int err) {
+    switch (err) {
+        case EAGAIN:
+#if EWOULDBLOCK != EAGAIN
+        case EWOULDBLOCK:
+#endif
+            return {.kind = FdErrorKind::WOULD_BLOCK, .err = err};
+        case ECONNRESET:
+        case EPIPE:
+            return {.kind = FdErrorKind::CONNECTION_RESET, .err = err};
+        default:
+            return {.kind = FdErrorKind::OTHER, .err = err};
+    }
+}
+
+void FdError::Throw() const {
+    if (kind == FdErrorKind::END_OF_FILE) {
+        throw EofException();
+    }
+    throw FdException();
+}
+
 Fd::Fd(int fd) : fd(fd) {}
 
 Fd &Fd::operator =(Fd &&mv) {
@@ -58,6 +92,93 @@ Fd Fd::InetSocket() {
     return {fd};
 }
 
+Fd Fd::UnixSocket() {
+    auto fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw FdException();
+    }
+    return {fd};
+}
+
+/*
+ * A path starting with '@' names a socket in the Linux abstract namespace, which has
+ * no file system entry.
+ */
+static socklen_t UnixAddress(const std::string &path, struct sockaddr_un &addr) {
+    addr.sun_family = AF_UNIX;
+    if (path.empty() || path.size() > sizeof(addr.sun_path) || (path.size() == sizeof(addr.sun_path) && path[0] != '@')) {
+        throw FdException("Invalid unix socket path");
+    }
+    memcpy(addr.sun_path, path.data(), path.size());
+    if (path[0] == '@') {
+        addr.sun_path[0] = '\0';
+        return (socklen_t) (offsetof(struct sockaddr_un, sun_path) + path.size());
+    }
+    if (path.size() < sizeof(addr.sun_path)) {
+        addr.sun_path[path.size()] = '\0';
+    }
+    return (socklen_t) sizeof(addr);
+}
+
+Fd Fd::OpenReadOnly(const std::string &path) {
+    auto fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return {};
+    }
+    return {fd};
+}
+
+Fd Fd::OpenDirectory(const std::string &path) {
+    auto fd = open(path.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0) {
+        return {};
+    }
+    return {fd};
+}
+
+/*
+ * Without openat2 each component is opened on its own and symbolic links are not
+ * followed at all.
+ */
+Fd Fd::OpenReadOnlyBeneath(const std::string &path) const {
+    struct open_how how{};
+    how.flags = O_RDONLY | O_CLOEXEC;
+    how.resolve = RESOLVE_BENEATH | RESOLVE_NO_MAGICLINKS;
+    auto file = (int) syscall(SYS_openat2, fd, path.c_str(), &how, sizeof(how));
+    if (file >= 0) {
+        return {file};
+    }
+    if (errno != ENOSYS) {
+        return {};
+    }
+    Fd dir{};
+    int dirFd{fd};
+    size_t start{0};
+    while (true) {
+        auto slash = path.find('/', start);
+        auto component = path.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+        if (component == "..") {
+            return {};
+        }
+        if (slash == std::string::npos) {
+            file = openat(dirFd, component.c_str(), O_RDONLY | O_CLOEXEC | O_NOFOLLOW);
+            if (file < 0) {
+                return {};
+            }
+            return {file};
+        }
+        if (!component.empty()) {
+            auto next = openat(dirFd, component.c_str(), O_PATH | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW);
+            if (next < 0) {
+                return {};
+            }
+            dir = Fd{next};
+            dirFd = dir.fd;
+        }
+        start = slash + 1;
+    }
+}
+
 void Fd::BindListen(int port) {
     struct sockaddr_in sin;
     sin.sin_family = AF_INET;
@@ -68,6 +189,14 @@ void Fd::BindListen(int port) {
     }
 }
 
+void Fd::BindUnix(const std::string &path) {
+    struct sockaddr_un addr{};
+    auto len = UnixAddress(path, addr);
+    if (bind(fd, (struct sockaddr *) &addr, len) < 0) {
+        throw FdException();
+    }
+}
+
 void Fd::Listen(int backlog) {
     if (listen(fd, backlog) != 0) {
         throw FdException();
@@ -91,11 +220,93 @@ void Fd::Connect(const void *ipaddr_norder, size_t ipaddr_size, int port) {
     } else {
         throw FdException("Unexpected address size");
     }
-    if (err < 0) {
+    /* A non-blocking socket completes the connection in the background */
+    if (err < 0 && errno != EINPROGRESS) {
+        throw FdException("connect() failed", errno);
+    }
+}
+
+void Fd::ConnectUnix(const std::string &path) {
+    struct sockaddr_un addr{};
+    auto len = UnixAddress(path, addr);
+    if (connect(fd, (struct sockaddr *) &addr, len) < 0) {
         throw FdException("connect() failed");
     }
 }
 
+std::expected<void,FdError> Fd::TryConnectUnix(const std::string &path) const {
+    struct sockaddr_un addr{};
+    auto len = UnixAddress(path, addr);
+    if (connect(fd, (struct sockaddr *) &addr, len) < 0) {
+        return std::unexpected(FdError::FromErrno(errno));
+    }
+    return {};
+}
+
+int Fd::GetSocketDomain() const {
+    int domain{0};
+    socklen_t len{sizeof(domain)};
+    if (getsockopt(fd, SOL_SOCKET, SO_DOMAIN, &domain, &len) != 0) {
+        throw FdException();
+    }
+    return domain;
+}
+
+/*
+ * Passes a duplicate of the descriptor over a unix domain socket with SCM_RIGHTS. The
+ * receiving process gets its own descriptor for the same open socket or file.
+ */
+void Fd::SendDescriptor(const Fd &descriptor) const {
+    char data{'f'};
+    struct iovec iov{.iov_base = &data, .iov_len = 1};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+    memcpy(CMSG_DATA(cmsg), &(descriptor.fd), sizeof(int));
+    while (sendmsg(fd, &msg, 0) != 1) {
+        if (errno != EINTR) {
+            throw FdException("sendmsg() failed");
+        }
+    }
+}
+
+Fd Fd::ReceiveDescriptor() const {
+    char data{0};
+    struct iovec iov{.iov_base = &data, .iov_len = 1};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int))]{};
+    struct msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    while (true) {
+        auto res = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        if (res > 0) {
+            break;
+        }
+        if (res == 0) {
+            throw EofException();
+        }
+        if (errno != EINTR) {
+            throw FdException("recvmsg() failed");
+        }
+    }
+    auto *cmsg = CMSG_FIRSTHDR(&msg);
+    if (cmsg == nullptr || cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS || cmsg->cmsg_len != CMSG_LEN(sizeof(int))) {
+        throw FdException("No descriptor received");
+    }
+    int received{-1};
+    memcpy(&received, CMSG_DATA(cmsg), sizeof(int));
+    return {received};
+}
+
 void Fd::SetNonblocking() {
     auto flags = fcntl(fd, F_GETFL);
     if (flags == -1) {
@@ -106,6 +317,56 @@ void Fd::SetNonblocking() {
     }
 }
 
+void Fd::SetSocketOption(int level, int name, int value) {
+    if (setsockopt(fd, level, name, &value, sizeof(value)) != 0) {
+        throw FdException();
+    }
+}
+
+void Fd::SetTcpNoDelay(bool noDelay) {
+    SetSocketOption(IPPROTO_TCP, TCP_NODELAY, noDelay ? 1 : 0);
+}
+
+void Fd::SetReuseAddress(bool reuse) {
+    SetSocketOption(SOL_SOCKET, SO_REUSEADDR, reuse ? 1 : 0);
+}
+
+void Fd::SetReceiveBufferSize(int size) {
+    SetSocketOption(SOL_SOCKET, SO_RCVBUF, size);
+}
+
+void Fd::SetSendBufferSize(int size) {
+    SetSocketOption(SOL_SOCKET, SO_SNDBUF, size);
+}
+
+void Fd::SetKeepAlive(bool keepAlive, int idleSeconds, int intervalSeconds, int count) {
+    SetSocketOption(SOL_SOCKET, SO_KEEPALIVE, keepAlive ? 1 : 0);
+    if (!keepAlive) {
+        return;
+    }
+    if (idleSeconds > 0) {
+        SetSocketOption(IPPROTO_TCP, TCP_KEEPIDLE, idleSeconds);
+    }
+    if (intervalSeconds > 0) {
+        SetSocketOption(IPPROTO_TCP, TCP_KEEPINTVL, intervalSeconds);
+    }
+    if (count > 0) {
+        SetSocketOption(IPPROTO_TCP, TCP_KEEPCNT, count);
+    }
+}
+
+void Fd::SetDeferAccept(int seconds) {
+    SetSocketOption(IPPROTO_TCP, TCP_DEFER_ACCEPT, seconds);
+}
+
+void Fd::SetUserTimeout(unsigned int timeoutMs) {
+    SetSocketOption(IPPROTO_TCP, TCP_USER_TIMEOUT, (int) timeoutMs);
+}
+
+void Fd::SetZeroCopy(bool zeroCopy) {
+    SetSocketOption(SOL_SOCKET, SO_ZEROCOPY, zeroCopy ? 1 : 0);
+}
+
 Fd Fd::Accept() {
     int cfd = accept(fd, NULL, NULL);
     if (cfd < 0) {
@@ -114,34 +375,197 @@ Fd Fd::Accept() {
     return {cfd};
 }
 
-size_t Fd::Write(const void *ptr, size_t size) const {
+std::expected<Fd,FdError> Fd::TryAccept() const {
+    while (true) {
+        int cfd = accept4(fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd >= 0) {
+            return Fd(cfd);
+        }
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+std::expected<size_t,FdError> Fd::TryWrite(const void *ptr, size_t size) const {
     if (size <= 0) {
         return 0;
     }
-    auto res = write(fd, ptr, size);
-    if (res >= 0) {
-        return res;
-    } else {
-        if (errno == EAGAIN) {
-            return 0;
+    while (true) {
+        auto res = write(fd, ptr, size);
+        if (res >= 0) {
+            return res;
         }
-        throw FdException();
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+std::expected<size_t,FdError> Fd::TryRead(void *ptr, size_t size) const {
+    if (size <= 0) {
+        return 0;
+    }
+    while (true) {
+        auto res = read(fd, ptr, size);
+        if (res > 0) {
+            return res;
+        } else if (res == 0) {
+            return std::unexpected(FdError{.kind = FdErrorKind::END_OF_FILE, .err = 0});
+        }
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+std::expected<size_t,FdError> Fd::TryWritev(const struct iovec *iov, int iovcnt) const {
+    if (iovcnt <= 0) {
+        return 0;
+    }
+    while (true) {
+        auto res = writev(fd, iov, iovcnt);
+        if (res >= 0) {
+            return res;
+        }
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+std::expected<size_t,FdError> Fd::TryReadv(const struct iovec *iov, int iovcnt) const {
+    if (iovcnt <= 0) {
+        return 0;
+    }
+    while (true) {
+        auto res = readv(fd, iov, iovcnt);
+        if (res > 0) {
+            return res;
+        } else if (res == 0) {
+            return std::unexpected(FdError{.kind = FdErrorKind::END_OF_FILE, .err = 0});
+        }
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+size_t Fd::Write(const void *ptr, size_t size) const {
+    auto res = TryWrite(ptr, size);
+    if (res) {
+        return *res;
     }
+    if (res.error().IsWouldBlock()) {
+        return 0;
+    }
+    res.error().Throw();
 }
 
 size_t Fd::Read(void *ptr, size_t size) const {
+    auto res = TryRead(ptr, size);
+    if (res) {
+        return *res;
+    }
+    if (res.error().IsWouldBlock()) {
+        return 0;
+    }
+    res.error().Throw();
+}
+
+std::expected<size_t,FdError> Fd::TrySendFile(const Fd &input, uint64_t &offset, size_t size) const {
     if (size <= 0) {
         return 0;
     }
-    auto res = read(fd, ptr, size);
+    while (true) {
+        off_t off = (off_t) offset;
+        auto res = sendfile(fd, input.fd, &off, size);
+        if (res > 0) {
+            offset = (uint64_t) off;
+            return res;
+        } else if (res == 0) {
+            return std::unexpected(FdError{.kind = FdErrorKind::END_OF_FILE, .err = 0});
+        }
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+/*
+ * The pages of the buffer are pinned and must not change until the kernel has reported
+ * the send as completed on the error queue.
+ */
+std::expected<size_t,FdError> Fd::TrySendZeroCopy(const void *ptr, size_t size) const {
+    if (size <= 0) {
+        return 0;
+    }
+    while (true) {
+        auto res = send(fd, ptr, size, MSG_ZEROCOPY);
+        if (res >= 0) {
+            return res;
+        }
+        if (errno != EINTR) {
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+    }
+}
+
+std::expected<FdZeroCopyCompletion,FdError> Fd::TryReadZeroCopyCompletion() const {
+    while (true) {
+        char control[128];
+        struct msghdr msg{};
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        auto res = recvmsg(fd, &msg, MSG_ERRQUEUE);
+        if (res < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return std::unexpected(FdError::FromErrno(errno));
+        }
+        for (auto *cmsg = CMSG_FIRSTHDR(&msg); cmsg != nullptr; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (!((cmsg->cmsg_level == SOL_IP && cmsg->cmsg_type == IP_RECVERR) || (cmsg->cmsg_level == SOL_IPV6 && cmsg->cmsg_type == IPV6_RECVERR))) {
+                continue;
+            }
+            struct sock_extended_err serr{};
+            memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
+            if (serr.ee_origin == SO_EE_ORIGIN_ZEROCOPY && serr.ee_errno == 0) {
+                return FdZeroCopyCompletion{.first = serr.ee_info, .last = serr.ee_data, .copied = (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0};
+            }
+        }
+    }
+}
+
+size_t Fd::SendFile(const Fd &input, uint64_t &offset, size_t size) const {
+    auto res = TrySendFile(input, offset, size);
+    if (res) {
+        return *res;
+    }
+    if (res.error().IsWouldBlock()) {
+        return 0;
+    }
+    res.error().Throw();
+}
+
+size_t Fd::ReadAt(void *ptr, size_t size, uint64_t offset) const {
+    if (size <= 0) {
+        return 0;
+    }
+    auto res = pread(fd, ptr, size, (off_t) offset);
     if (res > 0) {
         return res;
     } else if (res == 0) {
         throw EofException();
     } else {
-        if (errno == EAGAIN) {
-            return 0;
-        }
         throw FdException();
     }
 }
+
+size_t Fd::ReadableBytes() const {
+    int available{0};
+    if (ioctl(fd, FIONREAD, &available) != 0 || available < 0) {
+        return 0;
+    }
+    return (size_t) available;
+}
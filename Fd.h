@@ -9,14 +9,26 @@
 #include <tuple>
 #include <exception>
 #include <string>
+#include <memory>
+#include <expected>
+#include <limits>
+#include <cstdint>
 
 class FdException : public std::exception {
 private:
     std::string errorMsg;
+    int err{0};
 public:
     FdException() : errorMsg("Input output error") {}
     FdException(const std::string &errorMsg) : errorMsg(errorMsg) {}
+    FdException(const std::string &errorMsg, int err) : errorMsg(errorMsg), err(err) {}
     const char * what() const noexcept override;
+    /*
+     * The errno value for the error, or 0 when there is none.
+     */
+    int GetErrno() const {
+        return err;
+    }
 };
 
 class EofException : public FdException {
@@ -24,6 +36,50 @@ public:
     EofException() : FdException("End of file") {}
 };
 
+class TimeoutException : public FdException {
+public:
+    TimeoutException();
+};
+
+enum class FdErrorKind {
+    END_OF_FILE, WOULD_BLOCK, CONNECTION_RESET, OTHER
+};
+
+/*
+ * Error value of the Try* I/O functions. err is the errno value, or 0 for end of file.
+ */
+struct FdError {
+    FdErrorKind kind{FdErrorKind::OTHER};
+    int err{0};
+    static FdError FromErrno(int err);
+    bool IsWouldBlock() const {
+        return kind == FdErrorKind::WOULD_BLOCK;
+    }
+    [[noreturn]] void Throw() const;
+};
+
+class Fd;
+
+extern "C" {
+struct iovec;
+};
+
+/*
+ * Range of MSG_ZEROCOPY sends released by the kernel. Sends are numbered per socket
+ * from zero. copied is set when the kernel copied the data after all, e.g. on loopback.
+ */
+struct FdZeroCopyCompletion {
+    uint32_t first{0};
+    uint32_t last{0};
+    bool copied{false};
+};
+
+struct FdFileRange {
+    std::shared_ptr<const Fd> fd;
+    uint64_t offset{0};
+    uint64_t length{0};
+};
+
 class Fd {
 private:
     int fd;
@@ -31,6 +87,7 @@ public:
     Fd() : fd(-1) {}
 protected:
     Fd(int fd);
+    void SetSocketOption(int level, int name, int value);
 public:
     bool IsValid() const {
         return fd >= 0;
@@ -44,15 +101,52 @@ public:
     ~Fd();
     static std::tuple<Fd,Fd> Pipe(bool closeOnExec = true, bool nonblock = false);
     static Fd InetSocket();
+    static Fd UnixSocket();
+    static Fd OpenReadOnly(const std::string &path);
+    static Fd OpenDirectory(const std::string &path);
+    /*
+     * Opens a path relative to this directory, symbolic links are followed only while
+     * they stay beneath it.
+     */
+    Fd OpenReadOnlyBeneath(const std::string &path) const;
     void BindListen(int port);
+    void BindUnix(const std::string &path);
     void Listen(int backlog);
     void Connect(const void *ipaddr_norder, size_t ipaddr_size, int port);
+    void ConnectUnix(const std::string &path);
+    /*
+     * A non-blocking unix domain socket connect either completes at once or fails with
+     * would-block when the backlog of the listener is full, and is then tried again.
+     */
+    std::expected<void,FdError> TryConnectUnix(const std::string &path) const;
+    int GetSocketDomain() const;
+    void SendDescriptor(const Fd &descriptor) const;
+    Fd ReceiveDescriptor() const;
     void SetNonblocking();
+    void SetTcpNoDelay(bool noDelay = true);
+    void SetReuseAddress(bool reuse = true);
+    void SetReceiveBufferSize(int size);
+    void SetSendBufferSize(int size);
+    void SetKeepAlive(bool keepAlive, int idleSeconds = 0, int intervalSeconds = 0, int count = 0);
+    void SetDeferAccept(int seconds);
+    void SetUserTimeout(unsigned int timeoutMs);
+    void SetZeroCopy(bool zeroCopy = true);
     Fd Accept();
+    std::expected<Fd,FdError> TryAccept() const;
+    size_t SendFile(const Fd &input, uint64_t &offset, size_t size) const;
+    std::expected<size_t,FdError> TrySendFile(const Fd &input, uint64_t &offset, size_t size) const;
+    std::expected<size_t,FdError> TrySendZeroCopy(const void *ptr, size_t size) const;
+    std::expected<FdZeroCopyCompletion,FdError> TryReadZeroCopyCompletion() const;
+    size_t ReadAt(void *ptr, size_t size, uint64_t offset) const;
+    size_t ReadableBytes() const;
+    std::expected<size_t,FdError> TryReadv(const struct iovec *iov, int iovcnt) const;
+    std::expected<size_t,FdError> TryWritev(const struct iovec *iov, int iovcnt) const;
 protected:
     size_t Write(const void *ptr, size_t size) const;
     size_t Read(void *ptr, size_t size) const;
-    template <class T> constexpr size_t FinalIoSize(T input, T::size_type offset, T::size_type size) const {
+    std::expected<size_t,FdError> TryWrite(const void *ptr, size_t size) const;
+    std::expected<size_t,FdError> TryRead(void *ptr, size_t size) const;
+    template <class T> constexpr size_t FinalIoSize(const T &input, T::size_type offset, T::size_type size) const {
         if (offset >= input.size()) {
             return 0;
         }
@@ -79,6 +173,12 @@ public:
     template <class T> size_t Read(T &output, T::size_type offset = 0, T::size_type size = std::numeric_limits<typename T::size_type>::max()) const {
         return Read(output.data() + offset, FinalIoSize(output, offset, size));
     }
+    template <class T> std::expected<size_t,FdError> TryWrite(const T &input, T::size_type offset = 0, T::size_type size = std::numeric_limits<typename T::size_type>::max()) const {
+        return TryWrite(input.data() + offset, FinalIoSize(input, offset, size));
+    }
+    template <class T> std::expected<size_t,FdError> TryRead(T &output, T::size_type offset = 0, T::size_type size = std::numeric_limits<typename T::size_type>::max()) const {
+        return TryRead(output.data() + offset, FinalIoSize(output, offset, size));
+    }
     operator decltype(fd) ()const  {
         return fd;
     }
@@ -0,0 +1,248 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <atomic>
+#include "HttpServer.h"
+#include "HttpRouter.h"
+extern "C" {
+#include <unistd.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+/*
+ * Hands the listen socket over from this process to a forked successor while a client
+ * keeps opening new connections. No connection may fail, the in-flight request on the
+ * old process must complete, and its idle keep-alive connection must be closed, as must
+ * a connection that never sent a request, without waiting for the drain deadline.
+ */
+
+static std::shared_ptr<HttpServer> server{};
+
+static task<void> Pid(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent(std::to_string(getpid()), "text/plain");
+    request->Respond(response);
+    co_return;
+}
+
+static task<void> Slow(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    std::thread responder{[request] () {
+        std::this_thread::sleep_for(std::chrono::milliseconds(500));
+        auto response = std::make_shared<HttpResponse>(200, "OK");
+        response->SetContent("slow", "text/plain");
+        request->Respond(response);
+    }};
+    responder.detach();
+    co_return;
+}
+
+static task<void> Quit(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent("bye", "text/plain");
+    request->Respond(response);
+    server->Drain(std::chrono::milliseconds(2000));
+    co_return;
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static bool ReadResponse(int fd, std::string &body) {
+    std::string input{};
+    std::string buf{};
+    buf.resize(4096);
+    while (true) {
+        auto headEnd = input.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            auto lengthPos = input.find("Content-Length: ");
+            size_t contentLength{0};
+            if (lengthPos != std::string::npos && lengthPos < headEnd) {
+                contentLength = std::stoul(input.substr(lengthPos + 16));
+            }
+            if (input.size() >= headEnd + 4 + contentLength) {
+                body = input.substr(headEnd + 4, contentLength);
+                return true;
+            }
+        }
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        input.append(buf.data(), rd);
+    }
+}
+
+static bool Request(int fd, const std::string &path, std::string &body) {
+    std::string request{"GET "};
+    request.append(path);
+    request.append(" HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    return write(fd, request.data(), request.size()) == (ssize_t) request.size() && ReadResponse(fd, body);
+}
+
+static int RunSuccessor(int readyFd, const std::string &handOffPath) {
+    char ch;
+    if (read(readyFd, &ch, 1) != 1) {
+        return 1;
+    }
+    server = HttpServer::CreateHandOff(handOffPath);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/pid", Pid);
+    router->Add("GET", "/quit", Quit);
+    server->SetRouter(router);
+    server->Run();
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8098;
+    std::string handOffPath{"@libhttptooling-handoff-"};
+    handOffPath.append(std::to_string(getpid()));
+    alarm(60);
+
+    int ready[2];
+    if (pipe(ready) != 0) {
+        return 1;
+    }
+    auto successorPid = fork();
+    if (successorPid < 0) {
+        return 1;
+    }
+    if (successorPid == 0) {
+        close(ready[1]);
+        _exit(RunSuccessor(ready[0], handOffPath));
+    }
+    close(ready[0]);
+    auto pid = std::to_string(getpid());
+    auto successor = std::to_string(successorPid);
+
+    server = HttpServer::Create(port);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/pid", Pid);
+    router->Add("GET", "/slow", Slow);
+    server->SetRouter(router);
+    server->EnableHandOff(handOffPath, std::chrono::milliseconds(5000));
+    std::thread serverThread{[] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bool failed{false};
+    std::string body{};
+    int idle = ConnectLoopback(port);
+    if (idle < 0 || !Request(idle, "/pid", body) || body != pid) {
+        std::cerr << "Keep-alive request to the old process failed\n";
+        failed = true;
+    }
+    int preopened = ConnectLoopback(port);
+    if (preopened < 0) {
+        std::cerr << "Connection without a request failed\n";
+        failed = true;
+    }
+    int inflight = ConnectLoopback(port);
+    std::string slowRequest{"GET /slow HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+    if (inflight < 0 || write(inflight, slowRequest.data(), slowRequest.size()) != (ssize_t) slowRequest.size()) {
+        std::cerr << "Slow request failed\n";
+        failed = true;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    std::atomic<bool> stop{false};
+    std::atomic<bool> successorSeen{false};
+    uint64_t probes{0};
+    uint64_t probeFailures{0};
+    std::thread prober{[&] () {
+        while (!stop) {
+            int fd = ConnectLoopback(port);
+            std::string probeBody{};
+            if (fd < 0 || !Request(fd, "/pid", probeBody) || (probeBody != pid && probeBody != successor)) {
+                ++probeFailures;
+            } else if (probeBody == successor) {
+                successorSeen = true;
+            }
+            if (fd >= 0) {
+                close(fd);
+            }
+            ++probes;
+        }
+    }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto handOffStart = std::chrono::steady_clock::now();
+    if (write(ready[1], "h", 1) != 1) {
+        failed = true;
+    }
+    for (int i = 0; i < 500 && !successorSeen; i++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    if (!successorSeen) {
+        std::cerr << "The successor did not take over\n";
+        failed = true;
+    }
+
+    if (inflight < 0 || !ReadResponse(inflight, body) || body != "slow") {
+        std::cerr << "In-flight request was not completed by the old process\n";
+        failed = true;
+    }
+    char ch;
+    if (idle >= 0 && read(idle, &ch, 1) != 0) {
+        std::cerr << "Idle keep-alive connection was not closed\n";
+        failed = true;
+    }
+    if (preopened >= 0 && (read(preopened, &ch, 1) != 0 || std::chrono::steady_clock::now() - handOffStart > std::chrono::milliseconds(2500))) {
+        std::cerr << "Connection without a request was not closed by the drain\n";
+        failed = true;
+    }
+    serverThread.join();
+    server = {};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    stop = true;
+    prober.join();
+    if (probeFailures > 0) {
+        std::cerr << probeFailures << " of " << probes << " connections failed during the hand off\n";
+        failed = true;
+    }
+
+    int quit = ConnectLoopback(port);
+    if (quit < 0 || !Request(quit, "/quit", body) || body != "bye") {
+        std::cerr << "Successor did not respond after the old process exited\n";
+        failed = true;
+        kill(successorPid, SIGTERM);
+    }
+    int status{0};
+    if (waitpid(successorPid, &status, 0) != successorPid || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        std::cerr << "Successor did not exit cleanly\n";
+        failed = true;
+    }
+    if (idle >= 0) {
+        close(idle);
+    }
+    if (preopened >= 0) {
+        close(preopened);
+    }
+    if (inflight >= 0) {
+        close(inflight);
+    }
+    if (quit >= 0) {
+        close(quit);
+    }
+    std::cout << probes << " connections during the hand off, " << probeFailures << " failed\n";
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,184 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "Http1Chunked.h"
+#include <string>
+extern "C" {
+#include <sys/uio.h>
+}
+
+static_assert(Http1ChunkSizeLine(0).View() == "0\r\n");
+static_assert(Http1ChunkSizeLine(1).View() == "1\r\n");
+static_assert(Http1ChunkSizeLine(15).View() == "f\r\n");
+static_assert(Http1ChunkSizeLine(16).View() == "10\r\n");
+static_assert(Http1ChunkSizeLine(0x1f).View() == "1f\r\n");
+static_assert(Http1ChunkSizeLine(65536).View() == "10000\r\n");
+static_assert(Http1ChunkSizeLine((size_t) -1).View() == "ffffffffffffffff\r\n");
+
+/*
+ * Decodes the input given step bytes more at a time, keeping what the decoder did not
+ * consume, like a reader appending to a buffer does. The trailers are appended to
+ * trailers as "name=value;", and the input after the body has to be expectedRest.
+ */
+constexpr bool TestHttp1ChunkedDecoder(std::string_view input, size_t step, std::string_view expectedBody, std::string_view expectedTrailers, std::string_view expectedExtensions = {}, std::string_view expectedRest = {}) {
+    Http1ChunkedDecoder decoder{};
+    std::string buffered{};
+    std::string body{};
+    std::string trailers{};
+    std::string extensions{};
+    size_t offset{0};
+    while (true) {
+        auto event = decoder.Decode(buffered);
+        switch (event.type) {
+            case Http1ChunkedEventType::CHUNK:
+                extensions.append(event.data);
+                break;
+            case Http1ChunkedEventType::DATA:
+                body.append(event.data);
+                break;
+            case Http1ChunkedEventType::TRAILER:
+                trailers.append(event.trailer.GetHeader());
+                trailers.append("=");
+                trailers.append(event.trailer.GetValue());
+                trailers.append(";");
+                break;
+            case Http1ChunkedEventType::END:
+                buffered.erase(0, event.consumed);
+                buffered.append(input.substr(offset));
+                return buffered == expectedRest && body == expectedBody && trailers == expectedTrailers && extensions == expectedExtensions;
+            case Http1ChunkedEventType::ERROR:
+                return false;
+            case Http1ChunkedEventType::NEED_MORE:
+                if (offset >= input.size()) {
+                    return false;
+                }
+                buffered.append(input.substr(offset, step));
+                offset += input.substr(offset, step).size();
+                break;
+        }
+        buffered.erase(0, event.consumed);
+    }
+}
+
+constexpr bool TestHttp1ChunkedDecoderSteps(std::string_view input, std::string_view expectedBody, std::string_view expectedTrailers, std::string_view expectedExtensions = {}, std::string_view expectedRest = {}) {
+    for (size_t step = 1; step <= input.size(); step++) {
+        if (!TestHttp1ChunkedDecoder(input, step, expectedBody, expectedTrailers, expectedExtensions, expectedRest)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*
+ * True when the decoder rejects the input, whole or a byte at a time.
+ */
+constexpr bool TestHttp1ChunkedDecoderRejects(std::string_view input) {
+    {
+        Http1ChunkedDecoder decoder{};
+        Http1ChunkedEvent event{};
+        auto remaining = input;
+        do {
+            event = decoder.Decode(remaining);
+            remaining.remove_prefix(event.consumed);
+        } while (event.type != Http1ChunkedEventType::ERROR && event.type != Http1ChunkedEventType::END && event.type != Http1ChunkedEventType::NEED_MORE);
+        if (event.type != Http1ChunkedEventType::ERROR) {
+            return false;
+        }
+    }
+    return !TestHttp1ChunkedDecoder(input, 1, {}, {});
+}
+
+static_assert(TestHttp1ChunkedDecoderSteps("0\r\n\r\n", "", ""));
+static_assert(TestHttp1ChunkedDecoderSteps("1f\r\n012345678901234567890123456789s\r\n0\r\n\r\n", "012345678901234567890123456789s", ""));
+static_assert(TestHttp1ChunkedDecoderSteps("5\r\nhello\r\n1\r\n \r\n5\r\nworld\r\n0\r\n\r\n", "hello world", ""));
+static_assert(TestHttp1ChunkedDecoderSteps("A\r\n0123456789\r\na\r\n0123456789\r\n0\r\n\r\n", "01234567890123456789", ""));
+static_assert(TestHttp1ChunkedDecoderSteps("5\nhello\n0\n\n", "hello", ""));
+static_assert(TestHttp1ChunkedDecoderSteps("5;name=value\r\nhello\r\n0 ;last\r\n\r\n", "hello", "", "name=valuelast"));
+static_assert(TestHttp1ChunkedDecoderSteps("5\r\nhello\r\n0\r\nExpires: never\r\nX-Checksum:  abc \r\n\r\n", "hello", "Expires=never;X-Checksum=abc;"));
+static_assert(TestHttp1ChunkedDecoderSteps("5\r\nhello\r\n0\r\n\r\nGET / HTTP/1.1\r\n", "hello", "", "", "GET / HTTP/1.1\r\n"));
+static_assert(TestHttp1ChunkedDecoderSteps("000000000000005\r\nhello\r\n0\r\n\r\n", "hello", ""));
+
+static_assert(TestHttp1ChunkedDecoderRejects("\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("x\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("5 x\r\nhello\r\n0\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("5\r\nhelloX\r\n0\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("5\r\nhello\rX0\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("10000000000000000\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("000000000000000000005\r\nhello\r\n0\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("5;a\x01\r\nhello\r\n0\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("0\r\nNo colon\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("0\r\n: empty\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("0\r\nBad name: value\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderRejects("0\r\nName: value\r\n folded\r\n\r\n"));
+
+/*
+ * A size line that does not end within the lookahead is rejected, no matter how the
+ * input is split.
+ */
+constexpr bool TestHttp1ChunkedDecoderLookahead() {
+    std::string input{"5;"};
+    input.append(http1ChunkedMaxLine, 'x');
+    Http1ChunkedDecoder decoder{};
+    if (decoder.Decode(std::string_view(input).substr(0, http1ChunkedMaxLine)).type != Http1ChunkedEventType::NEED_MORE) {
+        return false;
+    }
+    return decoder.Decode(input).type == Http1ChunkedEventType::ERROR && decoder.IsFailed();
+}
+
+static_assert(TestHttp1ChunkedDecoderLookahead());
+
+/*
+ * The decoder and Http1Chunk agree on a single chunk.
+ */
+constexpr bool TestHttp1ChunkedDecoderChunk(std::string_view input) {
+    Http1Chunk chunk{std::string(input), true};
+    Http1ChunkedDecoder decoder{};
+    auto event = decoder.Decode(input);
+    if (!chunk.IsValid() || event.type != Http1ChunkedEventType::CHUNK) {
+        return false;
+    }
+    auto consumed = event.consumed;
+    std::string body{};
+    event = decoder.Decode(input.substr(consumed));
+    if (event.type == Http1ChunkedEventType::DATA) {
+        body.append(event.data);
+        consumed += event.consumed;
+        event = decoder.Decode(input.substr(consumed));
+        consumed += event.consumed;
+    } else if (event.type == Http1ChunkedEventType::END) {
+        consumed += event.consumed;
+    }
+    return body == chunk.GetChunk() && consumed == chunk.GetConsumedBytes();
+}
+
+static_assert(TestHttp1ChunkedDecoderChunk("0\r\n\r\n"));
+static_assert(TestHttp1ChunkedDecoderChunk("1f\r\n012345678901234567890123456789s\r\n"));
+static_assert(TestHttp1ChunkedDecoderChunk("3\r\nabc\r\n"));
+
+size_t Http1ChunkedEncoder::Chunk(Http1ChunkSizeLine &sizeLine, std::string_view payload, struct iovec *iov) {
+    if (payload.empty()) {
+        return 0;
+    }
+    sizeLine = Http1ChunkSizeLine(payload.size());
+    iov[0] = {.iov_base = sizeLine.line, .iov_len = sizeLine.size};
+    iov[1] = {.iov_base = const_cast<char *>(payload.data()), .iov_len = payload.size()};
+    iov[2] = {.iov_base = const_cast<char *>(sizeLine.line + sizeLine.size - 2), .iov_len = 2};
+    return chunkSegments;
+}
+
+size_t Http1ChunkedEncoder::End(std::span<const Http1HeaderView> trailers, struct iovec *iov) {
+    static constexpr std::string_view lastChunk{"0\r\n"};
+    static constexpr std::string_view separator{": "};
+    static constexpr std::string_view crLf{"\r\n"};
+    size_t segments{0};
+    iov[segments++] = {.iov_base = const_cast<char *>(lastChunk.data()), .iov_len = lastChunk.size()};
+    for (const auto &trailer : trailers) {
+        iov[segments++] = {.iov_base = const_cast<char *>(trailer.header.data()), .iov_len = trailer.header.size()};
+        iov[segments++] = {.iov_base = const_cast<char *>(separator.data()), .iov_len = separator.size()};
+        iov[segments++] = {.iov_base = const_cast<char *>(trailer.value.data()), .iov_len = trailer.value.size()};
+        iov[segments++] = {.iov_base = const_cast<char *>(crLf.data()), .iov_len = crLf.size()};
+    }
+    iov[segments++] = {.iov_base = const_cast<char *>(crLf.data()), .iov_len = crLf.size()};
+    return segments;
+}
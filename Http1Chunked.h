@@ -0,0 +1,291 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTP1CHUNKED_H
+#define LIBHTTPTOOLING_HTTP1CHUNKED_H
+
+#include <string_view>
+#include <span>
+#include <bit>
+#include <cstddef>
+#include "Http1Protocol.h"
+
+extern "C" {
+struct iovec;
+};
+
+/*
+ * Longest size line, with chunk extensions, and longest trailer line the decoder looks
+ * ahead for, and the most trailer data it accepts in total.
+ */
+constexpr size_t http1ChunkedMaxLine = 4096;
+constexpr size_t http1ChunkedMaxTrailers = 16384;
+
+enum class Http1ChunkedEventType {
+    NEED_MORE,
+    CHUNK,
+    DATA,
+    TRAILER,
+    END,
+    ERROR
+};
+
+/*
+ * One step of the decoder. consumed is the number of input bytes that are done with,
+ * the rest has to be passed in again, followed by more input. data is the body data
+ * for DATA and the extensions after the first ';' for CHUNK, and trailer is set for
+ * TRAILER. The views point into the input.
+ */
+struct Http1ChunkedEvent {
+    Http1ChunkedEventType type{Http1ChunkedEventType::NEED_MORE};
+    size_t consumed{0};
+    size_t chunkSize{0};
+    std::string_view data{};
+    Http1HeaderView trailer{};
+};
+
+/*
+ * Streaming decoder for the chunked transfer coding. Each call to Decode returns at
+ * most one event, body data is returned as it arrives without waiting for the rest of
+ * the chunk. Size lines and trailer lines are only consumed when they are complete,
+ * and if one is longer than http1ChunkedMaxLine the input is rejected. Lines end with
+ * CRLF or LF.
+ */
+class Http1ChunkedDecoder {
+private:
+    enum class State {
+        SIZE_LINE,
+        DATA,
+        DATA_END,
+        TRAILER,
+        DONE,
+        FAILED
+    };
+    State state{State::SIZE_LINE};
+    size_t remaining{0};
+    size_t trailerBytes{0};
+    static constexpr bool IsSpace(char ch) {
+        return ch == ' ' || ch == '\t';
+    }
+    static constexpr bool IsControl(char ch) {
+        return (ch >= 0 && ch < ' ' && ch != '\t') || ch == 0x7f;
+    }
+    static constexpr int HexValue(char ch) {
+        if (ch >= '0' && ch <= '9') {
+            return ch - '0';
+        } else if (ch >= 'a' && ch <= 'f') {
+            return ch - 'a' + 10;
+        } else if (ch >= 'A' && ch <= 'F') {
+            return ch - 'A' + 10;
+        }
+        return -1;
+    }
+    /*
+     * Length of the line including the line ending, and the line without it in line.
+     * Zero when the line is not complete yet.
+     */
+    static constexpr size_t FindLine(std::string_view input, std::string_view &line) {
+        auto lookahead = input.size() < (http1ChunkedMaxLine + 2) ? input.size() : (http1ChunkedMaxLine + 2);
+        auto lf = input.substr(0, lookahead).find('\n');
+        if (lf == std::string_view::npos) {
+            return 0;
+        }
+        line = input.substr(0, lf > 0 && input[lf - 1] == '\r' ? lf - 1 : lf);
+        return lf + 1;
+    }
+    constexpr Http1ChunkedEvent Fail(size_t consumed) {
+        state = State::FAILED;
+        return {.type = Http1ChunkedEventType::ERROR, .consumed = consumed};
+    }
+    constexpr Http1ChunkedEvent SizeLine(std::string_view input, size_t pos) {
+        std::string_view line{};
+        auto lineLength = FindLine(input.substr(pos), line);
+        if (lineLength == 0) {
+            if ((input.size() - pos) > (http1ChunkedMaxLine + 1) || HexValue(input.size() > pos ? input[pos] : '0') < 0) {
+                return Fail(pos);
+            }
+            return {.type = Http1ChunkedEventType::NEED_MORE, .consumed = pos};
+        }
+        size_t size{0};
+        size_t i{0};
+        for (; i < line.size(); i++) {
+            auto value = HexValue(line[i]);
+            if (value < 0) {
+                break;
+            }
+            if (i >= (sizeof(size_t) * 2)) {
+                /* The size would overflow */
+                return Fail(pos);
+            }
+            size = (size << 4) | (size_t) value;
+        }
+        if (i == 0) {
+            return Fail(pos);
+        }
+        while (i < line.size() && IsSpace(line[i])) {
+            ++i;
+        }
+        std::string_view extensions{};
+        if (i < line.size()) {
+            if (line[i] != ';') {
+                return Fail(pos);
+            }
+            extensions = line.substr(i + 1);
+            for (auto ch : extensions) {
+                if (IsControl(ch)) {
+                    return Fail(pos);
+                }
+            }
+        }
+        if (size > 0) {
+            state = State::DATA;
+            remaining = size;
+        } else {
+            state = State::TRAILER;
+        }
+        return {.type = Http1ChunkedEventType::CHUNK, .consumed = pos + lineLength, .chunkSize = size, .data = extensions};
+    }
+    constexpr Http1ChunkedEvent Trailer(std::string_view input, size_t pos) {
+        std::string_view line{};
+        auto lineLength = FindLine(input.substr(pos), line);
+        if (lineLength == 0) {
+            if ((input.size() - pos) > (http1ChunkedMaxLine + 1)) {
+                return Fail(pos);
+            }
+            return {.type = Http1ChunkedEventType::NEED_MORE, .consumed = pos};
+        }
+        if (line.empty()) {
+            state = State::DONE;
+            return {.type = Http1ChunkedEventType::END, .consumed = pos + lineLength};
+        }
+        trailerBytes += lineLength;
+        if (trailerBytes > http1ChunkedMaxTrailers) {
+            return Fail(pos);
+        }
+        auto colon = line.find(':');
+        if (colon == 0 || colon == std::string_view::npos) {
+            return Fail(pos);
+        }
+        auto header = line.substr(0, colon);
+        for (auto ch : header) {
+            if (IsSpace(ch) || IsControl(ch)) {
+                return Fail(pos);
+            }
+        }
+        auto value = line.substr(colon + 1);
+        for (auto ch : value) {
+            if (IsControl(ch)) {
+                return Fail(pos);
+            }
+        }
+        while (!value.empty() && IsSpace(value.front())) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && IsSpace(value.back())) {
+            value.remove_suffix(1);
+        }
+        return {.type = Http1ChunkedEventType::TRAILER, .consumed = pos + lineLength, .trailer = {.header = header, .value = value}};
+    }
+public:
+    constexpr Http1ChunkedDecoder() = default;
+    constexpr Http1ChunkedEvent Decode(std::string_view input) {
+        size_t pos{0};
+        while (true) {
+            switch (state) {
+                case State::SIZE_LINE:
+                    return SizeLine(input, pos);
+                case State::DATA: {
+                    if (pos >= input.size()) {
+                        return {.type = Http1ChunkedEventType::NEED_MORE, .consumed = pos};
+                    }
+                    auto size = input.size() - pos;
+                    if (size > remaining) {
+                        size = remaining;
+                    }
+                    remaining -= size;
+                    if (remaining == 0) {
+                        state = State::DATA_END;
+                    }
+                    return {.type = Http1ChunkedEventType::DATA, .consumed = pos + size, .data = input.substr(pos, size)};
+                }
+                case State::DATA_END:
+                    if (pos >= input.size()) {
+                        return {.type = Http1ChunkedEventType::NEED_MORE, .consumed = pos};
+                    }
+                    if (input[pos] == '\r') {
+                        if ((pos + 1) >= input.size()) {
+                            return {.type = Http1ChunkedEventType::NEED_MORE, .consumed = pos};
+                        }
+                        ++pos;
+                    }
+                    if (input[pos] != '\n') {
+                        return Fail(pos);
+                    }
+                    ++pos;
+                    state = State::SIZE_LINE;
+                    break;
+                case State::TRAILER:
+                    return Trailer(input, pos);
+                case State::DONE:
+                    return {.type = Http1ChunkedEventType::END, .consumed = pos};
+                case State::FAILED:
+                default:
+                    return {.type = Http1ChunkedEventType::ERROR, .consumed = pos};
+            }
+        }
+    }
+    constexpr bool IsDone() const {
+        return state == State::DONE;
+    }
+    constexpr bool IsFailed() const {
+        return state == State::FAILED;
+    }
+};
+
+/*
+ * Hex size and CRLF that go in front of a chunk.
+ */
+struct Http1ChunkSizeLine {
+    char line[sizeof(size_t) * 2 + 2]{};
+    unsigned char size{0};
+    constexpr Http1ChunkSizeLine() = default;
+    constexpr Http1ChunkSizeLine(size_t chunkSize) {
+        size = chunkSize > 0 ? (unsigned char) ((std::bit_width(chunkSize) + 3) / 4) : 1;
+        for (auto i = size; i > 0; i--) {
+            auto digit = chunkSize & 0xF;
+            line[i - 1] = (char) (digit < 10 ? '0' + digit : 'a' + digit - 10);
+            chunkSize = chunkSize >> 4;
+        }
+        line[size++] = '\r';
+        line[size++] = '\n';
+    }
+    constexpr std::string_view View() const {
+        return {line, size};
+    }
+};
+
+/*
+ * Writes the chunk framing as iovecs around the payload, which is not copied. The
+ * size line, the payload and the trailers have to stay in place until the iovecs are
+ * written.
+ */
+class Http1ChunkedEncoder {
+public:
+    static constexpr size_t chunkSegments = 3;
+    static constexpr size_t EndSegments(size_t trailers) {
+        return 2 + (trailers * 4);
+    }
+    /*
+     * Returns the number of iovecs used, at most chunkSegments. An empty payload uses
+     * none, since a zero sized chunk ends the body.
+     */
+    static size_t Chunk(Http1ChunkSizeLine &sizeLine, std::string_view payload, struct iovec *iov);
+    /*
+     * The last chunk, the trailers and the end of the body, EndSegments(trailers.size())
+     * iovecs.
+     */
+    static size_t End(std::span<const Http1HeaderView> trailers, struct iovec *iov);
+};
+
+#endif //LIBHTTPTOOLING_HTTP1CHUNKED_H
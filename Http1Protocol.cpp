@@ -3,6 +3,8 @@
 //
 
 #include "Http1Protocol.h"
+#include "HttpHeaders.h"
+#include <array>
 
 constexpr bool TestHttp1RequestLine(const std::string &ln, const std::string &expectedMethod, const std::string &expectedPath, const std::string &expectedVersion) {
     Http1RequestLine req{ln};
@@ -51,6 +53,48 @@ static_assert(!Http1RequestParser("GET / HTTP/1.1\r\nAccept: text/html\r\n").IsV
 static_assert(Http1RequestParser("GET / HTTP/1.1\r\nAccept: text/html\r\n").IsTruncatedValid());
 static_assert(Http1RequestParser("GET / HTTP/1.1\r\nAccept: text/html\r\n\r\n").IsValid());
 static_assert(Http1RequestParser("GET / HTTP/1.1\r\nAccept: text/html\r\n\r\n").GetParsedInputCharacters() == std::string("GET / HTTP/1.1\r\nAccept: text/html\r\n\r\n").size());
+static_assert(!Http1RequestParser("GET / HTTP/1.1\r\nAccept: text/html\r\n\r").IsValid());
+static_assert(Http1RequestParser("GET / HTTP/1.1\r\nAccept: text/html\r\n\r").IsTruncatedValid());
+static_assert(Http1RequestParser("GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n").GetParsedInputCharacters() == std::string("GET /a HTTP/1.1\r\n\r\n").size());
+
+constexpr bool TestHttp1RequestHeadParser(std::string_view input) {
+    Http1RequestParser expected{input};
+    std::vector<Http1HeaderView> headerLines{};
+    Http1RequestHeadParser parser{input, headerLines};
+    if (parser.IsValid() != expected.IsValid() || parser.IsTruncatedValid() != expected.IsTruncatedValid() || parser.GetParsedInputCharacters() != expected.GetParsedInputCharacters()) {
+        return false;
+    }
+    if (!parser.IsValid()) {
+        return true;
+    }
+    auto request = expected.operator Http1Request();
+    if (parser.GetMethod() != request.GetRequest().GetMethod() || parser.GetPath() != request.GetRequest().GetPath() || parser.GetVersion() != request.GetRequest().GetVersion()) {
+        return false;
+    }
+    auto expectedHeaders = request.GetHeader();
+    if (headerLines.size() != expectedHeaders.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < headerLines.size(); i++) {
+        if (headerLines[i].GetHeader() != expectedHeaders[i].GetHeader() || headerLines[i].GetValue() != expectedHeaders[i].GetValue()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(TestHttp1RequestHeadParser(""));
+static_assert(TestHttp1RequestHeadParser("GET /"));
+static_assert(TestHttp1RequestHeadParser("GET /\r\n"));
+static_assert(TestHttp1RequestHeadParser("gEt /\r\n"));
+static_assert(TestHttp1RequestHeadParser("POST /\r\n"));
+static_assert(TestHttp1RequestHeadParser("GET / HTTP/1.1\r\n"));
+static_assert(TestHttp1RequestHeadParser("GET / HTTP/1.1\r\nAccept: text/html"));
+static_assert(TestHttp1RequestHeadParser("GET / HTTP/1.1\r\nAccept: text/html\r\n\r"));
+static_assert(TestHttp1RequestHeadParser("GET / HTTP/1.1\r\nAccept: text/html\r\n\r\n"));
+static_assert(TestHttp1RequestHeadParser(" GET  /index.html  HTTP/1.1 \nHost:localhost\n  Accept:  text/html \nX-Empty:\nNoColon\n\n"));
+static_assert(TestHttp1RequestHeadParser("GET / HTTP/1.1\r\n: value\r\n\r\n"));
+static_assert(TestHttp1RequestHeadParser("GET /a HTTP/1.1\r\n\r\nGET /b HTTP/1.1\r\n\r\n"));
 
 static_assert(Http1Chunk("0\r\n\r\n", true).IsValid());
 static_assert(Http1Chunk("0\r\n\r\n", true).GetConsumedBytes() == 5);
@@ -69,6 +113,7 @@ static_assert(Http1ResponseLine("HTTP/1.1 200 OK").GetVersion() == "HTTP/1.1");
 static_assert(Http1ResponseLine("HTTP/1.1 200 OK").GetCode() == 200);
 static_assert(Http1ResponseLine("HTTP/1.1 200 OK").GetDescription() == "OK");
 static_assert(Http1ResponseLine("HTTP/1.1", 200, "OK").operator std::string() == "HTTP/1.1 200 OK");
+static_assert(Http1ResponseLine("HTTP/1.1", 404, "Not found").operator std::string() == "HTTP/1.1 404 Not found");
 
 static_assert(Http1ResponseParser("HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\n").IsValid());
 static_assert(Http1ResponseParser("HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\n").GetParsedInputCharacters() == std::string("HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\n").size());
@@ -93,3 +138,18 @@ static_assert(!Http1ResponseParser("").IsValid());
 static_assert(Http1ResponseParser("").IsTruncated());
 
 static_assert(Http1Response({"HTTP/1.1", 200, "OK"}, {{"Content-Length", "13"}}).operator std::string() == "HTTP/1.1 200 OK\r\nContent-Length: 13\r\n\r\n");
+
+static_assert(HttpEqualsIgnoreCase("Content-Length", "content-length"));
+static_assert(HttpEqualsIgnoreCase("TRANSFER-ENCODING", "transfer-encoding"));
+static_assert(!HttpEqualsIgnoreCase("Content-Length", "content-lengtH1"));
+static_assert(!HttpEqualsIgnoreCase("Content-Type", "content-length"));
+static_assert(!HttpEqualsIgnoreCase("[", "{"));
+static_assert(HttpHeaderTransferCoding(std::array<Http1HeaderView,1>{{{"Content-Length", "5"}}}) == HttpTransferCoding::NONE);
+static_assert(HttpHeaderTransferCoding(std::array<Http1HeaderView,1>{{{"Transfer-Encoding", "chunked"}}}) == HttpTransferCoding::CHUNKED);
+static_assert(HttpHeaderTransferCoding(std::array<Http1HeaderView,1>{{{"transfer-encoding", "gzip, Chunked "}}}) == HttpTransferCoding::CHUNKED);
+static_assert(HttpHeaderTransferCoding(std::array<Http1HeaderView,1>{{{"Transfer-Encoding", "chunked, gzip"}}}) == HttpTransferCoding::OTHER);
+static_assert(HttpHeaderTransferCoding(std::array<Http1HeaderView,2>{{{"Transfer-Encoding", "gzip"}, {"Transfer-Encoding", "chunked"}}}) == HttpTransferCoding::CHUNKED);
+static_assert(!HttpHeaderConnectionClose(std::array<Http1HeaderView,1>{{{"Connection", "keep-alive"}}}));
+static_assert(HttpHeaderConnectionClose(std::array<Http1HeaderView,1>{{{"connection", "Close"}}}));
+static_assert(HttpHeaderConnectionClose(std::array<Http1HeaderView,2>{{{"Content-Length", "0"}, {"Connection", "keep-alive, close "}}}));
+static_assert(!HttpHeaderConnectionClose(std::array<Http1HeaderView,1>{{{"Connection", "closed"}}}));
@@ -6,7 +6,9 @@
 #define LIBHTTPTOOLING_HTTP1PROTOCOL_H
 
 #include <string>
+#include <string_view>
 #include <vector>
+#include <algorithm>
 
 class Http1RequestLine {
 private:
@@ -176,7 +178,7 @@ public:
         return ch == '\n' || ch == '\r';
     }
     constexpr Http1RequestParser() = default;
-    constexpr Http1RequestParser(const std::string &input) {
+    constexpr Http1RequestParser(std::string_view input) {
         if (input.empty()) {
             truncatedHttpRequest = true;
             return;
@@ -192,7 +194,7 @@ public:
             truncatedHttpRequest = true;
             return;
         }
-        requestLine = Http1RequestLine(input.substr(0, i));
+        requestLine = Http1RequestLine(std::string(input.substr(0, i)));
         if (requestLine.GetMethod().empty() || requestLine.GetPath().empty()) {
             return;
         }
@@ -231,7 +233,7 @@ public:
                 truncatedHttpRequest = true;
                 return;
             }
-            Http1HeaderLine hdr{input.substr(start, i - start)};
+            Http1HeaderLine hdr{std::string(input.substr(start, i - start))};
             if (hdr.GetHeader().empty()) {
                 return;
             }
@@ -248,8 +250,13 @@ public:
         }
         auto prevCh = input[i];
         ++i;
-        if (IsLfOrCr(input[i]) && input[i] != prevCh) {
-            ++i;
+        if (i < input.size()) {
+            if (IsLfOrCr(input[i]) && input[i] != prevCh) {
+                ++i;
+            }
+        } else if (prevCh == '\r') {
+            truncatedHttpRequest = true;
+            return;
         }
         validHttpRequest = true;
         parsedInputCharacters = i;
@@ -268,6 +275,170 @@ public:
     }
 };
 
+struct Http1HeaderView {
+    std::string_view header{};
+    std::string_view value{};
+    constexpr std::string_view GetHeader() const {
+        return header;
+    }
+    constexpr std::string_view GetValue() const {
+        return value;
+    }
+};
+
+/*
+ * Parses the same request head as Http1RequestParser without copying anything. The
+ * method, path, version and header views point into the input. The header lines are
+ * put in a vector owned by the caller, so that it can be reused between requests.
+ */
+class Http1RequestHeadParser {
+private:
+    std::string_view method{};
+    std::string_view path{};
+    std::string_view version{};
+    size_t parsedInputCharacters{0};
+    bool validHttpRequest{false};
+    bool truncatedHttpRequest{false};
+    static constexpr bool IsSpace(char ch) {
+        return ch == ' ' || ch == '\t';
+    }
+    static constexpr bool IsLfOrCr(char ch) {
+        return ch == '\n' || ch == '\r';
+    }
+    static constexpr std::string_view TrimStart(std::string_view str) {
+        decltype(str.size()) i = 0;
+        while (i < str.size() && IsSpace(str[i])) {
+            ++i;
+        }
+        return str.substr(i);
+    }
+    /*
+     * Splits at pos, the remainder starts at the first non-space after pos.
+     */
+    static constexpr std::string_view Remainder(std::string_view str, size_t pos) {
+        for (auto i = pos + 1; i < str.size(); i++) {
+            if (!IsSpace(str[i])) {
+                return str.substr(i);
+            }
+        }
+        return {};
+    }
+    constexpr void ParseRequestLine(std::string_view line) {
+        method = TrimStart(line);
+        auto methodEnd = method.find_first_of(" \t");
+        if (methodEnd == std::string_view::npos) {
+            return;
+        }
+        path = Remainder(method, methodEnd);
+        method = method.substr(0, methodEnd);
+        auto pathEnd = path.find_first_of(" \t");
+        if (pathEnd == std::string_view::npos) {
+            return;
+        }
+        version = Remainder(path, pathEnd);
+        path = path.substr(0, pathEnd);
+    }
+    static constexpr Http1HeaderView ParseHeaderLine(std::string_view line) {
+        Http1HeaderView hdr{.header = TrimStart(line), .value = {}};
+        auto headerEnd = hdr.header.find(':');
+        if (headerEnd != std::string_view::npos) {
+            hdr.value = Remainder(hdr.header, headerEnd);
+            hdr.header = hdr.header.substr(0, headerEnd);
+        }
+        return hdr;
+    }
+public:
+    constexpr Http1RequestHeadParser(std::string_view input, std::vector<Http1HeaderView> &headerLines) {
+        headerLines.clear();
+        if (input.empty()) {
+            truncatedHttpRequest = true;
+            return;
+        }
+        decltype(input.size()) i = 0;
+        while (i < input.size() && !IsLfOrCr(input[i])) {
+            ++i;
+        }
+        if (i == 0) {
+            return;
+        }
+        if (i >= input.size()) {
+            truncatedHttpRequest = true;
+            return;
+        }
+        ParseRequestLine(input.substr(0, i));
+        if (method.empty() || path.empty()) {
+            return;
+        }
+        {
+            auto prevCh = input[i];
+            ++i;
+            if (i < input.size() && IsLfOrCr(input[i]) && input[i] != prevCh) {
+                ++i;
+            }
+        }
+        if (version.empty()) {
+            validHttpRequest = method.size() == 3 && (method[0] == 'g' || method[0] == 'G') && (method[1] == 'e' || method[1] == 'E') && (method[2] == 't' || method[2] == 'T');
+            parsedInputCharacters = i;
+            return;
+        }
+        while (i < input.size() && !IsLfOrCr(input[i])) {
+            decltype(i) start = i;
+            ++i;
+            while (i < input.size() && !IsLfOrCr(input[i])) {
+                ++i;
+            }
+            if (i >= input.size()) {
+                truncatedHttpRequest = true;
+                return;
+            }
+            auto hdr = ParseHeaderLine(input.substr(start, i - start));
+            if (hdr.header.empty()) {
+                return;
+            }
+            auto prevCh = input[i];
+            ++i;
+            if (i < input.size() && IsLfOrCr(input[i]) && prevCh != input[i]) {
+                ++i;
+            }
+            headerLines.emplace_back(hdr);
+        }
+        if (i >= input.size()) {
+            truncatedHttpRequest = true;
+            return;
+        }
+        auto prevCh = input[i];
+        ++i;
+        if (i < input.size()) {
+            if (IsLfOrCr(input[i]) && input[i] != prevCh) {
+                ++i;
+            }
+        } else if (prevCh == '\r') {
+            truncatedHttpRequest = true;
+            return;
+        }
+        validHttpRequest = true;
+        parsedInputCharacters = i;
+    }
+    constexpr std::string_view GetMethod() const {
+        return method;
+    }
+    constexpr std::string_view GetPath() const {
+        return path;
+    }
+    constexpr std::string_view GetVersion() const {
+        return version;
+    }
+    constexpr size_t GetParsedInputCharacters() const {
+        return parsedInputCharacters;
+    }
+    constexpr bool IsValid() const {
+        return validHttpRequest;
+    }
+    constexpr bool IsTruncatedValid() const {
+        return truncatedHttpRequest;
+    }
+};
+
 class Http1Chunk {
 private:
     std::string chunk{};
@@ -352,20 +523,19 @@ public:
     constexpr std::string GetEncoded() const {
         auto sz = chunk.size();
         if (sz > 0) {
+            size_t digits{0};
+            for (auto rem = sz; rem > 0; rem = rem >> 4) {
+                ++digits;
+            }
             std::string encoded{};
-            while (sz > 0) {
+            encoded.reserve(digits + chunk.size() + 4);
+            encoded.resize(digits);
+            for (auto i = digits; i > 0; i--) {
                 auto szv = sz & 0xF;
                 sz = sz >> 4;
-                char ch;
-                if (szv < 10) {
-                    ch = '0' + szv;
-                } else {
-                    ch = 'a' + szv - 10;
-                }
-                encoded.insert(0, &ch, 1);
+                encoded[i - 1] = (char) (szv < 10 ? '0' + szv : 'a' + szv - 10);
             }
             encoded.append("\r\n");
-            encoded.reserve(encoded.size() + chunk.size() + 2);
             encoded.append(chunk);
             encoded.append("\r\n");
             return encoded;
@@ -448,12 +618,14 @@ public:
         }
         auto cd = code;
         if (cd > 0) {
-            auto pos = ln.size();
+            char digits[10]{};
+            int numDigits{0};
             while (cd > 0) {
-                auto dg = cd % 10;
+                digits[numDigits++] = (char) ('0' + (cd % 10));
                 cd = cd / 10;
-                char ch = '0' + dg;
-                ln.insert(pos, &ch, 1);
+            }
+            while (numDigits > 0) {
+                ln.push_back(digits[--numDigits]);
             }
         } else {
             ln.append("0");
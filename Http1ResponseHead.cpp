@@ -0,0 +1,102 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "Http1ResponseHead.h"
+#include <charconv>
+#include <cstring>
+#include <ctime>
+
+static_assert(Http1ResponseHeadWriter::statusLines.Get(200) == "HTTP/1.1 200 OK\r\n");
+static_assert(Http1ResponseHeadWriter::statusLines.Get(404) == "HTTP/1.1 404 Not Found\r\n");
+static_assert(Http1ResponseHeadWriter::statusLines.Get(599).empty());
+static_assert(Http1ResponseHeadWriter::statusLines.Get(99).empty());
+
+constexpr bool TestHttpWriteDate(int year, int month, int day, int weekday, int hour, int minute, int second, std::string_view expected) {
+    struct tm tm{};
+    tm.tm_year = year - 1900;
+    tm.tm_mon = month - 1;
+    tm.tm_mday = day;
+    tm.tm_wday = weekday;
+    tm.tm_hour = hour;
+    tm.tm_min = minute;
+    tm.tm_sec = second;
+    char buf[httpDateSize]{};
+    auto end = HttpWriteDate(buf, tm);
+    return (size_t) (end - buf) == httpDateSize && std::string_view(buf, httpDateSize) == expected;
+}
+
+static_assert(TestHttpWriteDate(1994, 11, 6, 0, 8, 48, 37, "Sun, 06 Nov 1994 08:48:37 GMT"));
+static_assert(TestHttpWriteDate(2026, 12, 31, 4, 23, 0, 0, "Thu, 31 Dec 2026 23:00:00 GMT"));
+
+HttpHeaderTemplate::HttpHeaderTemplate(std::initializer_list<std::pair<std::string_view, std::string_view>> headers) {
+    for (const auto &header : headers) {
+        Add(header.first, header.second);
+    }
+}
+
+void HttpHeaderTemplate::Add(std::string_view header, std::string_view value) {
+    serialized.reserve(serialized.size() + header.size() + value.size() + 4);
+    serialized.append(header);
+    serialized.append(": ");
+    serialized.append(value);
+    serialized.append("\r\n");
+}
+
+struct HttpDateCacheLine {
+    time_t second{-1};
+    char line[HttpDateCache::headerLineSize + 1]{};
+};
+
+static thread_local HttpDateCacheLine httpDateCacheLine{};
+
+std::string_view HttpDateCache::GetHeaderLine() {
+    auto now = time(nullptr);
+    if (now != httpDateCacheLine.second) {
+        struct tm tm{};
+        gmtime_r(&now, &tm);
+        auto ptr = std::copy_n("Date: ", 6, httpDateCacheLine.line);
+        ptr = HttpWriteDate(ptr, tm);
+        std::copy_n("\r\n", 2, ptr);
+        httpDateCacheLine.second = now;
+    }
+    return {httpDateCacheLine.line, headerLineSize};
+}
+
+static inline char *WriteView(char *output, std::string_view str) {
+    memcpy(output, str.data(), str.size());
+    return output + str.size();
+}
+
+size_t Http1ResponseHeadWriter::Write(char *output, int code, std::string_view description, std::string_view contentType, size_t contentLength, const HttpHeaderTemplate *headerTemplate, const HttpHeaderTemplate *extraHeaders) {
+    char *ptr = output;
+    auto statusLine = statusLines.Get(code);
+    if (!statusLine.empty() && statusLine.substr(13, statusLine.size() - 15) == description) {
+        ptr = WriteView(ptr, statusLine);
+    } else {
+        ptr = WriteView(ptr, "HTTP/1.1 ");
+        ptr = std::to_chars(ptr, ptr + 11, code).ptr;
+        *(ptr++) = ' ';
+        ptr = WriteView(ptr, description);
+        ptr = WriteView(ptr, "\r\n");
+    }
+    ptr = WriteView(ptr, HttpDateCache::GetHeaderLine());
+    if (!contentType.empty()) {
+        ptr = WriteView(ptr, "Content-Type: ");
+        ptr = WriteView(ptr, contentType);
+        ptr = WriteView(ptr, "\r\n");
+    }
+    if (HasContentLength(code)) {
+        ptr = WriteView(ptr, "Content-Length: ");
+        ptr = std::to_chars(ptr, ptr + 20, contentLength).ptr;
+        ptr = WriteView(ptr, "\r\n");
+    }
+    if (headerTemplate != nullptr) {
+        ptr = WriteView(ptr, headerTemplate->GetSerialized());
+    }
+    if (extraHeaders != nullptr) {
+        ptr = WriteView(ptr, extraHeaders->GetSerialized());
+    }
+    ptr = WriteView(ptr, "\r\n");
+    return ptr - output;
+}
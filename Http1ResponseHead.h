@@ -0,0 +1,178 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTP1RESPONSEHEAD_H
+#define LIBHTTPTOOLING_HTTP1RESPONSEHEAD_H
+
+#include <array>
+#include <algorithm>
+#include <string>
+#include <string_view>
+#include <initializer_list>
+#include <utility>
+#include <ctime>
+
+constexpr std::string_view Http1ReasonPhrase(int code) {
+    switch (code) {
+        case 100: return "Continue";
+        case 101: return "Switching Protocols";
+        case 200: return "OK";
+        case 201: return "Created";
+        case 202: return "Accepted";
+        case 203: return "Non-Authoritative Information";
+        case 204: return "No Content";
+        case 205: return "Reset Content";
+        case 206: return "Partial Content";
+        case 300: return "Multiple Choices";
+        case 301: return "Moved Permanently";
+        case 302: return "Found";
+        case 303: return "See Other";
+        case 304: return "Not Modified";
+        case 307: return "Temporary Redirect";
+        case 308: return "Permanent Redirect";
+        case 400: return "Bad Request";
+        case 401: return "Unauthorized";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 406: return "Not Acceptable";
+        case 408: return "Request Timeout";
+        case 409: return "Conflict";
+        case 410: return "Gone";
+        case 411: return "Length Required";
+        case 412: return "Precondition Failed";
+        case 413: return "Content Too Large";
+        case 414: return "URI Too Long";
+        case 415: return "Unsupported Media Type";
+        case 416: return "Range Not Satisfiable";
+        case 417: return "Expectation Failed";
+        case 421: return "Misdirected Request";
+        case 422: return "Unprocessable Content";
+        case 426: return "Upgrade Required";
+        case 428: return "Precondition Required";
+        case 429: return "Too Many Requests";
+        case 431: return "Request Header Fields Too Large";
+        case 500: return "Internal Server Error";
+        case 501: return "Not Implemented";
+        case 502: return "Bad Gateway";
+        case 503: return "Service Unavailable";
+        case 504: return "Gateway Timeout";
+        case 505: return "HTTP Version Not Supported";
+        default: return {};
+    }
+}
+
+struct Http1StatusLine {
+    char line[48]{};
+    unsigned char size{0};
+    constexpr std::string_view View() const {
+        return {line, size};
+    }
+};
+
+class Http1StatusLines {
+public:
+    static constexpr int firstCode = 100;
+    static constexpr int lastCode = 599;
+private:
+    std::array<Http1StatusLine, lastCode - firstCode + 1> lines{};
+public:
+    constexpr Http1StatusLines() {
+        for (int code = firstCode; code <= lastCode; code++) {
+            auto reason = Http1ReasonPhrase(code);
+            if (reason.empty()) {
+                continue;
+            }
+            auto &ln = lines[code - firstCode];
+            std::string_view version{"HTTP/1.1 "};
+            for (auto ch : version) {
+                ln.line[ln.size++] = ch;
+            }
+            ln.line[ln.size++] = (char) ('0' + code / 100);
+            ln.line[ln.size++] = (char) ('0' + (code / 10) % 10);
+            ln.line[ln.size++] = (char) ('0' + code % 10);
+            ln.line[ln.size++] = ' ';
+            for (auto ch : reason) {
+                ln.line[ln.size++] = ch;
+            }
+            ln.line[ln.size++] = '\r';
+            ln.line[ln.size++] = '\n';
+        }
+    }
+    constexpr std::string_view Get(int code) const {
+        if (code < firstCode || code > lastCode) {
+            return {};
+        }
+        return lines[code - firstCode].View();
+    }
+};
+
+class HttpHeaderTemplate {
+private:
+    std::string serialized{};
+public:
+    HttpHeaderTemplate() = default;
+    HttpHeaderTemplate(std::initializer_list<std::pair<std::string_view,std::string_view>> headers);
+    void Add(std::string_view header, std::string_view value);
+    std::string_view GetSerialized() const {
+        return serialized;
+    }
+};
+
+constexpr size_t httpDateSize = 29;
+
+/*
+ * Writes the IMF-fixdate of a UTC time, with the English day and month names whatever
+ * the locale. Years are written with four digits.
+ */
+constexpr char *HttpWriteDate(char *output, const struct tm &tm) {
+    constexpr std::string_view days{"SunMonTueWedThuFriSat"};
+    constexpr std::string_view months{"JanFebMarAprMayJunJulAugSepOctNovDec"};
+    auto twoDigits = [&output] (int value) {
+        *(output++) = (char) ('0' + ((value / 10) % 10));
+        *(output++) = (char) ('0' + (value % 10));
+    };
+    auto name = days.substr((size_t) (tm.tm_wday % 7) * 3, 3);
+    output = std::copy(name.cbegin(), name.cend(), output);
+    *(output++) = ',';
+    *(output++) = ' ';
+    twoDigits(tm.tm_mday);
+    *(output++) = ' ';
+    name = months.substr((size_t) (tm.tm_mon % 12) * 3, 3);
+    output = std::copy(name.cbegin(), name.cend(), output);
+    *(output++) = ' ';
+    auto year = tm.tm_year + 1900;
+    twoDigits(year / 100);
+    twoDigits(year % 100);
+    *(output++) = ' ';
+    twoDigits(tm.tm_hour);
+    *(output++) = ':';
+    twoDigits(tm.tm_min);
+    *(output++) = ':';
+    twoDigits(tm.tm_sec);
+    output = std::copy_n(" GMT", 4, output);
+    return output;
+}
+
+class HttpDateCache {
+public:
+    static constexpr size_t headerLineSize = 37;
+    static std::string_view GetHeaderLine();
+};
+
+class Http1ResponseHeadWriter {
+public:
+    static constexpr Http1StatusLines statusLines{};
+    static size_t MaxSize(std::string_view description, std::string_view contentType, const HttpHeaderTemplate *headerTemplate, const HttpHeaderTemplate *extraHeaders = nullptr) {
+        return 24 + description.size() + HttpDateCache::headerLineSize + 16 + contentType.size() + 18 + 20 + 2 +
+               (headerTemplate != nullptr ? headerTemplate->GetSerialized().size() : 0) +
+               (extraHeaders != nullptr ? extraHeaders->GetSerialized().size() : 0) + 2;
+    }
+    static constexpr bool HasContentLength(int code) {
+        return code >= 200 && code != 204 && code != 304;
+    }
+    static size_t Write(char *output, int code, std::string_view description, std::string_view contentType, size_t contentLength, const HttpHeaderTemplate *headerTemplate, const HttpHeaderTemplate *extraHeaders = nullptr);
+};
+
+#endif //LIBHTTPTOOLING_HTTP1RESPONSEHEAD_H
@@ -9,14 +9,14 @@ extern "C" {
 #include <unistd.h>
 }
 
-HttpClient::HttpClient() :
+HttpClient::HttpClient(const NetwSocketOptions &socketOptions) :
     clientImpl(std::make_shared<HttpClientImpl>()),
-    netwServer(NetwServer::Create(clientImpl)),
+    netwServer(NetwServer::Create(clientImpl, socketOptions)),
     commandFd(netwServer->GetCommandFd()) {
 }
 
-std::shared_ptr<HttpClient> HttpClient::Create() {
-    std::shared_ptr<HttpClient> client{new HttpClient()};
+std::shared_ptr<HttpClient> HttpClient::Create(const NetwSocketOptions &socketOptions) {
+    std::shared_ptr<HttpClient> client{new HttpClient(socketOptions)};
     return client;
 }
 
@@ -29,6 +29,32 @@ HttpClient::Execute(const std::string &host, int port, const std::shared_ptr<Htt
     return clientImpl->Execute(host, port, request);
 }
 
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>>
+HttpClient::ExecuteUnix(const std::string &path, const std::shared_ptr<HttpRequest> &request) {
+    return clientImpl->ExecuteUnix(path, request);
+}
+
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>>
+HttpClient::ExecuteUpstream(const std::string &name, const std::shared_ptr<HttpRequest> &request) {
+    return clientImpl->ExecuteUpstream(name, request);
+}
+
+void HttpClient::SetUpstream(const std::string &name, const std::vector<HttpUpstreamEndpoint> &endpoints, const HttpUpstreamHealthPolicy &healthPolicy) {
+    clientImpl->SetUpstream(name, endpoints, healthPolicy);
+}
+
+void HttpClient::SetPipelineDepth(size_t depth) {
+    clientImpl->SetPipelineDepth(depth);
+}
+
+void HttpClient::SetTimeouts(const HttpRequestTimeouts &timeouts) {
+    clientImpl->SetTimeouts(timeouts);
+}
+
+void HttpClient::SetRetryPolicy(const HttpClientRetryPolicy &policy) {
+    clientImpl->SetRetryPolicy(policy);
+}
+
 void HttpClient::Stop() {
     write(commandFd, "q", 1);
 }
@@ -11,6 +11,9 @@
 #include "Fd.h"
 #include "HttpRequest.h"
 #include "HttpResponse.h"
+#include "HttpClientRetry.h"
+#include "HttpUpstream.h"
+#include "NetwSocketOptions.h"
 
 class NetwServer;
 class HttpClientImpl;
@@ -20,15 +23,27 @@ private:
     std::shared_ptr<HttpClientImpl> clientImpl;
     std::shared_ptr<NetwServer> netwServer;
     int commandFd;
-    HttpClient();
+    HttpClient(const NetwSocketOptions &socketOptions);
 public:
     HttpClient(const HttpClient &) = delete;
     HttpClient(HttpClient &&) = delete;
     HttpClient &operator =(const HttpClient &) = delete;
     HttpClient &operator =(HttpClient &&) = delete;
-    static std::shared_ptr<HttpClient> Create();
+    static std::shared_ptr<HttpClient> Create(const NetwSocketOptions &socketOptions = {});
     std::shared_ptr<HttpRequest> Request(const std::string &method, const std::string &path);
     task<std::expected<std::shared_ptr<HttpResponse>,FdException>> Execute(const std::string &host, int port, const std::shared_ptr<HttpRequest> &request);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> ExecuteUnix(const std::string &path, const std::shared_ptr<HttpRequest> &request);
+    /*
+     * Sends the request to one of the endpoints of the upstream set with SetUpstream,
+     * the one with fewer requests in flight of two picked at random. Endpoints that
+     * fail or slow down are ejected for a while, and when all of them are the request
+     * fails right away with EHOSTUNREACH, see FdException::GetErrno().
+     */
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> ExecuteUpstream(const std::string &name, const std::shared_ptr<HttpRequest> &request);
+    void SetUpstream(const std::string &name, const std::vector<HttpUpstreamEndpoint> &endpoints, const HttpUpstreamHealthPolicy &healthPolicy = {});
+    void SetPipelineDepth(size_t depth);
+    void SetTimeouts(const HttpRequestTimeouts &timeouts);
+    void SetRetryPolicy(const HttpClientRetryPolicy &policy);
     void Stop();
     void Run();
 };
@@ -4,16 +4,62 @@
 
 #include "HttpClientImpl.h"
 #include "Http1Protocol.h"
+#include "Http1Chunked.h"
 #include "HttpHeaders.h"
 #include "HttpRequestImpl.h"
+#include "include/sync_coroutine.h"
 #include <netdb.h>
+#include <errno.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 
 struct HttpClientRequestContainer {
     std::weak_ptr<HttpClientConnectionHandler> handler{};
-    std::function<void (std::shared_ptr<HttpResponse> &response)> callback{};
+    std::function<void (std::expected<std::shared_ptr<HttpResponse>,FdException>)> callback{};
     std::string requestMethod{};
+    std::function<void ()> retry{};
+    HttpClientDeadlines deadlines{};
+    std::optional<NetwTimer> connectTimer{};
+    std::optional<NetwTimer> firstByteTimer{};
+    std::optional<NetwTimer> totalTimer{};
+};
+
+/*
+ * Lets the copy of a hedged request that lost be cancelled, wherever it is by then.
+ */
+class HttpClientCancellation {
+private:
+    std::mutex mtx{};
+    std::weak_ptr<HttpClientRequestContainer> requestContainer{};
+    bool cancelled{false};
+public:
+    bool IsCancelled();
+    void Attach(const std::shared_ptr<HttpClientRequestContainer> &requestContainer);
+    void Cancel();
+};
+
+/*
+ * The copies of a request in flight, the first to succeed completes it.
+ */
+struct HttpClientHedge {
+    std::mutex mtx{};
+    std::function<void (HttpClientAttemptResult)> callback{};
+    std::vector<std::shared_ptr<HttpClientCancellation>> attempts{};
+    std::optional<NetwTimer> hedgeTimer{};
+    unsigned int pending{0};
+    bool done{false};
+};
+
+/*
+ * A request to an upstream, with the endpoints its attempts were sent to, so that
+ * retries and hedges go to other endpoints when there are.
+ */
+struct HttpClientUpstreamRequest {
+    std::string name{};
+    std::shared_ptr<HttpUpstreamGroup> group{};
+    std::shared_ptr<HttpRequest> request{};
+    std::mutex mtx{};
+    std::vector<std::shared_ptr<HttpUpstreamEndpointState>> tried{};
 };
 
 class HttpResponseImpl;
@@ -26,14 +72,44 @@ private:
     Http1Response requestHead{};
     std::vector<std::shared_ptr<HttpClientRequestContainer>> inflightRequests{};
     std::shared_ptr<HttpResponseImpl> responseBodyPending{};
+    std::shared_ptr<HttpClientRequestContainer> responseBodyContainer{};
     size_t responseBodyRemaining{0};
+    Http1ChunkedDecoder responseBodyDecoder{};
+    bool responseBodyChunked{false};
+    bool responseBodyUntilClose{false};
     std::mutex mtx;
+    std::function<void (bool)> callOutputWritable{};
     bool closeConnection{};
+    bool connected{false};
+    bool keepAlive{true};
+    bool retired{false};
+    bool outputDrained{false};
+    bool uploadStopped{false};
+    size_t AcceptChunkedBody(std::string_view input);
+    void FinishResponseBody(bool success);
+    bool IsRetiredAndIdle() const;
+    void FailConnection();
+    void StopUpload();
+    void StartTimers(const std::shared_ptr<HttpClientRequestContainer> &requestContainer);
+    void CancelTimer(std::optional<NetwTimer> &timer);
+    void CancelTimers(HttpClientRequestContainer &requestContainer);
+    void AbortRequest(const std::shared_ptr<HttpClientRequestContainer> &requestContainer, const FdException &error);
+    static func_task<bool> OutputWritable(const std::weak_ptr<HttpClientConnectionHandler> &handler);
+    static task<void> UploadBody(std::weak_ptr<HttpClientConnectionHandler> handler, HttpRequestBodySource source, std::optional<size_t> contentLength);
 public:
-    HttpClientConnectionHandler(const std::shared_ptr<HttpClientImpl> &httpServer, const std::function<void(const std::string &)> &output, const std::function<void()> &close) : httpClient(httpClient), output(output), close(close) {}
+    HttpClientConnectionHandler(const std::shared_ptr<HttpClientImpl> &httpClient, const std::function<void(const std::string &)> &output, const std::function<void()> &close) : httpClient(httpClient), output(output), close(close) {}
+    ~HttpClientConnectionHandler();
     size_t AcceptInput(const std::string &) override;
     void EndOfConnection() override;
-    void WaitForResponse(const std::string &requestMethod, const std::function<void (std::shared_ptr<HttpResponse> &response)> &callback);
+    bool IsInputPaused() override;
+    void OutputDrained() override;
+    void Connected() override;
+    void ResumeInput();
+    void WaitForResponse(const std::shared_ptr<HttpClientRequestContainer> &requestContainer);
+    bool Pipeline(const std::shared_ptr<HttpClientRequestContainer> &requestContainer, const std::string &requestData, size_t depth);
+    void StartUpload(const HttpRequestBodySource &source, std::optional<size_t> contentLength);
+    void CancelRequest(const std::shared_ptr<HttpClientRequestContainer> &requestContainer);
+    void Retire();
 };
 
 class HttpResponseImpl : public HttpResponse, public std::enable_shared_from_this<HttpResponseImpl> {
@@ -44,12 +120,17 @@ private:
     std::string responseBody{};
     bool responseBodyOk{true};
     std::vector<std::function<void ()>> callResponseBodyFinished{};
+    std::function<void ()> callBodySegment{};
     bool responseBodyComplete;
+    bool responseBodyCollect{false};
+    void BodyArrived();
 public:
     HttpResponseImpl(const std::shared_ptr<HttpClientConnectionHandler> &clientConnectionHandler, std::shared_ptr<HttpClientRequestContainer> &clientRequestContainer, int code, const std::string &description, bool hasResponseBody) : HttpResponse(code, description), clientConnectionHandler(clientConnectionHandler), clientRequestContainer(clientRequestContainer), responseBodyComplete(!hasResponseBody) {
     }
     task<ResponseBodyResult> ResponseBody() override;
-    void RecvBody(const std::string &chunk);
+    task<ResponseBodySegment> NextBodySegment() override;
+    bool IsBodyBackedUp();
+    void RecvBody(std::string_view chunk);
     void CompletedBody();
     void FailedBody();
 };
@@ -57,11 +138,26 @@ public:
 task<ResponseBodyResult> HttpResponseImpl::ResponseBody() {
     {
         std::unique_lock lock{mtx};
+        /* The whole body is kept, so reading must not stay paused for it */
+        bool resume = !responseBodyCollect && !responseBodyComplete && responseBody.size() >= httpClientBodyBufferMax;
+        responseBodyCollect = true;
+        if (resume) {
+            lock.unlock();
+            auto handler = clientConnectionHandler.lock();
+            if (handler) {
+                handler->ResumeInput();
+            }
+            lock.lock();
+        }
         if (!responseBodyComplete) {
             lock.unlock();
             std::weak_ptr<HttpResponseImpl> respObj{shared_from_this()};
             func_task<ResponseBodyResult> fnTask{[respObj] (const auto &func) {
                 auto resp = respObj.lock();
+                if (!resp) {
+                    func({.body = "", .success = false});
+                    return;
+                }
                 std::unique_lock lock{resp->mtx};
                 if (resp->responseBodyComplete) {
                     lock.unlock();
@@ -84,9 +180,73 @@ task<ResponseBodyResult> HttpResponseImpl::ResponseBody() {
     co_return {.body = responseBody, .success = responseBodyOk};
 }
 
-void HttpResponseImpl::RecvBody(const std::string &chunk) {
+/*
+ * Waits for body data unless there is some already, and hands out all that has arrived.
+ * Taking the data out of a full buffer resumes reading from the connection.
+ */
+task<ResponseBodySegment> HttpResponseImpl::NextBodySegment() {
+    {
+        std::unique_lock lock{mtx};
+        if (responseBody.empty() && !responseBodyComplete) {
+            lock.unlock();
+            std::weak_ptr<HttpResponseImpl> respObj{shared_from_this()};
+            func_task<void> fnTask{[respObj] (const auto &func) {
+                auto resp = respObj.lock();
+                if (!resp) {
+                    func();
+                    return;
+                }
+                std::unique_lock lock{resp->mtx};
+                if (!resp->responseBody.empty() || resp->responseBodyComplete) {
+                    lock.unlock();
+                    func();
+                    return;
+                }
+                resp->callBodySegment = func;
+            }};
+            co_await fnTask;
+        }
+    }
+    ResponseBodySegment segment{};
+    bool resume{false};
+    {
+        std::lock_guard lock{mtx};
+        resume = !responseBodyComplete && responseBody.size() >= httpClientBodyBufferMax;
+        std::swap(segment.data, responseBody);
+        segment.success = responseBodyOk;
+        segment.end = responseBodyComplete;
+    }
+    if (resume) {
+        auto handler = clientConnectionHandler.lock();
+        if (handler) {
+            handler->ResumeInput();
+        }
+    }
+    co_return segment;
+}
+
+bool HttpResponseImpl::IsBodyBackedUp() {
     std::lock_guard lock{mtx};
-    responseBody.append(chunk);
+    return !responseBodyCollect && !responseBodyComplete && responseBody.size() >= httpClientBodyBufferMax;
+}
+
+void HttpResponseImpl::BodyArrived() {
+    std::function<void ()> callback{};
+    {
+        std::lock_guard lock{mtx};
+        std::swap(callback, callBodySegment);
+    }
+    if (callback) {
+        callback();
+    }
+}
+
+void HttpResponseImpl::RecvBody(std::string_view chunk) {
+    {
+        std::lock_guard lock{mtx};
+        responseBody.append(chunk);
+    }
+    BodyArrived();
 }
 
 void HttpResponseImpl::CompletedBody() {
@@ -97,6 +257,7 @@ void HttpResponseImpl::CompletedBody() {
     for (const auto &cl : callResponseBodyFinished) {
         cl();
     }
+    BodyArrived();
 }
 
 void HttpResponseImpl::FailedBody() {
@@ -108,25 +269,382 @@ void HttpResponseImpl::FailedBody() {
     for (const auto &cl : callResponseBodyFinished) {
         cl();
     }
+    BodyArrived();
+}
+
+/*
+ * Decodes as much of a chunked body as there is input for, the body data is passed on
+ * as it arrives.
+ */
+size_t HttpClientConnectionHandler::AcceptChunkedBody(std::string_view input) {
+    size_t consumed{0};
+    while (true) {
+        auto event = responseBodyDecoder.Decode(input.substr(consumed));
+        consumed += event.consumed;
+        switch (event.type) {
+            case Http1ChunkedEventType::DATA:
+                responseBodyPending->RecvBody(event.data);
+                break;
+            case Http1ChunkedEventType::END:
+                FinishResponseBody(true);
+                return consumed;
+            case Http1ChunkedEventType::ERROR:
+                FinishResponseBody(false);
+                FailConnection();
+                return input.size();
+            case Http1ChunkedEventType::NEED_MORE:
+                return consumed;
+            default:
+                break;
+        }
+    }
+}
+
+void HttpClientConnectionHandler::FinishResponseBody(bool success) {
+    std::shared_ptr<HttpResponseImpl> response{};
+    std::swap(response, responseBodyPending);
+    responseBodyRemaining = 0;
+    responseBodyChunked = false;
+    responseBodyUntilClose = false;
+    bool closeNow{false};
+    {
+        std::lock_guard lock{mtx};
+        if (responseBodyContainer) {
+            CancelTimers(*responseBodyContainer);
+            responseBodyContainer = {};
+        }
+        closeNow = IsRetiredAndIdle();
+    }
+    if (success) {
+        response->CompletedBody();
+    } else {
+        response->FailedBody();
+    }
+    if (closeNow) {
+        close();
+    }
+}
+
+/*
+ * Called with the lock held.
+ */
+bool HttpClientConnectionHandler::IsRetiredAndIdle() const {
+    return retired && inflightRequests.empty() && !responseBodyContainer;
+}
+
+/*
+ * No more requests are added, and the connection is closed when the responses to the
+ * requests on it are done.
+ */
+void HttpClientConnectionHandler::Retire() {
+    {
+        std::lock_guard lock{mtx};
+        retired = true;
+        keepAlive = false;
+        if (!IsRetiredAndIdle()) {
+            return;
+        }
+    }
+    close();
+}
+
+void HttpClientConnectionHandler::FailConnection() {
+    decltype(this->inflightRequests) inflightRequests{};
+    bool wasConnected{false};
+    {
+        std::lock_guard lock{mtx};
+        closeConnection = true;
+        wasConnected = connected;
+        inflightRequests.reserve(this->inflightRequests.size());
+        for (auto &&req : this->inflightRequests) {
+            CancelTimers(*req);
+            inflightRequests.emplace_back(std::move(req));
+        }
+        this->inflightRequests.clear();
+    }
+    /* Requests that have not seen any of their response yet are sent again if allowed to */
+    for (auto &req : inflightRequests) {
+        if (req->retry) {
+            req->retry();
+            continue;
+        }
+        if (!wasConnected) {
+            req->callback(std::unexpected(FdException("connect() failed")));
+            continue;
+        }
+        std::shared_ptr<HttpResponse> response{};
+        req->callback(response);
+    }
+    StopUpload();
+}
+
+/*
+ * Called with the lock held. The timer for the connection is only needed until it is
+ * established.
+ */
+void HttpClientConnectionHandler::StartTimers(const std::shared_ptr<HttpClientRequestContainer> &requestContainer) {
+    auto client = httpClient.lock();
+    if (!client) {
+        return;
+    }
+    std::weak_ptr<HttpClientConnectionHandler> handler{shared_from_this()};
+    std::function<void ()> timedOut{[handler, requestContainer] () {
+        auto shptr = handler.lock();
+        if (shptr) {
+            shptr->AbortRequest(requestContainer, TimeoutException());
+        }
+    }};
+    const auto &deadlines = requestContainer->deadlines;
+    if (deadlines.connect && !connected) {
+        requestContainer->connectTimer = client->AddTimer(*deadlines.connect, timedOut);
+    }
+    if (deadlines.firstByte) {
+        requestContainer->firstByteTimer = client->AddTimer(*deadlines.firstByte, timedOut);
+    }
+    if (deadlines.total) {
+        requestContainer->totalTimer = client->AddTimer(*deadlines.total, timedOut);
+    }
+}
+
+void HttpClientConnectionHandler::CancelTimer(std::optional<NetwTimer> &timer) {
+    if (!timer) {
+        return;
+    }
+    auto client = httpClient.lock();
+    if (client) {
+        client->CancelTimer(*timer);
+    }
+    timer = {};
+}
+
+void HttpClientConnectionHandler::CancelTimers(HttpClientRequestContainer &requestContainer) {
+    CancelTimer(requestContainer.connectTimer);
+    CancelTimer(requestContainer.firstByteTimer);
+    CancelTimer(requestContainer.totalTimer);
+}
+
+/*
+ * A request waiting for its response fails with the error, a response that has started
+ * gets a failed body. Responses after it on the connection can not be matched anymore,
+ * so the connection is closed and the requests queued behind are failed or sent again.
+ */
+void HttpClientConnectionHandler::AbortRequest(const std::shared_ptr<HttpClientRequestContainer> &requestContainer, const FdException &error) {
+    bool waiting{false};
+    bool receiving{false};
+    {
+        std::lock_guard lock{mtx};
+        CancelTimers(*requestContainer);
+        auto iterator = std::find(inflightRequests.begin(), inflightRequests.end(), requestContainer);
+        if (iterator != inflightRequests.end()) {
+            inflightRequests.erase(iterator);
+            waiting = true;
+        }
+        receiving = requestContainer == responseBodyContainer;
+    }
+    if (waiting) {
+        requestContainer->callback(std::unexpected(error));
+    } else if (receiving) {
+        FinishResponseBody(false);
+    } else {
+        return;
+    }
+    FailConnection();
+    close();
+}
+
+/*
+ * Aborts the request from the loop, as the timeouts do, since the caller can be in the
+ * middle of the input of another connection.
+ */
+void HttpClientConnectionHandler::CancelRequest(const std::shared_ptr<HttpClientRequestContainer> &requestContainer) {
+    auto client = httpClient.lock();
+    if (!client) {
+        return;
+    }
+    std::weak_ptr<HttpClientConnectionHandler> handler{shared_from_this()};
+    client->AddTimer(std::chrono::steady_clock::now(), [handler, requestContainer] () {
+        auto shptr = handler.lock();
+        if (shptr) {
+            shptr->AbortRequest(requestContainer, FdException("Cancelled", ECANCELED));
+        }
+    });
+}
+
+bool HttpClientCancellation::IsCancelled() {
+    std::lock_guard lock{mtx};
+    return cancelled;
+}
+
+/*
+ * Called once the request has a connection, so that a cancel that came first can be
+ * carried out.
+ */
+void HttpClientCancellation::Attach(const std::shared_ptr<HttpClientRequestContainer> &requestContainer) {
+    {
+        std::lock_guard lock{mtx};
+        this->requestContainer = requestContainer;
+        if (!cancelled) {
+            return;
+        }
+    }
+    Cancel();
+}
+
+void HttpClientCancellation::Cancel() {
+    std::shared_ptr<HttpClientRequestContainer> requestContainer{};
+    {
+        std::lock_guard lock{mtx};
+        cancelled = true;
+        requestContainer = this->requestContainer.lock();
+    }
+    if (!requestContainer) {
+        return;
+    }
+    auto handler = requestContainer->handler.lock();
+    if (handler) {
+        handler->CancelRequest(requestContainer);
+    }
+}
+
+void HttpClientConnectionHandler::Connected() {
+    std::lock_guard lock{mtx};
+    connected = true;
+    for (auto &req : inflightRequests) {
+        CancelTimer(req->connectTimer);
+    }
+}
+
+HttpClientConnectionHandler::~HttpClientConnectionHandler() {
+    StopUpload();
+}
+
+void HttpClientConnectionHandler::StopUpload() {
+    std::function<void (bool)> callback{};
+    {
+        std::lock_guard lock{mtx};
+        uploadStopped = true;
+        std::swap(callback, callOutputWritable);
+    }
+    if (callback) {
+        callback(false);
+    }
+}
+
+/*
+ * The upload waits here until what it queued has been written to the socket. False
+ * when the connection is gone.
+ */
+func_task<bool> HttpClientConnectionHandler::OutputWritable(const std::weak_ptr<HttpClientConnectionHandler> &handler) {
+    return func_task<bool>{[handler] (const auto &func) {
+        auto shptr = handler.lock();
+        if (!shptr) {
+            func(false);
+            return;
+        }
+        std::unique_lock lock{shptr->mtx};
+        if (shptr->uploadStopped || shptr->outputDrained) {
+            bool writable = !shptr->uploadStopped;
+            shptr->outputDrained = false;
+            lock.unlock();
+            func(writable);
+            return;
+        }
+        shptr->callOutputWritable = func;
+    }};
+}
+
+void HttpClientConnectionHandler::OutputDrained() {
+    std::function<void (bool)> callback{};
+    {
+        std::lock_guard lock{mtx};
+        std::swap(callback, callOutputWritable);
+        outputDrained = !callback;
+    }
+    if (callback) {
+        callback(true);
+    }
+}
+
+/*
+ * Asks the source for a segment each time the output has drained, so no more than a
+ * segment is queued for the connection at a time. A source that fails, or that gives
+ * more or less than the announced length, fails the request and closes the connection.
+ */
+task<void> HttpClientConnectionHandler::UploadBody(std::weak_ptr<HttpClientConnectionHandler> handler, HttpRequestBodySource source, std::optional<size_t> contentLength) {
+    size_t sent{0};
+    while (true) {
+        auto writableTask = OutputWritable(handler);
+        if (!co_await writableTask) {
+            co_return;
+        }
+        auto segmentTask = source();
+        auto segment = co_await segmentTask;
+        auto shptr = handler.lock();
+        if (!shptr) {
+            co_return;
+        }
+        sent += segment.data.size();
+        if (!segment.success || (contentLength && (sent > *contentLength || (segment.end && sent != *contentLength)))) {
+            shptr->FailConnection();
+            shptr->close();
+            co_return;
+        }
+        std::string data{};
+        if (contentLength) {
+            data = std::move(segment.data);
+        } else {
+            if (!segment.data.empty()) {
+                Http1ChunkSizeLine sizeLine{segment.data.size()};
+                data.reserve(sizeLine.size + segment.data.size() + 7);
+                data.append(sizeLine.View());
+                data.append(segment.data);
+                data.append("\r\n");
+            }
+            if (segment.end) {
+                data.append("0\r\n\r\n");
+            }
+        }
+        if (!data.empty()) {
+            shptr->output(data);
+        } else if (!segment.end) {
+            /* Nothing was queued, so there will be no drain to wait for */
+            std::lock_guard lock{shptr->mtx};
+            shptr->outputDrained = true;
+        }
+        if (segment.end) {
+            co_return;
+        }
+    }
+}
+
+void HttpClientConnectionHandler::StartUpload(const HttpRequestBodySource &source, std::optional<size_t> contentLength) {
+    std::weak_ptr<HttpClientConnectionHandler> handler{shared_from_this()};
+    FireAndForget<task<void>>([handler, source, contentLength] () {
+        return UploadBody(handler, source, contentLength);
+    });
 }
 
 size_t HttpClientConnectionHandler::AcceptInput(const std::string &input) {
+    if (responseBodyChunked) {
+        return AcceptChunkedBody(input);
+    }
+    if (responseBodyUntilClose) {
+        responseBodyPending->RecvBody(input);
+        return input.size();
+    }
     if (responseBodyRemaining > 0) {
         if (input.size() <= responseBodyRemaining) {
             responseBodyPending->RecvBody(input);
             responseBodyRemaining -= input.size();
             if (responseBodyRemaining <= 0) {
-                responseBodyPending->CompletedBody();
-                responseBodyPending = {};
+                FinishResponseBody(true);
             }
             return input.size();
         } else {
             auto len = responseBodyRemaining;
-            auto chunk = input.substr(0, len);
+            auto chunk = std::string_view(input).substr(0, len);
             responseBodyPending->RecvBody(chunk);
-            responseBodyRemaining = 0;
-            responseBodyPending->CompletedBody();
-            responseBodyPending = {};
+            FinishResponseBody(true);
             return len;
         }
     }
@@ -143,69 +661,114 @@ size_t HttpClientConnectionHandler::AcceptInput(const std::string &input) {
     Http1ResponseParser parser{input};
     if (parser.IsValid()) {
         auto responseHead = parser.operator Http1Response();
-        HttpHeaderValues hdrValues{responseHead};
-        size_t contentLength = hdrValues.ContentLength;
-        bool hasResponseBody = contentLength > 0;
+        auto code = responseHead.GetResponseLine().GetCode();
         std::shared_ptr<HttpClientRequestContainer> requestContainer{};
         {
+            std::lock_guard lock{mtx};
             auto iterator = inflightRequests.begin();
             requestContainer = *iterator;
             inflightRequests.erase(iterator);
+            CancelTimer(requestContainer->connectTimer);
+            CancelTimer(requestContainer->firstByteTimer);
+        }
+        /*
+         * Chunked goes before Content-Length, and without either the body lasts until
+         * the connection is closed. Responses to HEAD and 1xx, 204 and 304 responses
+         * never have a body.
+         */
+        auto transferCoding = HttpHeaderTransferCoding(responseHead.GetHeader());
+        bool noBody = requestContainer->requestMethod == "HEAD" || code < 200 || code == 204 || code == 304;
+        bool chunked = !noBody && transferCoding == HttpTransferCoding::CHUNKED;
+        bool untilClose = !noBody && !chunked && (transferCoding == HttpTransferCoding::OTHER || !HttpHeaderHasContentLength(responseHead.GetHeader()));
+        size_t contentLength{0};
+        if (!noBody && !chunked && !untilClose) {
+            HttpHeaderValues hdrValues{responseHead};
+            contentLength = hdrValues.ContentLength;
         }
-        hasResponseBody = hasResponseBody && requestContainer->requestMethod != "HEAD";
-        auto response = std::make_shared<HttpResponseImpl>(shared_from_this(), requestContainer, responseHead.GetResponseLine().GetCode(), responseHead.GetResponseLine().GetDescription(), hasResponseBody);
-        if (hasResponseBody) {
+        if (untilClose || responseHead.GetResponseLine().GetVersion() != "HTTP/1.1" || HttpHeaderConnectionClose(responseHead.GetHeader())) {
+            std::lock_guard lock{mtx};
+            keepAlive = false;
+        }
+        bool hasResponseBody = chunked || untilClose || contentLength > 0;
+        auto response = std::make_shared<HttpResponseImpl>(shared_from_this(), requestContainer, code, responseHead.GetResponseLine().GetDescription(), hasResponseBody);
+        if (chunked) {
+            responseBodyDecoder = {};
+            responseBodyChunked = true;
+            responseBodyPending = response;
+        } else if (untilClose) {
+            responseBodyUntilClose = true;
+            responseBodyPending = response;
+        } else if (hasResponseBody) {
             responseBodyRemaining = contentLength;
             responseBodyPending = response;
         }
-        std::shared_ptr<HttpResponse> genResponse{response};
-        requestContainer->callback(genResponse);
-        return parser.GetParsedInputCharacters();
-    } else if (!parser.IsTruncated()) {
-        decltype(this->inflightRequests) inflightRequests{};
+        bool closeNow{false};
         {
             std::lock_guard lock{mtx};
-            closeConnection = true;
-            inflightRequests.reserve(this->inflightRequests.size());
-            for (auto &&req : this->inflightRequests) {
-                inflightRequests.emplace_back(std::move(req));
+            if (hasResponseBody) {
+                responseBodyContainer = requestContainer;
+            } else {
+                CancelTimer(requestContainer->totalTimer);
             }
-            this->inflightRequests.clear();
+            closeNow = IsRetiredAndIdle();
         }
-        for (auto &req : inflightRequests) {
-            std::shared_ptr<HttpResponse> response{};
-            req->callback(response);
+        std::shared_ptr<HttpResponse> genResponse{response};
+        requestContainer->callback(genResponse);
+        if (closeNow) {
+            close();
         }
+        return parser.GetParsedInputCharacters();
+    } else if (!parser.IsTruncated()) {
+        FailConnection();
     }
     return 0;
 }
 
 void HttpClientConnectionHandler::EndOfConnection() {
-    if (responseBodyRemaining > 0) {
-        responseBodyPending->FailedBody();
-        responseBodyPending = {};
-    }
-    decltype(this->inflightRequests) inflightRequests{};
-    {
-        std::lock_guard lock{mtx};
-        closeConnection = true;
-        inflightRequests.reserve(this->inflightRequests.size());
-        for (auto &&req : this->inflightRequests) {
-            inflightRequests.emplace_back(std::move(req));
-        }
-        this->inflightRequests.clear();
-    }
-    for (auto &req : inflightRequests) {
-        std::shared_ptr<HttpResponse> response{};
-        req->callback(response);
+    if (responseBodyUntilClose) {
+        FinishResponseBody(true);
+    } else if (responseBodyRemaining > 0 || responseBodyChunked) {
+        FinishResponseBody(false);
     }
+    FailConnection();
+}
+
+/*
+ * Reading stops while the body waits for the consumer, and an empty output has the
+ * loop look at the connection again when it has caught up.
+ */
+bool HttpClientConnectionHandler::IsInputPaused() {
+    return responseBodyPending && responseBodyPending->IsBodyBackedUp();
+}
+
+void HttpClientConnectionHandler::ResumeInput() {
+    output({});
 }
 
-void HttpClientConnectionHandler::WaitForResponse(const std::string &requestMethod, const std::function<void (std::shared_ptr<HttpResponse> &response)> &callback) {
+void HttpClientConnectionHandler::WaitForResponse(const std::shared_ptr<HttpClientRequestContainer> &requestContainer) {
     auto shptr = shared_from_this();
-    std::weak_ptr<HttpClientConnectionHandler> wkptr{shptr};
-    HttpClientRequestContainer reqContainer{.handler = std::move(wkptr), .callback = callback, .requestMethod = requestMethod};
-    inflightRequests.emplace_back(std::make_shared<HttpClientRequestContainer>(std::move(reqContainer)));
+    requestContainer->handler = shptr;
+    std::lock_guard lock{mtx};
+    inflightRequests.emplace_back(requestContainer);
+    StartTimers(requestContainer);
+}
+
+/*
+ * Writes the request behind those already sent, unless the connection is going away or
+ * has depth requests waiting for a response. The request is queued for its response
+ * and written under the lock, so the responses are matched in the order of the writes.
+ */
+bool HttpClientConnectionHandler::Pipeline(const std::shared_ptr<HttpClientRequestContainer> &requestContainer, const std::string &requestData, size_t depth) {
+    auto shptr = shared_from_this();
+    std::lock_guard lock{mtx};
+    if (closeConnection || !keepAlive || inflightRequests.size() >= depth) {
+        return false;
+    }
+    requestContainer->handler = shptr;
+    inflightRequests.emplace_back(requestContainer);
+    StartTimers(requestContainer);
+    output(requestData);
+    return true;
 }
 
 class HttpClientConnectionHandlerProxy : public NetwConnectionHandler {
@@ -215,6 +778,9 @@ public:
     HttpClientConnectionHandlerProxy(const std::shared_ptr<HttpClientImpl> &httpClient, const std::function<void(const std::string &)> &output, const std::function<void()> &close) : handler(std::make_shared<HttpClientConnectionHandler>(httpClient, output, close)) {}
     size_t AcceptInput(const std::string &) override;
     void EndOfConnection() override;
+    bool IsInputPaused() override;
+    void OutputDrained() override;
+    void Connected() override;
     std::shared_ptr<HttpClientConnectionHandler> GetHandler() const {
         return handler;
     }
@@ -228,6 +794,18 @@ void HttpClientConnectionHandlerProxy::EndOfConnection() {
     handler->EndOfConnection();
 }
 
+bool HttpClientConnectionHandlerProxy::IsInputPaused() {
+    return handler->IsInputPaused();
+}
+
+void HttpClientConnectionHandlerProxy::OutputDrained() {
+    handler->OutputDrained();
+}
+
+void HttpClientConnectionHandlerProxy::Connected() {
+    handler->Connected();
+}
+
 NetwConnectionHandler *
 HttpClientImpl::Create(const std::function<void(const std::string &)> &output, const std::function<void()> &close) {
     std::shared_ptr<HttpClientImpl> shptr = shared_from_this();
@@ -246,11 +824,11 @@ std::shared_ptr<HttpRequest> HttpClientImpl::Request(const std::string &method,
     return std::make_shared<HttpRequestImpl>(method, path);
 }
 
-task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::Execute(const std::string &host, int port, const std::shared_ptr<HttpRequest> &request) {
-    auto netwServer = this->netwServer.lock();
-    if (!netwServer) {
-        co_return {};
-    }
+/*
+ * The address of the host in network byte order, four bytes for IPv4 and sixteen for
+ * IPv6.
+ */
+std::string HttpClientImpl::ResolveAddress(const std::string &host) {
     std::unique_ptr<struct addrinfo,std::function<void (struct addrinfo *)>> addrinfo{};
     {
         struct addrinfo *addrinfo_raw;
@@ -265,7 +843,7 @@ task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::E
         }};
         addrinfo = std::move(up);
     }
-    struct sockaddr *sa;
+    struct sockaddr *sa{NULL};
     {
         struct addrinfo *addrinfo_w = &(*addrinfo);
         while (addrinfo_w != NULL) {
@@ -280,18 +858,223 @@ task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::E
         }
     }
 
+    std::string addr{};
+    if (sa->sa_family == AF_INET) {
+        struct sockaddr_in *sa4 = (struct sockaddr_in *) sa;
+        addr.resize(4);
+        memcpy(addr.data(), &(sa4->sin_addr), 4);
+    } else if (sa->sa_family == AF_INET6) {
+        struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *) sa;
+        addr.resize(16);
+        memcpy(addr.data(), &(sa6->sin6_addr), 16);
+    }
+    return addr;
+}
+
+HttpClientSendArgs HttpClientImpl::TcpSendArgs(const std::shared_ptr<NetwServerInterface> &netwServer, const std::string &host, const std::string &addr, int port, const std::shared_ptr<HttpRequest> &request) const {
+    auto requestMethod = request->GetMethod();
+    auto reqContent = RequestContent(host, request);
+    auto contentSource = request->GetContentSource();
+    std::function<void (const std::function<void (NetwConnectionHandler *)> &)> connect{[netwServer, addr, port, reqContent] (const std::function<void (NetwConnectionHandler *)> &setupHandler) {
+        netwServer->Connect(addr.data(), addr.size(), port, reqContent, setupHandler);
+    }};
+    return {
+        .requestMethod = requestMethod,
+        .destination = addr + ":" + std::to_string(port),
+        .requestData = reqContent,
+        .contentSource = contentSource,
+        .contentSourceLength = request->GetContentSourceLength(),
+        .connect = connect,
+        .timeouts = Timeouts(request->GetTimeouts()),
+        .pipelined = pipelineDepth > 0 && !contentSource && IsIdempotent(requestMethod)
+    };
+}
+
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::Execute(const std::string &host, int port, const std::shared_ptr<HttpRequest> &request) {
+    auto netwServer = this->netwServer.lock();
+    if (!netwServer) {
+        co_return {};
+    }
+    auto args = TcpSendArgs(netwServer, host, ResolveAddress(host), port, request);
+    auto response = co_await SendWithRetries(args);
+    co_return response;
+}
+
+/*
+ * Idempotent requests to an upstream reuse the connections to the endpoint, one
+ * request at a time on each unless pipelining is on. Each attempt, retry or hedge,
+ * picks its own endpoint.
+ */
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::ExecuteUpstream(const std::string &name, const std::shared_ptr<HttpRequest> &request) {
+    std::shared_ptr<HttpUpstreamGroup> group{};
+    {
+        std::lock_guard lock{mtx};
+        auto iterator = upstreams.find(name);
+        if (iterator != upstreams.end()) {
+            group = iterator->second;
+        }
+    }
+    if (!group || group->Endpoints().empty()) {
+        co_return std::unexpected(FdException("No endpoints in upstream " + name));
+    }
+    if (!group->HasAvailable()) {
+        co_return std::unexpected(FdException("All endpoints of upstream " + name + " are ejected", EHOSTUNREACH));
+    }
+    auto upstream = std::make_shared<HttpClientUpstreamRequest>();
+    upstream->name = name;
+    upstream->group = group;
+    upstream->request = request;
+    auto requestMethod = request->GetMethod();
+    auto contentSource = request->GetContentSource();
+    HttpClientSendArgs args{
+        .requestMethod = requestMethod,
+        .contentSource = contentSource,
+        .contentSourceLength = request->GetContentSourceLength(),
+        .timeouts = Timeouts(request->GetTimeouts()),
+        .pipelined = !contentSource && IsIdempotent(requestMethod),
+        .upstream = upstream
+    };
+    auto response = co_await SendWithRetries(args);
+    co_return response;
+}
+
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::UpstreamAttempt(HttpClientSendArgs args, HttpClientDeadlines deadlines, std::shared_ptr<HttpClientCancellation> cancellation) {
+    auto netwServer = this->netwServer.lock();
+    if (!netwServer) {
+        co_return {};
+    }
+    auto upstream = args.upstream;
+    HttpUpstreamLease lease{};
+    {
+        std::lock_guard lock{upstream->mtx};
+        lease = upstream->group->Acquire(upstream->tried);
+        if (lease.endpoint) {
+            upstream->tried.emplace_back(lease.endpoint);
+        }
+    }
+    if (!lease.endpoint) {
+        co_return std::unexpected(FdException("All endpoints of upstream " + upstream->name + " are ejected", EHOSTUNREACH));
+    }
+    auto endpoint = lease.endpoint;
+    auto endpointArgs = TcpSendArgs(netwServer, endpoint->endpoint.host, endpoint->address, endpoint->endpoint.port, upstream->request);
+    endpointArgs.pipelined = args.pipelined;
+    auto start = std::chrono::steady_clock::now();
+    auto response = co_await Attempt(endpointArgs, deadlines, cancellation);
+    /* A hedge cancelled because the other copy won says nothing about the endpoint */
+    if (!response.has_value() && response.error().GetErrno() == ECANCELED) {
+        upstream->group->Release(lease);
+        co_return response;
+    }
+    auto latency = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    bool success = response.has_value() && response.value() && response.value()->GetCode() < 500;
+    upstream->group->Release(lease, success, latency);
+    co_return response;
+}
+
+/*
+ * Resolves the hosts that are new to the group. Requests in flight to endpoints that
+ * are removed are completed, and their connections are closed when idle. Endpoints
+ * that stay keep their health.
+ */
+void HttpClientImpl::SetUpstream(const std::string &name, const std::vector<HttpUpstreamEndpoint> &endpoints, const HttpUpstreamHealthPolicy &healthPolicy) {
+    std::shared_ptr<HttpUpstreamGroup> group{};
+    {
+        std::lock_guard lock{mtx};
+        auto &existing = upstreams[name];
+        if (!existing) {
+            existing = std::make_shared<HttpUpstreamGroup>();
+        }
+        group = existing;
+    }
+    group->SetHealthPolicy(healthPolicy);
+    std::vector<std::shared_ptr<HttpUpstreamEndpointState>> states{};
+    for (const auto &endpoint : endpoints) {
+        auto state = group->Find(endpoint);
+        if (!state) {
+            state = std::make_shared<HttpUpstreamEndpointState>(endpoint, ResolveAddress(endpoint.host));
+        }
+        states.emplace_back(state);
+    }
+    auto removed = group->Replace(states);
+    for (const auto &endpoint : removed) {
+        RetireDestination(endpoint->destination);
+    }
+}
+
+/*
+ * Takes the connection pool of a destination that no upstream has anymore out of use.
+ */
+void HttpClientImpl::RetireDestination(const std::string &destination) {
+    std::vector<std::weak_ptr<HttpClientConnectionHandler>> connections{};
+    {
+        std::lock_guard lock{mtx};
+        for (const auto &upstream : upstreams) {
+            for (const auto &endpoint : upstream.second->Endpoints()) {
+                if (endpoint->destination == destination) {
+                    return;
+                }
+            }
+        }
+        auto iterator = pipelineConnections.find(destination);
+        if (iterator == pipelineConnections.end()) {
+            return;
+        }
+        connections = std::move(iterator->second);
+        pipelineConnections.erase(iterator);
+    }
+    for (const auto &connection : connections) {
+        auto handler = connection.lock();
+        if (handler) {
+            handler->Retire();
+        }
+    }
+}
+
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::ExecuteUnix(const std::string &path, const std::shared_ptr<HttpRequest> &request) {
+    auto netwServer = this->netwServer.lock();
+    if (!netwServer) {
+        co_return {};
+    }
     auto requestMethod = request->GetMethod();
+    auto reqContent = RequestContent("localhost", request);
+    auto contentSource = request->GetContentSource();
+    auto contentSourceLength = request->GetContentSourceLength();
+    std::function<void (const std::function<void (NetwConnectionHandler *)> &)> connect{[netwServer, path, reqContent] (const std::function<void (NetwConnectionHandler *)> &setupHandler) {
+        netwServer->ConnectUnix(path, reqContent, setupHandler);
+    }};
+    HttpClientSendArgs args{
+        .requestMethod = requestMethod,
+        .destination = "unix:" + path,
+        .requestData = reqContent,
+        .contentSource = contentSource,
+        .contentSourceLength = contentSourceLength,
+        .connect = connect,
+        .timeouts = Timeouts(request->GetTimeouts()),
+        .pipelined = pipelineDepth > 0 && !contentSource && IsIdempotent(requestMethod)
+    };
+    auto response = co_await SendWithRetries(args);
+    co_return response;
+}
+
+std::string HttpClientImpl::RequestContent(const std::string &host, const std::shared_ptr<HttpRequest> &request) {
     std::string reqContent{};
     {
-        Http1RequestLine reqLine{requestMethod, request->GetPath(), "HTTP/1.1"};
+        Http1RequestLine reqLine{request->GetMethod(), request->GetPath(), "HTTP/1.1"};
         auto requestBody = request->GetContent();
         auto contentType = request->GetContentType();
+        bool streamed{request->GetContentSource()};
         std::vector<Http1HeaderLine> header{};
-        if (!requestBody.empty()) {
+        if (!requestBody.empty() || streamed) {
             if (!contentType.empty()) {
                 header.emplace_back("Content-Type", contentType);
             }
-            header.emplace_back("Content-Length", std::to_string(requestBody.size()));
+            if (!streamed) {
+                header.emplace_back("Content-Length", std::to_string(requestBody.size()));
+            } else if (auto contentLength = request->GetContentSourceLength()) {
+                header.emplace_back("Content-Length", std::to_string(*contentLength));
+            } else {
+                header.emplace_back("Transfer-Encoding", "chunked");
+            }
         }
         header.emplace_back("Host", host);
         Http1Request request{reqLine, header};
@@ -300,33 +1083,392 @@ task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::E
             reqContent.append(requestBody);
         }
     }
+    return reqContent;
+}
 
-    std::string addr{};
-    if (sa->sa_family == AF_INET) {
-        struct sockaddr_in *sa4 = (struct sockaddr_in *) sa;
-        addr.resize(4);
-        memcpy(addr.data(), &(sa4->sin_addr), 4);
-    } else if (sa->sa_family == AF_INET6) {
-        struct sockaddr_in6 *sa6 = (struct sockaddr_in6 *) sa;
-        addr.resize(16);
-        memcpy(addr.data(), &(sa6->sin6_addr), 16);
-    }
-
-    func_task<std::expected<std::shared_ptr<HttpResponse>,FdException>> fnTask{[netwServer, requestMethod, addr, port, reqContent] (const auto &callback) {
-        std::function<void (NetwConnectionHandler *)> setupHandler{[requestMethod, callback] (NetwConnectionHandler *rawHandler) {
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::Send(const std::string &requestMethod, const HttpClientDeadlines &deadlines, const std::shared_ptr<HttpClientCancellation> &cancellation, const HttpRequestBodySource &contentSource, std::optional<size_t> contentSourceLength, const std::function<void (const std::function<void (NetwConnectionHandler *)> &)> &connect) {
+    func_task<std::expected<std::shared_ptr<HttpResponse>,FdException>> fnTask{[requestMethod, deadlines, cancellation, contentSource, contentSourceLength, connect] (const auto &callback) {
+        if (cancellation && cancellation->IsCancelled()) {
+            callback(std::unexpected(FdException("Cancelled", ECANCELED)));
+            return;
+        }
+        std::function<void (NetwConnectionHandler *)> setupHandler{[requestMethod, deadlines, cancellation, contentSource, contentSourceLength, callback] (NetwConnectionHandler *rawHandler) {
             HttpClientConnectionHandlerProxy *handlerProxy = dynamic_cast<HttpClientConnectionHandlerProxy *>(rawHandler);
             if (handlerProxy == nullptr) {
                 throw std::exception();
             }
             auto handler = handlerProxy->GetHandler();
-            handler->WaitForResponse(requestMethod, callback);
+            auto requestContainer = std::make_shared<HttpClientRequestContainer>(HttpClientRequestContainer{.callback = callback, .requestMethod = requestMethod, .deadlines = deadlines});
+            handler->WaitForResponse(requestContainer);
+            if (cancellation) {
+                cancellation->Attach(requestContainer);
+            }
+            if (contentSource) {
+                handler->StartUpload(contentSource, contentSourceLength);
+            }
         }};
         try {
-            netwServer->Connect(addr.data(), addr.size(), port, reqContent, setupHandler);
+            connect(setupHandler);
         } catch (const FdException &e) {
             callback(std::unexpected(e));
         }
     }};
     auto response = co_await fnTask;
     co_return response;
-}
\ No newline at end of file
+}
+
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::Attempt(HttpClientSendArgs args, HttpClientDeadlines deadlines, std::shared_ptr<HttpClientCancellation> cancellation) {
+    if (args.upstream) {
+        auto response = co_await UpstreamAttempt(args, deadlines, cancellation);
+        co_return response;
+    }
+    if (args.pipelined) {
+        auto response = co_await SendPipelined(args.destination, args.requestMethod, deadlines, cancellation, args.requestData, args.connect);
+        co_return response;
+    }
+    auto response = co_await Send(args.requestMethod, deadlines, cancellation, args.contentSource, args.contentSourceLength, args.connect);
+    co_return response;
+}
+
+/*
+ * Sends an idempotent request again after failures that may be gone the next time, as
+ * long as the policy, the budget and the total deadline allow it. Each attempt gets
+ * its own connect and first byte deadlines.
+ */
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::SendWithRetries(HttpClientSendArgs args) {
+    HttpClientRetryPolicy policy{};
+    std::optional<std::chrono::microseconds> hedgeDelay{};
+    {
+        std::lock_guard lock{mtx};
+        policy = retryPolicy;
+        retryBudget.Deposit();
+        if (policy.hedgePercentile > 0) {
+            hedgeDelay = latency.Percentile(policy.hedgePercentile);
+            if (hedgeDelay && *hedgeDelay < policy.minHedgeDelay) {
+                hedgeDelay = policy.minHedgeDelay;
+            }
+        }
+    }
+    auto deadlines = Deadlines(args.timeouts);
+    bool retriable = !args.contentSource && IsIdempotent(args.requestMethod);
+    if (!retriable || (policy.maxAttempts <= 1 && policy.hedgePercentile <= 0)) {
+        auto response = co_await Attempt(args, deadlines, {});
+        co_return response;
+    }
+    unsigned int attempt{1};
+    while (true) {
+        auto start = std::chrono::steady_clock::now();
+        auto result = co_await SendHedged(args, deadlines, hedgeDelay);
+        auto now = std::chrono::steady_clock::now();
+        if (!IsRetriable(result.response)) {
+            if (result.response.has_value()) {
+                std::lock_guard lock{mtx};
+                latency.Add(std::chrono::duration_cast<std::chrono::microseconds>(now - start));
+            }
+            co_return result.response;
+        }
+        if (attempt >= policy.maxAttempts || (deadlines.total && now >= *deadlines.total)) {
+            co_return result.response;
+        }
+        bool withdrawn{false};
+        std::chrono::milliseconds delay{};
+        {
+            std::lock_guard lock{mtx};
+            withdrawn = retryBudget.Withdraw();
+            std::uniform_int_distribution<int64_t> jitter{0, HttpClientBackoffCap(policy, attempt).count()};
+            delay = std::chrono::milliseconds(jitter(random));
+        }
+        if (!withdrawn) {
+            co_return result.response;
+        }
+        if (result.response.has_value()) {
+            /* The body of the failed response is not wanted */
+            result.cancellation->Cancel();
+        }
+        co_await Backoff(delay);
+        ++attempt;
+        auto total = deadlines.total;
+        deadlines = Deadlines(args.timeouts);
+        deadlines.total = total;
+    }
+}
+
+task<void> HttpClientImpl::Backoff(std::chrono::milliseconds delay) {
+    std::weak_ptr<HttpClientImpl> weakSelf{shared_from_this()};
+    func_task<void> fnTask{[weakSelf, delay] (const auto &callback) {
+        auto self = weakSelf.lock();
+        std::optional<NetwTimer> timer{};
+        if (self) {
+            timer = self->AddTimer(std::chrono::steady_clock::now() + delay, callback);
+        }
+        if (!timer) {
+            callback();
+        }
+    }};
+    co_await fnTask;
+}
+
+/*
+ * Sends the request, and a copy of it if there is no response after hedgeDelay and the
+ * budget allows it.
+ */
+task<HttpClientAttemptResult> HttpClientImpl::SendHedged(HttpClientSendArgs args, HttpClientDeadlines deadlines, std::optional<std::chrono::microseconds> hedgeDelay) {
+    auto hedge = std::make_shared<HttpClientHedge>();
+    std::shared_ptr<HttpClientImpl> self{shared_from_this()};
+    func_task<HttpClientAttemptResult> fnTask{[self, hedge, args, deadlines, hedgeDelay] (const auto &callback) {
+        {
+            std::lock_guard lock{hedge->mtx};
+            hedge->callback = callback;
+        }
+        self->StartHedge(hedge, args, deadlines);
+        if (!hedgeDelay) {
+            return;
+        }
+        std::weak_ptr<HttpClientImpl> weakSelf{self};
+        auto timer = self->AddTimer(std::chrono::steady_clock::now() + *hedgeDelay, [weakSelf, hedge, args, deadlines] () {
+            auto self = weakSelf.lock();
+            if (!self) {
+                return;
+            }
+            {
+                std::lock_guard lock{hedge->mtx};
+                hedge->hedgeTimer = {};
+                if (hedge->done) {
+                    return;
+                }
+            }
+            {
+                std::lock_guard lock{self->mtx};
+                if (!self->retryBudget.Withdraw()) {
+                    return;
+                }
+            }
+            auto hedgeDeadlines = Deadlines(args.timeouts);
+            hedgeDeadlines.total = deadlines.total;
+            self->StartHedge(hedge, args, hedgeDeadlines);
+        });
+        bool done{false};
+        {
+            std::lock_guard lock{hedge->mtx};
+            done = hedge->done;
+            if (!done) {
+                hedge->hedgeTimer = timer;
+            }
+        }
+        if (done && timer) {
+            self->CancelTimer(*timer);
+        }
+    }};
+    auto result = co_await fnTask;
+    co_return result;
+}
+
+void HttpClientImpl::StartHedge(const std::shared_ptr<HttpClientHedge> &hedge, const HttpClientSendArgs &args, const HttpClientDeadlines &deadlines) {
+    auto cancellation = std::make_shared<HttpClientCancellation>();
+    {
+        std::lock_guard lock{hedge->mtx};
+        if (hedge->done) {
+            return;
+        }
+        hedge->attempts.emplace_back(cancellation);
+        ++hedge->pending;
+    }
+    std::shared_ptr<HttpClientImpl> self{shared_from_this()};
+    FireAndForget<task<void>>([self, hedge, args, deadlines, cancellation] () {
+        return self->HedgeAttempt(hedge, args, deadlines, cancellation);
+    });
+}
+
+/*
+ * The first copy to succeed completes the request and the others are cancelled. A copy
+ * that fails leaves it to those still in flight, unless it is the last one.
+ */
+task<void> HttpClientImpl::HedgeAttempt(std::shared_ptr<HttpClientHedge> hedge, HttpClientSendArgs args, HttpClientDeadlines deadlines, std::shared_ptr<HttpClientCancellation> cancellation) {
+    auto response = co_await Attempt(args, deadlines, cancellation);
+    std::function<void (HttpClientAttemptResult)> callback{};
+    std::vector<std::shared_ptr<HttpClientCancellation>> losers{};
+    std::optional<NetwTimer> hedgeTimer{};
+    {
+        std::lock_guard lock{hedge->mtx};
+        --hedge->pending;
+        if (!hedge->done && (!IsRetriable(response) || hedge->pending == 0)) {
+            hedge->done = true;
+            std::swap(callback, hedge->callback);
+            std::swap(hedgeTimer, hedge->hedgeTimer);
+            for (const auto &attempt : hedge->attempts) {
+                if (attempt != cancellation) {
+                    losers.emplace_back(attempt);
+                }
+            }
+        }
+    }
+    if (!callback) {
+        cancellation->Cancel();
+        co_return;
+    }
+    if (hedgeTimer) {
+        CancelTimer(*hedgeTimer);
+    }
+    for (const auto &loser : losers) {
+        loser->Cancel();
+    }
+    callback({.response = response, .cancellation = cancellation});
+}
+
+/*
+ * Only requests that can be sent again without harm are pipelined, RFC 9110 9.2.2.
+ */
+bool HttpClientImpl::IsIdempotent(const std::string &requestMethod) {
+    return requestMethod == "GET" || requestMethod == "HEAD" || requestMethod == "OPTIONS" || requestMethod == "TRACE" || requestMethod == "PUT" || requestMethod == "DELETE";
+}
+
+/*
+ * Failures to connect, connections lost before the response and the statuses of
+ * gateways and of servers that are unavailable for now, RFC 9110 15.6.
+ */
+bool HttpClientImpl::IsRetriable(const std::expected<std::shared_ptr<HttpResponse>,FdException> &response) {
+    if (!response.has_value()) {
+        return response.error().GetErrno() != ECANCELED;
+    }
+    if (!response.value()) {
+        return true;
+    }
+    auto code = response.value()->GetCode();
+    return code == 502 || code == 503 || code == 504;
+}
+
+task<std::expected<std::shared_ptr<HttpResponse>,FdException>> HttpClientImpl::SendPipelined(const std::string &destination, const std::string &requestMethod, const HttpClientDeadlines &deadlines, const std::shared_ptr<HttpClientCancellation> &cancellation, const std::string &requestData, const std::function<void (const std::function<void (NetwConnectionHandler *)> &)> &connect) {
+    std::shared_ptr<HttpClientImpl> self{shared_from_this()};
+    func_task<std::expected<std::shared_ptr<HttpResponse>,FdException>> fnTask{[self, destination, requestMethod, deadlines, cancellation, requestData, connect] (const auto &callback) {
+        self->Dispatch(destination, requestMethod, deadlines, cancellation, requestData, connect, callback, true);
+    }};
+    auto response = co_await fnTask;
+    co_return response;
+}
+
+/*
+ * Writes the request on an open connection to the destination that has room in its
+ * pipeline, or opens a new one. If the connection fails before the response starts,
+ * the request is dispatched once more, within the same deadlines.
+ */
+void HttpClientImpl::Dispatch(const std::string &destination, const std::string &requestMethod, const HttpClientDeadlines &deadlines, const std::shared_ptr<HttpClientCancellation> &cancellation, const std::string &requestData, const std::function<void (const std::function<void (NetwConnectionHandler *)> &)> &connect, const std::function<void (std::expected<std::shared_ptr<HttpResponse>,FdException>)> &callback, bool retry) {
+    if (cancellation && cancellation->IsCancelled()) {
+        callback(std::unexpected(FdException("Cancelled", ECANCELED)));
+        return;
+    }
+    auto requestContainer = std::make_shared<HttpClientRequestContainer>(HttpClientRequestContainer{.callback = callback, .requestMethod = requestMethod, .deadlines = deadlines});
+    if (retry) {
+        std::weak_ptr<HttpClientImpl> weakSelf{shared_from_this()};
+        requestContainer->retry = [weakSelf, destination, requestMethod, deadlines, cancellation, requestData, connect, callback] () {
+            auto self = weakSelf.lock();
+            if (!self) {
+                std::shared_ptr<HttpResponse> response{};
+                callback(response);
+                return;
+            }
+            self->Dispatch(destination, requestMethod, deadlines, cancellation, requestData, connect, callback, false);
+        };
+    }
+    bool pipelined{false};
+    {
+        std::lock_guard lock{mtx};
+        auto &connections = pipelineConnections[destination];
+        auto iterator = connections.begin();
+        while (iterator != connections.end()) {
+            auto handler = iterator->lock();
+            if (!handler) {
+                iterator = connections.erase(iterator);
+                continue;
+            }
+            if (handler->Pipeline(requestContainer, requestData, pipelineDepth > 0 ? pipelineDepth : 1)) {
+                pipelined = true;
+                break;
+            }
+            ++iterator;
+        }
+    }
+    if (pipelined) {
+        if (cancellation) {
+            cancellation->Attach(requestContainer);
+        }
+        return;
+    }
+    auto connected = std::make_shared<std::shared_ptr<HttpClientConnectionHandler>>();
+    std::function<void (NetwConnectionHandler *)> setupHandler{[requestContainer, connected] (NetwConnectionHandler *rawHandler) {
+        HttpClientConnectionHandlerProxy *handlerProxy = dynamic_cast<HttpClientConnectionHandlerProxy *>(rawHandler);
+        if (handlerProxy == nullptr) {
+            throw std::exception();
+        }
+        *connected = handlerProxy->GetHandler();
+        (*connected)->WaitForResponse(requestContainer);
+    }};
+    try {
+        connect(setupHandler);
+    } catch (const FdException &e) {
+        callback(std::unexpected(e));
+        return;
+    }
+    {
+        /* Not before the connection has been added, output for it would be dropped until then */
+        std::lock_guard lock{mtx};
+        pipelineConnections[destination].emplace_back(*connected);
+    }
+    if (cancellation) {
+        cancellation->Attach(requestContainer);
+    }
+}
+
+void HttpClientImpl::SetPipelineDepth(size_t depth) {
+    pipelineDepth = depth;
+}
+
+void HttpClientImpl::SetTimeouts(const HttpRequestTimeouts &timeouts) {
+    this->timeouts = timeouts;
+}
+
+/*
+ * The timeouts set on the request replace the ones of the client.
+ */
+HttpRequestTimeouts HttpClientImpl::Timeouts(const HttpRequestTimeouts &requestTimeouts) const {
+    return {
+        .connect = requestTimeouts.connect.count() > 0 ? requestTimeouts.connect : timeouts.connect,
+        .firstByte = requestTimeouts.firstByte.count() > 0 ? requestTimeouts.firstByte : timeouts.firstByte,
+        .total = requestTimeouts.total.count() > 0 ? requestTimeouts.total : timeouts.total
+    };
+}
+
+HttpClientDeadlines HttpClientImpl::Deadlines(const HttpRequestTimeouts &timeouts) {
+    auto now = std::chrono::steady_clock::now();
+    HttpClientDeadlines deadlines{};
+    if (timeouts.connect.count() > 0) {
+        deadlines.connect = now + timeouts.connect;
+    }
+    if (timeouts.firstByte.count() > 0) {
+        deadlines.firstByte = now + timeouts.firstByte;
+    }
+    if (timeouts.total.count() > 0) {
+        deadlines.total = now + timeouts.total;
+    }
+    return deadlines;
+}
+
+void HttpClientImpl::SetRetryPolicy(const HttpClientRetryPolicy &policy) {
+    std::lock_guard lock{mtx};
+    retryPolicy = policy;
+    retryBudget.Configure(policy.budgetRatio, policy.budgetMax);
+}
+
+std::optional<NetwTimer> HttpClientImpl::AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func) {
+    auto netwServer = this->netwServer.lock();
+    if (!netwServer) {
+        return {};
+    }
+    return netwServer->AddTimer(deadline, func);
+}
+
+void HttpClientImpl::CancelTimer(const NetwTimer &timer) {
+    auto netwServer = this->netwServer.lock();
+    if (netwServer) {
+        netwServer->CancelTimer(timer);
+    }
+}
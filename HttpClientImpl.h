@@ -9,20 +9,105 @@
 #include "NetwServer.h"
 #include "HttpResponse.h"
 #include "HttpRequest.h"
+#include "HttpClientRetry.h"
+#include "HttpUpstream.h"
 #include <expected>
+#include <map>
+#include <mutex>
+#include <random>
+#include <vector>
 #include "Fd.h"
 
 class HttpClientConnectionHandler;
+class HttpClientCancellation;
+struct HttpClientHedge;
+struct HttpClientUpstreamRequest;
+
+/*
+ * Body bytes a response keeps for NextBodySegment before reading from the connection
+ * is paused.
+ */
+constexpr size_t httpClientBodyBufferMax = 256 * 1024;
+
+/*
+ * The timeouts of a request as points in time, so that they are kept when the request
+ * is sent again.
+ */
+struct HttpClientDeadlines {
+    std::optional<std::chrono::steady_clock::time_point> connect{};
+    std::optional<std::chrono::steady_clock::time_point> firstByte{};
+    std::optional<std::chrono::steady_clock::time_point> total{};
+};
+
+/*
+ * What is needed to send a request again, for retries and hedges. A request to an
+ * upstream has no destination yet, each attempt picks an endpoint.
+ */
+struct HttpClientSendArgs {
+    std::string requestMethod{};
+    std::string destination{};
+    std::string requestData{};
+    HttpRequestBodySource contentSource{};
+    std::optional<size_t> contentSourceLength{};
+    std::function<void (const std::function<void (NetwConnectionHandler *)> &)> connect{};
+    HttpRequestTimeouts timeouts{};
+    bool pipelined{false};
+    std::shared_ptr<HttpClientUpstreamRequest> upstream{};
+};
+
+struct HttpClientAttemptResult {
+    std::expected<std::shared_ptr<HttpResponse>,FdException> response{};
+    std::shared_ptr<HttpClientCancellation> cancellation{};
+};
 
 class HttpClientImpl : public NetwProtocolHandler, public std::enable_shared_from_this<HttpClientImpl> {
 private:
     std::weak_ptr<NetwServerInterface> netwServer{};
+    std::mutex mtx{};
+    std::map<std::string,std::vector<std::weak_ptr<HttpClientConnectionHandler>>> pipelineConnections{};
+    size_t pipelineDepth{0};
+    HttpRequestTimeouts timeouts{};
+    HttpClientRetryPolicy retryPolicy{};
+    HttpClientRetryBudget retryBudget{};
+    HttpClientLatency latency{};
+    std::minstd_rand random{std::random_device{}()};
+    std::map<std::string,std::shared_ptr<HttpUpstreamGroup>> upstreams{};
+    HttpRequestTimeouts Timeouts(const HttpRequestTimeouts &requestTimeouts) const;
+    static HttpClientDeadlines Deadlines(const HttpRequestTimeouts &timeouts);
+    static bool IsIdempotent(const std::string &requestMethod);
+    static bool IsRetriable(const std::expected<std::shared_ptr<HttpResponse>,FdException> &response);
+    static std::string ResolveAddress(const std::string &host);
+    HttpClientSendArgs TcpSendArgs(const std::shared_ptr<NetwServerInterface> &netwServer, const std::string &host, const std::string &addr, int port, const std::shared_ptr<HttpRequest> &request) const;
+    void RetireDestination(const std::string &destination);
+    static std::string RequestContent(const std::string &host, const std::shared_ptr<HttpRequest> &request);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> SendWithRetries(HttpClientSendArgs args);
+    task<HttpClientAttemptResult> SendHedged(HttpClientSendArgs args, HttpClientDeadlines deadlines, std::optional<std::chrono::microseconds> hedgeDelay);
+    void StartHedge(const std::shared_ptr<HttpClientHedge> &hedge, const HttpClientSendArgs &args, const HttpClientDeadlines &deadlines);
+    task<void> HedgeAttempt(std::shared_ptr<HttpClientHedge> hedge, HttpClientSendArgs args, HttpClientDeadlines deadlines, std::shared_ptr<HttpClientCancellation> cancellation);
+    task<void> Backoff(std::chrono::milliseconds delay);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> Attempt(HttpClientSendArgs args, HttpClientDeadlines deadlines, std::shared_ptr<HttpClientCancellation> cancellation);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> UpstreamAttempt(HttpClientSendArgs args, HttpClientDeadlines deadlines, std::shared_ptr<HttpClientCancellation> cancellation);
+    static task<std::expected<std::shared_ptr<HttpResponse>,FdException>> Send(const std::string &requestMethod, const HttpClientDeadlines &deadlines, const std::shared_ptr<HttpClientCancellation> &cancellation, const HttpRequestBodySource &contentSource, std::optional<size_t> contentSourceLength, const std::function<void (const std::function<void (NetwConnectionHandler *)> &)> &connect);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> SendPipelined(const std::string &destination, const std::string &requestMethod, const HttpClientDeadlines &deadlines, const std::shared_ptr<HttpClientCancellation> &cancellation, const std::string &requestData, const std::function<void (const std::function<void (NetwConnectionHandler *)> &)> &connect);
+    void Dispatch(const std::string &destination, const std::string &requestMethod, const HttpClientDeadlines &deadlines, const std::shared_ptr<HttpClientCancellation> &cancellation, const std::string &requestData, const std::function<void (const std::function<void (NetwConnectionHandler *)> &)> &connect, const std::function<void (std::expected<std::shared_ptr<HttpResponse>,FdException>)> &callback, bool retry);
 public:
     NetwConnectionHandler *Create(const std::function<void (const std::string &)> &output, const std::function<void ()> &close) override;
     void Release(NetwConnectionHandler *) override;
     void SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &netwServer) override;
     std::shared_ptr<HttpRequest> Request(const std::string &method, const std::string &path);
     task<std::expected<std::shared_ptr<HttpResponse>,FdException>> Execute(const std::string &host, int port, const std::shared_ptr<HttpRequest> &request);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> ExecuteUnix(const std::string &path, const std::shared_ptr<HttpRequest> &request);
+    task<std::expected<std::shared_ptr<HttpResponse>,FdException>> ExecuteUpstream(const std::string &name, const std::shared_ptr<HttpRequest> &request);
+    void SetUpstream(const std::string &name, const std::vector<HttpUpstreamEndpoint> &endpoints, const HttpUpstreamHealthPolicy &healthPolicy);
+    /*
+     * With a depth above zero, idempotent requests to the same destination share keep
+     * alive connections with up to depth requests written ahead of their responses.
+     */
+    void SetPipelineDepth(size_t depth);
+    void SetTimeouts(const HttpRequestTimeouts &timeouts);
+    void SetRetryPolicy(const HttpClientRetryPolicy &policy);
+    std::optional<NetwTimer> AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func);
+    void CancelTimer(const NetwTimer &timer);
 };
 
 
@@ -0,0 +1,65 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "HttpClientRetry.h"
+
+static_assert(HttpClientBackoffCap({}, 1) == std::chrono::milliseconds(10));
+static_assert(HttpClientBackoffCap({}, 2) == std::chrono::milliseconds(20));
+static_assert(HttpClientBackoffCap({}, 4) == std::chrono::milliseconds(80));
+static_assert(HttpClientBackoffCap({}, 8) == std::chrono::milliseconds(1000));
+static_assert(HttpClientBackoffCap({}, 1000) == std::chrono::milliseconds(1000));
+
+/*
+ * A full budget pays for max retries, after that one per 1/ratio requests.
+ */
+constexpr bool TestHttpClientRetryBudget() {
+    HttpClientRetryBudget budget{};
+    budget.Configure(0.25, 2);
+    if (!budget.Withdraw() || !budget.Withdraw() || budget.Withdraw()) {
+        return false;
+    }
+    for (int i = 0; i < 3; i++) {
+        budget.Deposit();
+        if (budget.Withdraw()) {
+            return false;
+        }
+    }
+    budget.Deposit();
+    if (!budget.Withdraw() || budget.Withdraw()) {
+        return false;
+    }
+    for (int i = 0; i < 100; i++) {
+        budget.Deposit();
+    }
+    return budget.Withdraw() && budget.Withdraw() && !budget.Withdraw();
+}
+
+static_assert(TestHttpClientRetryBudget());
+
+constexpr std::optional<std::chrono::microseconds> TestHttpClientLatency(size_t samples, double percentile) {
+    HttpClientLatency latency{};
+    for (size_t i = 0; i < samples; i++) {
+        latency.Add(std::chrono::microseconds((i * 37) % samples));
+    }
+    return latency.Percentile(percentile);
+}
+
+static_assert(!TestHttpClientLatency(httpClientLatencyMinSamples - 1, 0.5));
+static_assert(TestHttpClientLatency(100, 0) == std::chrono::microseconds(0));
+static_assert(TestHttpClientLatency(100, 0.5) == std::chrono::microseconds(49));
+static_assert(TestHttpClientLatency(100, 0.99) == std::chrono::microseconds(98));
+static_assert(TestHttpClientLatency(100, 1) == std::chrono::microseconds(99));
+
+/*
+ * Only the latest samples count.
+ */
+constexpr bool TestHttpClientLatencyRing() {
+    HttpClientLatency latency{};
+    for (size_t i = 0; i < 1000; i++) {
+        latency.Add(std::chrono::microseconds(i < 500 ? 1000000 : i));
+    }
+    return latency.Percentile(1) == std::chrono::microseconds(999) && latency.Percentile(0) == std::chrono::microseconds(1000 - httpClientLatencySamples);
+}
+
+static_assert(TestHttpClientLatencyRing());
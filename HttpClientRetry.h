@@ -0,0 +1,93 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTPCLIENTRETRY_H
+#define LIBHTTPTOOLING_HTTPCLIENTRETRY_H
+
+#include <chrono>
+#include <array>
+#include <algorithm>
+#include <optional>
+#include <cstdint>
+
+/*
+ * Retries and hedging apply to idempotent requests without a body source. A request is
+ * tried up to maxAttempts times, waiting a random time up to initialBackoff doubled for
+ * each attempt and at most maxBackoff in between. With hedgePercentile above zero, a
+ * second copy is sent when the response has taken longer than that percentile of the
+ * recent latencies, and the slower copy is cancelled. Retries and hedges are paid from
+ * a budget that every request adds budgetRatio to, up to budgetMax.
+ */
+struct HttpClientRetryPolicy {
+    unsigned int maxAttempts{1};
+    std::chrono::milliseconds initialBackoff{10};
+    std::chrono::milliseconds maxBackoff{1000};
+    double budgetRatio{0.1};
+    double budgetMax{10};
+    double hedgePercentile{0};
+    std::chrono::milliseconds minHedgeDelay{1};
+};
+
+constexpr std::chrono::milliseconds HttpClientBackoffCap(const HttpClientRetryPolicy &policy, unsigned int attempt) {
+    auto cap = policy.initialBackoff;
+    for (unsigned int i = 1; i < attempt && cap < policy.maxBackoff; i++) {
+        cap *= 2;
+    }
+    return cap < policy.maxBackoff ? cap : policy.maxBackoff;
+}
+
+class HttpClientRetryBudget {
+private:
+    double tokens{0};
+    double ratio{0};
+    double max{0};
+public:
+    constexpr void Configure(double ratio, double max) {
+        this->ratio = ratio;
+        this->max = max;
+        tokens = max;
+    }
+    constexpr void Deposit() {
+        tokens = (tokens + ratio) < max ? (tokens + ratio) : max;
+    }
+    constexpr bool Withdraw() {
+        if (tokens < 1) {
+            return false;
+        }
+        tokens -= 1;
+        return true;
+    }
+};
+
+constexpr size_t httpClientLatencySamples = 256;
+constexpr size_t httpClientLatencyMinSamples = 20;
+
+/*
+ * The latest response latencies in a ring.
+ */
+class HttpClientLatency {
+private:
+    std::array<std::chrono::microseconds,httpClientLatencySamples> samples{};
+    size_t count{0};
+    size_t next{0};
+public:
+    constexpr void Add(std::chrono::microseconds latency) {
+        samples[next] = latency;
+        next = (next + 1) % samples.size();
+        if (count < samples.size()) {
+            ++count;
+        }
+    }
+    constexpr std::optional<std::chrono::microseconds> Percentile(double percentile) const {
+        if (count < httpClientLatencyMinSamples) {
+            return {};
+        }
+        auto sorted = samples;
+        auto rank = (size_t) (percentile * (count - 1));
+        std::nth_element(sorted.begin(), sorted.begin() + rank, sorted.begin() + count);
+        return sorted[rank];
+    }
+};
+
+#endif //LIBHTTPTOOLING_HTTPCLIENTRETRY_H
@@ -8,6 +8,7 @@
 #include <type_traits>
 #include <concepts>
 #include <string>
+#include <string_view>
 #include <algorithm>
 
 template <class T> concept HttpHeadClass = requires (T t){
@@ -60,4 +61,108 @@ public:
     } ContentLength;
 };
 
+/*
+ * Header names and tokens are ASCII, folding only A-Z keeps the comparison constexpr
+ * and independent of the locale.
+ */
+constexpr char HttpAsciiLower(char c) {
+    return (c >= 'A' && c <= 'Z') ? (char) (c + ('a' - 'A')) : c;
+}
+
+constexpr bool HttpEqualsIgnoreCase(std::string_view a, std::string_view b) {
+    return a.size() == b.size() && std::equal(a.cbegin(), a.cend(), b.cbegin(), [] (char chA, char chB) { return HttpAsciiLower(chA) == HttpAsciiLower(chB); });
+}
+
+/*
+ * The same as HttpHeaderValues::ContentLength, for header lines that are views.
+ */
+template <typename H> constexpr size_t HttpHeaderContentLength(const H &headerLines) {
+    for (const auto &header : headerLines) {
+        if (HttpEqualsIgnoreCase(header.GetHeader(), "content-length")) {
+            size_t val = 0;
+            for (auto ch : header.GetValue()) {
+                if (ch < '0' || ch > '9') {
+                    return 0;
+                }
+                val *= 10;
+                val += ch - '0';
+            }
+            return val;
+        }
+    }
+    return 0;
+}
+
+template <typename H> constexpr bool HttpHeaderHasContentLength(const H &headerLines) {
+    for (const auto &header : headerLines) {
+        if (HttpEqualsIgnoreCase(header.GetHeader(), "content-length")) {
+            return true;
+        }
+    }
+    return false;
+}
+
+enum class HttpTransferCoding {
+    NONE,
+    CHUNKED,
+    OTHER
+};
+
+/*
+ * The transfer coding of a message, chunked only when it is the last coding applied,
+ * any other coding leaves the length of the body to the end of the connection.
+ */
+template <typename H> constexpr HttpTransferCoding HttpHeaderTransferCoding(const H &headerLines) {
+    HttpTransferCoding coding{HttpTransferCoding::NONE};
+    for (const auto &header : headerLines) {
+        if (!HttpEqualsIgnoreCase(header.GetHeader(), "transfer-encoding")) {
+            continue;
+        }
+        const auto &headerValue = header.GetValue();
+        std::string_view value{headerValue};
+        auto comma = value.rfind(',');
+        if (comma != std::string_view::npos) {
+            value = value.substr(comma + 1);
+        }
+        while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+            value.remove_prefix(1);
+        }
+        while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+            value.remove_suffix(1);
+        }
+        if (!value.empty()) {
+            coding = HttpEqualsIgnoreCase(value, "chunked") ? HttpTransferCoding::CHUNKED : HttpTransferCoding::OTHER;
+        }
+    }
+    return coding;
+}
+
+/*
+ * True when a Connection header lists the close option.
+ */
+template <typename H> constexpr bool HttpHeaderConnectionClose(const H &headerLines) {
+    for (const auto &header : headerLines) {
+        if (!HttpEqualsIgnoreCase(header.GetHeader(), "connection")) {
+            continue;
+        }
+        const auto &headerValue = header.GetValue();
+        std::string_view value{headerValue};
+        while (!value.empty()) {
+            auto comma = value.find(',');
+            auto option = value.substr(0, comma);
+            while (!option.empty() && (option.front() == ' ' || option.front() == '\t')) {
+                option.remove_prefix(1);
+            }
+            while (!option.empty() && (option.back() == ' ' || option.back() == '\t')) {
+                option.remove_suffix(1);
+            }
+            if (HttpEqualsIgnoreCase(option, "close")) {
+                return true;
+            }
+            value = comma == std::string_view::npos ? std::string_view{} : value.substr(comma + 1);
+        }
+    }
+    return false;
+}
+
 #endif //LIBHTTPTOOLING_HTTPHEADERS_H
@@ -0,0 +1,26 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "HttpMetricsResponder.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "Metrics.h"
+
+std::shared_ptr<HttpResponse> HttpMetricsResponder::CreateResponse() const {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent(registry->PrometheusText(), "text/plain; version=0.0.4; charset=utf-8");
+    return response;
+}
+
+void HttpMetricsResponder::Respond(const std::shared_ptr<HttpRequest> &request) const {
+    request->Respond(CreateResponse());
+}
+
+HttpRouteHandler HttpMetricsResponder::GetRouteHandler() const {
+    std::shared_ptr<MetricsRegistry> registry{this->registry};
+    return [registry] (std::shared_ptr<HttpRequest> request, HttpRouteParams) -> task<void> {
+        HttpMetricsResponder{registry}.Respond(request);
+        co_return;
+    };
+}
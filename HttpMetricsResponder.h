@@ -0,0 +1,25 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTPMETRICSRESPONDER_H
+#define LIBHTTPTOOLING_HTTPMETRICSRESPONDER_H
+
+#include <memory>
+#include "HttpRouter.h"
+
+class HttpRequest;
+class HttpResponse;
+class MetricsRegistry;
+
+class HttpMetricsResponder {
+private:
+    std::shared_ptr<MetricsRegistry> registry;
+public:
+    HttpMetricsResponder(const std::shared_ptr<MetricsRegistry> &registry) : registry(registry) {}
+    std::shared_ptr<HttpResponse> CreateResponse() const;
+    void Respond(const std::shared_ptr<HttpRequest> &request) const;
+    HttpRouteHandler GetRouteHandler() const;
+};
+
+#endif //LIBHTTPTOOLING_HTTPMETRICSRESPONDER_H
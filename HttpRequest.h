@@ -8,6 +8,10 @@
 #include "HttpResponse.h"
 #include "include/task.h"
 #include <memory>
+#include <memory_resource>
+#include <functional>
+#include <optional>
+#include <chrono>
 
 class HttpClientImpl;
 
@@ -16,18 +20,68 @@ struct HttpRequestBody {
     bool success{true};
 };
 
+struct HttpRequestBodySegment {
+    std::string data{};
+    bool end{false};
+    bool success{true};
+};
+
+/*
+ * Produces the request body one segment at a time, the last segment has end set. The
+ * next segment is asked for when the previous one has been written to the socket.
+ */
+typedef std::function<task<HttpRequestBodySegment> ()> HttpRequestBodySource;
+
+/*
+ * Limits for a client request, counted from when it is executed. connect is for the
+ * connection to be established, firstByte for the response to start arriving and total
+ * for the whole response body. Zero is no limit.
+ */
+struct HttpRequestTimeouts {
+    std::chrono::milliseconds connect{0};
+    std::chrono::milliseconds firstByte{0};
+    std::chrono::milliseconds total{0};
+};
+
 class HttpRequest {
     friend HttpClientImpl;
 protected:
     virtual std::string GetContent() const = 0;
     virtual std::string GetContentType() const = 0;
+    virtual HttpRequestBodySource GetContentSource() const {
+        return {};
+    }
+    virtual std::optional<size_t> GetContentSourceLength() const {
+        return {};
+    }
+    virtual HttpRequestTimeouts GetTimeouts() const {
+        return {};
+    }
 public:
     virtual ~HttpRequest() = default;
-    virtual std::string GetMethod() const = 0;
-    virtual std::string GetPath() const = 0;
+    virtual const std::string &GetMethod() const = 0;
+    virtual const std::string &GetPath() const = 0;
+    virtual std::string GetHeader(const std::string &name) const = 0;
     virtual void Respond(const std::shared_ptr<HttpResponse> &) = 0;
     virtual task<HttpRequestBody> RequestBody() = 0;
     virtual void SetContent(const std::string &content, const std::string &contentType) = 0;
+    /*
+     * Streams the body of a client request from source, sent with Content-Length when
+     * the length is given and with the chunked transfer coding otherwise.
+     */
+    virtual void SetContentSource(const HttpRequestBodySource &source, const std::string &contentType, std::optional<size_t> contentLength = {}) = 0;
+    /*
+     * Overrides the timeouts of the client for this request, where not zero. A request
+     * that runs out of time fails with ETIMEDOUT, see FdException::GetErrno().
+     */
+    virtual void SetTimeouts(const HttpRequestTimeouts &timeouts) = 0;
+    /*
+     * Scratch memory for the handler that is released together with the request. It is
+     * not synchronized, so only one thread at a time may allocate from it.
+     */
+    virtual std::pmr::memory_resource *GetArena() {
+        return std::pmr::get_default_resource();
+    }
 };
 
 #endif //LIBHTTPTOOLING_HTTPREQUEST_H
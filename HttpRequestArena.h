@@ -0,0 +1,41 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTPREQUESTARENA_H
+#define LIBHTTPTOOLING_HTTPREQUESTARENA_H
+
+#include <memory_resource>
+#include <string_view>
+#include <cstddef>
+#include <cstring>
+
+constexpr size_t httpRequestArenaInline = 3072;
+
+/*
+ * Monotonic arena for the data of one request. The first httpRequestArenaInline bytes
+ * are part of the object, so a request that fits does not allocate anything for its
+ * data, and larger ones grow from the heap. Nothing is freed until the arena is
+ * destroyed, then everything goes in one step. Not synchronized.
+ */
+class HttpRequestArena {
+private:
+    alignas(std::max_align_t) std::byte inlineBuffer[httpRequestArenaInline];
+    std::pmr::monotonic_buffer_resource resource;
+public:
+    HttpRequestArena() : resource(inlineBuffer, sizeof(inlineBuffer), std::pmr::new_delete_resource()) {}
+    HttpRequestArena(const HttpRequestArena &) = delete;
+    HttpRequestArena(HttpRequestArena &&) = delete;
+    HttpRequestArena &operator =(const HttpRequestArena &) = delete;
+    HttpRequestArena &operator =(HttpRequestArena &&) = delete;
+    std::pmr::memory_resource *Resource() {
+        return &resource;
+    }
+    char *Copy(std::string_view str) {
+        auto *copy = static_cast<char *>(resource.allocate(str.size() > 0 ? str.size() : 1, 1));
+        memcpy(copy, str.data(), str.size());
+        return copy;
+    }
+};
+
+#endif //LIBHTTPTOOLING_HTTPREQUESTARENA_H
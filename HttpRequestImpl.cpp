@@ -4,9 +4,23 @@
 
 #include "HttpRequestImpl.h"
 #include "Http1Protocol.h"
+#include "Http1ResponseHead.h"
 #include "HttpServerResponseContainer.h"
 #include "HttpServerConnectionHandler.h"
 #include <vector>
+#include <cstring>
+
+HttpRequestImpl::HttpRequestImpl(const std::shared_ptr<HttpServerConnectionHandler> &serverConnectionHandler, std::shared_ptr<HttpServerResponseContainer> &serverResponseContainer, const Http1RequestHeadParser &head, std::string_view headInput, const std::vector<Http1HeaderView> &headerLines, bool hasRequestBody) : serverConnectionHandler(serverConnectionHandler), serverResponseContainer(serverResponseContainer), method(head.GetMethod()), path(head.GetPath()), requestBodyComplete(!hasRequestBody) {
+    std::transform(this->method.cbegin(), this->method.cend(), this->method.begin(), [] (char ch) {return std::toupper(ch);});
+    const char *copy = arena.Copy(headInput);
+    auto rebase = [headInput, copy] (std::string_view view) {
+        return std::string_view(copy + (view.data() - headInput.data()), view.size());
+    };
+    headers.reserve(headerLines.size());
+    for (const auto &header : headerLines) {
+        headers.emplace_back(Http1HeaderView{.header = rebase(header.header), .value = rebase(header.value)});
+    }
+}
 
 std::string HttpRequestImpl::GetContent() const {
     return requestBody;
@@ -16,33 +30,66 @@ std::string HttpRequestImpl::GetContentType() const {
     return contentType;
 }
 
-std::string HttpRequestImpl::GetMethod() const {
+HttpRequestBodySource HttpRequestImpl::GetContentSource() const {
+    return contentSource;
+}
+
+std::optional<size_t> HttpRequestImpl::GetContentSourceLength() const {
+    return contentSourceLength;
+}
+
+HttpRequestTimeouts HttpRequestImpl::GetTimeouts() const {
+    return timeouts;
+}
+
+const std::string &HttpRequestImpl::GetMethod() const {
     return method;
 }
 
-std::string HttpRequestImpl::GetPath() const {
+const std::string &HttpRequestImpl::GetPath() const {
     return path;
 }
 
+std::string HttpRequestImpl::GetHeader(const std::string &name) const {
+    for (const auto &header : headers) {
+        auto headerName = header.GetHeader();
+        if (headerName.size() == name.size() && std::equal(headerName.cbegin(), headerName.cend(), name.cbegin(), [] (char a, char b) { return std::tolower(a) == std::tolower(b); })) {
+            return std::string(header.GetValue());
+        }
+    }
+    return {};
+}
+
 void HttpRequestImpl::Respond(const std::shared_ptr<HttpResponse> &response) {
     auto serverConnectionHandler = this->serverConnectionHandler.lock();
     auto serverResponseContainer = this->serverResponseContainer.lock();
     if (serverResponseContainer) {
-        std::vector<Http1HeaderLine> hdrLns{};
-        hdrLns.emplace_back("Content-Type", response->GetContentType());
-        hdrLns.emplace_back("Content-Length", std::to_string(response->GetContentLength()));
-
-        Http1Response responseHead{{"HTTP/1.1", response->GetCode(), response->GetDescription()}, hdrLns};
-        serverResponseContainer->output.append(responseHead.operator std::string());
-        serverResponseContainer->output.append(response->GetContent());
-        serverResponseContainer->completed = true;
+        bool sendBody = method != "HEAD";
+        auto file = response->GetFileContent();
+        auto content = file.fd || !sendBody ? std::string() : response->GetContent();
+        auto contentType = response->GetContentType();
+        auto description = response->GetDescription();
+        auto headerTemplate = response->GetHeaderTemplate();
+        const auto &extraHeaders = response->GetHeaders();
+        std::string output{};
+        output.resize_and_overwrite(Http1ResponseHeadWriter::MaxSize(description, contentType, headerTemplate.get(), &extraHeaders) + content.size(), [&] (char *buf, size_t) {
+            auto headSize = Http1ResponseHeadWriter::Write(buf, response->GetCode(), description, contentType, response->GetContentLength(), headerTemplate.get(), &extraHeaders);
+            memcpy(buf + headSize, content.data(), content.size());
+            return headSize + content.size();
+        });
+        if (!sendBody) {
+            file = {};
+        }
         if (serverConnectionHandler) {
-            serverConnectionHandler->RunOutputs();
+            serverConnectionHandler->Complete(serverResponseContainer, response->GetCode(), std::move(output), file);
+        } else {
+            serverResponseContainer->output = std::move(output);
+            serverResponseContainer->completed = true;
         }
     }
 }
 
-void HttpRequestImpl::RecvBody(const std::string &chunk) {
+void HttpRequestImpl::RecvBody(std::string_view chunk) {
     std::lock_guard lock{mtx};
     requestBody.append(chunk);
 }
@@ -101,4 +148,21 @@ task<HttpRequestBody> HttpRequestImpl::RequestBody() {
 void HttpRequestImpl::SetContent(const std::string &content, const std::string &contentType) {
     requestBody = content;
     this->contentType = contentType;
+    contentSource = {};
+    contentSourceLength = {};
+}
+
+void HttpRequestImpl::SetContentSource(const HttpRequestBodySource &source, const std::string &contentType, std::optional<size_t> contentLength) {
+    requestBody = {};
+    this->contentType = contentType;
+    contentSource = source;
+    contentSourceLength = contentLength;
+}
+
+void HttpRequestImpl::SetTimeouts(const HttpRequestTimeouts &timeouts) {
+    this->timeouts = timeouts;
+}
+
+std::pmr::memory_resource *HttpRequestImpl::GetArena() {
+    return arena.Resource();
 }
@@ -6,8 +6,11 @@
 #define LIBHTTPTOOLING_HTTPREQUESTIMPL_H
 
 #include "HttpRequest.h"
+#include "Http1Protocol.h"
+#include "HttpRequestArena.h"
 #include <memory>
 #include <mutex>
+#include <vector>
 
 class HttpClientImpl;
 class HttpServerConnectionHandler;
@@ -18,33 +21,47 @@ class HttpRequestImpl : public HttpRequest, public std::enable_shared_from_this<
 private:
     std::weak_ptr<HttpServerConnectionHandler> serverConnectionHandler;
     std::weak_ptr<HttpServerResponseContainer> serverResponseContainer;
+    HttpRequestArena arena{};
     std::string method{};
     std::string path{};
+    std::pmr::vector<Http1HeaderView> headers{arena.Resource()};
     std::mutex mtx{};
     std::string requestBody{};
     std::string contentType{};
+    HttpRequestBodySource contentSource{};
+    std::optional<size_t> contentSourceLength{};
+    HttpRequestTimeouts timeouts{};
     std::vector<std::function<void ()>> callRequestBodyFinished{};
     bool requestBodyComplete;
     bool requestBodyFailed{false};
 public:
-    HttpRequestImpl(const std::shared_ptr<HttpServerConnectionHandler> &serverConnectionHandler, std::shared_ptr<HttpServerResponseContainer> &serverResponseContainer, const std::string &method, const std::string &path, bool hasRequestBody) : serverConnectionHandler(serverConnectionHandler), serverResponseContainer(serverResponseContainer), method(method), path(path), requestBodyComplete(!hasRequestBody) {
-        std::transform(this->method.cbegin(), this->method.cend(), this->method.begin(), [] (char ch) {return std::toupper(ch);});
-    }
+    /*
+     * The head is copied into the arena, and the header views of the parser are moved
+     * to point into the copy.
+     */
+    HttpRequestImpl(const std::shared_ptr<HttpServerConnectionHandler> &serverConnectionHandler, std::shared_ptr<HttpServerResponseContainer> &serverResponseContainer, const Http1RequestHeadParser &head, std::string_view headInput, const std::vector<Http1HeaderView> &headerLines, bool hasRequestBody);
     HttpRequestImpl(const std::string &method, const std::string &path) : serverConnectionHandler(), serverResponseContainer(), method(method), path(path), requestBodyComplete(true) {
         std::transform(this->method.cbegin(), this->method.cend(), this->method.begin(), [] (char ch) {return std::toupper(ch);});
     }
 protected:
     std::string GetContent() const override;
     std::string GetContentType() const override;
+    HttpRequestBodySource GetContentSource() const override;
+    std::optional<size_t> GetContentSourceLength() const override;
+    HttpRequestTimeouts GetTimeouts() const override;
 public:
-    std::string GetMethod() const override;
-    std::string GetPath() const override;
+    const std::string &GetMethod() const override;
+    const std::string &GetPath() const override;
+    std::string GetHeader(const std::string &name) const override;
     void Respond(const std::shared_ptr<HttpResponse> &) override;
     task<HttpRequestBody> RequestBody() override;
-    void RecvBody(const std::string &chunk);
+    void RecvBody(std::string_view chunk);
     void CompletedBody();
     void FailedBody();
     void SetContent(const std::string &content, const std::string &contentType) override;
+    void SetContentSource(const HttpRequestBodySource &source, const std::string &contentType, std::optional<size_t> contentLength) override;
+    void SetTimeouts(const HttpRequestTimeouts &timeouts) override;
+    std::pmr::memory_resource *GetArena() override;
 };
 
 #endif //LIBHTTPTOOLING_HTTPREQUESTIMPL_H
@@ -9,4 +9,9 @@ task<ResponseBodyResult> HttpResponse::ResponseBody() {
     std::string content{this->content};
     func_task<ResponseBodyResult> fnTask{[content] (const auto &fn) { fn({.body = content, .success = true}); }};
     co_return co_await fnTask;
-}
\ No newline at end of file
+}
+task<ResponseBodySegment> HttpResponse::NextBodySegment() {
+    std::string content{this->content};
+    func_task<ResponseBodySegment> fnTask{[content] (const auto &fn) { fn({.data = content, .success = true, .end = true}); }};
+    co_return co_await fnTask;
+}
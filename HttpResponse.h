@@ -6,27 +6,43 @@
 #define LIBHTTPTOOLING_HTTPRESPONSE_H
 
 #include <string>
+#include <memory>
 #include "include/task.h"
+#include "Http1ResponseHead.h"
+#include "Fd.h"
 
 struct ResponseBodyResult {
     std::string body{};
     bool success{true};
 };
 
+/*
+ * Part of a response body pulled with NextBodySegment. end is set with the last part,
+ * which can be empty, and success is false when the body was cut short.
+ */
+struct ResponseBodySegment {
+    std::string data{};
+    bool success{true};
+    bool end{false};
+};
+
 class HttpResponse {
 private:
     std::string content;
     std::string contentType;
     std::string description;
+    std::shared_ptr<const HttpHeaderTemplate> headerTemplate{};
+    HttpHeaderTemplate headers{};
+    FdFileRange file{};
     int code;
 public:
-    constexpr HttpResponse(int code, const std::string &description) : code(code), description(description) {}
-    constexpr HttpResponse(int code, std::string &&description) : code(code), description(std::move(description)) {}
+    constexpr HttpResponse(int code, const std::string &description) : description(description), code(code) {}
+    constexpr HttpResponse(int code, std::string &&description) : description(std::move(description)), code(code) {}
     constexpr std::string GetContent() const {
         return content;
     }
-    constexpr size_t GetContentLength() const {
-        return content.size();
+    size_t GetContentLength() const {
+        return file.fd ? file.length : content.size();
     }
     constexpr std::string GetContentType() const {
         return contentType;
@@ -45,7 +61,32 @@ public:
         this->content = std::move(content);
         this->contentType = std::move(contentType);
     }
+    const FdFileRange &GetFileContent() const {
+        return file;
+    }
+    void SetFileContent(const FdFileRange &file, const std::string &contentType) {
+        this->file = file;
+        this->contentType = contentType;
+    }
+    const HttpHeaderTemplate &GetHeaders() const {
+        return headers;
+    }
+    void AddHeader(std::string_view header, std::string_view value) {
+        headers.Add(header, value);
+    }
+    std::shared_ptr<const HttpHeaderTemplate> GetHeaderTemplate() const {
+        return headerTemplate;
+    }
+    void SetHeaderTemplate(const std::shared_ptr<const HttpHeaderTemplate> &headerTemplate) {
+        this->headerTemplate = headerTemplate;
+    }
     virtual task<ResponseBodyResult> ResponseBody();
+    /*
+     * Hands out the body in segments as it arrives, so that it does not have to be held
+     * in memory all at once. Reading from the connection pauses while too much of the
+     * body is waiting to be pulled. Use either this or ResponseBody for a response.
+     */
+    virtual task<ResponseBodySegment> NextBodySegment();
 };
 
 #endif //LIBHTTPTOOLING_HTTPRESPONSE_H
@@ -0,0 +1,169 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "HttpRouter.h"
+#include "HttpRequest.h"
+#include "include/sync_coroutine.h"
+#include <stdexcept>
+
+void HttpRouter::Add(const std::string &method, std::string_view pattern, const HttpRouteHandler &handler) {
+    HttpRouteNode *node = &root;
+    if (pattern.starts_with('/')) {
+        pattern.remove_prefix(1);
+    }
+    while (!pattern.empty()) {
+        auto end = pattern.find('/');
+        auto segment = pattern.substr(0, end);
+        if (segment.size() >= 2 && segment.starts_with('{') && segment.ends_with('}')) {
+            auto name = segment.substr(1, segment.size() - 2);
+            if (!node->paramChild) {
+                node->paramChild = std::make_unique<HttpRouteNode>();
+                node->paramChild->paramName = name;
+            } else if (node->paramChild->paramName != name) {
+                throw std::invalid_argument("Conflicting route parameter names");
+            }
+            node = node->paramChild.get();
+        } else {
+            auto iterator = node->children.find(segment);
+            if (iterator == node->children.end()) {
+                iterator = node->children.emplace(std::string(segment), std::make_unique<HttpRouteNode>()).first;
+            }
+            node = iterator->second.get();
+        }
+        if (end == std::string_view::npos) {
+            break;
+        }
+        pattern.remove_prefix(end + 1);
+        if (pattern.empty()) {
+            auto iterator = node->children.find(std::string_view());
+            if (iterator == node->children.end()) {
+                iterator = node->children.emplace(std::string(), std::make_unique<HttpRouteNode>()).first;
+            }
+            node = iterator->second.get();
+        }
+    }
+    for (auto &existing : node->handlers) {
+        if (existing.first == method) {
+            existing.second = handler;
+            return;
+        }
+    }
+    node->handlers.emplace_back(method, handler);
+    ++routes;
+}
+
+const HttpRouteNode *HttpRouter::Find(const HttpRouteNode &node, std::string_view path, HttpRouteParams &params) const {
+    auto end = path.find('/');
+    auto segment = path.substr(0, end);
+    std::string_view rest{};
+    bool last = end == std::string_view::npos;
+    if (!last) {
+        rest = path.substr(end + 1);
+    }
+    auto iterator = node.children.find(segment);
+    if (iterator != node.children.end()) {
+        const auto &child = *(iterator->second);
+        if (last) {
+            if (!child.handlers.empty()) {
+                return &child;
+            }
+        } else {
+            auto found = Find(child, rest, params);
+            if (found != nullptr) {
+                return found;
+            }
+        }
+    }
+    if (node.paramChild && !segment.empty()) {
+        const auto &child = *(node.paramChild);
+        auto paramCount = params.Size();
+        params.Add(child.paramName, segment);
+        if (last) {
+            if (!child.handlers.empty()) {
+                return &child;
+            }
+        } else {
+            auto found = Find(child, rest, params);
+            if (found != nullptr) {
+                return found;
+            }
+        }
+        params.Truncate(paramCount);
+    }
+    return nullptr;
+}
+
+HttpRouteMatch HttpRouter::Match(std::string_view method, std::string_view path, const HttpRouteHandler *&handler, HttpRouteParams &params) const {
+    auto queryStart = path.find_first_of("?#");
+    if (queryStart != std::string_view::npos) {
+        path = path.substr(0, queryStart);
+    }
+    if (path.starts_with('/')) {
+        path.remove_prefix(1);
+    }
+    const HttpRouteNode *node{nullptr};
+    if (path.empty()) {
+        node = root.handlers.empty() ? nullptr : &root;
+    } else {
+        node = Find(root, path, params);
+    }
+    if (node == nullptr) {
+        return HttpRouteMatch::NOT_FOUND;
+    }
+    const HttpRouteHandler *getHandler{nullptr};
+    for (const auto &candidate : node->handlers) {
+        if (candidate.first == method) {
+            handler = &(candidate.second);
+            return HttpRouteMatch::FOUND;
+        }
+        if (candidate.first == "GET") {
+            getHandler = &(candidate.second);
+        }
+    }
+    if (getHandler != nullptr && method == "HEAD") {
+        handler = getHandler;
+        return HttpRouteMatch::FOUND;
+    }
+    return HttpRouteMatch::METHOD_NOT_ALLOWED;
+}
+
+std::string HttpRouter::AllowedMethods(const HttpRouteNode &node) {
+    std::string allow{};
+    for (const auto &handler : node.handlers) {
+        if (!allow.empty()) {
+            allow.append(", ");
+        }
+        allow.append(handler.first);
+    }
+    return allow;
+}
+
+void HttpRouter::Dispatch(const std::shared_ptr<HttpRequest> &request) const {
+    const HttpRouteHandler *handler{nullptr};
+    HttpRouteParams params{};
+    const auto &path = request->GetPath();
+    auto match = Match(request->GetMethod(), path, handler, params);
+    if (match == HttpRouteMatch::FOUND) {
+        FireAndForget<task<void>>([handler, request, &params] () {
+            return (*handler)(request, std::move(params));
+        });
+        return;
+    }
+    if (match == HttpRouteMatch::METHOD_NOT_ALLOWED) {
+        HttpRouteParams ignored{};
+        std::string_view pathView{path};
+        pathView = pathView.substr(0, pathView.find_first_of("?#"));
+        if (pathView.starts_with('/')) {
+            pathView.remove_prefix(1);
+        }
+        const HttpRouteNode *node = pathView.empty() ? &root : Find(root, pathView, ignored);
+        auto response = std::make_shared<HttpResponse>(405, "Method Not Allowed");
+        if (node != nullptr) {
+            response->AddHeader("Allow", AllowedMethods(*node));
+        }
+        request->Respond(response);
+        return;
+    }
+    request->Respond(std::make_shared<HttpResponse>(404, "Not Found"));
+}
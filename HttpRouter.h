@@ -0,0 +1,86 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTPROUTER_H
+#define LIBHTTPTOOLING_HTTPROUTER_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include "include/task.h"
+
+class HttpRequest;
+
+class HttpRouteParams {
+private:
+    std::vector<std::pair<std::string_view,std::string>> params{};
+public:
+    void Add(std::string_view name, std::string_view value) {
+        params.emplace_back(name, value);
+    }
+    void Truncate(size_t size) {
+        if (size < params.size()) {
+            params.resize(size);
+        }
+    }
+    size_t Size() const {
+        return params.size();
+    }
+    std::string Get(std::string_view name) const {
+        for (const auto &param : params) {
+            if (param.first == name) {
+                return param.second;
+            }
+        }
+        return {};
+    }
+};
+
+typedef std::function<task<void> (std::shared_ptr<HttpRequest> request, HttpRouteParams params)> HttpRouteHandler;
+
+struct HttpRouteStringHash {
+    using is_transparent = void;
+    size_t operator () (std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
+struct HttpRouteNode {
+    std::unordered_map<std::string,std::unique_ptr<HttpRouteNode>,HttpRouteStringHash,std::equal_to<>> children{};
+    std::unique_ptr<HttpRouteNode> paramChild{};
+    std::string paramName{};
+    std::vector<std::pair<std::string,HttpRouteHandler>> handlers{};
+};
+
+enum class HttpRouteMatch {
+    FOUND,
+    NOT_FOUND,
+    METHOD_NOT_ALLOWED
+};
+
+/*
+ * Routes are compiled into a trie with one level per path segment. Static segments are
+ * looked up by hash, "{name}" segments match any single segment. Static segments take
+ * precedence over captures. Routes must be added before requests are dispatched.
+ */
+class HttpRouter {
+private:
+    HttpRouteNode root{};
+    size_t routes{0};
+public:
+    void Add(const std::string &method, std::string_view pattern, const HttpRouteHandler &handler);
+    size_t GetRouteCount() const {
+        return routes;
+    }
+    HttpRouteMatch Match(std::string_view method, std::string_view path, const HttpRouteHandler *&handler, HttpRouteParams &params) const;
+    void Dispatch(const std::shared_ptr<HttpRequest> &request) const;
+private:
+    const HttpRouteNode *Find(const HttpRouteNode &node, std::string_view path, HttpRouteParams &params) const;
+    static std::string AllowedMethods(const HttpRouteNode &node);
+};
+
+#endif //LIBHTTPTOOLING_HTTPROUTER_H
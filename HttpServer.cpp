@@ -4,19 +4,37 @@
 
 #include "HttpServer.h"
 #include "HttpServerImpl.h"
+#include "HttpRouter.h"
 extern "C" {
 #include <unistd.h>
 }
 #include <thread>
+#include <iostream>
 
-HttpServer::HttpServer(int port) :
-    serverImpl(std::make_shared<HttpServerImpl>()),
-    netwServer(NetwServer::Create(port, serverImpl)),
+HttpServer::HttpServer(const std::shared_ptr<HttpServerImpl> &serverImpl, const std::shared_ptr<NetwServer> &netwServer) :
+    serverImpl(serverImpl),
+    netwServer(netwServer),
+    metrics(std::make_shared<MetricsRegistry>()),
     commandFd(netwServer->GetCommandFd()) {
+    netwServer->GetMetrics()->Register(*metrics);
+    serverImpl->GetMetrics()->Register(*metrics);
 }
 
-std::shared_ptr<HttpServer> HttpServer::Create(int port) {
-    std::shared_ptr<HttpServer> server{new HttpServer(port)};
+std::shared_ptr<HttpServer> HttpServer::Create(int port, const NetwSocketOptions &socketOptions) {
+    auto serverImpl = std::make_shared<HttpServerImpl>();
+    std::shared_ptr<HttpServer> server{new HttpServer(serverImpl, NetwServer::Create(port, serverImpl, socketOptions))};
+    return server;
+}
+
+std::shared_ptr<HttpServer> HttpServer::CreateUnix(const std::string &path, const NetwSocketOptions &socketOptions) {
+    auto serverImpl = std::make_shared<HttpServerImpl>();
+    std::shared_ptr<HttpServer> server{new HttpServer(serverImpl, NetwServer::CreateUnix(path, serverImpl, socketOptions))};
+    return server;
+}
+
+std::shared_ptr<HttpServer> HttpServer::CreateHandOff(const std::string &handOffPath, const NetwSocketOptions &socketOptions) {
+    auto serverImpl = std::make_shared<HttpServerImpl>();
+    std::shared_ptr<HttpServer> server{new HttpServer(serverImpl, NetwServer::CreateHandOff(handOffPath, serverImpl, socketOptions))};
     return server;
 }
 
@@ -24,8 +42,44 @@ task<std::shared_ptr<HttpRequest>> HttpServer::NextRequest() {
     return serverImpl->NextRequest();
 }
 
+void HttpServer::SetMaxPipelineDepth(size_t depth) {
+    serverImpl->SetMaxPipelineDepth(depth);
+}
+
+void HttpServer::SetRunnerThreads(size_t threads) {
+    netwServer->SetRunnerThreads(threads);
+}
+
+void HttpServer::SetReadBudget(size_t budget) {
+    netwServer->SetReadBudget(budget);
+}
+
+void HttpServer::SetRequestHandler(const std::function<void(const std::shared_ptr<HttpRequest> &)> &handler) {
+    serverImpl->SetRequestHandler(handler);
+}
+
+void HttpServer::SetRouter(const std::shared_ptr<const HttpRouter> &router) {
+    serverImpl->SetRequestHandler([router] (const std::shared_ptr<HttpRequest> &request) {
+        router->Dispatch(request);
+    });
+}
+
+std::shared_ptr<MetricsRegistry> HttpServer::GetMetrics() const {
+    return metrics;
+}
+
 void HttpServer::Stop() {
-    int res = write(commandFd, "q", 1);
+    if (write(commandFd, "q", 1) != 1) {
+        std::cerr << "Internal command interface failure: stop not sent\n";
+    }
+}
+
+void HttpServer::Drain(std::chrono::milliseconds timeout) {
+    netwServer->Drain(timeout);
+}
+
+void HttpServer::EnableHandOff(const std::string &path, std::chrono::milliseconds drainTimeout) {
+    netwServer->EnableHandOff(path, drainTimeout);
 }
 
 void HttpServer::Run() {
@@ -7,27 +7,42 @@
 
 #include "HttpRequest.h"
 #include "include/task.h"
+#include "NetwSocketOptions.h"
 #include <memory>
+#include <chrono>
 
 class HttpServerImpl;
+class HttpRouter;
 class NetwServer;
+class MetricsRegistry;
 
 class HttpServer {
 private:
     std::shared_ptr<HttpServerImpl> serverImpl;
     std::shared_ptr<NetwServer> netwServer;
+    std::shared_ptr<MetricsRegistry> metrics;
     int commandFd;
 private:
-    HttpServer(int port);
+    HttpServer(const std::shared_ptr<HttpServerImpl> &serverImpl, const std::shared_ptr<NetwServer> &netwServer);
 public:
     HttpServer() = delete;
     HttpServer(const HttpServer &) = delete;
     HttpServer(HttpServer &&) = delete;
     HttpServer &operator = (const HttpServer &) = delete;
     HttpServer &operator = (HttpServer &&) = delete;
-    static std::shared_ptr<HttpServer> Create(int port);
+    static std::shared_ptr<HttpServer> Create(int port, const NetwSocketOptions &socketOptions = {});
+    static std::shared_ptr<HttpServer> CreateUnix(const std::string &path, const NetwSocketOptions &socketOptions = {});
+    static std::shared_ptr<HttpServer> CreateHandOff(const std::string &handOffPath, const NetwSocketOptions &socketOptions = {});
     task<std::shared_ptr<HttpRequest>> NextRequest();
+    void SetMaxPipelineDepth(size_t depth);
+    void SetRunnerThreads(size_t threads);
+    void SetReadBudget(size_t budget);
+    void SetRequestHandler(const std::function<void (const std::shared_ptr<HttpRequest> &)> &handler);
+    void SetRouter(const std::shared_ptr<const HttpRouter> &router);
+    std::shared_ptr<MetricsRegistry> GetMetrics() const;
     void Stop();
+    void Drain(std::chrono::milliseconds timeout);
+    void EnableHandOff(const std::string &path, std::chrono::milliseconds drainTimeout);
     void Run();
 };
 
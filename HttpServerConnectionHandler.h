@@ -9,6 +9,7 @@
 #include "Http1Protocol.h"
 
 class HttpServerImpl;
+struct HttpServerMetrics;
 class HttpServerResponseContainer;
 class HttpRequestImpl;
 
@@ -16,17 +17,33 @@ class HttpServerConnectionHandler : public NetwConnectionHandler, public std::en
 private:
     std::weak_ptr<HttpServerImpl> httpServer;
     std::function<void(const std::string &)> output;
+    std::function<void(const FdFileRange &)> outputFile;
     std::function<void()> close;
-    Http1Request requestHead{};
+    std::shared_ptr<HttpServerMetrics> metrics;
     std::vector<std::shared_ptr<HttpServerResponseContainer>> inflightRequests{};
+    std::vector<std::shared_ptr<HttpServerResponseContainer>> outputResponses{};
+    std::vector<Http1HeaderView> headerLines{};
     std::shared_ptr<HttpRequestImpl> requestBodyPending{};
     size_t requestBodyRemaining{0};
+    size_t maxPipelineDepth;
+    uint32_t latencySampleCount{0};
     std::mutex mtx;
+    std::mutex outputMtx;
     bool closeConnection{};
 public:
-    HttpServerConnectionHandler(const std::shared_ptr<HttpServerImpl> &httpServer, const std::function<void(const std::string &)> &output, const std::function<void()> &close) : httpServer(httpServer), output(output), close(close) {}
+    HttpServerConnectionHandler(const std::shared_ptr<HttpServerImpl> &httpServer, const std::function<void(const std::string &)> &output, const std::function<void(const FdFileRange &)> &outputFile, const std::function<void()> &close);
+private:
+    size_t AcceptRequest(std::string_view input);
+    void RespondAndClose(Http1Response &&response);
+    void OutputFile(const FdFileRange &file);
+public:
     size_t AcceptInput(const std::string &) override;
     void EndOfConnection() override;
+    bool IsInputPaused() override;
+    bool IsIdle() override;
+    size_t MemoryUsage() override;
+    void ReleaseIdleMemory() override;
+    void Complete(const std::shared_ptr<HttpServerResponseContainer> &container, int code, std::string &&responseOutput, const FdFileRange &responseFile = {});
     void RunOutputs();
 };
 
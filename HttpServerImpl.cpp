@@ -8,8 +8,55 @@
 #include "HttpServerResponseContainer.h"
 #include "HttpServerConnectionHandler.h"
 #include "HttpRequestImpl.h"
+#include "include/object_pool.h"
 
-size_t HttpServerConnectionHandler::AcceptInput(const std::string &input) {
+HttpServerMetrics::HttpServerMetrics() {
+    for (auto &counter : responsesByClass) {
+        counter = std::make_shared<MetricsCounter>();
+    }
+}
+
+void HttpServerMetrics::Register(MetricsRegistry &registry) const {
+    const char *classLabels[] = {"code=\"1xx\"", "code=\"2xx\"", "code=\"3xx\"", "code=\"4xx\"", "code=\"5xx\""};
+    for (size_t i = 0; i < responsesByClass.size(); i++) {
+        registry.Add("http_responses_total", "Responses by status class", classLabels[i], responsesByClass[i]);
+    }
+    registry.Add("http_parse_errors_total", "Requests rejected as malformed", "", parseErrors);
+    registry.Add("http_request_queue_depth", "Requests waiting for NextRequest", "", requestQueueDepth);
+    registry.Add("http_requests_in_progress", "Requests parsed and not yet written", "", requestsInProgress);
+    /* About a microsecond to 17 seconds, in steps of four */
+    std::vector<uint64_t> latencyBounds{};
+    for (unsigned int exponent = 10; exponent <= 34; exponent += 2) {
+        latencyBounds.emplace_back(((uint64_t) 1) << exponent);
+    }
+    registry.Add("http_handler_latency_seconds", "Time from request parsed to response submitted", "", handlerLatency, 1e-9, latencyBounds);
+}
+
+void HttpServerMetrics::RecordResponse(int code, std::chrono::steady_clock::time_point received) {
+    auto statusClass = (code / 100) - 1;
+    if (statusClass >= 0 && statusClass < (int) responsesByClass.size()) {
+        responsesByClass[statusClass]->Add();
+    }
+    if (received != std::chrono::steady_clock::time_point()) {
+        handlerLatency->Record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - received).count());
+    }
+}
+
+HttpServerConnectionHandler::HttpServerConnectionHandler(const std::shared_ptr<HttpServerImpl> &httpServer, const std::function<void(const std::string &)> &output, const std::function<void(const FdFileRange &)> &outputFile, const std::function<void()> &close) : httpServer(httpServer), output(output), outputFile(outputFile), close(close), metrics(httpServer->metrics), maxPipelineDepth(httpServer->maxPipelineDepth) {
+}
+
+void HttpServerConnectionHandler::RespondAndClose(Http1Response &&response) {
+    std::weak_ptr<HttpServerConnectionHandler> weakPtr{shared_from_this()};
+    HttpServerResponseContainer resp{.handler = std::move(weakPtr), .output = response.operator std::string(), .completed = true};
+    {
+        std::lock_guard lock{mtx};
+        inflightRequests.emplace_back(object_pool_make_shared<HttpServerResponseContainer>(std::move(resp)));
+        closeConnection = true;
+    }
+    RunOutputs();
+}
+
+size_t HttpServerConnectionHandler::AcceptRequest(std::string_view input) {
     if (requestBodyRemaining > 0) {
         if (input.size() <= requestBodyRemaining) {
             requestBodyPending->RecvBody(input);
@@ -29,37 +76,40 @@ size_t HttpServerConnectionHandler::AcceptInput(const std::string &input) {
             return len;
         }
     }
-    if (closeConnection) {
-        return input.size();
+    {
+        std::lock_guard lock{mtx};
+        if (closeConnection) {
+            return input.size();
+        }
+        if (inflightRequests.size() >= maxPipelineDepth) {
+            return 0;
+        }
     }
-    Http1RequestParser parser{input};
+    Http1RequestHeadParser parser{input, headerLines};
     if (parser.IsValid()) {
-        requestHead = parser.operator Http1Request();
-        HttpHeaderValues hdrValues{requestHead};
-        size_t contentLength = hdrValues.ContentLength;
+        size_t contentLength = HttpHeaderContentLength(headerLines);
         bool hasRequestBody = contentLength > 0;
         if (hasRequestBody) {
-            auto method = requestHead.GetRequest().GetMethod();
-            std::transform(method.cbegin(), method.cend(), method.begin(), [] (char ch) { return std::tolower(ch); });
-            if (method == "get" || method == "head") {
-                Http1Response response{{"HTTP/1.1", 400, "Bad request"}, {{"Content-Length", "0"}, {"Connection", "close"}}};
-                std::weak_ptr<HttpServerConnectionHandler> weakPtr{shared_from_this()};
-                HttpServerResponseContainer resp{.handler = std::move(weakPtr), .output = response.operator std::string(), .completed = true};
-                {
-                    std::lock_guard lock{mtx};
-                    inflightRequests.emplace_back(std::make_shared<HttpServerResponseContainer>(std::move(resp)));
-                    closeConnection = true;
-                }
-                RunOutputs();
+            auto method = parser.GetMethod();
+            if (HttpEqualsIgnoreCase(method, "get") || HttpEqualsIgnoreCase(method, "head")) {
+                metrics->parseErrors->Add();
+                RespondAndClose({{"HTTP/1.1", 400, "Bad request"}, {{"Content-Length", "0"}, {"Connection", "close"}}});
                 return parser.GetParsedInputCharacters();
             }
         }
         auto httpServer = this->httpServer.lock();
         if (httpServer) {
-            auto container = std::make_shared<HttpServerResponseContainer>();
+            auto container = object_pool_make_shared<HttpServerResponseContainer>();
             container->handler = shared_from_this();
-            std::function<void (const std::shared_ptr<HttpRequest> &)> postRequest{[] (auto req) {}};
-            auto req = std::make_shared<HttpRequestImpl>(shared_from_this(), container, requestHead.GetRequest().GetMethod(), requestHead.GetRequest().GetPath(), hasRequestBody);
+            if (++latencySampleCount >= metrics->latencySampleInterval) {
+                latencySampleCount = 0;
+                container->received = std::chrono::steady_clock::now();
+            }
+            container->inflightGauge = metrics->requestsInProgress;
+            metrics->requestsInProgress->Add(1);
+            std::shared_ptr<const std::function<void (const std::shared_ptr<HttpRequest> &)>> handler{};
+            std::function<void (const std::shared_ptr<HttpRequest> &)> postRequest{};
+            auto req = object_pool_make_shared<HttpRequestImpl>(shared_from_this(), container, parser, input.substr(0, parser.GetParsedInputCharacters()), headerLines, hasRequestBody);
             if (hasRequestBody) {
                 requestBodyPending = req;
                 requestBodyRemaining = contentLength;
@@ -70,61 +120,128 @@ size_t HttpServerConnectionHandler::AcceptInput(const std::string &input) {
                     inflightRequests.emplace_back(container);
                 }
                 std::lock_guard lock{httpServer->mtx};
-                if (!httpServer->requestHandlerQueue.empty()) {
+                if (httpServer->requestHandler) {
+                    handler = httpServer->requestHandler;
+                } else if (!httpServer->requestHandlerQueue.empty()) {
                     auto iterator = httpServer->requestHandlerQueue.begin();
-                    postRequest = *iterator;
+                    postRequest = std::move(*iterator);
                     iterator = httpServer->requestHandlerQueue.erase(iterator);
                 } else {
                     httpServer->requestQueue.emplace_back(req);
+                    metrics->requestQueueDepth->Add(1);
                 }
             }
-            postRequest(req);
-        } else {
-            Http1Response response{{"HTTP/1.1", 503, "Service unavailable"},
-                                   {{"Content-Length", "0"}, {"Connection", "close"}}};
-            std::weak_ptr<HttpServerConnectionHandler> weakPtr{shared_from_this()};
-            HttpServerResponseContainer resp{.handler = std::move(
-                    weakPtr), .output = response.operator std::string(), .completed = true};
-            {
-                std::lock_guard lock{mtx};
-                inflightRequests.emplace_back(std::make_shared<HttpServerResponseContainer>(std::move(resp)));
-                closeConnection = true;
+            if (handler) {
+                (*handler)(req);
+            } else if (postRequest) {
+                postRequest(req);
             }
-            RunOutputs();
+        } else {
+            RespondAndClose({{"HTTP/1.1", 503, "Service unavailable"}, {{"Content-Length", "0"}, {"Connection", "close"}}});
         }
         return parser.GetParsedInputCharacters();
     } else if (!parser.IsTruncatedValid()) {
-        Http1Response response{{"HTTP/1.1", 400, "Bad request"}, {{"Content-Length", "0"}, {"Connection", "close"}}};
-        std::weak_ptr<HttpServerConnectionHandler> weakPtr{shared_from_this()};
-        HttpServerResponseContainer resp{.handler = std::move(weakPtr), .output = response.operator std::string(), .completed = true};
-        {
-            std::lock_guard lock{mtx};
-            inflightRequests.emplace_back(std::make_shared<HttpServerResponseContainer>(std::move(resp)));
-            closeConnection = true;
-        }
-        RunOutputs();
+        metrics->parseErrors->Add();
+        RespondAndClose({{"HTTP/1.1", 400, "Bad request"}, {{"Content-Length", "0"}, {"Connection", "close"}}});
         return input.size();
     }
     return 0;
 }
 
+size_t HttpServerConnectionHandler::AcceptInput(const std::string &input) {
+    std::string_view remaining{input};
+    size_t consumed{0};
+    while (!remaining.empty()) {
+        auto accepted = AcceptRequest(remaining);
+        if (accepted == 0) {
+            break;
+        }
+        consumed += accepted;
+        remaining.remove_prefix(accepted);
+    }
+    return consumed;
+}
+
 void HttpServerConnectionHandler::EndOfConnection() {
     if (requestBodyRemaining > 0) {
         requestBodyPending->FailedBody();
         requestBodyPending = {};
+        requestBodyRemaining = 0;
     }
-    if (closeConnection) {
-        return;
+    std::lock_guard lock{mtx};
+    closeConnection = true;
+}
+
+bool HttpServerConnectionHandler::IsInputPaused() {
+    if (requestBodyRemaining > 0) {
+        return false;
     }
+    std::lock_guard lock{mtx};
+    return !closeConnection && inflightRequests.size() >= maxPipelineDepth;
+}
+
+/*
+ * Holding the output lock, a response is either still in flight or already handed to
+ * the output. A connection that has not sent a request yet is idle too, like those a
+ * proxy opens ahead of time.
+ */
+bool HttpServerConnectionHandler::IsIdle() {
+    std::lock_guard outputLock{outputMtx};
+    std::lock_guard lock{mtx};
+    return requestBodyRemaining == 0 && inflightRequests.empty();
+}
+
+size_t HttpServerConnectionHandler::MemoryUsage() {
+    std::lock_guard outputLock{outputMtx};
+    std::lock_guard lock{mtx};
+    return sizeof(*this) + ((inflightRequests.capacity() + outputResponses.capacity()) * sizeof(inflightRequests[0])) + (headerLines.capacity() * sizeof(headerLines[0]));
+}
+
+void HttpServerConnectionHandler::ReleaseIdleMemory() {
+    std::lock_guard outputLock{outputMtx};
+    std::lock_guard lock{mtx};
+    if (inflightRequests.empty()) {
+        inflightRequests.shrink_to_fit();
+        outputResponses.shrink_to_fit();
+        headerLines.clear();
+        headerLines.shrink_to_fit();
+    }
+}
+
+void HttpServerConnectionHandler::Complete(const std::shared_ptr<HttpServerResponseContainer> &container, int code, std::string &&responseOutput, const FdFileRange &responseFile) {
+    metrics->RecordResponse(code, container->received);
     {
         std::lock_guard lock{mtx};
-        closeConnection = true;
+        container->output = std::move(responseOutput);
+        container->file = responseFile;
+        container->completed = true;
+    }
+    RunOutputs();
+}
+
+void HttpServerConnectionHandler::OutputFile(const FdFileRange &file) {
+    if (outputFile) {
+        outputFile(file);
+        return;
+    }
+    std::string buffer{};
+    auto offset = file.offset;
+    auto remaining = file.length;
+    while (remaining > 0) {
+        buffer.resize(remaining < 65536 ? remaining : 65536);
+        auto rdCount = file.fd->ReadAt(buffer.data(), buffer.size(), offset);
+        buffer.resize(rdCount);
+        output(buffer);
+        offset += rdCount;
+        remaining -= rdCount;
     }
 }
 
 void HttpServerConnectionHandler::RunOutputs() {
-    std::vector<std::shared_ptr<HttpServerResponseContainer>> responses{};
+    std::lock_guard outputLock{outputMtx};
+    auto &responses = outputResponses;
     bool done;
+    bool closing;
     {
         std::lock_guard lock{mtx};
         auto iterator = inflightRequests.begin();
@@ -132,19 +249,25 @@ void HttpServerConnectionHandler::RunOutputs() {
             const auto &resp = *iterator;
             if (resp->completed) {
                 responses.emplace_back(resp);
-                iterator = inflightRequests.erase(iterator);
+                ++iterator;
                 continue;
             }
             break;
         }
+        inflightRequests.erase(inflightRequests.begin(), iterator);
         done = inflightRequests.empty();
+        closing = closeConnection;
     }
     for (const auto &resp : responses) {
         if (!resp->output.empty()) {
             output(resp->output);
         }
+        if (resp->file.fd) {
+            OutputFile(resp->file);
+        }
     }
-    if (closeConnection && done) {
+    responses.clear();
+    if (closing && done) {
         close();
     }
 }
@@ -153,9 +276,19 @@ class HttpServerConnectionHandlerProxy : public NetwConnectionHandler {
 private:
     std::shared_ptr<HttpServerConnectionHandler> handler;
 public:
-    HttpServerConnectionHandlerProxy(const std::shared_ptr<HttpServerImpl> &httpServer, const std::function<void(const std::string &)> &output, const std::function<void()> &close) : handler(std::make_shared<HttpServerConnectionHandler>(httpServer, output, close)) {}
+    HttpServerConnectionHandlerProxy(const std::shared_ptr<HttpServerImpl> &httpServer, const std::function<void(const std::string &)> &output, const std::function<void(const FdFileRange &)> &outputFile, const std::function<void()> &close) : handler(object_pool_make_shared<HttpServerConnectionHandler>(httpServer, output, outputFile, close)) {}
+    static void *operator new(std::size_t size) {
+        return object_pool_allocate(size);
+    }
+    static void operator delete(void *ptr, std::size_t size) {
+        object_pool_deallocate(ptr, size);
+    }
     size_t AcceptInput(const std::string &) override;
     void EndOfConnection() override;
+    bool IsInputPaused() override;
+    bool IsIdle() override;
+    size_t MemoryUsage() override;
+    void ReleaseIdleMemory() override;
 };
 
 size_t HttpServerConnectionHandlerProxy::AcceptInput(const std::string &input) {
@@ -166,10 +299,31 @@ void HttpServerConnectionHandlerProxy::EndOfConnection() {
     handler->EndOfConnection();
 }
 
+bool HttpServerConnectionHandlerProxy::IsInputPaused() {
+    return handler->IsInputPaused();
+}
+
+bool HttpServerConnectionHandlerProxy::IsIdle() {
+    return handler->IsIdle();
+}
+
+size_t HttpServerConnectionHandlerProxy::MemoryUsage() {
+    return sizeof(*this) + handler->MemoryUsage();
+}
+
+void HttpServerConnectionHandlerProxy::ReleaseIdleMemory() {
+    handler->ReleaseIdleMemory();
+}
+
 NetwConnectionHandler *
 HttpServerImpl::Create(const std::function<void(const std::string &)> &output, const std::function<void()> &close) {
+    return Create(output, {}, close);
+}
+
+NetwConnectionHandler *
+HttpServerImpl::Create(const std::function<void(const std::string &)> &output, const std::function<void(const FdFileRange &)> &outputFile, const std::function<void()> &close) {
     std::shared_ptr<HttpServerImpl> shptr = shared_from_this();
-    return new HttpServerConnectionHandlerProxy(shptr, output, close);
+    return new HttpServerConnectionHandlerProxy(shptr, output, outputFile, close);
 }
 
 void HttpServerImpl::Release(NetwConnectionHandler *handler) {
@@ -179,6 +333,26 @@ void HttpServerImpl::Release(NetwConnectionHandler *handler) {
 void HttpServerImpl::SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &) {
 }
 
+void HttpServerImpl::SetMaxPipelineDepth(size_t depth) {
+    maxPipelineDepth = depth > 0 ? depth : 1;
+}
+
+void HttpServerImpl::SetRequestHandler(const std::function<void (const std::shared_ptr<HttpRequest> &)> &handler) {
+    std::vector<std::shared_ptr<HttpRequest>> queued{};
+    {
+        std::lock_guard lock{mtx};
+        requestHandler = handler ? std::make_shared<const std::function<void (const std::shared_ptr<HttpRequest> &)>>(handler) : nullptr;
+        if (handler) {
+            queued = std::move(requestQueue);
+            requestQueue = {};
+            metrics->requestQueueDepth->Add(-((int64_t) queued.size()));
+        }
+    }
+    for (const auto &req : queued) {
+        handler(req);
+    }
+}
+
 task<std::shared_ptr<HttpRequest>> HttpServerImpl::NextRequest() {
     auto shptr = shared_from_this();
     func_task<std::shared_ptr<HttpRequest>> ftask{[shptr] (const auto &callback) {
@@ -195,6 +369,7 @@ task<std::shared_ptr<HttpRequest>> HttpServerImpl::NextRequest() {
             auto iterator = shptr->requestQueue.begin();
             req = *iterator;
             iterator = shptr->requestQueue.erase(iterator);
+            shptr->metrics->requestQueueDepth->Add(-1);
         }
         callback(req);
     }};
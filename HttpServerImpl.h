@@ -9,20 +9,48 @@
 #include "NetwServer.h"
 #include "HttpResponse.h"
 #include "HttpRequest.h"
+#include "Metrics.h"
+#include <array>
+#include <chrono>
 
 class HttpServerConnectionHandler;
 
+/*
+ * Handler latency is sampled for every latencySampleInterval-th request on a connection,
+ * the counters and gauges count every request.
+ */
+struct HttpServerMetrics {
+    std::array<std::shared_ptr<MetricsCounter>,5> responsesByClass{};
+    std::shared_ptr<MetricsCounter> parseErrors{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsGauge> requestQueueDepth{std::make_shared<MetricsGauge>()};
+    std::shared_ptr<MetricsGauge> requestsInProgress{std::make_shared<MetricsGauge>()};
+    std::shared_ptr<MetricsHistogram> handlerLatency{std::make_shared<MetricsHistogram>()};
+    uint32_t latencySampleInterval{8};
+    HttpServerMetrics();
+    void Register(MetricsRegistry &registry) const;
+    void RecordResponse(int code, std::chrono::steady_clock::time_point received);
+};
+
 class HttpServerImpl : public NetwProtocolHandler, public std::enable_shared_from_this<HttpServerImpl> {
     friend HttpServerConnectionHandler;
 private:
     std::vector<std::shared_ptr<HttpRequest>> requestQueue{};
     std::vector<std::function<void (const std::shared_ptr<HttpRequest> &)>> requestHandlerQueue{};
+    std::shared_ptr<const std::function<void (const std::shared_ptr<HttpRequest> &)>> requestHandler{};
     std::mutex mtx;
+    std::shared_ptr<HttpServerMetrics> metrics{std::make_shared<HttpServerMetrics>()};
+    size_t maxPipelineDepth{16};
 public:
     NetwConnectionHandler *Create(const std::function<void (const std::string &)> &output, const std::function<void ()> &close) override;
+    NetwConnectionHandler *Create(const std::function<void (const std::string &)> &output, const std::function<void (const FdFileRange &)> &outputFile, const std::function<void ()> &close) override;
     void Release(NetwConnectionHandler *) override;
     void SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &) override;
     task<std::shared_ptr<HttpRequest>> NextRequest();
+    void SetMaxPipelineDepth(size_t depth);
+    std::shared_ptr<const HttpServerMetrics> GetMetrics() const {
+        return metrics;
+    }
+    void SetRequestHandler(const std::function<void (const std::shared_ptr<HttpRequest> &)> &handler);
 };
 
 
@@ -7,13 +7,24 @@
 
 #include <memory>
 #include <string>
+#include <chrono>
+#include "Fd.h"
+#include "Metrics.h"
 
 class HttpServerConnectionHandler;
 
 struct HttpServerResponseContainer {
     std::weak_ptr<HttpServerConnectionHandler> handler{};
     std::string output{};
+    FdFileRange file{};
+    std::chrono::steady_clock::time_point received{};
+    std::shared_ptr<MetricsGauge> inflightGauge{};
     bool completed{false};
+    ~HttpServerResponseContainer() {
+        if (inflightGauge) {
+            inflightGauge->Add(-1);
+        }
+    }
 };
 
 #endif //LIBHTTPTOOLING_HTTPSERVERRESPONSECONTAINER_H
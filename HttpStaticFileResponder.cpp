@@ -0,0 +1,339 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "HttpStaticFileResponder.h"
+#include "HttpRequest.h"
+#include "HttpResponse.h"
+#include "HttpHeaders.h"
+#include "Http1ResponseHead.h"
+#include <ctime>
+extern "C" {
+#include <sys/stat.h>
+}
+
+static_assert(HttpParseRange("bytes=0-99", 1000)->offset == 0);
+static_assert(HttpParseRange("bytes=0-99", 1000)->length == 100);
+static_assert(HttpParseRange("bytes=900-", 1000)->length == 100);
+static_assert(HttpParseRange("bytes=900-2000", 1000)->length == 100);
+static_assert(HttpParseRange("bytes=-100", 1000)->offset == 900);
+static_assert(HttpParseRange("bytes=-2000", 1000)->length == 1000);
+static_assert(!HttpParseRange("bytes=1000-", 1000)->satisfiable);
+static_assert(!HttpParseRange("bytes=0-1,5-6", 1000));
+static_assert(!HttpParseRange("bytes=5-1", 1000));
+static_assert(!HttpParseRange("items=0-1", 1000));
+static_assert(!HttpParseRange("bytes=a-", 1000));
+
+static std::string HttpDate(int64_t time) {
+    time_t t = (time_t) time;
+    struct tm tm{};
+    gmtime_r(&t, &tm);
+    char buf[httpDateSize];
+    auto end = HttpWriteDate(buf, tm);
+    return {buf, end};
+}
+
+static std::optional<int64_t> ParseHttpDate(const std::string &date) {
+    struct tm tm{};
+    auto end = strptime(date.c_str(), "%a, %d %b %Y %H:%M:%S GMT", &tm);
+    if (end == nullptr || *end != '\0') {
+        return {};
+    }
+    return (int64_t) timegm(&tm);
+}
+
+std::shared_ptr<const HttpOpenFile> HttpOpenFileCache::Load(const std::string &path) const {
+    auto fd = std::make_shared<Fd>(root.OpenReadOnlyBeneath(path));
+    if (!fd->IsValid()) {
+        return {};
+    }
+    struct stat st{};
+    if (fstat(*fd, &st) != 0) {
+        return {};
+    }
+    auto file = std::make_shared<HttpOpenFile>();
+    file->device = st.st_dev;
+    file->inode = st.st_ino;
+    file->mtime = st.st_mtime;
+    file->validated = std::chrono::steady_clock::now();
+    if (S_ISDIR(st.st_mode)) {
+        file->directory = true;
+        return file;
+    }
+    if (!S_ISREG(st.st_mode)) {
+        return {};
+    }
+    file->fd = fd;
+    file->size = st.st_size;
+    file->etag = "\"";
+    file->etag.append(std::to_string(file->size));
+    file->etag.append("-");
+    file->etag.append(std::to_string(file->mtime));
+    file->etag.append("\"");
+    file->lastModified = HttpDate(file->mtime);
+    return file;
+}
+
+/*
+ * The stat follows links anywhere, but only the file that was opened beneath the root
+ * can match.
+ */
+bool HttpOpenFileCache::Unchanged(const std::string &path, const HttpOpenFile &file) const {
+    struct stat st{};
+    if (fstatat(root, path.c_str(), &st, 0) != 0) {
+        return false;
+    }
+    return st.st_dev == file.device && st.st_ino == file.inode && st.st_mtime == file.mtime && (file.directory ? S_ISDIR(st.st_mode) : (uint64_t) st.st_size == file.size);
+}
+
+void HttpOpenFileCache::Insert(const std::string &path, const std::shared_ptr<const HttpOpenFile> &file) {
+    auto iterator = files.find(path);
+    if (iterator != files.end()) {
+        lru.erase(iterator->second.second);
+        files.erase(iterator);
+    }
+    if (!file || maxOpenFiles == 0) {
+        return;
+    }
+    while (files.size() >= maxOpenFiles) {
+        files.erase(lru.back());
+        lru.pop_back();
+    }
+    lru.emplace_front(path);
+    files.emplace(path, std::make_pair(file, lru.begin()));
+}
+
+std::shared_ptr<const HttpOpenFile> HttpOpenFileCache::Open(const std::string &path) {
+    std::shared_ptr<const HttpOpenFile> cached{};
+    {
+        std::lock_guard lock{mtx};
+        auto iterator = files.find(path);
+        if (iterator != files.end()) {
+            cached = iterator->second.first;
+            lru.splice(lru.begin(), lru, iterator->second.second);
+            if ((std::chrono::steady_clock::now() - cached->validated) < revalidateInterval) {
+                return cached;
+            }
+        }
+    }
+    std::shared_ptr<const HttpOpenFile> file{};
+    if (cached && Unchanged(path, *cached)) {
+        auto revalidated = std::make_shared<HttpOpenFile>(*cached);
+        revalidated->validated = std::chrono::steady_clock::now();
+        file = revalidated;
+    } else {
+        file = Load(path);
+    }
+    std::lock_guard lock{mtx};
+    Insert(path, file);
+    return file;
+}
+
+HttpStaticFileResponder::HttpStaticFileResponder(const std::string &root, size_t maxOpenFiles) : openFiles(Fd::OpenDirectory(root), maxOpenFiles) {
+}
+
+static int HexValue(char ch) {
+    if (ch >= '0' && ch <= '9') {
+        return ch - '0';
+    }
+    if (ch >= 'a' && ch <= 'f') {
+        return ch - 'a' + 10;
+    }
+    if (ch >= 'A' && ch <= 'F') {
+        return ch - 'A' + 10;
+    }
+    return -1;
+}
+
+std::optional<std::string> HttpStaticFileResponder::ResolvePath(std::string_view requestPath) {
+    auto end = requestPath.find_first_of("?#");
+    if (end != std::string_view::npos) {
+        requestPath = requestPath.substr(0, end);
+    }
+    if (!requestPath.starts_with('/')) {
+        return {};
+    }
+    std::string path{};
+    path.reserve(requestPath.size());
+    for (size_t i = 0; i < requestPath.size(); i++) {
+        auto ch = requestPath[i];
+        if (ch == '%') {
+            if ((i + 2) >= requestPath.size()) {
+                return {};
+            }
+            auto hi = HexValue(requestPath[i + 1]);
+            auto lo = HexValue(requestPath[i + 2]);
+            if (hi < 0 || lo < 0) {
+                return {};
+            }
+            ch = (char) ((hi << 4) | lo);
+            i += 2;
+        }
+        if (ch == '\0' || ch == '\\') {
+            return {};
+        }
+        path.push_back(ch);
+    }
+    size_t segmentStart{1};
+    while (segmentStart <= path.size()) {
+        auto segmentEnd = path.find('/', segmentStart);
+        if (segmentEnd == std::string::npos) {
+            segmentEnd = path.size();
+        }
+        if (std::string_view(path).substr(segmentStart, segmentEnd - segmentStart) == "..") {
+            return {};
+        }
+        segmentStart = segmentEnd + 1;
+    }
+    if (path.ends_with('/')) {
+        path.append("index.html");
+    }
+    return path;
+}
+
+std::string_view HttpStaticFileResponder::ContentType(std::string_view path) {
+    static constexpr std::pair<std::string_view,std::string_view> contentTypes[] = {
+        {".html", "text/html; charset=utf-8"},
+        {".htm", "text/html; charset=utf-8"},
+        {".css", "text/css; charset=utf-8"},
+        {".js", "text/javascript; charset=utf-8"},
+        {".mjs", "text/javascript; charset=utf-8"},
+        {".json", "application/json"},
+        {".txt", "text/plain; charset=utf-8"},
+        {".xml", "application/xml"},
+        {".svg", "image/svg+xml"},
+        {".png", "image/png"},
+        {".jpg", "image/jpeg"},
+        {".jpeg", "image/jpeg"},
+        {".gif", "image/gif"},
+        {".webp", "image/webp"},
+        {".ico", "image/vnd.microsoft.icon"},
+        {".woff", "font/woff"},
+        {".woff2", "font/woff2"},
+        {".wasm", "application/wasm"},
+        {".pdf", "application/pdf"},
+        {".mp4", "video/mp4"},
+        {".webm", "video/webm"}
+    };
+    auto dot = path.rfind('.');
+    auto slash = path.rfind('/');
+    if (dot == std::string_view::npos || (slash != std::string_view::npos && dot < slash)) {
+        return "application/octet-stream";
+    }
+    auto ext = path.substr(dot);
+    for (const auto &contentType : contentTypes) {
+        if (ext.size() == contentType.first.size() && std::equal(ext.cbegin(), ext.cend(), contentType.first.cbegin(), [] (char a, char b) { return HttpAsciiLower(a) == b; })) {
+            return contentType.second;
+        }
+    }
+    return "application/octet-stream";
+}
+
+static bool EtagMatches(std::string_view ifNoneMatch, std::string_view etag) {
+    while (!ifNoneMatch.empty()) {
+        auto comma = ifNoneMatch.find(',');
+        auto candidate = ifNoneMatch.substr(0, comma);
+        while (!candidate.empty() && candidate.front() == ' ') {
+            candidate.remove_prefix(1);
+        }
+        while (!candidate.empty() && candidate.back() == ' ') {
+            candidate.remove_suffix(1);
+        }
+        if (candidate.starts_with("W/")) {
+            candidate.remove_prefix(2);
+        }
+        if (candidate == "*" || candidate == etag) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        ifNoneMatch.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+std::shared_ptr<HttpResponse> HttpStaticFileResponder::CreateResponse(const HttpRequest &request) {
+    auto method = request.GetMethod();
+    if (method != "GET" && method != "HEAD") {
+        auto response = std::make_shared<HttpResponse>(405, "Method Not Allowed");
+        response->AddHeader("Allow", "GET, HEAD");
+        return response;
+    }
+    auto requestPath = request.GetPath();
+    auto path = ResolvePath(requestPath);
+    if (!path) {
+        return std::make_shared<HttpResponse>(400, "Bad Request");
+    }
+    auto file = openFiles.Open(path->substr(1));
+    if (!file) {
+        return std::make_shared<HttpResponse>(404, "Not Found");
+    }
+    if (file->directory) {
+        auto response = std::make_shared<HttpResponse>(301, "Moved Permanently");
+        auto location = requestPath.substr(0, requestPath.find_first_of("?#"));
+        location.append("/");
+        response->AddHeader("Location", location);
+        return response;
+    }
+    auto ifNoneMatch = request.GetHeader("If-None-Match");
+    bool notModified{false};
+    if (!ifNoneMatch.empty()) {
+        notModified = EtagMatches(ifNoneMatch, file->etag);
+    } else {
+        auto ifModifiedSince = request.GetHeader("If-Modified-Since");
+        if (!ifModifiedSince.empty()) {
+            auto since = ParseHttpDate(ifModifiedSince);
+            notModified = since && file->mtime <= *since;
+        }
+    }
+    if (notModified) {
+        auto response = std::make_shared<HttpResponse>(304, "Not Modified");
+        response->AddHeader("ETag", file->etag);
+        response->AddHeader("Last-Modified", file->lastModified);
+        return response;
+    }
+    std::string contentType{ContentType(*path)};
+    auto rangeHeader = request.GetHeader("Range");
+    std::optional<HttpByteRange> range{};
+    if (!rangeHeader.empty()) {
+        auto ifRange = request.GetHeader("If-Range");
+        if (ifRange.empty() || ifRange == file->etag || ifRange == file->lastModified) {
+            range = HttpParseRange(rangeHeader, file->size);
+        }
+    }
+    if (range && !range->satisfiable) {
+        auto response = std::make_shared<HttpResponse>(416, "Range Not Satisfiable");
+        std::string contentRange{"bytes */"};
+        contentRange.append(std::to_string(file->size));
+        response->AddHeader("Content-Range", contentRange);
+        return response;
+    }
+    std::shared_ptr<HttpResponse> response{};
+    if (range) {
+        response = std::make_shared<HttpResponse>(206, "Partial Content");
+        std::string contentRange{"bytes "};
+        contentRange.append(std::to_string(range->offset));
+        contentRange.append("-");
+        contentRange.append(std::to_string(range->offset + range->length - 1));
+        contentRange.append("/");
+        contentRange.append(std::to_string(file->size));
+        response->AddHeader("Content-Range", contentRange);
+    } else {
+        response = std::make_shared<HttpResponse>(200, "OK");
+        range = HttpByteRange{.offset = 0, .length = file->size, .satisfiable = true};
+    }
+    response->AddHeader("Accept-Ranges", "bytes");
+    response->AddHeader("ETag", file->etag);
+    response->AddHeader("Last-Modified", file->lastModified);
+    if (range->length > 0) {
+        response->SetFileContent({.fd = file->fd, .offset = range->offset, .length = range->length}, contentType);
+    } else {
+        response->SetContent("", contentType);
+    }
+    return response;
+}
+
+void HttpStaticFileResponder::Respond(const std::shared_ptr<HttpRequest> &request) {
+    request->Respond(CreateResponse(*request));
+}
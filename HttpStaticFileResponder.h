@@ -0,0 +1,135 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTPSTATICFILERESPONDER_H
+#define LIBHTTPTOOLING_HTTPSTATICFILERESPONDER_H
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <mutex>
+#include <list>
+#include <unordered_map>
+#include <chrono>
+#include <optional>
+#include <cstdint>
+#include "Fd.h"
+
+class HttpRequest;
+class HttpResponse;
+
+struct HttpOpenFile {
+    std::shared_ptr<const Fd> fd{};
+    uint64_t size{0};
+    int64_t mtime{0};
+    uint64_t device{0};
+    uint64_t inode{0};
+    std::string etag{};
+    std::string lastModified{};
+    bool directory{false};
+    std::chrono::steady_clock::time_point validated{};
+};
+
+/*
+ * Paths are relative to the root directory and are opened beneath it, a symbolic link
+ * can not lead out of the root.
+ */
+class HttpOpenFileCache {
+private:
+    Fd root;
+    std::mutex mtx{};
+    std::list<std::string> lru{};
+    std::unordered_map<std::string,std::pair<std::shared_ptr<const HttpOpenFile>,std::list<std::string>::iterator>> files{};
+    size_t maxOpenFiles;
+    std::chrono::steady_clock::duration revalidateInterval;
+public:
+    HttpOpenFileCache(Fd &&root, size_t maxOpenFiles, std::chrono::steady_clock::duration revalidateInterval = std::chrono::seconds(1)) : root(std::move(root)), maxOpenFiles(maxOpenFiles), revalidateInterval(revalidateInterval) {}
+    std::shared_ptr<const HttpOpenFile> Open(const std::string &path);
+private:
+    std::shared_ptr<const HttpOpenFile> Load(const std::string &path) const;
+    bool Unchanged(const std::string &path, const HttpOpenFile &file) const;
+    void Insert(const std::string &path, const std::shared_ptr<const HttpOpenFile> &file);
+};
+
+struct HttpByteRange {
+    uint64_t offset{0};
+    uint64_t length{0};
+    bool satisfiable{true};
+};
+
+constexpr std::optional<uint64_t> HttpParseRangeNumber(std::string_view str) {
+    if (str.empty() || str.size() > 19) {
+        return {};
+    }
+    uint64_t value{0};
+    for (auto ch : str) {
+        if (ch < '0' || ch > '9') {
+            return {};
+        }
+        value = (value * 10) + (ch - '0');
+    }
+    return value;
+}
+
+/*
+ * Only a single range is supported. An empty result means that the header should be
+ * ignored and the full content served.
+ */
+constexpr std::optional<HttpByteRange> HttpParseRange(std::string_view range, uint64_t size) {
+    if (!range.starts_with("bytes=")) {
+        return {};
+    }
+    range.remove_prefix(6);
+    if (range.find(',') != std::string_view::npos) {
+        return {};
+    }
+    auto dash = range.find('-');
+    if (dash == std::string_view::npos) {
+        return {};
+    }
+    auto first = range.substr(0, dash);
+    auto last = range.substr(dash + 1);
+    if (first.empty()) {
+        auto suffix = HttpParseRangeNumber(last);
+        if (!suffix) {
+            return {};
+        }
+        if (*suffix == 0 || size == 0) {
+            return HttpByteRange{.offset = 0, .length = 0, .satisfiable = false};
+        }
+        auto length = *suffix < size ? *suffix : size;
+        return HttpByteRange{.offset = size - length, .length = length, .satisfiable = true};
+    }
+    auto offset = HttpParseRangeNumber(first);
+    if (!offset) {
+        return {};
+    }
+    uint64_t end{size > 0 ? size - 1 : 0};
+    if (!last.empty()) {
+        auto lastPos = HttpParseRangeNumber(last);
+        if (!lastPos || *lastPos < *offset) {
+            return {};
+        }
+        if (*lastPos < end) {
+            end = *lastPos;
+        }
+    }
+    if (*offset >= size) {
+        return HttpByteRange{.offset = 0, .length = 0, .satisfiable = false};
+    }
+    return HttpByteRange{.offset = *offset, .length = end - *offset + 1, .satisfiable = true};
+}
+
+class HttpStaticFileResponder {
+private:
+    HttpOpenFileCache openFiles;
+public:
+    HttpStaticFileResponder(const std::string &root, size_t maxOpenFiles = 1024);
+    static std::optional<std::string> ResolvePath(std::string_view requestPath);
+    static std::string_view ContentType(std::string_view path);
+    std::shared_ptr<HttpResponse> CreateResponse(const HttpRequest &request);
+    void Respond(const std::shared_ptr<HttpRequest> &request);
+};
+
+#endif //LIBHTTPTOOLING_HTTPSTATICFILERESPONDER_H
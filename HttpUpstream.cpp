@@ -0,0 +1,230 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "HttpUpstream.h"
+#include <algorithm>
+
+constexpr bool TestHttpUpstreamTwoChoices(size_t count) {
+    std::vector<size_t> picked(count, 0);
+    for (uint64_t random = 0; random < count * count * 4; random++) {
+        auto [first, second] = HttpUpstreamTwoChoices(count, random);
+        if (first >= count || second >= count || (count > 1 && first == second)) {
+            return false;
+        }
+        ++picked[first];
+        ++picked[second];
+    }
+    /* Every endpoint is picked as often as the others */
+    for (auto times : picked) {
+        if (times != picked[0]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static_assert(HttpUpstreamTwoChoices(1, 12345) == std::pair<size_t,size_t>{0, 0});
+static_assert(TestHttpUpstreamTwoChoices(2));
+static_assert(TestHttpUpstreamTwoChoices(3));
+static_assert(TestHttpUpstreamTwoChoices(7));
+
+constexpr std::chrono::steady_clock::time_point TestTime(int ms) {
+    return std::chrono::steady_clock::time_point{} + std::chrono::milliseconds(ms);
+}
+
+/*
+ * Ejected after the consecutive errors, a failed probe doubles the ejection time and a
+ * successful one closes the circuit.
+ */
+constexpr bool TestHttpUpstreamConsecutiveErrors() {
+    HttpUpstreamHealthPolicy policy{.consecutiveErrors = 3, .errorRate = 0, .ejectionTime = std::chrono::milliseconds(100)};
+    HttpUpstreamHealth health{};
+    health.Report(policy, TestTime(0), false, {}, false);
+    health.Report(policy, TestTime(0), true, {}, false);
+    health.Report(policy, TestTime(0), false, {}, false);
+    health.Report(policy, TestTime(0), false, {}, false);
+    if (health.GetCircuit() != HttpUpstreamCircuit::CLOSED) {
+        return false;
+    }
+    health.Report(policy, TestTime(10), false, {}, false);
+    if (health.GetCircuit() != HttpUpstreamCircuit::OPEN || health.IsAvailable(TestTime(109)) || !health.IsAvailable(TestTime(110))) {
+        return false;
+    }
+    if (!health.Acquire(TestTime(110)) || health.IsAvailable(TestTime(110)) || health.GetCircuit() != HttpUpstreamCircuit::HALF_OPEN) {
+        return false;
+    }
+    health.Report(policy, TestTime(120), false, {}, true);
+    if (health.IsAvailable(TestTime(319)) || !health.IsAvailable(TestTime(320))) {
+        return false;
+    }
+    if (!health.Acquire(TestTime(320))) {
+        return false;
+    }
+    health.Report(policy, TestTime(330), true, {}, true);
+    return health.GetCircuit() == HttpUpstreamCircuit::CLOSED && !health.Acquire(TestTime(330));
+}
+
+static_assert(TestHttpUpstreamConsecutiveErrors());
+
+constexpr bool TestHttpUpstreamErrorRate() {
+    HttpUpstreamHealthPolicy policy{.consecutiveErrors = 0, .errorRate = 0.3, .minRequests = 10, .ewmaWeight = 0.2};
+    HttpUpstreamHealth health{};
+    for (int i = 0; i < 20; i++) {
+        health.Report(policy, TestTime(0), (i % 2) == 0, {}, false);
+        if (health.GetCircuit() != HttpUpstreamCircuit::CLOSED) {
+            return i >= 9;
+        }
+    }
+    return false;
+}
+
+static_assert(TestHttpUpstreamErrorRate());
+
+constexpr bool TestHttpUpstreamLatency() {
+    HttpUpstreamHealthPolicy policy{.latency = std::chrono::milliseconds(50), .minRequests = 5, .ewmaWeight = 0.3};
+    HttpUpstreamHealth health{};
+    for (int i = 0; i < 10; i++) {
+        health.Report(policy, TestTime(0), true, std::chrono::milliseconds(10), false);
+    }
+    health.Report(policy, TestTime(0), true, std::chrono::milliseconds(100), false);
+    if (health.GetCircuit() != HttpUpstreamCircuit::CLOSED) {
+        return false;
+    }
+    health.Report(policy, TestTime(0), true, std::chrono::milliseconds(100), false);
+    if (health.GetCircuit() != HttpUpstreamCircuit::OPEN) {
+        return false;
+    }
+    /* A probe that is still slow keeps it ejected */
+    health.Acquire(TestTime(1000));
+    health.Report(policy, TestTime(1000), true, std::chrono::milliseconds(100), true);
+    return health.GetCircuit() == HttpUpstreamCircuit::OPEN;
+}
+
+static_assert(TestHttpUpstreamLatency());
+
+/*
+ * Responses to requests that were sent before the ejection do not count.
+ */
+constexpr bool TestHttpUpstreamLateResponses() {
+    HttpUpstreamHealthPolicy policy{.consecutiveErrors = 1};
+    HttpUpstreamHealth health{};
+    health.Report(policy, TestTime(0), false, {}, false);
+    health.Report(policy, TestTime(0), false, {}, false);
+    health.Report(policy, TestTime(0), true, {}, false);
+    return health.GetCircuit() == HttpUpstreamCircuit::OPEN && !health.IsAvailable(TestTime(999)) && health.IsAvailable(TestTime(1000));
+}
+
+static_assert(TestHttpUpstreamLateResponses());
+
+/*
+ * An abandoned probe leaves the circuit half open for the next probe.
+ */
+constexpr bool TestHttpUpstreamAbandonedProbe() {
+    HttpUpstreamHealthPolicy policy{.consecutiveErrors = 1};
+    HttpUpstreamHealth health{};
+    health.Report(policy, TestTime(0), false, {}, false);
+    if (!health.Acquire(TestTime(1000))) {
+        return false;
+    }
+    health.Abandon(true);
+    if (health.GetCircuit() != HttpUpstreamCircuit::HALF_OPEN || !health.IsAvailable(TestTime(1000)) || !health.Acquire(TestTime(1000))) {
+        return false;
+    }
+    health.Report(policy, TestTime(1000), true, {}, true);
+    return health.GetCircuit() == HttpUpstreamCircuit::CLOSED;
+}
+
+static_assert(TestHttpUpstreamAbandonedProbe());
+
+std::shared_ptr<HttpUpstreamEndpointState> HttpUpstreamGroup::Find(const HttpUpstreamEndpoint &endpoint) {
+    std::lock_guard lock{mtx};
+    for (const auto &state : endpoints) {
+        if (state->endpoint == endpoint) {
+            return state;
+        }
+    }
+    return {};
+}
+
+std::vector<std::shared_ptr<HttpUpstreamEndpointState>> HttpUpstreamGroup::Endpoints() {
+    std::lock_guard lock{mtx};
+    return endpoints;
+}
+
+std::vector<std::shared_ptr<HttpUpstreamEndpointState>> HttpUpstreamGroup::Replace(const std::vector<std::shared_ptr<HttpUpstreamEndpointState>> &endpoints) {
+    std::vector<std::shared_ptr<HttpUpstreamEndpointState>> removed{};
+    std::lock_guard lock{mtx};
+    for (const auto &state : this->endpoints) {
+        if (std::find(endpoints.begin(), endpoints.end(), state) == endpoints.end()) {
+            removed.emplace_back(state);
+        }
+    }
+    this->endpoints = endpoints;
+    return removed;
+}
+
+bool HttpUpstreamGroup::HasAvailable() {
+    std::lock_guard lock{mtx};
+    auto now = std::chrono::steady_clock::now();
+    return std::any_of(endpoints.begin(), endpoints.end(), [now] (const auto &endpoint) {
+        return endpoint->health.IsAvailable(now);
+    });
+}
+
+HttpUpstreamLease HttpUpstreamGroup::Acquire(const std::vector<std::shared_ptr<HttpUpstreamEndpointState>> &avoid) {
+    HttpUpstreamLease lease{};
+    {
+        std::lock_guard lock{mtx};
+        auto now = std::chrono::steady_clock::now();
+        bool avoiding{!avoid.empty()};
+        auto eligible = [now, &avoid, &avoiding] (const std::shared_ptr<HttpUpstreamEndpointState> &endpoint) {
+            return endpoint->health.IsAvailable(now) && (!avoiding || std::find(avoid.begin(), avoid.end(), endpoint) == avoid.end());
+        };
+        size_t available = std::count_if(endpoints.begin(), endpoints.end(), eligible);
+        if (available == 0 && avoiding) {
+            avoiding = false;
+            available = std::count_if(endpoints.begin(), endpoints.end(), eligible);
+        }
+        if (available == 0) {
+            return {};
+        }
+        auto [first, second] = HttpUpstreamTwoChoices(available, random());
+        std::shared_ptr<HttpUpstreamEndpointState> firstEndpoint{};
+        std::shared_ptr<HttpUpstreamEndpointState> secondEndpoint{};
+        size_t index{0};
+        for (const auto &endpoint : endpoints) {
+            if (!eligible(endpoint)) {
+                continue;
+            }
+            if (index == first) {
+                firstEndpoint = endpoint;
+            }
+            if (index == second) {
+                secondEndpoint = endpoint;
+            }
+            ++index;
+        }
+        lease.endpoint = secondEndpoint->outstanding < firstEndpoint->outstanding ? secondEndpoint : firstEndpoint;
+        lease.probe = lease.endpoint->health.Acquire(now);
+    }
+    ++(lease.endpoint->outstanding);
+    return lease;
+}
+
+void HttpUpstreamGroup::Release(const HttpUpstreamLease &lease, bool success, std::chrono::microseconds latency) {
+    --(lease.endpoint->outstanding);
+    std::lock_guard lock{mtx};
+    lease.endpoint->health.Report(healthPolicy, std::chrono::steady_clock::now(), success, latency, lease.probe);
+}
+
+void HttpUpstreamGroup::Release(const HttpUpstreamLease &lease) {
+    --(lease.endpoint->outstanding);
+    std::lock_guard lock{mtx};
+    lease.endpoint->health.Abandon(lease.probe);
+}
+
+void HttpUpstreamGroup::SetHealthPolicy(const HttpUpstreamHealthPolicy &policy) {
+    std::lock_guard lock{mtx};
+    healthPolicy = policy;
+}
@@ -0,0 +1,209 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_HTTPUPSTREAM_H
+#define LIBHTTPTOOLING_HTTPUPSTREAM_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <random>
+#include <utility>
+#include <chrono>
+#include <cstdint>
+
+struct HttpUpstreamEndpoint {
+    std::string host{};
+    int port{0};
+    constexpr bool operator ==(const HttpUpstreamEndpoint &) const = default;
+};
+
+/*
+ * An endpoint is ejected after consecutiveErrors failed requests in a row, or once it
+ * has had minRequests requests when the moving average of its errors reaches errorRate
+ * or that of its latency goes above latency. Zero turns a limit off. The averages
+ * weigh the latest request by ewmaWeight. The ejection lasts ejectionTime times the
+ * number of ejections in a row, at most maxEjectionTime, and then a single request is
+ * let through to probe the endpoint. Errors are failures to get a response and 5xx
+ * responses.
+ */
+struct HttpUpstreamHealthPolicy {
+    unsigned int consecutiveErrors{5};
+    double errorRate{0.5};
+    std::chrono::milliseconds latency{0};
+    unsigned int minRequests{10};
+    double ewmaWeight{0.1};
+    std::chrono::milliseconds ejectionTime{1000};
+    std::chrono::milliseconds maxEjectionTime{30000};
+};
+
+enum class HttpUpstreamCircuit {
+    CLOSED,
+    OPEN,
+    HALF_OPEN
+};
+
+/*
+ * The circuit of an endpoint, closed while it is healthy, open while it is ejected and
+ * half open while a probe is deciding.
+ */
+class HttpUpstreamHealth {
+private:
+    std::chrono::steady_clock::time_point ejectedUntil{};
+    double errorRate{0};
+    double latency{0};
+    unsigned int consecutiveErrors{0};
+    unsigned int requests{0};
+    unsigned int ejections{0};
+    HttpUpstreamCircuit circuit{HttpUpstreamCircuit::CLOSED};
+    bool probing{false};
+    constexpr void Eject(const HttpUpstreamHealthPolicy &policy, std::chrono::steady_clock::time_point now) {
+        ++ejections;
+        auto ejectionTime = policy.ejectionTime * ejections;
+        ejectedUntil = now + (ejectionTime < policy.maxEjectionTime ? ejectionTime : policy.maxEjectionTime);
+        circuit = HttpUpstreamCircuit::OPEN;
+        probing = false;
+        requests = 0;
+        consecutiveErrors = 0;
+        errorRate = 0;
+    }
+    constexpr static bool IsSlow(const HttpUpstreamHealthPolicy &policy, double latency) {
+        return policy.latency.count() > 0 && latency > (double) std::chrono::duration_cast<std::chrono::microseconds>(policy.latency).count();
+    }
+public:
+    constexpr HttpUpstreamCircuit GetCircuit() const {
+        return circuit;
+    }
+    constexpr bool IsAvailable(std::chrono::steady_clock::time_point now) const {
+        switch (circuit) {
+            case HttpUpstreamCircuit::CLOSED:
+                return true;
+            case HttpUpstreamCircuit::OPEN:
+                return now >= ejectedUntil;
+            case HttpUpstreamCircuit::HALF_OPEN:
+                return !probing;
+        }
+        return false;
+    }
+    /*
+     * True when the request is the probe of the endpoint.
+     */
+    constexpr bool Acquire(std::chrono::steady_clock::time_point now) {
+        if (circuit == HttpUpstreamCircuit::OPEN && now >= ejectedUntil) {
+            circuit = HttpUpstreamCircuit::HALF_OPEN;
+        }
+        if (circuit != HttpUpstreamCircuit::HALF_OPEN) {
+            return false;
+        }
+        probing = true;
+        return true;
+    }
+    /*
+     * A request that ended without a verdict, like a cancelled hedge, only lets the
+     * next request probe in place of the probe it was.
+     */
+    constexpr void Abandon(bool probe) {
+        if (probe) {
+            probing = false;
+        }
+    }
+    constexpr void Report(const HttpUpstreamHealthPolicy &policy, std::chrono::steady_clock::time_point now, bool success, std::chrono::microseconds latency, bool probe) {
+        if (probe) {
+            if (!success || IsSlow(policy, (double) latency.count())) {
+                Eject(policy, now);
+                return;
+            }
+            circuit = HttpUpstreamCircuit::CLOSED;
+            probing = false;
+            ejections = 0;
+            requests = 1;
+            this->latency = (double) latency.count();
+            return;
+        }
+        /* Responses to requests sent before the ejection do not count */
+        if (circuit != HttpUpstreamCircuit::CLOSED) {
+            return;
+        }
+        ++requests;
+        errorRate += policy.ewmaWeight * ((success ? 0.0 : 1.0) - errorRate);
+        if (success) {
+            consecutiveErrors = 0;
+            this->latency = requests == 1 ? (double) latency.count() : this->latency + policy.ewmaWeight * ((double) latency.count() - this->latency);
+        } else {
+            ++consecutiveErrors;
+        }
+        if ((policy.consecutiveErrors > 0 && consecutiveErrors >= policy.consecutiveErrors) ||
+            (requests >= policy.minRequests && ((policy.errorRate > 0 && errorRate >= policy.errorRate) || IsSlow(policy, this->latency)))) {
+            Eject(policy, now);
+        }
+    }
+};
+
+/*
+ * An endpoint with its resolved address, the key of its connection pool, the requests
+ * sent to it that have not got their response yet and its health.
+ */
+struct HttpUpstreamEndpointState {
+    HttpUpstreamEndpoint endpoint{};
+    std::string address{};
+    std::string destination{};
+    std::atomic<size_t> outstanding{0};
+    HttpUpstreamHealth health{};
+    HttpUpstreamEndpointState(const HttpUpstreamEndpoint &endpoint, const std::string &address) : endpoint(endpoint), address(address), destination(address + ":" + std::to_string(endpoint.port)) {}
+};
+
+/*
+ * Two different indexes below count out of one random number.
+ */
+constexpr std::pair<size_t,size_t> HttpUpstreamTwoChoices(size_t count, uint64_t random) {
+    auto first = random % count;
+    if (count < 2) {
+        return {first, first};
+    }
+    auto second = (first + 1 + (random / count) % (count - 1)) % count;
+    return {first, second};
+}
+
+struct HttpUpstreamLease {
+    std::shared_ptr<HttpUpstreamEndpointState> endpoint{};
+    bool probe{false};
+};
+
+/*
+ * A named set of endpoints. Of two endpoints picked at random among those that are not
+ * ejected, the one with fewer outstanding requests gets the next one. Replacing the set
+ * does not affect requests already sent, they keep their endpoint until they are done.
+ */
+class HttpUpstreamGroup {
+private:
+    std::mutex mtx{};
+    std::vector<std::shared_ptr<HttpUpstreamEndpointState>> endpoints{};
+    HttpUpstreamHealthPolicy healthPolicy{};
+    std::minstd_rand random{std::random_device{}()};
+public:
+    void SetHealthPolicy(const HttpUpstreamHealthPolicy &policy);
+    std::shared_ptr<HttpUpstreamEndpointState> Find(const HttpUpstreamEndpoint &endpoint);
+    std::vector<std::shared_ptr<HttpUpstreamEndpointState>> Endpoints();
+    /*
+     * Returns the endpoints that are no longer in the set.
+     */
+    std::vector<std::shared_ptr<HttpUpstreamEndpointState>> Replace(const std::vector<std::shared_ptr<HttpUpstreamEndpointState>> &endpoints);
+    bool HasAvailable();
+    /*
+     * Picks an endpoint and counts the request as outstanding on it until Release, or
+     * nothing when all of them are ejected. Endpoints in avoid, those that a request
+     * has already been sent to, are only picked when no other one is available.
+     */
+    HttpUpstreamLease Acquire(const std::vector<std::shared_ptr<HttpUpstreamEndpointState>> &avoid = {});
+    void Release(const HttpUpstreamLease &lease, bool success, std::chrono::microseconds latency);
+    /*
+     * Releases a request that got no verdict on the endpoint, it does not count towards
+     * its health.
+     */
+    void Release(const HttpUpstreamLease &lease);
+};
+
+#endif //LIBHTTPTOOLING_HTTPUPSTREAM_H
@@ -23,6 +23,9 @@ public:
     void Close();
     size_t AcceptInput(const std::string &) override;
     void EndOfConnection() override;
+    bool IsInputPaused() override;
+    void OutputDrained() override;
+    void Connected() override;
 };
 
 HttpsClientConnectionHandler::~HttpsClientConnectionHandler() {
@@ -76,6 +79,22 @@ void HttpsClientConnectionHandler::EndOfConnection() {
     }
 }
 
+bool HttpsClientConnectionHandler::IsInputPaused() {
+    return handler != nullptr && handler->IsInputPaused();
+}
+
+void HttpsClientConnectionHandler::OutputDrained() {
+    if (handler != nullptr) {
+        handler->OutputDrained();
+    }
+}
+
+void HttpsClientConnectionHandler::Connected() {
+    if (handler != nullptr) {
+        handler->Connected();
+    }
+}
+
 class HttpsClientConnectionHandlerProxy : public NetwConnectionHandler {
 private:
     std::shared_ptr<HttpsClientConnectionHandler> handler;
@@ -85,6 +104,9 @@ public:
     }
     size_t AcceptInput(const std::string &) override;
     void EndOfConnection() override;
+    bool IsInputPaused() override;
+    void OutputDrained() override;
+    void Connected() override;
     std::shared_ptr<HttpsClientConnectionHandler> GetHandler() const {
         return handler;
     }
@@ -98,6 +120,18 @@ void HttpsClientConnectionHandlerProxy::EndOfConnection() {
     handler->EndOfConnection();
 }
 
+bool HttpsClientConnectionHandlerProxy::IsInputPaused() {
+    return handler->IsInputPaused();
+}
+
+void HttpsClientConnectionHandlerProxy::OutputDrained() {
+    handler->OutputDrained();
+}
+
+void HttpsClientConnectionHandlerProxy::Connected() {
+    handler->Connected();
+}
+
 NetwConnectionHandler *
 HttpsClientImpl::Create(const std::function<void(const std::string &)> &output, const std::function<void()> &close) {
     return new HttpsClientConnectionHandlerProxy(upstreamHandler, output, close);
@@ -127,3 +161,34 @@ void HttpsClientImpl::Connect(const void *ipaddr_norder, size_t ipaddr_len, int
         handler->SetupConnection(callback);
     });
 }
+
+void HttpsClientImpl::ConnectUnix(const std::string &path, const std::string &requestData, const std::function<void(NetwConnectionHandler *)> &callback) {
+    auto netwServer = this->netwServer.lock();
+    if (!netwServer) {
+        callback(nullptr);
+        return;
+    }
+    netwServer->ConnectUnix(path, requestData, [callback] (NetwConnectionHandler *rawHandler) {
+        HttpsClientConnectionHandlerProxy *handlerProxy = dynamic_cast<HttpsClientConnectionHandlerProxy *>(rawHandler);
+        if (handlerProxy == nullptr) {
+            throw std::exception();
+        }
+        auto handler = handlerProxy->GetHandler();
+        handler->SetupConnection(callback);
+    });
+}
+
+NetwTimer HttpsClientImpl::AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func) {
+    auto netwServer = this->netwServer.lock();
+    if (!netwServer) {
+        return {};
+    }
+    return netwServer->AddTimer(deadline, func);
+}
+
+void HttpsClientImpl::CancelTimer(const NetwTimer &timer) {
+    auto netwServer = this->netwServer.lock();
+    if (netwServer) {
+        netwServer->CancelTimer(timer);
+    }
+}
@@ -19,6 +19,9 @@ public:
     void Release(NetwConnectionHandler *) override;
     void SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &) override;
     void Connect(const void *ipaddr_norder, size_t ipaddr_len, int port, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &);
+    void ConnectUnix(const std::string &path, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &) override;
+    NetwTimer AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func) override;
+    void CancelTimer(const NetwTimer &timer) override;
 };
 
 
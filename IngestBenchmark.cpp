@@ -0,0 +1,247 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <atomic>
+#include <algorithm>
+#include "HttpServer.h"
+#include "HttpRouter.h"
+#include "Metrics.h"
+#include "NetwServer.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+constexpr size_t uploadSize = 1024 * 1024;
+
+static task<void> Upload(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto body = co_await request->RequestBody();
+    auto response = std::make_shared<HttpResponse>(body.success ? 200 : 400, body.success ? "OK" : "Bad Request");
+    response->SetContent(std::to_string(body.content.size()), "text/plain");
+    request->Respond(response);
+}
+
+static task<void> Small(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent("ok", "text/plain");
+    request->Respond(response);
+    co_return;
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static bool WriteAll(int fd, const std::string &data) {
+    size_t written{0};
+    while (written < data.size()) {
+        auto wr = write(fd, data.data() + written, data.size() - written);
+        if (wr <= 0) {
+            return false;
+        }
+        written += wr;
+    }
+    return true;
+}
+
+static bool ReadResponse(int fd, std::string &input, std::string &body) {
+    std::string buf{};
+    buf.resize(65536);
+    while (true) {
+        auto headEnd = input.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            auto lengthPos = input.find("Content-Length: ");
+            size_t contentLength{0};
+            if (lengthPos != std::string::npos && lengthPos < headEnd) {
+                contentLength = std::stoul(input.substr(lengthPos + 16));
+            }
+            if (input.size() >= headEnd + 4 + contentLength) {
+                body = input.substr(headEnd + 4, contentLength);
+                input.erase(0, headEnd + 4 + contentLength);
+                return true;
+            }
+        }
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        input.append(buf.data(), rd);
+    }
+}
+
+static uint64_t RunUploads(int port, const std::atomic<bool> &stop, bool &failed) {
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        failed = true;
+        return 0;
+    }
+    std::string request{"POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/octet-stream\r\nContent-Length: "};
+    request.append(std::to_string(uploadSize));
+    request.append("\r\n\r\n");
+    request.append(uploadSize, 'x');
+    uint64_t uploads{0};
+    std::string input{};
+    std::string body{};
+    while (!stop) {
+        if (!WriteAll(fd, request) || !ReadResponse(fd, input, body)) {
+            failed = true;
+            break;
+        }
+        if (body != std::to_string(uploadSize)) {
+            failed = true;
+            break;
+        }
+        ++uploads;
+    }
+    close(fd);
+    return uploads;
+}
+
+static std::vector<double> RunSmall(int port, const std::atomic<bool> &stop, bool &failed) {
+    std::vector<double> latencies{};
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        failed = true;
+        return latencies;
+    }
+    std::string request{"GET /small HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+    std::string input{};
+    std::string body{};
+    while (!stop) {
+        auto start = std::chrono::steady_clock::now();
+        if (!WriteAll(fd, request) || !ReadResponse(fd, input, body)) {
+            failed = true;
+            break;
+        }
+        latencies.emplace_back(std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count());
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    close(fd);
+    return latencies;
+}
+
+static double MetricValue(const std::shared_ptr<MetricsRegistry> &metrics, const std::string &name) {
+    for (const auto &value : metrics->Snapshot()) {
+        if (value.name == name) {
+            return value.value;
+        }
+    }
+    return 0;
+}
+
+struct IngestResult {
+    double mibPerSecond{0};
+    double wakeupsPerUpload{0};
+    double fairness{0};
+    double smallP50{0};
+    double smallP99{0};
+    bool failed{false};
+};
+
+static IngestResult RunIngest(int port, int seconds, size_t readBudget) {
+    constexpr int bulkConnections = 8;
+    constexpr int smallConnections = 8;
+    IngestResult result{};
+
+    auto server = HttpServer::Create(port);
+    server->SetReadBudget(readBudget);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("POST", "/upload", Upload);
+    router->Add("GET", "/small", Small);
+    server->SetRouter(router);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    std::atomic<bool> stop{false};
+    std::vector<uint64_t> uploads{};
+    uploads.resize(bulkConnections);
+    std::vector<std::vector<double>> latencies{};
+    latencies.resize(smallConnections);
+    bool failedConnections[bulkConnections + smallConnections]{};
+    auto wakeupsStart = MetricValue(server->GetMetrics(), "netw_poll_wakeups_total");
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> clients{};
+    for (int i = 0; i < bulkConnections; i++) {
+        clients.emplace_back([&uploads, &stop, &failedConnections, i, port] () {
+            uploads[i] = RunUploads(port, stop, failedConnections[i]);
+        });
+    }
+    for (int i = 0; i < smallConnections; i++) {
+        clients.emplace_back([&latencies, &stop, &failedConnections, i, port] () {
+            latencies[i] = RunSmall(port, stop, failedConnections[bulkConnections + i]);
+        });
+    }
+    std::this_thread::sleep_for(std::chrono::seconds(seconds));
+    stop = true;
+    for (auto &client : clients) {
+        client.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    auto wakeups = MetricValue(server->GetMetrics(), "netw_poll_wakeups_total") - wakeupsStart;
+    server->Stop();
+    serverThread.join();
+
+    for (auto connectionFailed : failedConnections) {
+        result.failed = result.failed || connectionFailed;
+    }
+    uint64_t totalUploads{0};
+    double sum{0};
+    double sumSquares{0};
+    for (auto count : uploads) {
+        totalUploads += count;
+        sum += (double) count;
+        sumSquares += (double) count * (double) count;
+    }
+    /* Jain's fairness index over the bulk connections, 1.0 when all got the same share */
+    result.fairness = sumSquares > 0 ? (sum * sum) / (bulkConnections * sumSquares) : 0.0;
+    std::vector<double> small{};
+    for (const auto &connection : latencies) {
+        small.insert(small.end(), connection.begin(), connection.end());
+    }
+    std::sort(small.begin(), small.end());
+    if (totalUploads == 0 || small.empty()) {
+        result.failed = true;
+        return result;
+    }
+    result.mibPerSecond = (totalUploads * uploadSize) / (elapsed * 1024 * 1024);
+    result.wakeupsPerUpload = wakeups / totalUploads;
+    result.smallP50 = small[small.size() / 2];
+    result.smallP99 = small[(small.size() * 99) / 100];
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8094;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    bool failed{false};
+    for (size_t budget : {(size_t) 16 * 1024, netwDefaultReadBudget, (size_t) 1024 * 1024}) {
+        auto result = RunIngest(port++, seconds, budget);
+        std::cout << "read budget " << (budget / 1024) << " KiB: " << (uint64_t) result.mibPerSecond << " MiB/s, "
+                  << result.wakeupsPerUpload << " wakeups per 1MiB upload, fairness " << result.fairness
+                  << ", small requests p50 " << result.smallP50 << " us, p99 " << result.smallP99 << " us\n";
+        failed = failed || result.failed;
+        if (budget == netwDefaultReadBudget && result.wakeupsPerUpload > 32.0) {
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,237 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include "HttpServer.h"
+#include "HttpRouter.h"
+#include "Metrics.h"
+#include "NetwServer.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+/*
+ * Opens a large number of keep-alive connections over loopback that each make one
+ * request and then stay idle, and reports the resident memory of the process and the
+ * memory accounted by the server per connection. The first connections make a large
+ * upload before going idle, which must not leave them holding on to the read buffers.
+ */
+
+constexpr size_t connectionBatch = 2000;
+constexpr size_t connectionsPerSourceAddress = 20000;
+constexpr size_t uploadSize = 1024 * 1024;
+constexpr size_t uploadConnections = 1000;
+
+static task<void> Small(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent("ok", "text/plain");
+    request->Respond(response);
+    co_return;
+}
+
+static task<void> Upload(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto body = co_await request->RequestBody();
+    auto response = std::make_shared<HttpResponse>(body.success ? 200 : 400, body.success ? "OK" : "Bad Request");
+    response->SetContent(std::to_string(body.content.size()), "text/plain");
+    request->Respond(response);
+}
+
+/*
+ * The loopback network is 127.0.0.0/8, so binding to different source addresses gives
+ * each of them a full range of ephemeral ports.
+ */
+static int ConnectLoopback(int port, size_t index) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    int one{1};
+    setsockopt(fd, IPPROTO_IP, IP_BIND_ADDRESS_NO_PORT, &one, sizeof(one));
+    struct sockaddr_in source{};
+    source.sin_family = AF_INET;
+    source.sin_addr.s_addr = htonl(INADDR_LOOPBACK + 1 + (index / connectionsPerSourceAddress));
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *) &source, sizeof(source)) != 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static bool WriteAll(int fd, const std::string &data) {
+    size_t written{0};
+    while (written < data.size()) {
+        auto wr = write(fd, data.data() + written, data.size() - written);
+        if (wr <= 0) {
+            return false;
+        }
+        written += wr;
+    }
+    return true;
+}
+
+static bool ReadResponse(int fd, std::string &body) {
+    std::string input{};
+    std::string buf{};
+    buf.resize(4096);
+    while (true) {
+        auto headEnd = input.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            auto lengthPos = input.find("Content-Length: ");
+            size_t contentLength{0};
+            if (lengthPos != std::string::npos && lengthPos < headEnd) {
+                contentLength = std::stoul(input.substr(lengthPos + 16));
+            }
+            if (input.size() >= headEnd + 4 + contentLength) {
+                body = input.substr(headEnd + 4, contentLength);
+                return true;
+            }
+        }
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        input.append(buf.data(), rd);
+    }
+}
+
+static size_t ResidentBytes() {
+    std::ifstream statm{"/proc/self/statm"};
+    size_t pages{0};
+    size_t resident{0};
+    statm >> pages >> resident;
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+static double MetricValue(const std::shared_ptr<MetricsRegistry> &metrics, const std::string &name) {
+    for (const auto &value : metrics->Snapshot()) {
+        if (value.name == name) {
+            return value.value;
+        }
+    }
+    return 0;
+}
+
+/*
+ * Each connection is two descriptors in this process, the client and the server end.
+ */
+static size_t RaiseDescriptorLimit(size_t connections) {
+    struct rlimit limit{};
+    getrlimit(RLIMIT_NOFILE, &limit);
+    rlim_t wanted = (connections * 2) + 256;
+    if (limit.rlim_cur < wanted) {
+        struct rlimit raised{.rlim_cur = wanted, .rlim_max = limit.rlim_max > wanted ? limit.rlim_max : wanted};
+        if (setrlimit(RLIMIT_NOFILE, &raised) != 0) {
+            raised.rlim_cur = limit.rlim_max;
+            raised.rlim_max = limit.rlim_max;
+            setrlimit(RLIMIT_NOFILE, &raised);
+        }
+        getrlimit(RLIMIT_NOFILE, &limit);
+    }
+    return limit.rlim_cur > 256 ? (limit.rlim_cur - 256) / 2 : 0;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8099;
+    size_t connections = argc > 2 ? std::stoul(argv[2]) : 100000;
+    auto maxConnections = RaiseDescriptorLimit(connections);
+    if (maxConnections < connections) {
+        std::cerr << "Descriptor limit allows " << maxConnections << " connections\n";
+        connections = maxConnections;
+    }
+    size_t uploads = connections < uploadConnections ? connections : uploadConnections;
+
+    /* Keep-alive probes for all the idle connections at once can overflow the loopback backlog */
+    NetwSocketOptions socketOptions{};
+    socketOptions.keepAlive = false;
+    auto server = HttpServer::Create(port, socketOptions);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/", Small);
+    router->Add("POST", "/upload", Upload);
+    server->SetRouter(router);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    auto metrics = server->GetMetrics();
+
+    std::vector<int> fds{};
+    fds.reserve(connections);
+    bool failed{false};
+    auto residentStart = ResidentBytes();
+    std::string body{};
+
+    std::string upload{"POST /upload HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/octet-stream\r\nContent-Length: "};
+    upload.append(std::to_string(uploadSize));
+    upload.append("\r\n\r\n");
+    upload.append(uploadSize, 'x');
+    for (size_t i = 0; i < uploads && !failed; i++) {
+        int fd = ConnectLoopback(port, i);
+        if (fd < 0 || !WriteAll(fd, upload) || !ReadResponse(fd, body) || body != std::to_string(uploadSize)) {
+            failed = true;
+        }
+        if (fd >= 0) {
+            fds.emplace_back(fd);
+        }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    auto accountedUploads = MetricValue(metrics, "netw_connection_memory_bytes");
+    std::cout << "after a 1 MiB upload each: " << (uint64_t) (accountedUploads / (fds.empty() ? 1 : fds.size()))
+              << " bytes per connection accounted by the server, " << (uint64_t) MetricValue(metrics, "netw_buffer_pool_bytes")
+              << " bytes in the buffer pool\n";
+    /* Idle connections give their buffers back, so the uploads must not leave read buffers behind */
+    if (accountedUploads > (double) (fds.size() * netwReadChunkMin)) {
+        failed = true;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::string request{"GET / HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+    while (fds.size() < connections && !failed) {
+        auto batchStart = fds.size();
+        auto batchEnd = batchStart + connectionBatch < connections ? batchStart + connectionBatch : connections;
+        for (auto i = batchStart; i < batchEnd; i++) {
+            int fd = ConnectLoopback(port, i);
+            if (fd < 0) {
+                std::cerr << "Connect failed after " << fds.size() << " connections\n";
+                failed = true;
+                break;
+            }
+            fds.emplace_back(fd);
+        }
+        for (auto i = batchStart; i < fds.size(); i++) {
+            if (!WriteAll(fds[i], request)) {
+                failed = true;
+            }
+        }
+        for (auto i = batchStart; i < fds.size(); i++) {
+            if (!ReadResponse(fds[i], body) || body != "ok") {
+                failed = true;
+            }
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+    auto resident = ResidentBytes() - residentStart;
+    auto accounted = MetricValue(metrics, "netw_connection_memory_bytes");
+    std::cout << fds.size() << " idle connections (opened in " << elapsed << " s): " << (resident / (fds.empty() ? 1 : fds.size()))
+              << " resident bytes per connection, " << (uint64_t) (accounted / (fds.empty() ? 1 : fds.size()))
+              << " bytes per connection accounted by the server\n";
+
+    for (auto fd : fds) {
+        close(fd);
+    }
+    server->Stop();
+    serverThread.join();
+    return failed || fds.size() < connections ? 1 : 0;
+}
@@ -0,0 +1,229 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "Metrics.h"
+#include <charconv>
+#include <algorithm>
+#include <vector>
+
+static_assert(MetricsHistogram::BucketIndex(0) == 0);
+static_assert(MetricsHistogram::BucketIndex(3) == 3);
+static_assert(MetricsHistogram::BucketIndex(4) == 4);
+static_assert(MetricsHistogram::BucketIndex(7) == 7);
+static_assert(MetricsHistogram::BucketIndex(8) == 8);
+static_assert(MetricsHistogram::BucketIndex(9) == 8);
+static_assert(MetricsHistogram::BucketIndex(10) == 9);
+static_assert(MetricsHistogram::BucketUpperBound(8) == 9);
+static_assert(MetricsHistogram::BucketUpperBound(MetricsHistogram::BucketIndex(1000)) >= 1000);
+static_assert(MetricsHistogram::BucketIndex(MetricsHistogram::BucketUpperBound(MetricsHistogram::BucketIndex(1000))) == MetricsHistogram::BucketIndex(1000));
+static_assert(MetricsHistogram::BucketIndex(~((uint64_t) 0)) == MetricsHistogram::bucketCount - 1);
+static_assert(MetricsHistogram::BucketUpperBound(MetricsHistogram::bucketCount - 1) == ~((uint64_t) 0));
+static_assert(MetricsHistogram::BucketsUpTo(0) == 1);
+static_assert(MetricsHistogram::BucketsUpTo(3) == 4);
+static_assert(MetricsHistogram::BucketsUpTo(8) == 8);
+static_assert(MetricsHistogram::BucketsUpTo(9) == 9);
+static_assert(MetricsHistogram::BucketsUpTo(1024) == MetricsHistogram::BucketIndex(1023) + 1);
+static_assert(MetricsHistogram::BucketsUpTo(~((uint64_t) 0)) == MetricsHistogram::bucketCount);
+
+static std::mutex metricsShardMtx{};
+static std::vector<size_t> metricsFreeShards{};
+static size_t metricsNextShard{0};
+
+struct MetricsShardOwner {
+    size_t shard{metricsSharedShard};
+    ~MetricsShardOwner() {
+        if (shard != metricsSharedShard) {
+            metricsThreadShard = metricsSharedShard;
+            std::lock_guard lock{metricsShardMtx};
+            metricsFreeShards.emplace_back(shard);
+        }
+    }
+};
+
+static thread_local MetricsShardOwner metricsShardOwner{};
+
+size_t MetricsAssignShard() {
+    size_t shard{metricsSharedShard};
+    {
+        std::lock_guard lock{metricsShardMtx};
+        if (!metricsFreeShards.empty()) {
+            shard = metricsFreeShards.back();
+            metricsFreeShards.pop_back();
+        } else if (metricsNextShard < metricsSharedShard) {
+            shard = metricsNextShard++;
+        }
+    }
+    metricsShardOwner.shard = shard;
+    metricsThreadShard = shard;
+    return shard;
+}
+
+uint64_t MetricsCounter::Get() const {
+    uint64_t sum{0};
+    for (const auto &shard : shards) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+int64_t MetricsGauge::Get() const {
+    int64_t sum{0};
+    for (const auto &shard : shards) {
+        sum += shard.value.load(std::memory_order_relaxed);
+    }
+    return sum;
+}
+
+uint64_t MetricsHistogramSnapshot::Percentile(double percentile) const {
+    if (count == 0) {
+        return 0;
+    }
+    auto rank = (uint64_t) (percentile * count);
+    if (rank >= count) {
+        rank = count - 1;
+    }
+    uint64_t seen{0};
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen > rank) {
+            return MetricsHistogram::BucketUpperBound(i);
+        }
+    }
+    return MetricsHistogram::BucketUpperBound(buckets.size() - 1);
+}
+
+MetricsHistogramSnapshot MetricsHistogram::Snapshot() const {
+    MetricsHistogramSnapshot snapshot{};
+    snapshot.buckets.resize(bucketCount);
+    for (const auto &shard : *shards) {
+        for (size_t i = 0; i < bucketCount; i++) {
+            auto value = shard.buckets[i].load(std::memory_order_relaxed);
+            snapshot.buckets[i] += value;
+            snapshot.count += value;
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+void MetricsRegistry::Add(const std::string &name, const std::string &help, const std::string &labels, const std::shared_ptr<const MetricsCounter> &counter) {
+    std::lock_guard lock{mtx};
+    entries.emplace_back(Entry{.name = name, .help = help, .labels = labels, .type = MetricsType::COUNTER, .counter = counter});
+}
+
+void MetricsRegistry::Add(const std::string &name, const std::string &help, const std::string &labels, const std::shared_ptr<const MetricsGauge> &gauge) {
+    std::lock_guard lock{mtx};
+    entries.emplace_back(Entry{.name = name, .help = help, .labels = labels, .type = MetricsType::GAUGE, .gauge = gauge});
+}
+
+std::vector<uint64_t> MetricsHistogramDefaultBounds() {
+    std::vector<uint64_t> bounds{};
+    for (unsigned int exponent = 0; exponent < 64; exponent += 2) {
+        bounds.emplace_back(((uint64_t) 1) << exponent);
+    }
+    return bounds;
+}
+
+void MetricsRegistry::Add(const std::string &name, const std::string &help, const std::string &labels, const std::shared_ptr<const MetricsHistogram> &histogram, double scale, const std::vector<uint64_t> &bounds) {
+    std::vector<uint64_t> sortedBounds{bounds};
+    std::sort(sortedBounds.begin(), sortedBounds.end());
+    sortedBounds.erase(std::unique(sortedBounds.begin(), sortedBounds.end()), sortedBounds.end());
+    std::lock_guard lock{mtx};
+    entries.emplace_back(Entry{.name = name, .help = help, .labels = labels, .type = MetricsType::HISTOGRAM, .histogram = histogram, .scale = scale, .bounds = std::move(sortedBounds)});
+}
+
+std::vector<MetricsValue> MetricsRegistry::Snapshot() {
+    std::vector<MetricsValue> values{};
+    std::lock_guard lock{mtx};
+    values.reserve(entries.size());
+    for (const auto &entry : entries) {
+        auto &value = values.emplace_back(MetricsValue{.name = entry.name, .labels = entry.labels, .type = entry.type});
+        switch (entry.type) {
+            case MetricsType::COUNTER:
+                value.value = (double) entry.counter->Get();
+                break;
+            case MetricsType::GAUGE:
+                value.value = (double) entry.gauge->Get();
+                break;
+            case MetricsType::HISTOGRAM:
+                value.histogram = entry.histogram->Snapshot();
+                value.value = (double) value.histogram.count;
+                break;
+        }
+    }
+    return values;
+}
+
+static void AppendNumber(std::string &output, double value) {
+    char buf[32];
+    auto result = std::to_chars(buf, buf + sizeof(buf), value);
+    output.append(buf, result.ptr);
+}
+
+static void AppendSample(std::string &output, const std::string &name, std::string_view suffix, const std::string &labels, std::string_view extraLabel, double value) {
+    output.append(name);
+    output.append(suffix);
+    if (!labels.empty() || !extraLabel.empty()) {
+        output.append("{");
+        output.append(labels);
+        if (!labels.empty() && !extraLabel.empty()) {
+            output.append(",");
+        }
+        output.append(extraLabel);
+        output.append("}");
+    }
+    output.append(" ");
+    AppendNumber(output, value);
+    output.append("\n");
+}
+
+std::string MetricsRegistry::PrometheusText() {
+    std::string output{};
+    std::lock_guard lock{mtx};
+    for (size_t i = 0; i < entries.size(); i++) {
+        const auto &entry = entries[i];
+        bool first = i == 0 || entries[i - 1].name != entry.name;
+        if (first) {
+            output.append("# HELP ");
+            output.append(entry.name);
+            output.append(" ");
+            output.append(entry.help);
+            output.append("\n# TYPE ");
+            output.append(entry.name);
+            output.append(entry.type == MetricsType::COUNTER ? " counter\n" : entry.type == MetricsType::GAUGE ? " gauge\n" : " histogram\n");
+        }
+        switch (entry.type) {
+            case MetricsType::COUNTER:
+                AppendSample(output, entry.name, "", entry.labels, "", (double) entry.counter->Get());
+                break;
+            case MetricsType::GAUGE:
+                AppendSample(output, entry.name, "", entry.labels, "", (double) entry.gauge->Get());
+                break;
+            case MetricsType::HISTOGRAM: {
+                auto snapshot = entry.histogram->Snapshot();
+                /*
+                 * The same le bounds are exposed on every scrape, so that the set of series
+                 * does not change, each counting the fine buckets up to it.
+                 */
+                uint64_t cumulative{0};
+                size_t bucket{0};
+                for (auto bound : entry.bounds) {
+                    auto end = MetricsHistogram::BucketsUpTo(bound);
+                    for (; bucket < end; bucket++) {
+                        cumulative += snapshot.buckets[bucket];
+                    }
+                    std::string le{"le=\""};
+                    AppendNumber(le, (double) bound * entry.scale);
+                    le.append("\"");
+                    AppendSample(output, entry.name, "_bucket", entry.labels, le, (double) cumulative);
+                }
+                AppendSample(output, entry.name, "_bucket", entry.labels, "le=\"+Inf\"", (double) snapshot.count);
+                AppendSample(output, entry.name, "_sum", entry.labels, "", (double) snapshot.sum * entry.scale);
+                AppendSample(output, entry.name, "_count", entry.labels, "", (double) snapshot.count);
+            }
+                break;
+        }
+    }
+    return output;
+}
@@ -0,0 +1,185 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_METRICS_H
+#define LIBHTTPTOOLING_METRICS_H
+
+#include <atomic>
+#include <array>
+#include <bit>
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+constexpr size_t metricsShards = 32;
+constexpr size_t metricsSharedShard = metricsShards - 1;
+constexpr size_t metricsCacheLine = 64;
+
+size_t MetricsAssignShard();
+
+inline thread_local size_t metricsThreadShard{metricsShards};
+
+inline size_t MetricsShard() {
+    auto shard = metricsThreadShard;
+    if (shard >= metricsShards) [[unlikely]] {
+        shard = MetricsAssignShard();
+    }
+    return shard;
+}
+
+/*
+ * Threads own a shard each until they exit, so the owner can update it with a plain
+ * load and store. Threads beyond the number of shards share the last shard and use
+ * atomic increments.
+ */
+template <typename T> inline void MetricsShardAdd(std::atomic<T> &value, T n, size_t shard) {
+    if (shard != metricsSharedShard) [[likely]] {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    } else {
+        value.fetch_add(n, std::memory_order_relaxed);
+    }
+}
+
+class MetricsCounter {
+private:
+    struct alignas(metricsCacheLine) Shard {
+        std::atomic<uint64_t> value{0};
+    };
+    std::array<Shard,metricsShards> shards{};
+public:
+    void Add(uint64_t n = 1) {
+        auto shard = MetricsShard();
+        MetricsShardAdd(shards[shard].value, n, shard);
+    }
+    uint64_t Get() const;
+};
+
+/*
+ * Gauges are sharded like counters and only support relative updates. The value is the
+ * sum of all shards, so a thread may decrement what another thread incremented.
+ */
+class MetricsGauge {
+private:
+    struct alignas(metricsCacheLine) Shard {
+        std::atomic<int64_t> value{0};
+    };
+    std::array<Shard,metricsShards> shards{};
+public:
+    void Add(int64_t n) {
+        auto shard = MetricsShard();
+        MetricsShardAdd(shards[shard].value, n, shard);
+    }
+    int64_t Get() const;
+};
+
+struct MetricsHistogramSnapshot {
+    std::vector<uint64_t> buckets{};
+    uint64_t count{0};
+    uint64_t sum{0};
+    uint64_t Percentile(double percentile) const;
+};
+
+/*
+ * Log-linear histogram: each power of two is split into 2^subBucketBits linear buckets,
+ * which bounds the relative error of a bucket to 25%.
+ */
+class MetricsHistogram {
+public:
+    static constexpr unsigned int subBucketBits = 2;
+    static constexpr size_t subBuckets = 1 << subBucketBits;
+    static constexpr size_t bucketCount = subBuckets + (64 - subBucketBits) * subBuckets;
+    static constexpr size_t BucketIndex(uint64_t value) {
+        if (value < subBuckets) {
+            return value;
+        }
+        unsigned int exponent = std::bit_width(value) - 1;
+        auto sub = (value >> (exponent - subBucketBits)) & (subBuckets - 1);
+        return subBuckets + ((exponent - subBucketBits) * subBuckets) + sub;
+    }
+    static constexpr uint64_t BucketUpperBound(size_t index) {
+        if (index < subBuckets) {
+            return index;
+        }
+        auto exponent = ((index - subBuckets) / subBuckets) + subBucketBits;
+        auto sub = (index - subBuckets) % subBuckets;
+        auto lower = (((uint64_t) 1) << exponent) + (sub << (exponent - subBucketBits));
+        return lower + (((uint64_t) 1) << (exponent - subBucketBits)) - 1;
+    }
+private:
+    struct alignas(metricsCacheLine) Shard {
+        std::array<std::atomic<uint64_t>,bucketCount> buckets{};
+        std::atomic<uint64_t> sum{0};
+    };
+    std::unique_ptr<std::array<Shard,metricsShards>> shards{new std::array<Shard,metricsShards>()};
+public:
+    void Record(uint64_t value) {
+        auto index = MetricsShard();
+        auto &shard = (*shards)[index];
+        MetricsShardAdd(shard.buckets[BucketIndex(value)], (uint64_t) 1, index);
+        MetricsShardAdd(shard.sum, value, index);
+    }
+    MetricsHistogramSnapshot Snapshot() const;
+    /*
+     * The number of buckets that only hold values up to bound. Values are integers, so
+     * a power of two as bound counts the values below it.
+     */
+    static constexpr size_t BucketsUpTo(uint64_t bound) {
+        auto index = BucketIndex(bound);
+        return BucketUpperBound(index) == bound ? index + 1 : index;
+    }
+};
+
+/*
+ * Powers of two up to 2^62, every other one, the le bounds exported for histograms that
+ * have not been given their own.
+ */
+std::vector<uint64_t> MetricsHistogramDefaultBounds();
+
+enum class MetricsType {
+    COUNTER,
+    GAUGE,
+    HISTOGRAM
+};
+
+struct MetricsValue {
+    std::string name{};
+    std::string labels{};
+    MetricsType type{MetricsType::COUNTER};
+    double value{0};
+    MetricsHistogramSnapshot histogram{};
+};
+
+/*
+ * Registered metrics are pulled with Snapshot() or rendered in the Prometheus text
+ * exposition format. Histogram values are multiplied by scale on output, e.g. 1e-9
+ * to expose nanosecond measurements as seconds. The fine buckets of a histogram are
+ * only kept for Snapshot(), the text exposition has a fixed le bucket for each of the
+ * bounds given at registration, in recorded units.
+ */
+class MetricsRegistry {
+private:
+    struct Entry {
+        std::string name{};
+        std::string help{};
+        std::string labels{};
+        MetricsType type{MetricsType::COUNTER};
+        std::shared_ptr<const MetricsCounter> counter{};
+        std::shared_ptr<const MetricsGauge> gauge{};
+        std::shared_ptr<const MetricsHistogram> histogram{};
+        double scale{1.0};
+        std::vector<uint64_t> bounds{};
+    };
+    std::mutex mtx{};
+    std::vector<Entry> entries{};
+public:
+    void Add(const std::string &name, const std::string &help, const std::string &labels, const std::shared_ptr<const MetricsCounter> &counter);
+    void Add(const std::string &name, const std::string &help, const std::string &labels, const std::shared_ptr<const MetricsGauge> &gauge);
+    void Add(const std::string &name, const std::string &help, const std::string &labels, const std::shared_ptr<const MetricsHistogram> &histogram, double scale = 1.0, const std::vector<uint64_t> &bounds = MetricsHistogramDefaultBounds());
+    std::vector<MetricsValue> Snapshot();
+    std::string PrometheusText();
+};
+
+#endif //LIBHTTPTOOLING_METRICS_H
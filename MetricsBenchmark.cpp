@@ -0,0 +1,220 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "HttpServer.h"
+#include "HttpServerImpl.h"
+#include "HttpRouter.h"
+#include "HttpMetricsResponder.h"
+#include "Metrics.h"
+#include "NetwServer.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <time.h>
+}
+
+static task<void> Hello(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent("ok", "text/plain");
+    request->Respond(response);
+    co_return;
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static bool ReadResponse(int fd, std::string &input, std::string &body) {
+    std::string buf{};
+    buf.resize(65536);
+    while (true) {
+        auto headEnd = input.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            auto lengthPos = input.find("Content-Length: ");
+            size_t contentLength{0};
+            if (lengthPos != std::string::npos && lengthPos < headEnd) {
+                contentLength = std::stoul(input.substr(lengthPos + 16));
+            }
+            if (input.size() >= headEnd + 4 + contentLength) {
+                body = input.substr(headEnd + 4, contentLength);
+                input.erase(0, headEnd + 4 + contentLength);
+                return true;
+            }
+        }
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        input.append(buf.data(), rd);
+    }
+}
+
+static uint64_t RunConnection(int port, int depth, std::chrono::steady_clock::time_point until) {
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        return 0;
+    }
+    uint64_t responses{0};
+    std::string input{};
+    std::string body{};
+    std::string requests{};
+    for (int i = 0; i < depth; i++) {
+        requests.append("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    }
+    while (std::chrono::steady_clock::now() < until) {
+        if (write(fd, requests.data(), requests.size()) != (ssize_t) requests.size()) {
+            break;
+        }
+        for (int i = 0; i < depth && ReadResponse(fd, input, body); i++) {
+            ++responses;
+        }
+    }
+    close(fd);
+    return responses;
+}
+
+static double ThreadCpuSeconds(pthread_t thread) {
+    clockid_t clock{};
+    struct timespec ts{};
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+/*
+ * Replays the metric updates made for a request/response on a keep-alive connection
+ * with the given pipeline depth: the connection counters are updated once per read
+ * and write, the request counters once per request.
+ */
+static double MetricsNsPerRequest(size_t iterations, int threads, int depth) {
+    NetwServerMetrics netwMetrics{};
+    HttpServerMetrics httpMetrics{};
+    std::vector<double> cpu{};
+    cpu.resize(threads);
+    std::vector<std::thread> workers{};
+    for (int t = 0; t < threads; t++) {
+        workers.emplace_back([&netwMetrics, &httpMetrics, &cpu, t, iterations, depth] () {
+            auto start = ThreadCpuSeconds(pthread_self());
+            uint32_t sampleCount{0};
+            for (size_t i = 0; i < iterations; i++) {
+                if ((i % depth) == 0) {
+                    netwMetrics.pollWakeups->Add();
+                    netwMetrics.bytesRead->Add(40 * depth);
+                    netwMetrics.bytesWritten->Add(90 * depth);
+                }
+                std::chrono::steady_clock::time_point received{};
+                if (++sampleCount >= httpMetrics.latencySampleInterval) {
+                    sampleCount = 0;
+                    received = std::chrono::steady_clock::now();
+                }
+                httpMetrics.requestsInProgress->Add(1);
+                httpMetrics.RecordResponse(200, received);
+                httpMetrics.requestsInProgress->Add(-1);
+            }
+            cpu[t] = ThreadCpuSeconds(pthread_self()) - start;
+        });
+    }
+    for (auto &worker : workers) {
+        worker.join();
+    }
+    double total{0};
+    for (auto seconds : cpu) {
+        total += seconds;
+    }
+    return (total * 1e9) / (iterations * threads);
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8092;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    constexpr int connections = 4;
+    constexpr int depth = 8;
+
+    auto singleThread = MetricsNsPerRequest(4000000, 1, depth);
+    auto multiThread = MetricsNsPerRequest(4000000, 4, depth);
+    auto perRequest = singleThread > multiThread ? singleThread : multiThread;
+    std::cout << "metrics per request: " << singleThread << " ns (1 thread), " << multiThread << " ns (4 threads)\n";
+
+    auto server = HttpServer::Create(port);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/hello", Hello);
+    router->Add("GET", "/metrics", HttpMetricsResponder(server->GetMetrics()).GetRouteHandler());
+    server->SetRouter(router);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    auto serverCpuStart = ThreadCpuSeconds(serverThread.native_handle());
+    auto until = start + std::chrono::seconds(seconds);
+    std::vector<uint64_t> results{};
+    results.resize(connections);
+    std::vector<std::thread> clients{};
+    for (int i = 0; i < connections; i++) {
+        clients.emplace_back([&results, i, port, until] () {
+            results[i] = RunConnection(port, depth, until);
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    auto serverCpu = ThreadCpuSeconds(serverThread.native_handle()) - serverCpuStart;
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t responses{0};
+    for (auto result : results) {
+        responses += result;
+    }
+    auto rate = responses / elapsed;
+
+    bool failed{false};
+    {
+        int fd = ConnectLoopback(port);
+        std::string request{"GET /metrics HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+        std::string input{};
+        std::string body{};
+        if (fd < 0 || write(fd, request.data(), request.size()) != (ssize_t) request.size() || !ReadResponse(fd, input, body)) {
+            failed = true;
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+        std::string expected{"http_responses_total{code=\"2xx\"} "};
+        auto pos = body.find(expected);
+        if (pos == std::string::npos || std::stoull(body.substr(pos + expected.size())) < responses) {
+            std::cout << "Unexpected metrics output:\n" << body;
+            failed = true;
+        }
+    }
+    for (const auto &value : server->GetMetrics()->Snapshot()) {
+        if (value.type == MetricsType::HISTOGRAM) {
+            std::cout << value.name << ": p50 " << value.histogram.Percentile(0.5) << " ns, p99 " << value.histogram.Percentile(0.99) << " ns\n";
+        }
+    }
+    server->Stop();
+    serverThread.join();
+
+    auto serverNsPerRequest = (serverCpu * 1e9) / responses;
+    auto overhead = (perRequest / serverNsPerRequest) * 100.0;
+    std::cout << (uint64_t) rate << " req/s, " << serverNsPerRequest << " ns server cpu per request, metrics overhead " << overhead << "%\n";
+    return failed || overhead >= 1.0 ? 1 : 0;
+}
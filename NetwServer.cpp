@@ -5,9 +5,16 @@
 #include "NetwServer.h"
 #include "Poller.h"
 #include "include/sync_coroutine.h"
+#include "include/object_pool.h"
 #include <iostream>
+#include <thread>
+#include <algorithm>
 extern "C" {
 #include <unistd.h>
+#include <sys/uio.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
 }
 
 size_t NetwConnectionHandlerHandle::AcceptInput(const std::string &input) {
@@ -18,31 +25,404 @@ void NetwConnectionHandlerHandle::EndOfConnection() {
     handler->EndOfConnection();
 }
 
-NetwServer::NetwServer(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler) : outputBuffers(std::make_shared<NetwFdOutputStruct>()), netwProtocolHandler(netwProtocolHandler), poller(Poller::Create()) {
+bool NetwConnectionHandlerHandle::IsInputPaused() {
+    return handler->IsInputPaused();
+}
+
+void NetwConnectionHandlerHandle::OutputDrained() {
+    handler->OutputDrained();
+}
+
+void NetwConnectionHandlerHandle::Connected() {
+    handler->Connected();
+}
+
+bool NetwConnectionHandlerHandle::IsIdle() {
+    return handler->IsIdle();
+}
+
+size_t NetwConnectionHandlerHandle::MemoryUsage() {
+    return handler->MemoryUsage();
+}
+
+void NetwConnectionHandlerHandle::ReleaseIdleMemory() {
+    handler->ReleaseIdleMemory();
+}
+
+void NetwBufferPool::Take(std::string &buffer) {
+    if (buffers.empty()) {
+        return;
+    }
+    bytes->Add(-(int64_t) buffers.back().capacity());
+    buffer.swap(buffers.back());
+    buffers.pop_back();
+}
+
+void NetwBufferPool::Give(std::string &buffer) {
+    if (buffers.size() < netwBufferPoolMax && buffer.capacity() >= netwReadChunkMin && buffer.capacity() <= netwPooledBufferMax) {
+        buffer.clear();
+        bytes->Add((int64_t) buffer.capacity());
+        buffers.emplace_back(std::move(buffer));
+    }
+    std::string{}.swap(buffer);
+}
+
+void NetwClient::AppendOutput(const std::string &data) {
+    idleReleased = false;
+    if (zeroCopyThreshold > 0 && data.size() >= zeroCopyThreshold) {
+        outputQueue.emplace_back(NetwOutputSegment{.data = data, .file = {}, .zeroCopy = true});
+    } else if (outputQueue.empty()) {
+        outputBuffer.append(data);
+    } else if (!outputQueue.back().file.fd && !outputQueue.back().zeroCopy) {
+        outputQueue.back().data.append(data);
+    } else {
+        outputQueue.emplace_back(NetwOutputSegment{.data = data, .file = {}});
+    }
+}
+
+/*
+ * Takes over a chunk that gets a segment of its own, so a large body sent with
+ * MSG_ZEROCOPY is not copied on its way to the socket either.
+ */
+void NetwClient::AppendOutput(std::string &&data) {
+    if (zeroCopyThreshold > 0 && data.size() >= zeroCopyThreshold) {
+        idleReleased = false;
+        outputQueue.emplace_back(NetwOutputSegment{.data = std::move(data), .file = {}, .zeroCopy = true});
+    } else if (!outputQueue.empty() && (outputQueue.back().file.fd || outputQueue.back().zeroCopy)) {
+        idleReleased = false;
+        outputQueue.emplace_back(NetwOutputSegment{.data = std::move(data), .file = {}});
+    } else {
+        AppendOutput(data);
+    }
+}
+
+void NetwClient::AppendOutput(const FdFileRange &file) {
+    idleReleased = false;
+    if (file.fd && file.length > 0) {
+        outputQueue.emplace_back(NetwOutputSegment{.data = {}, .file = file});
+    }
+}
+
+constexpr size_t sendFileChunkSize = 512 * 1024;
+
+constexpr int writeOutputMaxSegments = 16;
+
+/*
+ * Reads until the socket is drained or the budget is spent, so a connection can not
+ * starve the others. A short read means the socket was drained. When a read fills the
+ * chunk, FIONREAD sizes the next read, and the chunk size is kept for the next wakeup.
+ * If the budget runs out first, readPending is set and the remaining input is read on
+ * the next loop iteration without waiting for a new readiness event. An error after
+ * some input was read is reported by that next read. An idle connection gets its input
+ * buffer from the pool.
+ */
+std::expected<size_t,FdError> NetwClient::ReadInput(size_t budget, NetwBufferPool &pool) {
+    size_t total{0};
+    readPending = false;
+    idleReleased = false;
+    if (inputBuffer.empty() && inputBuffer.capacity() < netwReadChunkMin) {
+        pool.Take(inputBuffer);
+    }
+    while (total < budget) {
+        auto size = readChunk < (budget - total) ? readChunk : budget - total;
+        auto offset = inputBuffer.size();
+        inputBuffer.resize(offset + size);
+        auto rdCount = fd.TryRead(inputBuffer, offset, size);
+        if (!rdCount) {
+            inputBuffer.resize(offset);
+            if (rdCount.error().IsWouldBlock()) {
+                return total;
+            }
+            if (total > 0) {
+                readPending = true;
+                return total;
+            }
+            return rdCount;
+        }
+        inputBuffer.resize(offset + *rdCount);
+        total += *rdCount;
+        if (*rdCount < size) {
+            if (*rdCount < (readChunk / 4) && readChunk > netwReadChunkMin) {
+                readChunk /= 2;
+            }
+            return total;
+        }
+        auto available = fd.ReadableBytes();
+        if (available == 0) {
+            return total;
+        }
+        if (available > readChunk) {
+            readChunk = available < netwReadChunkMax ? available : netwReadChunkMax;
+        }
+    }
+    readPending = true;
+    return total;
+}
+
+static size_t HeapCapacity(const std::string &str) {
+    return str.capacity() > std::string{}.capacity() ? str.capacity() : 0;
+}
+
+size_t NetwClient::MemoryUsage() const {
+    size_t bytes{sizeof(*this) + HeapCapacity(inputBuffer) + HeapCapacity(outputBuffer)};
+    for (const auto &segment : outputQueue) {
+        bytes += HeapCapacity(segment.data);
+    }
+    for (const auto &buffer : zeroCopyPending) {
+        bytes += HeapCapacity(buffer.data);
+    }
+    bytes += zeroCopyOutOfOrder.capacity() * sizeof(FdZeroCopyCompletion);
+    return bytes;
+}
+
+/*
+ * Only called with no buffered input or output. The read chunk starts over from the
+ * minimum, so the next request does not allocate for the largest earlier one.
+ */
+void NetwClient::ReleaseIdleBuffers(NetwBufferPool &pool) {
+    pool.Give(inputBuffer);
+    pool.Give(outputBuffer);
+    zeroCopyOutOfOrder.shrink_to_fit();
+    readChunk = netwReadChunkMin;
+    idleReleased = true;
+}
+
+void NetwServerMetrics::Register(MetricsRegistry &registry) const {
+    registry.Add("netw_connections_accepted_total", "Accepted connections", "", connectionsAccepted);
+    registry.Add("netw_connections_closed_total", "Closed connections", "", connectionsClosed);
+    registry.Add("netw_accept_errors_total", "Failed accepts other than aborted connections", "", acceptErrors);
+    registry.Add("netw_read_bytes_total", "Bytes read from connections", "", bytesRead);
+    registry.Add("netw_written_bytes_total", "Bytes written to connections", "", bytesWritten);
+    registry.Add("netw_poll_wakeups_total", "Poller wakeups of the connection loop", "", pollWakeups);
+    registry.Add("netw_zerocopy_completed_total", "Completed MSG_ZEROCOPY sends", "", zeroCopyCompleted);
+    registry.Add("netw_zerocopy_copied_total", "Completed MSG_ZEROCOPY sends where the kernel copied the data", "", zeroCopyCopied);
+    registry.Add("netw_connection_memory_bytes", "Buffer and handler memory held by open connections", "", connectionMemory);
+    registry.Add("netw_buffer_pool_bytes", "Buffer memory kept for reuse by connections", "", bufferPoolBytes);
+}
+
+/*
+ * Buffered output is written with a single writev() up to the next file or zero copy
+ * segment, which is then sent with sendfile() or MSG_ZEROCOPY. Would-block is reported
+ * as zero bytes written.
+ */
+std::expected<size_t,FdError> NetwClient::WriteOutput() {
+    if (outputBuffer.empty() && !outputQueue.empty() && outputQueue.front().zeroCopy) {
+        return WriteZeroCopy();
+    }
+    if (outputBuffer.empty() && !outputQueue.empty() && outputQueue.front().file.fd) {
+        auto &segment = outputQueue.front();
+        auto size = segment.file.length < sendFileChunkSize ? (size_t) segment.file.length : sendFileChunkSize;
+        auto wrCount = fd.TrySendFile(*(segment.file.fd), segment.file.offset, size);
+        if (!wrCount) {
+            if (wrCount.error().IsWouldBlock()) {
+                return 0;
+            }
+            return wrCount;
+        }
+        segment.file.length -= *wrCount;
+        if (segment.file.length == 0) {
+            outputQueue.pop_front();
+        }
+        return wrCount;
+    }
+    struct iovec iov[writeOutputMaxSegments];
+    int iovcnt{0};
+    if (!outputBuffer.empty()) {
+        iov[iovcnt++] = {.iov_base = outputBuffer.data(), .iov_len = outputBuffer.size()};
+    }
+    for (auto &segment : outputQueue) {
+        if (segment.file.fd || segment.zeroCopy || iovcnt >= writeOutputMaxSegments) {
+            break;
+        }
+        if (!segment.data.empty()) {
+            iov[iovcnt++] = {.iov_base = segment.data.data(), .iov_len = segment.data.size()};
+        }
+    }
+    auto wrCount = fd.TryWritev(iov, iovcnt);
+    if (!wrCount) {
+        if (wrCount.error().IsWouldBlock()) {
+            return 0;
+        }
+        return wrCount;
+    }
+    auto remaining = *wrCount;
+    if (!outputBuffer.empty()) {
+        auto consumed = remaining < outputBuffer.size() ? remaining : outputBuffer.size();
+        outputBuffer.erase(0, consumed);
+        remaining -= consumed;
+    }
+    while (!outputQueue.empty() && !outputQueue.front().file.fd && !outputQueue.front().zeroCopy) {
+        auto &data = outputQueue.front().data;
+        if (remaining < data.size()) {
+            data.erase(0, remaining);
+            break;
+        }
+        remaining -= data.size();
+        outputQueue.pop_front();
+    }
+    return wrCount;
+}
+
+/*
+ * When the kernel is out of memory for pinning pages the send fails with ENOBUFS, and
+ * that part is copied with a plain write instead. A segment that was sent with
+ * MSG_ZEROCOPY is kept until the completion of its last send has been reaped.
+ */
+std::expected<size_t,FdError> NetwClient::WriteZeroCopy() {
+    auto &segment = outputQueue.front();
+    auto *ptr = segment.data.data() + segment.offset;
+    auto size = segment.data.size() - segment.offset;
+    auto wrCount = fd.TrySendZeroCopy(ptr, size);
+    if (wrCount) {
+        segment.pinned = true;
+        segment.lastSend = zeroCopyNext++;
+    } else if (wrCount.error().err == ENOBUFS) {
+        struct iovec iov{.iov_base = ptr, .iov_len = size};
+        wrCount = fd.TryWritev(&iov, 1);
+    }
+    if (!wrCount) {
+        if (wrCount.error().IsWouldBlock()) {
+            return 0;
+        }
+        return wrCount;
+    }
+    segment.offset += *wrCount;
+    if (segment.offset >= segment.data.size()) {
+        if (segment.pinned) {
+            zeroCopyPending.emplace_back(NetwZeroCopyBuffer{.data = std::move(segment.data), .lastSend = segment.lastSend});
+        }
+        outputQueue.pop_front();
+    }
+    return wrCount;
+}
+
+/*
+ * Reads the completions from the error queue and releases the buffers whose sends have
+ * all completed. Returns the number of completed sends and how many of them the kernel
+ * copied.
+ */
+std::tuple<size_t,size_t> NetwClient::ReapZeroCopy() {
+    size_t completed{0};
+    size_t copied{0};
+    while (true) {
+        auto completion = fd.TryReadZeroCopyCompletion();
+        if (!completion) {
+            break;
+        }
+        size_t count = (size_t) (completion->last - completion->first) + 1;
+        completed += count;
+        if (completion->copied) {
+            copied += count;
+        }
+        zeroCopyOutOfOrder.emplace_back(*completion);
+        bool advanced{true};
+        while (advanced) {
+            advanced = false;
+            for (auto iterator = zeroCopyOutOfOrder.begin(); iterator != zeroCopyOutOfOrder.end(); ++iterator) {
+                if (iterator->first == zeroCopyDone) {
+                    zeroCopyDone = iterator->last + 1;
+                    zeroCopyOutOfOrder.erase(iterator);
+                    advanced = true;
+                    break;
+                }
+            }
+        }
+    }
+    while (!zeroCopyPending.empty() && (int32_t) (zeroCopyDone - zeroCopyPending.front().lastSend) > 0) {
+        zeroCopyPending.pop_front();
+    }
+    return {completed, copied};
+}
+
+NetwServer::NetwServer(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) : outputBuffers(std::make_shared<NetwFdOutputStruct>()), netwProtocolHandler(netwProtocolHandler), poller(Poller::Create()), socketOptions(socketOptions) {
     auto pipefds = Fd::Pipe(true, true);
-    commandInput = std::move(std::get<0>(pipefds));
-    commandMonitor = std::move(std::get<1>(pipefds));
+    commandInput = std::move(std::get<1>(pipefds));
+    commandMonitor = std::move(std::get<0>(pipefds));
     serverSocket = Fd::InetSocket();
+    socketOptions.ApplyListen(serverSocket);
     serverSocket.BindListen(port);
-    serverSocket.Listen(20);
+    serverSocket.Listen(socketOptions.backlog);
+    serverSocket.SetNonblocking();
+    inetListen = true;
+}
+
+NetwServer::NetwServer(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) : outputBuffers(std::make_shared<NetwFdOutputStruct>()), netwProtocolHandler(netwProtocolHandler), poller(Poller::Create()), socketOptions(socketOptions) {
+    auto pipefds = Fd::Pipe(true, true);
+    commandInput = std::move(std::get<1>(pipefds));
+    commandMonitor = std::move(std::get<0>(pipefds));
+}
+
+static void BindUnixReplacingStale(Fd &socket, const std::string &path) {
+    if (!path.starts_with('@')) {
+        struct stat st{};
+        if (lstat(path.c_str(), &st) == 0 && S_ISSOCK(st.st_mode)) {
+            unlink(path.c_str());
+        }
+    }
+    socket.BindUnix(path);
+}
+
+NetwServer::NetwServer(const std::string &unixPath, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) : outputBuffers(std::make_shared<NetwFdOutputStruct>()), netwProtocolHandler(netwProtocolHandler), poller(Poller::Create()), socketOptions(socketOptions) {
+    auto pipefds = Fd::Pipe(true, true);
+    commandInput = std::move(std::get<1>(pipefds));
+    commandMonitor = std::move(std::get<0>(pipefds));
+    serverSocket = Fd::UnixSocket();
+    socketOptions.ApplyUnix(serverSocket);
+    BindUnixReplacingStale(serverSocket, unixPath);
+    this->unixPath = unixPath;
+    serverSocket.Listen(socketOptions.backlog);
     serverSocket.SetNonblocking();
 }
 
-NetwServer::NetwServer(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler) : outputBuffers(std::make_shared<NetwFdOutputStruct>()), netwProtocolHandler(netwProtocolHandler), poller(Poller::Create()) {
+/*
+ * The listen socket keeps the options it was set up with by the previous owner.
+ */
+NetwServer::NetwServer(Fd &&listenSocket, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) : outputBuffers(std::make_shared<NetwFdOutputStruct>()), netwProtocolHandler(netwProtocolHandler), poller(Poller::Create()), socketOptions(socketOptions) {
     auto pipefds = Fd::Pipe(true, true);
-    commandInput = std::move(std::get<0>(pipefds));
-    commandMonitor = std::move(std::get<1>(pipefds));
+    commandInput = std::move(std::get<1>(pipefds));
+    commandMonitor = std::move(std::get<0>(pipefds));
+    serverSocket = std::move(listenSocket);
+    serverSocket.SetNonblocking();
+    inetListen = serverSocket.GetSocketDomain() != AF_UNIX;
+}
+
+static void UnlinkUnixPath(const std::string &path) {
+    if (!path.empty() && !path.starts_with('@')) {
+        unlink(path.c_str());
+    }
+}
+
+NetwServer::~NetwServer() {
+    UnlinkUnixPath(unixPath);
+    UnlinkUnixPath(handOffPath);
+}
+
+std::shared_ptr<NetwServer> NetwServer::Create(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) {
+    std::shared_ptr<NetwServer> server{new NetwServer(port, netwProtocolHandler, socketOptions)};
+    std::weak_ptr<NetwServer> weakPtr{server};
+    netwProtocolHandler->SetAssociatedNetwServer(weakPtr);
+    return server;
+}
+
+std::shared_ptr<NetwServer> NetwServer::CreateUnix(const std::string &unixPath, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) {
+    std::shared_ptr<NetwServer> server{new NetwServer(unixPath, netwProtocolHandler, socketOptions)};
+    std::weak_ptr<NetwServer> weakPtr{server};
+    netwProtocolHandler->SetAssociatedNetwServer(weakPtr);
+    return server;
 }
 
-std::shared_ptr<NetwServer> NetwServer::Create(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler) {
-    std::shared_ptr<NetwServer> server{new NetwServer(port, netwProtocolHandler)};
+std::shared_ptr<NetwServer> NetwServer::CreateHandOff(const std::string &handOffPath, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) {
+    auto handOff = Fd::UnixSocket();
+    handOff.ConnectUnix(handOffPath);
+    auto listenSocket = handOff.ReceiveDescriptor();
+    std::shared_ptr<NetwServer> server{new NetwServer(std::move(listenSocket), netwProtocolHandler, socketOptions)};
     std::weak_ptr<NetwServer> weakPtr{server};
     netwProtocolHandler->SetAssociatedNetwServer(weakPtr);
     return server;
 }
 
-std::shared_ptr<NetwServer> NetwServer::Create(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler) {
-    std::shared_ptr<NetwServer> server{new NetwServer(netwProtocolHandler)};
+std::shared_ptr<NetwServer> NetwServer::Create(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions) {
+    std::shared_ptr<NetwServer> server{new NetwServer(netwProtocolHandler, socketOptions)};
     std::weak_ptr<NetwServer> weakPtr{server};
     netwProtocolHandler->SetAssociatedNetwServer(weakPtr);
     return server;
@@ -54,51 +434,104 @@ void NetwServer::HandleCommand(Poller &poller, NetwFdOutputStruct &outputBuffers
         commandBuffer.erase(0, 1);
         if (ch == 'q') {
             quitCommandReceived = true;
+        } else if (ch == 'd') {
+            StartDrain(poller);
+        } else if (ch == 't') {
+            /* A timer was added that is due before the poll would time out, the next poll waits less */
         } else if (ch == 'w') {
-            std::vector<NetwFdOutput> buffers{};
+            /* Swapping keeps the capacity of both vectors, so queueing output does not allocate */
+            auto &buffers = commandOutputs;
             {
                 std::lock_guard lock{outputBuffers.mtx};
-                for (auto &buffer : outputBuffers.buffers) {
-                    buffers.emplace_back(std::move(buffer));
-                }
-                outputBuffers.buffers.clear();
+                std::swap(buffers, outputBuffers.buffers);
                 outputBuffers.signaled = false;
             }
-            for (auto &buffer : buffers) {
-                std::lock_guard lock{mtx};
-                auto iterator = clients.begin();
-                while (iterator != clients.end()) {
-                    auto &clientFd = *iterator;
-                    if (buffer.id == clientFd->id) {
-                        if (!buffer.chunk.empty()) {
-                            clientFd->outputBuffer.append(buffer.chunk);
-                        }
-                        bool closed{false};
-                        if (buffer.close) {
-                            if (!clientFd->outputBuffer.empty()) {
-                                clientFd->closeSocket = true;
-                            } else {
-                                poller.RemoveFd(clientFd->fd);
-                                iterator = clients.erase(iterator);
-                                break;
-                            }
+            auto &order = commandOutputOrder;
+            for (size_t i = 0; i < buffers.size(); i++) {
+                order.emplace_back(buffers[i].id, i);
+            }
+            std::sort(order.begin(), order.end());
+            size_t remainingIds{0};
+            for (size_t i = 0; i < order.size(); i++) {
+                if (i == 0 || order[i].first != order[i - 1].first) {
+                    ++remainingIds;
+                }
+            }
+            std::lock_guard lock{mtx};
+            auto iterator = clients.begin();
+            while (iterator != clients.end() && remainingIds > 0) {
+                auto &clientFd = *iterator;
+                auto clientBuffers = std::lower_bound(order.begin(), order.end(), std::make_pair(clientFd->id, (size_t) 0));
+                if (clientBuffers == order.end() || clientBuffers->first != clientFd->id) {
+                    ++iterator;
+                    continue;
+                }
+                --remainingIds;
+                bool erased{false};
+                for (; clientBuffers != order.end() && clientBuffers->first == clientFd->id; ++clientBuffers) {
+                    auto *buffer = &(buffers[clientBuffers->second]);
+                    if (!buffer->chunk.empty()) {
+                        clientFd->AppendOutput(std::move(buffer->chunk));
+                    }
+                    if (buffer->file.fd) {
+                        clientFd->AppendOutput(buffer->file);
+                    }
+                    if (buffer->close) {
+                        /* Output for a connection that never got established is dropped */
+                        if (!clientFd->IsDrained() && !clientFd->connecting) {
+                            clientFd->closeSocket = true;
+                        } else {
+                            iterator = EraseClient(poller, iterator);
+                            erased = true;
+                            break;
                         }
-                        poller.UpdateFd(clientFd->fd, true, !clientFd->outputBuffer.empty());
-                        break;
                     }
+                }
+                if (!erased) {
+                    poller.UpdateFd(clientFd->fd, !clientFd->handle.IsInputPaused(), clientFd->HasOutput());
                     ++iterator;
                 }
             }
+            buffers.clear();
+            order.clear();
         } else {
             std::cerr << "Invalid internal command: " << ch << "\n";
         }
     }
 }
 
+NetwConnectionHandler *NetwServer::CreateHandler(uint64_t id) {
+    int commandFd = commandInput;
+    std::shared_ptr<NetwFdOutputStruct> outputBuffers{this->outputBuffers};
+    auto queueOutput = [commandFd, outputBuffers] (NetwFdOutput &&buffer) {
+        bool signal{false};
+        {
+            std::lock_guard lock{outputBuffers->mtx};
+            outputBuffers->buffers.emplace_back(std::move(buffer));
+            signal = !outputBuffers->signaled;
+            if (signal) {
+                outputBuffers->signaled = true;
+            }
+        }
+        if (signal) {
+            write(commandFd, "w", 1);
+        }
+    };
+    return netwProtocolHandler->Create([id, queueOutput] (const std::string &output) {
+        queueOutput({.id = id, .chunk = output, .close = false});
+    }, [id, queueOutput] (const FdFileRange &file) {
+        queueOutput({.id = id, .chunk = {}, .close = false, .file = file});
+    }, [id, queueOutput] () {
+        queueOutput({.id = id, .chunk = {}, .close = true});
+    });
+}
+
 task<void> NetwServer::ConnectionAcceptReady(const std::shared_ptr<NetwServer> &selfptrIn) {
     std::shared_ptr<NetwServer> selfptr{selfptrIn};
-    func_task<void> accReadyTask{[selfptr] (const auto &cb) {
-        selfptr->acceptReadyCallback.emplace_back(cb);
+    /* The frame keeps the server alive, a raw pointer keeps the closure from allocating */
+    auto *self = selfptr.get();
+    func_task<void> accReadyTask{[self] (const auto &cb) {
+        self->acceptReadyCallback.emplace_back(cb);
     }};
     co_await accReadyTask;
     co_return;
@@ -109,49 +542,52 @@ static uint64_t netwClientId{0};
 task<void> NetwServer::ConnectionAcceptLoop(const std::shared_ptr<Poller> &pollerIn, const std::shared_ptr<NetwServer> &selfptrIn) {
     std::shared_ptr<Poller> poller{pollerIn};
     std::shared_ptr<NetwServer> selfptr{selfptrIn};
-    std::shared_ptr<NetwFdOutputStruct> outputBuffers{this->outputBuffers};
-    int commandFd = commandInput;
     while (!selfptr->quitAccepting) {
         co_await ConnectionAcceptReady(selfptr);
         if (selfptr->quitAccepting) {
             break;
         }
-        auto clientFd = serverSocket.Accept();
-        if (clientFd.IsValid()) {
-            uint64_t id{netwClientId++};
-            NetwClient cl{.id = id, .fd = std::move(clientFd), .inputBuffer = {}, .outputBuffer = {}, .handle = {netwProtocolHandler, netwProtocolHandler->Create([id, commandFd, outputBuffers] (const std::string &output) {
-                NetwFdOutput buffer{.id = id, .chunk = output, .close = false};
-                bool signal{false};
-                {
-                    std::lock_guard lock{outputBuffers->mtx};
-                    outputBuffers->buffers.emplace_back(std::move(buffer));
-                    signal = !outputBuffers->signaled;
-                    if (signal) {
-                        outputBuffers->signaled = true;
-                    }
-                }
-                if (signal) {
-                    write(commandFd, "w", 1);
+        if (selfptr->draining) {
+            continue;
+        }
+        std::vector<std::shared_ptr<NetwClient>> accepted{};
+        acceptPending = false;
+        while (true) {
+            if (accepted.size() >= acceptBatch) {
+                acceptPending = true;
+                break;
+            }
+            auto clientFd = serverSocket.TryAccept();
+            if (!clientFd) {
+                auto err = clientFd.error().err;
+                if (err == ECONNABORTED) {
+                    continue;
                 }
-            }, [id, commandFd, outputBuffers] () {
-                NetwFdOutput buffer{.id = id, .chunk = {}, .close = true};
-                bool signal{false};
-                {
-                    std::lock_guard lock{outputBuffers->mtx};
-                    outputBuffers->buffers.emplace_back(std::move(buffer));
-                    signal = !outputBuffers->signaled;
-                    if (signal) {
-                        outputBuffers->signaled = true;
+                if (!clientFd.error().IsWouldBlock()) {
+                    metrics->acceptErrors->Add();
+                    if (err == EMFILE || err == ENFILE || err == ENOBUFS || err == ENOMEM) {
+                        PauseAccepting(*poller);
                     }
                 }
-                if (signal) {
-                    write(commandFd, "w", 1);
-                }
-            })}};
-            std::lock_guard lock{mtx};
-            auto &fd = clients.emplace_back(std::make_shared<NetwClient>(std::move(cl)));
-            poller->AddFd(fd->fd, true, !fd->outputBuffer.empty(), true);
+                break;
+            }
+            uint64_t id{netwClientId++};
+            NetwClient cl{.id = id, .fd = std::move(*clientFd), .inputBuffer = {}, .outputBuffer = {}, .handle = {netwProtocolHandler, CreateHandler(id)}, .zeroCopyThreshold = inetListen ? socketOptions.zeroCopyThreshold : 0};
+            accepted.emplace_back(object_pool_make_shared<NetwClient>(std::move(cl)));
+        }
+        if (accepted.empty()) {
+            continue;
+        }
+        metrics->connectionsAccepted->Add(accepted.size());
+        std::vector<int> fds{};
+        fds.reserve(accepted.size());
+        std::lock_guard lock{mtx};
+        for (auto &client : accepted) {
+            fds.emplace_back(client->fd);
+            AccountMemory(*client);
+            clients.emplace_back(std::move(client));
         }
+        poller->AddFds(fds, true, false, true);
     }
     selfptr->quitPolling = true;
     co_return;
@@ -159,8 +595,9 @@ task<void> NetwServer::ConnectionAcceptLoop(const std::shared_ptr<Poller> &polle
 
 task<void> NetwServer::CommandReady(const std::shared_ptr<NetwServer> &selfptrIn) {
     std::shared_ptr<NetwServer> selfptr{selfptrIn};
-    func_task<void> cmdReadyTask{[selfptr] (const auto &cb) {
-        selfptr->commandReadyCallback.emplace_back(cb);
+    auto *self = selfptr.get();
+    func_task<void> cmdReadyTask{[self] (const auto &cb) {
+        self->commandReadyCallback.emplace_back(cb);
     }};
     co_await cmdReadyTask;
     co_return;
@@ -206,88 +643,128 @@ task<void> NetwServer::CommandReadLoop(const std::shared_ptr<Poller> &pollerIn,
 task<void> NetwServer::PollLoop(const std::shared_ptr<NetwServer> &selfptrIn, const std::shared_ptr<Poller> &pollerInc) {
     std::shared_ptr<NetwServer> selfptr{selfptrIn};
     std::shared_ptr<Poller> poller{pollerInc};
-    std::string buf{};
+    bool readPending{false};
     while (!quitPolling) {
-        auto result = co_await poller->Poll(10000);
+        uint64_t timeoutMs{readPending || acceptPending ? 0 : (uint64_t) 10000};
+        if (draining && !drainQuitSent && timeoutMs > 0) {
+            auto untilDeadline = std::chrono::duration_cast<std::chrono::milliseconds>(drainDeadline - std::chrono::steady_clock::now()).count() + 1;
+            timeoutMs = untilDeadline < 0 ? 0 : std::min(timeoutMs, (uint64_t) untilDeadline);
+        }
+        {
+            std::lock_guard lock{timerMtx};
+            auto now = std::chrono::steady_clock::now();
+            if (!timers.empty() && timeoutMs > 0) {
+                auto untilTimer = std::chrono::duration_cast<std::chrono::milliseconds>(timers.begin()->first.deadline - now).count() + 1;
+                timeoutMs = untilTimer < 0 ? 0 : std::min(timeoutMs, (uint64_t) untilTimer);
+            }
+            pollDeadline = now + std::chrono::milliseconds(timeoutMs);
+        }
+        auto result = co_await poller->Poll(timeoutMs);
+        if ((result == PollerResult::TIMEOUT || result == PollerResult::INTERRUPTED) && (readPending || acceptPending)) {
+            result = PollerResult::OK;
+        }
+        readPending = false;
+        metrics->pollWakeups->Add();
         switch (result) {
             case PollerResult::OK: {
                     auto cmdReadyTpl = poller->GetResults(commandMonitor);
                     auto cmdReady = std::get<0>(cmdReadyTpl) || std::get<2>(cmdReadyTpl);
                     if (cmdReady) {
-                        std::vector<std::function<void()>> cbs{};
-                        for (const auto &cb: commandReadyCallback) {
-                            cbs.emplace_back(cb);
-                        }
-                        commandReadyCallback.clear();
+                        auto &cbs = readyCallbacks;
+                        std::swap(cbs, commandReadyCallback);
                         for (const auto &cb: cbs) {
                             cb();
                         }
+                        cbs.clear();
+                    }
+                    if (handOffSocket.IsValid() && std::get<0>(poller->GetResults(handOffSocket))) {
+                        HandOff(*poller);
                     }
                     auto serverReadyTpl = poller->GetResults(serverSocket);
-                    auto serverReady = std::get<0>(serverReadyTpl) || std::get<2>(serverReadyTpl);
+                    auto serverReady = std::get<0>(serverReadyTpl) || std::get<2>(serverReadyTpl) || acceptPending;
                     if (serverReady) {
-                        std::vector<std::function<void()>> cbs{};
-                        for (const auto &cb: acceptReadyCallback) {
-                            cbs.emplace_back(cb);
-                        }
-                        acceptReadyCallback.clear();
+                        auto &cbs = readyCallbacks;
+                        std::swap(cbs, acceptReadyCallback);
                         for (const auto &cb: cbs) {
                             cb();
                         }
+                        cbs.clear();
                     }
-                    std::vector<std::shared_ptr<NetwClient>> updateInputClients{};
-                    std::vector<std::shared_ptr<NetwClient>> handleInputClients{};
-                    std::vector<std::shared_ptr<NetwClient>> handleEofClients{};
+                    auto &updateInputClients = pollUpdateClients;
+                    auto &handleInputClients = pollInputClients;
+                    auto &handleEofClients = pollEofClients;
+                    auto &drainedClients = pollDrainedClients;
+                    auto &connectedClients = pollConnectedClients;
                     {
                         std::lock_guard lock{mtx};
                         auto iterator = clients.begin();
                         while (iterator != clients.end()) {
                             auto &client = *iterator;
                             auto fdReadyTpl = poller->GetResults(client->fd);
-                            if (std::get<1>(fdReadyTpl)) {
-                                try {
-                                    auto wrCount = client->fd.Write(client->outputBuffer);
-                                    if (wrCount > 0) {
-                                        client->outputBuffer.erase(0, wrCount);
-                                    }
-                                    if (client->outputBuffer.empty() && client->closeSocket) {
-                                        poller->RemoveFd(client->fd);
-                                        iterator = clients.erase(iterator);
-                                        continue;
-                                    }
-                                } catch (const FdException &e) {
-                                    poller->RemoveFd(client->fd);
-                                    iterator = clients.erase(iterator);
+                            bool active{std::get<0>(fdReadyTpl) || std::get<1>(fdReadyTpl) || std::get<2>(fdReadyTpl) || client->readPending};
+                            bool errorReady{std::get<2>(fdReadyTpl)};
+                            if (errorReady && !client->zeroCopyPending.empty()) {
+                                auto zeroCopyReaped = client->ReapZeroCopy();
+                                /*
+                                 * Completions in the error queue raise the error flag too,
+                                 * that is not a reason to read a paused connection. A real
+                                 * error or hangup is still reported by the next poll.
+                                 */
+                                if (std::get<0>(zeroCopyReaped) > 0) {
+                                    errorReady = false;
+                                }
+                                metrics->zeroCopyCompleted->Add(std::get<0>(zeroCopyReaped));
+                                metrics->zeroCopyCopied->Add(std::get<1>(zeroCopyReaped));
+                                if (client->closeSocket && client->IsDrained()) {
+                                    iterator = EraseClient(*poller, iterator);
                                     continue;
                                 }
                             }
-                            if (std::get<0>(fdReadyTpl) || std::get<2>(fdReadyTpl)) {
-                                buf.resize(8192);
-                                try {
-                                    auto rdCount = client->fd.Read(buf);
-                                    if (rdCount > 0) {
-                                        buf.resize(rdCount);
-                                        client->inputBuffer.append(buf);
-                                    }
-                                } catch (const EofException &e) {
-                                    poller->RemoveFd(client->fd);
+                            if (std::get<1>(fdReadyTpl)) {
+                                auto wrCount = client->WriteOutput();
+                                if (!wrCount) {
+                                    /* Also a connection that could not be established */
                                     handleEofClients.emplace_back(client);
-                                    iterator = clients.erase(iterator);
+                                    iterator = EraseClient(*poller, iterator);
                                     continue;
-                                } catch (const FdException &e) {
-                                    poller->RemoveFd(client->fd);
+                                }
+                                metrics->bytesWritten->Add(*wrCount);
+                                if (client->connecting) {
+                                    client->connecting = false;
+                                    connectedClients.emplace_back(client);
+                                }
+                                if (client->closeSocket && client->IsDrained()) {
+                                    iterator = EraseClient(*poller, iterator);
+                                    continue;
+                                }
+                                if (!client->HasOutput()) {
+                                    drainedClients.emplace_back(client);
+                                }
+                            }
+                            if (((std::get<0>(fdReadyTpl) || client->readPending) && !client->handle.IsInputPaused()) || errorReady) {
+                                auto rdCount = client->ReadInput(readBudget, bufferPool);
+                                if (!rdCount) {
                                     handleEofClients.emplace_back(client);
-                                    iterator = clients.erase(iterator);
+                                    iterator = EraseClient(*poller, iterator);
                                     continue;
                                 }
+                                if (*rdCount > 0) {
+                                    metrics->bytesRead->Add(*rdCount);
+                                }
                             }
                             if (!client->inputBuffer.empty()) {
                                 handleInputClients.emplace_back(client);
+                                active = true;
+                            }
+                            if (active) {
+                                updateInputClients.emplace_back(client);
                             }
-                            updateInputClients.emplace_back(client);
                             ++iterator;
                         }
                     }
+                    for (const auto &client : connectedClients) {
+                        client->handle.Connected();
+                    }
                     for (const auto &client : handleInputClients) {
                         size_t consumed;
                         do {
@@ -297,95 +774,392 @@ task<void> NetwServer::PollLoop(const std::shared_ptr<NetwServer> &selfptrIn, co
                             }
                         } while (consumed > 0 && !client->inputBuffer.empty());
                     }
+                    for (const auto &client : drainedClients) {
+                        client->handle.OutputDrained();
+                    }
                     for (const auto &client : handleEofClients) {
-                        size_t consumed;
-                        do {
-                            consumed = client->handle.AcceptInput(client->inputBuffer);
-                            if (consumed > 0) {
-                                client->inputBuffer.erase(0, consumed);
-                            }
-                        } while (consumed > 0 && !client->inputBuffer.empty());
-                        client->handle.EndOfConnection();
+                        EndOfConnection(*client);
                     }
-                    std::lock_guard lock{mtx};
-                    for (const auto &client : updateInputClients) {
-                        poller->UpdateFd(client->fd, true, !client->outputBuffer.empty());
+                    /*
+                     * Only connections with events or buffered input can have changed
+                     * state, output queued by the handlers updates the fd when queued.
+                     */
+                    {
+                        std::lock_guard lock{mtx};
+                        for (const auto &client : updateInputClients) {
+                            if (client->closed) {
+                                continue;
+                            }
+                            auto inputPaused = client->handle.IsInputPaused();
+                            if (client->readPending && !inputPaused) {
+                                readPending = true;
+                            }
+                            poller->UpdateFd(client->fd, !inputPaused, client->HasOutput());
+                            if (!client->idleReleased && client->inputBuffer.empty() && client->IsDrained() && client->handle.IsIdle()) {
+                                client->ReleaseIdleBuffers(bufferPool);
+                                client->handle.ReleaseIdleMemory();
+                            }
+                            AccountMemory(*client);
+                        }
                     }
+                    updateInputClients.clear();
+                    handleInputClients.clear();
+                    handleEofClients.clear();
+                    drainedClients.clear();
+                    connectedClients.clear();
                 }
                 break;
             case PollerResult::TIMEOUT:
                 break;
             case PollerResult ::ERROR:
                 break;
+            case PollerResult::INTERRUPTED:
+                break;
             default:
                 std::cerr << "Poller error: Out in the woods\n";
         }
+        FireTimers();
+        if (draining) {
+            DrainConnections(*poller);
+        }
     }
     quitLoop = true;
+    poller->Stop();
 }
 
 void NetwServer::AddCommand(Poller &poller) const {
     poller.AddFd(commandMonitor, true, false, true);
 }
 
+std::vector<std::shared_ptr<NetwClient>>::iterator NetwServer::EraseClient(Poller &poller, std::vector<std::shared_ptr<NetwClient>>::iterator iterator) {
+    auto &client = *iterator;
+    poller.RemoveFd(client->fd);
+    client->closed = true;
+    metrics->connectionMemory->Add(-(int64_t) client->accountedMemory);
+    client->accountedMemory = 0;
+    metrics->connectionsClosed->Add();
+    return clients.erase(iterator);
+}
+
+/*
+ * Connections are accounted when accepted and after each loop iteration they were
+ * active in, the gauge is adjusted by the change since the last time.
+ */
+void NetwServer::AccountMemory(NetwClient &client) {
+    auto usage = client.MemoryUsage() + client.handle.MemoryUsage();
+    metrics->connectionMemory->Add((int64_t) usage - (int64_t) client.accountedMemory);
+    client.accountedMemory = usage;
+}
+
 void NetwServer::AddServerSocket(Poller &poller) const {
     poller.AddFd(serverSocket, true, false, true);
+    if (handOffSocket.IsValid()) {
+        poller.AddFd(handOffSocket, true, false, true);
+    }
+}
+
+/*
+ * The successor gets its own descriptor for the listen socket, so connections queued
+ * in the backlog are accepted by whichever process gets to them. This server stops
+ * accepting and drains. The successor owns a unix listen socket path from now on.
+ */
+void NetwServer::HandOff(Poller &poller) {
+    auto successor = handOffSocket.TryAccept();
+    if (!successor) {
+        return;
+    }
+    try {
+        successor->SendDescriptor(serverSocket);
+    } catch (const FdException &e) {
+        std::cerr << "Listen socket hand off failed: " << e.what() << "\n";
+        return;
+    }
+    unixPath = {};
+    drainTimeoutMs = handOffDrainTimeout.count();
+    StartDrain(poller);
+}
+
+void NetwServer::StartDrain(Poller &poller) {
+    if (draining) {
+        return;
+    }
+    draining = true;
+    drainDeadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(drainTimeoutMs.load());
+    acceptPending = false;
+    if (serverSocket.IsValid()) {
+        poller.RemoveFd(serverSocket);
+    }
+    if (handOffSocket.IsValid()) {
+        poller.RemoveFd(handOffSocket);
+        handOffSocket = {};
+        UnlinkUnixPath(handOffPath);
+        handOffPath = {};
+    }
+}
+
+/*
+ * Out of descriptors or memory, the connection stays in the backlog and the listen
+ * socket stays readable, so polling it would only spin. It is left out of the poll
+ * until the backoff has passed, when connections may have been closed.
+ */
+void NetwServer::PauseAccepting(Poller &poller) {
+    acceptPending = false;
+    poller.UpdateFd(serverSocket, false, false);
+    AddTimer(std::chrono::steady_clock::now() + netwAcceptErrorBackoff, [this] () {
+        auto poller = this->poller;
+        if (poller && !draining && serverSocket.IsValid()) {
+            poller->UpdateFd(serverSocket, true, false);
+        }
+    });
+}
+
+/*
+ * A response is idle in the handler when it has been handed to the output queue, so
+ * a connection is only closed when nothing is queued for it either. Past the deadline
+ * all connections are closed. With no connections left the server quits.
+ */
+void NetwServer::DrainConnections(Poller &poller) {
+    auto expired = std::chrono::steady_clock::now() >= drainDeadline;
+    auto &closedClients = drainClosedClients;
+    bool empty{false};
+    {
+        std::lock_guard lock{mtx};
+        auto iterator = clients.begin();
+        while (iterator != clients.end()) {
+            auto &client = *iterator;
+            bool close{expired};
+            if (!close && client->inputBuffer.empty() && client->IsDrained() && client->handle.IsIdle()) {
+                close = true;
+                std::lock_guard outputLock{outputBuffers->mtx};
+                for (const auto &buffer : outputBuffers->buffers) {
+                    if (buffer.id == client->id) {
+                        close = false;
+                        break;
+                    }
+                }
+            }
+            if (close) {
+                closedClients.emplace_back(client);
+                iterator = EraseClient(poller, iterator);
+                continue;
+            }
+            ++iterator;
+        }
+        empty = clients.empty();
+    }
+    /* The handlers are told like for a connection closed by the peer, which fails requests still pending */
+    for (const auto &client : closedClients) {
+        EndOfConnection(*client);
+    }
+    closedClients.clear();
+    if (empty && !drainQuitSent) {
+        drainQuitSent = true;
+        if (write(commandInput, "q", 1) != 1) {
+            std::cerr << "Internal command interface failure: drain quit not sent\n";
+        }
+    }
+}
+
+/*
+ * Input still buffered is given to the handler before it is told that the connection
+ * has ended.
+ */
+void NetwServer::EndOfConnection(NetwClient &client) {
+    size_t consumed;
+    do {
+        consumed = client.handle.AcceptInput(client.inputBuffer);
+        if (consumed > 0) {
+            client.inputBuffer.erase(0, consumed);
+        }
+    } while (consumed > 0 && !client.inputBuffer.empty());
+    client.handle.EndOfConnection();
 }
 
 int NetwServer::GetCommandFd() const {
     return commandInput;
 }
 
+/*
+ * The connection is established in the background, the handler is told when it is
+ * with Connected(), or gets EndOfConnection() if it fails.
+ */
 void NetwServer::Connect(const void *ipaddr_norder, size_t ipaddr_len, int port, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &setupConnection) {
     auto clientSocket = Fd::InetSocket();
+    socketOptions.ApplyConnection(clientSocket);
+    clientSocket.SetNonblocking();
     clientSocket.Connect(ipaddr_norder, ipaddr_len, port);
+    AddConnection(std::move(clientSocket), socketOptions.zeroCopyThreshold, requestData, setupConnection);
+}
+
+/*
+ * A unix domain socket connect does not complete in the background like a TCP one, it
+ * fails with would-block while the backlog of the listener is full. The connection is
+ * then kept out of the poller and the connect is tried again on a timer, backing off,
+ * until it completes or netwUnixConnectTimeout has passed. Either way the handler is
+ * told like for a TCP connection.
+ */
+void NetwServer::ConnectUnix(const std::string &path, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &setupConnection) {
+    auto clientSocket = Fd::UnixSocket();
+    socketOptions.ApplyUnix(clientSocket);
     clientSocket.SetNonblocking();
-    uint64_t id{netwClientId++};
-    int commandFd = commandInput;
-    std::shared_ptr<NetwFdOutputStruct> outputBuffers{this->outputBuffers};
-    auto handler = netwProtocolHandler->Create([id, commandFd, outputBuffers] (const std::string &output) {
-        NetwFdOutput buffer{.id = id, .chunk = output, .close = false};
-        bool signal{false};
-        {
-            std::lock_guard lock{outputBuffers->mtx};
-            outputBuffers->buffers.emplace_back(std::move(buffer));
-            signal = !outputBuffers->signaled;
-            if (signal) {
-                outputBuffers->signaled = true;
-            }
-        }
-        if (signal) {
-            write(commandFd, "w", 1);
+    auto connected = clientSocket.TryConnectUnix(path);
+    if (!connected && !connected.error().IsWouldBlock()) {
+        throw FdException("connect() failed", connected.error().err);
+    }
+    if (connected) {
+        AddConnection(std::move(clientSocket), 0, requestData, setupConnection);
+        return;
+    }
+    auto client = AddConnection(std::move(clientSocket), 0, requestData, setupConnection, path);
+    RetryConnectUnix(client, std::chrono::milliseconds(1), std::chrono::steady_clock::now() + netwUnixConnectTimeout);
+}
+
+void NetwServer::RetryConnectUnix(const std::shared_ptr<NetwClient> &client, std::chrono::milliseconds delay, std::chrono::steady_clock::time_point giveUp) {
+    std::weak_ptr<NetwClient> weakClient{client};
+    AddTimer(std::chrono::steady_clock::now() + delay, [this, weakClient, delay, giveUp] () {
+        auto client = weakClient.lock();
+        if (!client) {
+            return;
         }
-    }, [id, commandFd, outputBuffers] () {
-        NetwFdOutput buffer{.id = id, .chunk = {}, .close = true};
-        bool signal{false};
+        bool failed{false};
         {
-            std::lock_guard lock{outputBuffers->mtx};
-            outputBuffers->buffers.emplace_back(std::move(buffer));
-            signal = !outputBuffers->signaled;
-            if (signal) {
-                outputBuffers->signaled = true;
+            std::lock_guard lock{mtx};
+            if (client->closed) {
+                return;
+            }
+            auto connected = client->fd.TryConnectUnix(client->connectUnixPath);
+            if (connected) {
+                client->connectUnixPath = {};
+                if (poller) {
+                    poller->AddFd(client->fd, true, client->HasOutput(), true);
+                }
+                return;
+            }
+            if (!connected.error().IsWouldBlock() || std::chrono::steady_clock::now() + delay >= giveUp) {
+                auto iterator = std::find(clients.begin(), clients.end(), client);
+                if (iterator != clients.end() && poller) {
+                    EraseClient(*poller, iterator);
+                }
+                failed = true;
             }
         }
-        if (signal) {
-            write(commandFd, "w", 1);
+        if (failed) {
+            client->handle.EndOfConnection();
+            return;
         }
+        RetryConnectUnix(client, delay * 2 < netwUnixConnectRetryMax ? delay * 2 : netwUnixConnectRetryMax, giveUp);
     });
+}
+
+std::shared_ptr<NetwClient> NetwServer::AddConnection(Fd &&clientSocket, size_t zeroCopyThreshold, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &setupConnection, const std::string &connectUnixPath) {
+    clientSocket.SetNonblocking();
+    uint64_t id{netwClientId++};
+    int commandFd = commandInput;
+    auto handler = CreateHandler(id);
     try {
         setupConnection(handler);
     } catch (...) {
         netwProtocolHandler->Release(handler);
         throw;
     }
-    NetwClient cl{.id = id, .fd = std::move(clientSocket), .inputBuffer = {}, .outputBuffer = requestData, .handle = {netwProtocolHandler, handler}};
+    NetwClient cl{.id = id, .fd = std::move(clientSocket), .inputBuffer = {}, .outputBuffer = requestData, .handle = {netwProtocolHandler, handler}, .zeroCopyThreshold = zeroCopyThreshold};
+    cl.connecting = true;
+    cl.connectUnixPath = connectUnixPath;
     std::lock_guard lock{mtx};
-    auto &fd = clients.emplace_back(std::make_shared<NetwClient>(std::move(cl)));
+    auto &fd = clients.emplace_back(object_pool_make_shared<NetwClient>(std::move(cl)));
+    AccountMemory(*fd);
     auto poller = this->poller;
-    if (poller) {
-        poller->AddFd(fd->fd, true, !fd->outputBuffer.empty(), true);
+    if (poller && connectUnixPath.empty()) {
+        poller->AddFd(fd->fd, true, fd->HasOutput(), true);
         write(commandFd, "w", 1);
     }
+    return fd;
+}
+
+NetwTimer NetwServer::AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func) {
+    NetwTimer timer{};
+    bool wakeup{false};
+    {
+        std::lock_guard lock{timerMtx};
+        timer = {.deadline = deadline, .id = ++timerId};
+        timers.emplace(timer, func);
+        if (deadline < pollDeadline) {
+            pollDeadline = deadline;
+            wakeup = true;
+        }
+    }
+    if (wakeup) {
+        /* A full command pipe already wakes the poll loop */
+        if (write(commandInput, "t", 1) != 1 && errno != EAGAIN) {
+            std::cerr << "Internal command interface failure: timer wakeup not sent\n";
+        }
+    }
+    return timer;
+}
+
+void NetwServer::CancelTimer(const NetwTimer &timer) {
+    std::function<void ()> func{};
+    {
+        std::lock_guard lock{timerMtx};
+        auto iterator = timers.find(timer);
+        if (iterator == timers.end()) {
+            return;
+        }
+        std::swap(func, iterator->second);
+        timers.erase(iterator);
+    }
+}
+
+/*
+ * Runs the timers that are due, outside the lock so that they can add and cancel
+ * timers.
+ */
+void NetwServer::FireTimers() {
+    auto &expired = expiredTimers;
+    {
+        std::lock_guard lock{timerMtx};
+        auto now = std::chrono::steady_clock::now();
+        while (!timers.empty() && timers.begin()->first.deadline <= now) {
+            expired.emplace_back(std::move(timers.begin()->second));
+            timers.erase(timers.begin());
+        }
+    }
+    for (const auto &func : expired) {
+        func();
+    }
+    expired.clear();
+}
+
+void NetwServer::Post(const std::function<void()> &func) {
+    poller->Post(func);
+}
+
+void NetwServer::SetRunnerThreads(size_t threads) {
+    runnerThreads = threads > 0 ? threads : 1;
+}
+
+void NetwServer::SetReadBudget(size_t budget) {
+    readBudget = budget > netwReadChunkMin ? budget : netwReadChunkMin;
+}
+
+void NetwServer::SetAcceptBatch(size_t batch) {
+    acceptBatch = batch > 0 ? batch : 1;
+}
+
+void NetwServer::Drain(std::chrono::milliseconds timeout) {
+    drainTimeoutMs = timeout.count();
+    if (write(commandInput, "d", 1) != 1) {
+        std::cerr << "Internal command interface failure: drain not sent\n";
+    }
+}
+
+void NetwServer::EnableHandOff(const std::string &path, std::chrono::milliseconds drainTimeout) {
+    handOffSocket = Fd::UnixSocket();
+    BindUnixReplacingStale(handOffSocket, path);
+    handOffPath = path;
+    handOffSocket.Listen(16);
+    handOffSocket.SetNonblocking();
+    handOffDrainTimeout = drainTimeout;
 }
 
 void NetwServer::Run() {
@@ -398,8 +1172,24 @@ void NetwServer::Run() {
                 [shrptr, poller]() -> task<void> { return shrptr->ConnectionAcceptLoop(poller, shrptr); });
     }
     FireAndForget<task<void>>([shrptr, poller] () -> task<void> { return shrptr->CommandReadLoop(poller, shrptr); });
+    std::thread waitThread{[poller] () {
+        while (poller->Wait()) {
+        }
+    }};
+    std::vector<std::thread> runners{};
+    for (size_t i = 1; i < runnerThreads; i++) {
+        runners.emplace_back([shrptr, poller] () {
+            while (!shrptr->quitLoop) {
+                poller->Runner();
+            }
+        });
+    }
     FireAndForget<task<void>>([shrptr, poller] () -> task<void> { return shrptr->PollLoop(shrptr, poller); });
     while (!quitLoop) {
         poller->Runner();
     }
+    for (auto &runner : runners) {
+        runner.join();
+    }
+    waitThread.join();
 }
\ No newline at end of file
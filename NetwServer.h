@@ -7,8 +7,16 @@
 
 #include <memory>
 #include <mutex>
+#include <deque>
+#include <map>
+#include <atomic>
+#include <functional>
+#include <expected>
+#include <chrono>
 #include "include/task.h"
 #include "Fd.h"
+#include "Metrics.h"
+#include "NetwSocketOptions.h"
 
 class Poller;
 
@@ -17,6 +25,49 @@ public:
     virtual ~NetwConnectionHandler() = default;
     virtual size_t AcceptInput(const std::string &) = 0;
     virtual void EndOfConnection() = 0;
+    virtual bool IsInputPaused() {
+        return false;
+    }
+    /*
+     * Called on the loop when all output queued for the connection has been written
+     * to the socket, so that a producer can queue more without piling it up.
+     */
+    virtual void OutputDrained() {
+    }
+    /*
+     * Called on the loop when an outgoing connection has been established.
+     */
+    virtual void Connected() {
+    }
+    /*
+     * A draining server closes connections that are idle and have no buffered input
+     * or output left.
+     */
+    virtual bool IsIdle() {
+        return true;
+    }
+    /*
+     * Bytes held by the handler for the connection, including the handler itself. Used
+     * for the per connection memory accounting.
+     */
+    virtual size_t MemoryUsage() {
+        return 0;
+    }
+    /*
+     * Called when the connection has gone idle with no buffered input or output, to
+     * release memory kept from earlier requests.
+     */
+    virtual void ReleaseIdleMemory() {
+    }
+};
+
+/*
+ * A timer of the loop, identifies the timer to cancel.
+ */
+struct NetwTimer {
+    std::chrono::steady_clock::time_point deadline{};
+    uint64_t id{0};
+    auto operator <=>(const NetwTimer &) const = default;
 };
 
 class NetwServerInterface {
@@ -28,11 +79,21 @@ public:
     NetwServerInterface &operator =(NetwServerInterface &&) = delete;
     virtual ~NetwServerInterface() = default;
     virtual void Connect(const void *ipaddr_norder, size_t ipaddr_len, int port, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &) = 0;
+    virtual void ConnectUnix(const std::string &path, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &) = 0;
+    /*
+     * Calls func on the loop once the deadline has passed, unless the timer is
+     * cancelled first.
+     */
+    virtual NetwTimer AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func) = 0;
+    virtual void CancelTimer(const NetwTimer &timer) = 0;
 };
 
 class NetwProtocolHandler {
 public:
     virtual NetwConnectionHandler *Create(const std::function<void (const std::string &)> &output, const std::function<void ()> &close) = 0;
+    virtual NetwConnectionHandler *Create(const std::function<void (const std::string &)> &output, const std::function<void (const FdFileRange &)> & /* outputFile */, const std::function<void ()> &close) {
+        return Create(output, close);
+    }
     virtual void Release(NetwConnectionHandler *) = 0;
     virtual void SetAssociatedNetwServer(const std::weak_ptr<NetwServerInterface> &) = 0;
 };
@@ -70,6 +131,53 @@ public:
     }
     size_t AcceptInput(const std::string &input);
     void EndOfConnection();
+    bool IsInputPaused();
+    void OutputDrained();
+    void Connected();
+    bool IsIdle();
+    size_t MemoryUsage();
+    void ReleaseIdleMemory();
+};
+
+/*
+ * Zero copy segments are not appended to and are sent from offset, so the pages stay
+ * where they are while the kernel holds on to them.
+ */
+struct NetwOutputSegment {
+    std::string data{};
+    FdFileRange file{};
+    bool zeroCopy{false};
+    bool pinned{false};
+    size_t offset{0};
+    uint32_t lastSend{0};
+};
+
+struct NetwZeroCopyBuffer {
+    std::string data{};
+    uint32_t lastSend{0};
+};
+
+constexpr size_t netwReadChunkMin = 4096;
+constexpr size_t netwReadChunkMax = 256 * 1024;
+constexpr size_t netwDefaultReadBudget = 64 * 1024;
+constexpr size_t netwDefaultAcceptBatch = 64;
+constexpr size_t netwBufferPoolMax = 64;
+constexpr size_t netwPooledBufferMax = 64 * 1024;
+constexpr std::chrono::milliseconds netwUnixConnectRetryMax{100};
+constexpr std::chrono::milliseconds netwAcceptErrorBackoff{100};
+constexpr std::chrono::milliseconds netwUnixConnectTimeout{5000};
+
+/*
+ * Buffers released by idle connections are kept for the next connection that reads
+ * input, so keep-alive connections between requests do not hold on to buffer memory.
+ * At most netwBufferPoolMax buffers are kept, and larger buffers than
+ * netwPooledBufferMax are freed.
+ */
+struct NetwBufferPool {
+    std::vector<std::string> buffers{};
+    std::shared_ptr<MetricsGauge> bytes{std::make_shared<MetricsGauge>()};
+    void Take(std::string &buffer);
+    void Give(std::string &buffer);
 };
 
 struct NetwClient {
@@ -79,12 +187,56 @@ struct NetwClient {
     std::string outputBuffer;
     NetwConnectionHandlerHandle handle;
     bool closeSocket{false};
+    std::deque<NetwOutputSegment> outputQueue{};
+    size_t readChunk{netwReadChunkMin};
+    bool readPending{false};
+    size_t zeroCopyThreshold{0};
+    uint32_t zeroCopyNext{0};
+    uint32_t zeroCopyDone{0};
+    std::vector<FdZeroCopyCompletion> zeroCopyOutOfOrder{};
+    std::deque<NetwZeroCopyBuffer> zeroCopyPending{};
+    size_t accountedMemory{0};
+    bool idleReleased{false};
+    bool closed{false};
+    bool connecting{false};
+    /* Set while the connect is retried, the backlog of the listener was full */
+    std::string connectUnixPath{};
+    bool HasOutput() const {
+        return !outputBuffer.empty() || !outputQueue.empty();
+    }
+    bool IsDrained() const {
+        return !HasOutput() && zeroCopyPending.empty();
+    }
+    void AppendOutput(const std::string &data);
+    void AppendOutput(std::string &&data);
+    void AppendOutput(const FdFileRange &file);
+    std::expected<size_t,FdError> WriteOutput();
+    std::expected<size_t,FdError> WriteZeroCopy();
+    std::tuple<size_t,size_t> ReapZeroCopy();
+    std::expected<size_t,FdError> ReadInput(size_t budget, NetwBufferPool &pool);
+    size_t MemoryUsage() const;
+    void ReleaseIdleBuffers(NetwBufferPool &pool);
 };
 
 struct NetwFdOutput {
     uint64_t id{0};
     std::string chunk;
     bool close{false};
+    FdFileRange file{};
+};
+
+struct NetwServerMetrics {
+    std::shared_ptr<MetricsCounter> connectionsAccepted{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> connectionsClosed{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> acceptErrors{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> bytesRead{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> bytesWritten{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> pollWakeups{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> zeroCopyCompleted{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsCounter> zeroCopyCopied{std::make_shared<MetricsCounter>()};
+    std::shared_ptr<MetricsGauge> connectionMemory{std::make_shared<MetricsGauge>()};
+    std::shared_ptr<MetricsGauge> bufferPoolBytes{std::make_shared<MetricsGauge>()};
+    void Register(MetricsRegistry &registry) const;
 };
 
 struct NetwFdOutputStruct {
@@ -95,30 +247,72 @@ struct NetwFdOutputStruct {
 
 class NetwServer : public NetwServerInterface, public std::enable_shared_from_this<NetwServer> {
 private:
-    Fd commandInput, commandMonitor, serverSocket;
+    Fd commandInput, commandMonitor, serverSocket, handOffSocket;
     std::vector<std::shared_ptr<NetwClient>> clients{};
-    std::shared_ptr<NetwProtocolHandler> netwProtocolHandler{};
     std::shared_ptr<NetwFdOutputStruct> outputBuffers{};
+    std::shared_ptr<NetwProtocolHandler> netwProtocolHandler{};
     std::string commandBuffer;
+    std::vector<NetwFdOutput> commandOutputs{};
+    std::vector<std::pair<uint64_t,size_t>> commandOutputOrder{};
     std::vector<std::function<void ()>> acceptReadyCallback{};
     std::vector<std::function<void ()>> commandReadyCallback{};
+    std::vector<std::function<void ()>> readyCallbacks{};
+    std::vector<std::shared_ptr<NetwClient>> pollUpdateClients{};
+    std::vector<std::shared_ptr<NetwClient>> pollInputClients{};
+    std::vector<std::shared_ptr<NetwClient>> pollEofClients{};
+    std::vector<std::shared_ptr<NetwClient>> drainClosedClients{};
+    std::vector<std::shared_ptr<NetwClient>> pollDrainedClients{};
+    std::vector<std::shared_ptr<NetwClient>> pollConnectedClients{};
+    std::mutex timerMtx{};
+    std::map<NetwTimer,std::function<void ()>> timers{};
+    std::vector<std::function<void ()>> expiredTimers{};
+    std::chrono::steady_clock::time_point pollDeadline{};
+    uint64_t timerId{0};
     std::shared_ptr<Poller> poller{};
+    NetwSocketOptions socketOptions{};
+    std::string unixPath{};
+    std::string handOffPath{};
+    std::chrono::milliseconds handOffDrainTimeout{0};
+    std::atomic<int64_t> drainTimeoutMs{0};
+    std::chrono::steady_clock::time_point drainDeadline{};
+    std::shared_ptr<NetwServerMetrics> metrics{std::make_shared<NetwServerMetrics>()};
+    NetwBufferPool bufferPool{.buffers = {}, .bytes = metrics->bufferPoolBytes};
     std::mutex mtx{};
     bool quitCommandReceived{false};
     bool quitAccepting{false};
     bool quitPolling{false};
-    bool quitLoop{false};
+    std::atomic<bool> quitLoop{false};
+    size_t runnerThreads{1};
+    size_t readBudget{netwDefaultReadBudget};
+    size_t acceptBatch{netwDefaultAcceptBatch};
+    bool acceptPending{false};
+    bool inetListen{false};
+    bool draining{false};
+    bool drainQuitSent{false};
 protected:
     NetwServer() = delete;
-    NetwServer(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler);
-    NetwServer(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler);
+    NetwServer(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions);
+    NetwServer(const std::string &unixPath, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions);
+    NetwServer(Fd &&listenSocket, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions);
+    NetwServer(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions);
 public:
+    ~NetwServer();
     NetwServer(const NetwServer &) = delete;
     NetwServer(NetwServer &&) = delete;
     NetwServer &operator =(const NetwServer &) = delete;
     NetwServer &operator =(NetwServer &&) = delete;
-    static std::shared_ptr<NetwServer> Create(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler);
-    static std::shared_ptr<NetwServer> Create(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler);
+    static std::shared_ptr<NetwServer> Create(int port, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions = {});
+    /*
+     * Listens on a unix domain socket. A path starting with '@' is in the abstract
+     * namespace. A stale socket file at the path is replaced.
+     */
+    static std::shared_ptr<NetwServer> CreateUnix(const std::string &unixPath, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions = {});
+    /*
+     * Takes over the listen socket of a server that has enabled hand off at the unix
+     * socket path handOffPath.
+     */
+    static std::shared_ptr<NetwServer> CreateHandOff(const std::string &handOffPath, const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions = {});
+    static std::shared_ptr<NetwServer> Create(const std::shared_ptr<NetwProtocolHandler> &netwProtocolHandler, const NetwSocketOptions &socketOptions = {});
 private:
     void HandleCommand(Poller &poller, NetwFdOutputStruct &outputBuffers);
     task<void> ConnectionAcceptReady(const std::shared_ptr<NetwServer> &selfptrIn);
@@ -126,11 +320,47 @@ private:
     task<void> CommandReady(const std::shared_ptr<NetwServer> &selfptrIn);
     task<void> CommandReadLoop(const std::shared_ptr<Poller> &pollerIn, const std::shared_ptr<NetwServer> &selfptr);
     task<void> PollLoop(const std::shared_ptr<NetwServer> &selfptr, const std::shared_ptr<Poller> &pollerInc);
+    NetwConnectionHandler *CreateHandler(uint64_t id);
+    std::shared_ptr<NetwClient> AddConnection(Fd &&clientSocket, size_t zeroCopyThreshold, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &setupConnection, const std::string &connectUnixPath = {});
+    void RetryConnectUnix(const std::shared_ptr<NetwClient> &client, std::chrono::milliseconds delay, std::chrono::steady_clock::time_point giveUp);
     void AddCommand(Poller &) const;
     void AddServerSocket(Poller &) const;
+    std::vector<std::shared_ptr<NetwClient>>::iterator EraseClient(Poller &poller, std::vector<std::shared_ptr<NetwClient>>::iterator iterator);
+    void AccountMemory(NetwClient &client);
+    void HandOff(Poller &poller);
+    void StartDrain(Poller &poller);
+    void DrainConnections(Poller &poller);
+    void PauseAccepting(Poller &poller);
+    static void EndOfConnection(NetwClient &client);
+    void FireTimers();
 public:
     int GetCommandFd() const;
-    void Connect(const void *ipaddr_norder, size_t ipaddr_len, int port, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &);
+    std::shared_ptr<const NetwServerMetrics> GetMetrics() const {
+        return metrics;
+    }
+    void Connect(const void *ipaddr_norder, size_t ipaddr_len, int port, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &) override;
+    void ConnectUnix(const std::string &path, const std::string &requestData, const std::function<void (NetwConnectionHandler *)> &) override;
+    NetwTimer AddTimer(std::chrono::steady_clock::time_point deadline, const std::function<void ()> &func) override;
+    void CancelTimer(const NetwTimer &timer) override;
+    /*
+     * Posted work runs on the runner threads. With more than one runner thread it may
+     * run concurrently with the connection handlers.
+     */
+    void Post(const std::function<void ()> &func);
+    void SetRunnerThreads(size_t threads);
+    void SetReadBudget(size_t budget);
+    void SetAcceptBatch(size_t batch);
+    /*
+     * Stops accepting, lets in-flight and pipelined requests complete and closes the
+     * connections as they become idle. Run() returns when no connections are left, or
+     * at the deadline, where the remaining connections are closed.
+     */
+    void Drain(std::chrono::milliseconds timeout);
+    /*
+     * Must be called before Run(). A successor process connecting to the unix socket at
+     * path is passed the listen socket, and this server then drains with drainTimeout.
+     */
+    void EnableHandOff(const std::string &path, std::chrono::milliseconds drainTimeout);
     void Run();
 };
 
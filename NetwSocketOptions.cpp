@@ -0,0 +1,57 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include "NetwSocketOptions.h"
+#include "Fd.h"
+
+/*
+ * Applied before bind(). Linux copies the socket and TCP options of the listen socket
+ * to the accepted sockets, so accepting costs no extra setsockopt() calls.
+ */
+void NetwSocketOptions::ApplyListen(Fd &fd) const {
+    if (reuseAddress) {
+        fd.SetReuseAddress();
+    }
+    if (deferAcceptSeconds > 0) {
+        fd.SetDeferAccept(deferAcceptSeconds);
+    }
+    ApplyConnection(fd);
+}
+
+/*
+ * Applied before connect(), where the buffer sizes still affect the window scaling
+ * that is negotiated.
+ */
+void NetwSocketOptions::ApplyConnection(Fd &fd) const {
+    if (tcpNoDelay) {
+        fd.SetTcpNoDelay();
+    }
+    if (receiveBufferSize > 0) {
+        fd.SetReceiveBufferSize(receiveBufferSize);
+    }
+    if (sendBufferSize > 0) {
+        fd.SetSendBufferSize(sendBufferSize);
+    }
+    if (keepAlive) {
+        fd.SetKeepAlive(true, keepAliveIdleSeconds, keepAliveIntervalSeconds, keepAliveCount);
+    }
+    if (userTimeoutMs > 0) {
+        fd.SetUserTimeout(userTimeoutMs);
+    }
+    if (zeroCopyThreshold > 0) {
+        fd.SetZeroCopy();
+    }
+}
+
+/*
+ * Unix domain sockets only take the buffer sizes.
+ */
+void NetwSocketOptions::ApplyUnix(Fd &fd) const {
+    if (receiveBufferSize > 0) {
+        fd.SetReceiveBufferSize(receiveBufferSize);
+    }
+    if (sendBufferSize > 0) {
+        fd.SetSendBufferSize(sendBufferSize);
+    }
+}
@@ -0,0 +1,37 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_NETWSOCKETOPTIONS_H
+#define LIBHTTPTOOLING_NETWSOCKETOPTIONS_H
+
+#include <cstddef>
+
+class Fd;
+
+/*
+ * Options for listen sockets and connections. Zero leaves the kernel default in place,
+ * so the buffer sizes are autotuned unless set. The listen backlog is capped by the
+ * kernel at net.core.somaxconn. Output chunks of at least zeroCopyThreshold bytes are
+ * sent with MSG_ZEROCOPY on TCP connections, zero disables it. Pinning the pages only
+ * pays off for large chunks, in the order of 10 KB or more.
+ */
+struct NetwSocketOptions {
+    int backlog{4096};
+    bool reuseAddress{true};
+    bool tcpNoDelay{true};
+    int receiveBufferSize{0};
+    int sendBufferSize{0};
+    int deferAcceptSeconds{0};
+    bool keepAlive{true};
+    int keepAliveIdleSeconds{60};
+    int keepAliveIntervalSeconds{10};
+    int keepAliveCount{6};
+    unsigned int userTimeoutMs{0};
+    size_t zeroCopyThreshold{0};
+    void ApplyListen(Fd &fd) const;
+    void ApplyConnection(Fd &fd) const;
+    void ApplyUnix(Fd &fd) const;
+};
+
+#endif //LIBHTTPTOOLING_NETWSOCKETOPTIONS_H
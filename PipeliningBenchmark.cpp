@@ -0,0 +1,185 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "HttpServer.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+static std::shared_ptr<HttpServer> server{};
+static std::mutex workMtx{};
+static std::condition_variable workCond{};
+static std::deque<std::shared_ptr<HttpRequest>> workQueue{};
+static bool workStop{false};
+
+task<void> HttpServerLoop() {
+    while (true) {
+        auto req = co_await server->NextRequest();
+        {
+            std::lock_guard lock{workMtx};
+            workQueue.emplace_back(req);
+        }
+        workCond.notify_one();
+    }
+}
+
+static void Worker() {
+    while (true) {
+        std::shared_ptr<HttpRequest> req{};
+        {
+            std::unique_lock lock{workMtx};
+            workCond.wait(lock, [] () { return workStop || !workQueue.empty(); });
+            if (workQueue.empty()) {
+                return;
+            }
+            req = workQueue.front();
+            workQueue.pop_front();
+        }
+        auto response = std::make_shared<HttpResponse>(200, "OK");
+        response->SetContent(req->GetPath(), "text/plain");
+        req->Respond(response);
+    }
+}
+
+struct LoadResult {
+    uint64_t responses{0};
+    bool ordered{true};
+    bool failed{false};
+};
+
+static LoadResult RunConnection(int port, int depth, std::chrono::steady_clock::time_point until) {
+    LoadResult result{};
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        result.failed = true;
+        if (fd >= 0) {
+            close(fd);
+        }
+        return result;
+    }
+    uint64_t sent{0};
+    uint64_t received{0};
+    std::string input{};
+    std::string buf{};
+    while (std::chrono::steady_clock::now() < until) {
+        std::string requests{};
+        for (int i = 0; i < depth; i++) {
+            requests.append("GET /");
+            requests.append(std::to_string(sent++));
+            requests.append(" HTTP/1.1\r\nHost: localhost\r\n\r\n");
+        }
+        size_t offset{0};
+        while (offset < requests.size()) {
+            auto wr = write(fd, requests.data() + offset, requests.size() - offset);
+            if (wr <= 0) {
+                result.failed = true;
+                close(fd);
+                return result;
+            }
+            offset += wr;
+        }
+        while (received < sent) {
+            auto headEnd = input.find("\r\n\r\n");
+            if (headEnd != std::string::npos) {
+                auto lengthPos = input.find("Content-Length: ");
+                size_t contentLength{0};
+                if (lengthPos != std::string::npos && lengthPos < headEnd) {
+                    contentLength = std::stoul(input.substr(lengthPos + 16));
+                }
+                auto total = headEnd + 4 + contentLength;
+                if (input.size() >= total) {
+                    auto body = input.substr(headEnd + 4, contentLength);
+                    if (body != "/" + std::to_string(received)) {
+                        result.ordered = false;
+                    }
+                    input.erase(0, total);
+                    ++received;
+                    continue;
+                }
+            }
+            buf.resize(65536);
+            auto rd = read(fd, buf.data(), buf.size());
+            if (rd <= 0) {
+                result.failed = true;
+                close(fd);
+                return result;
+            }
+            input.append(buf.data(), rd);
+        }
+    }
+    close(fd);
+    result.responses = received;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8090;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    constexpr int connections = 4;
+    constexpr int workers = 4;
+    server = HttpServer::Create(port);
+    server->SetMaxPipelineDepth(64);
+    FireAndForget<task<void>>([] () { return HttpServerLoop(); });
+    std::vector<std::thread> workerThreads{};
+    for (int i = 0; i < workers; i++) {
+        workerThreads.emplace_back(Worker);
+    }
+    std::thread serverThread{[] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    bool failed{false};
+    for (int depth : {1, 8, 32}) {
+        auto start = std::chrono::steady_clock::now();
+        auto until = start + std::chrono::seconds(seconds);
+        std::vector<LoadResult> results{};
+        results.resize(connections);
+        std::vector<std::thread> clients{};
+        for (int i = 0; i < connections; i++) {
+            clients.emplace_back([&results, i, port, depth, until] () {
+                results[i] = RunConnection(port, depth, until);
+            });
+        }
+        for (auto &client : clients) {
+            client.join();
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t responses{0};
+        bool ordered{true};
+        for (const auto &result : results) {
+            responses += result.responses;
+            ordered = ordered && result.ordered;
+            failed = failed || result.failed;
+        }
+        std::cout << "depth " << depth << ": " << (uint64_t) (responses / elapsed) << " req/s over " << connections
+                  << " connections" << (ordered ? "" : " (OUT OF ORDER)") << "\n";
+        failed = failed || !ordered;
+    }
+    server->Stop();
+    serverThread.join();
+    {
+        std::lock_guard lock{workMtx};
+        workStop = true;
+    }
+    workCond.notify_all();
+    for (auto &worker : workerThreads) {
+        worker.join();
+    }
+    server = {};
+    return failed ? 1 : 0;
+}
@@ -11,11 +11,52 @@ constexpr decltype(std::declval<struct pollfd>().events) writeFlags = POLLOUT |
 constexpr decltype(std::declval<struct pollfd>().events) errFlagsRequest = POLLRDHUP;
 constexpr decltype(std::declval<struct pollfd>().revents) errFlagsReport = POLLERR | POLLHUP | POLLRDHUP | POLLNVAL;
 
+Poller::Poller() {
+    auto pipefds = Fd::Pipe(true, true);
+    wakeupMonitor = std::move(std::get<0>(pipefds));
+    wakeupInput = std::move(std::get<1>(pipefds));
+}
+
 std::shared_ptr<Poller> Poller::Create() {
     std::shared_ptr<Poller> shptr{new Poller()};
     return shptr;
 }
 
+void Poller::Interrupt() {
+    std::string signal{"i"};
+    try {
+        wakeupInput.Write(signal);
+    } catch (const FdException &e) {
+    }
+}
+
+/*
+ * pollfdIndex holds the position in pollfds plus one, zero when the fd is not added.
+ * Removal moves the last pollfd into the hole.
+ */
+void Poller::AddIndexed(const struct pollfd &pfd) {
+    if (pfd.fd < 0) {
+        return;
+    }
+    if ((size_t) pfd.fd >= pollfdIndex.size()) {
+        pollfdIndex.resize(pfd.fd + 1);
+    }
+    auto &index = pollfdIndex[pfd.fd];
+    if (index != 0) {
+        pollfds[index - 1] = pfd;
+        return;
+    }
+    pollfds.emplace_back(pfd);
+    index = pollfds.size();
+}
+
+struct pollfd *Poller::FindIndexed(int fd) {
+    if (fd < 0 || (size_t) fd >= pollfdIndex.size() || pollfdIndex[fd] == 0) {
+        return nullptr;
+    }
+    return &(pollfds[pollfdIndex[fd] - 1]);
+}
+
 void Poller::AddFd(int fd, bool read, bool write, bool err) {
     decltype(std::declval<struct pollfd>().events) flags = static_cast<decltype(std::declval<struct pollfd>().events)>((read ? readFlags : noFlags) | (write ? writeFlags : noFlags) | (err ? errFlagsRequest : noFlags));
     struct pollfd pfd {
@@ -23,45 +64,81 @@ void Poller::AddFd(int fd, bool read, bool write, bool err) {
         .events = flags,
         .revents = 0
     };
-    std::lock_guard lock{pollingMtx};
-    pollfds.emplace_back(pfd);
+    {
+        std::lock_guard lock{pollingMtx};
+        AddIndexed(pfd);
+    }
+    if (waiting) {
+        Interrupt();
+    }
+}
+
+void Poller::AddFds(const std::vector<int> &fds, bool read, bool write, bool err) {
+    if (fds.empty()) {
+        return;
+    }
+    decltype(std::declval<struct pollfd>().events) flags = static_cast<decltype(std::declval<struct pollfd>().events)>((read ? readFlags : noFlags) | (write ? writeFlags : noFlags) | (err ? errFlagsRequest : noFlags));
+    {
+        std::lock_guard lock{pollingMtx};
+        pollfds.reserve(pollfds.size() + fds.size());
+        for (auto fd : fds) {
+            AddIndexed(pollfd{.fd = fd, .events = flags, .revents = 0});
+        }
+    }
+    if (waiting) {
+        Interrupt();
+    }
 }
 
 void Poller::UpdateFd(int fd, bool read, bool write) {
-    std::lock_guard lock{pollingMtx};
-    for (auto &pfd : pollfds) {
-        if (pfd.fd == fd) {
+    {
+        std::lock_guard lock{pollingMtx};
+        auto *pfd = FindIndexed(fd);
+        if (pfd != nullptr) {
+            auto events = pfd->events;
+            /* A hang up is acted on by reading, so it is not polled for while reading is paused */
             if (read) {
-                pfd.events |= readFlags;
+                pfd->events |= readFlags | errFlagsRequest;
             } else {
-                pfd.events &= ~readFlags;
+                pfd->events &= ~(readFlags | errFlagsRequest);
             }
             if (write) {
-                pfd.events |= writeFlags;
+                pfd->events |= writeFlags;
             } else {
-                pfd.events &= ~writeFlags;
+                pfd->events &= ~writeFlags;
+            }
+            if (events == pfd->events) {
+                return;
             }
-            return;
         }
     }
+    if (waiting) {
+        Interrupt();
+    }
 }
 
 void Poller::RemoveFd(int fd) {
-    std::lock_guard lock{pollingMtx};
-    auto iterator = pollfds.begin();
-    while (iterator != pollfds.end()) {
-        const auto &pfd = *iterator;
-        if (pfd.fd == fd) {
-            iterator = pollfds.erase(iterator);
-            return;
+    {
+        std::lock_guard lock{pollingMtx};
+        if (FindIndexed(fd) != nullptr) {
+            auto position = pollfdIndex[fd] - 1;
+            pollfdIndex[fd] = 0;
+            if (position + 1 < pollfds.size()) {
+                pollfds[position] = pollfds.back();
+                pollfdIndex[pollfds[position].fd] = position + 1;
+            }
+            pollfds.pop_back();
         }
-        ++iterator;
+    }
+    if (waiting) {
+        Interrupt();
     }
 }
 
 void Poller::ClearFds() {
     std::lock_guard lock{pollingMtx};
     pollfds.clear();
+    pollfdIndex.clear();
 }
 
 std::tuple<bool, bool, bool> Poller::GetResults(int fd) {
@@ -74,72 +151,129 @@ std::tuple<bool, bool, bool> Poller::GetResults(int fd) {
     }
 }
 
+void PollerWait::await_suspend(std::coroutine_handle<> h) {
+    {
+        std::lock_guard lock{poller.waitMutex};
+        poller.pendingPoll = h;
+        poller.pendingResult = &result;
+        poller.pendingTimeoutMs = timeoutMs;
+    }
+    poller.waitCond.notify_one();
+}
+
 task<PollerResult> Poller::Poll(uint64_t timeoutMs) {
-    func_task<int> pollSyscall{[this, timeoutMs] (const auto &callback) {
-        {
-            auto selfptr = shared_from_this();
-            std::lock_guard lg{selfptr->runQueueMutex};
-            selfptr->runQueue.emplace_back([selfptr, timeoutMs, callback]() mutable {
-                sigset_t sigmask{};
-                sigprocmask(0, NULL, &sigmask);
-                uint64_t seconds = timeoutMs / 1000;
-                if (seconds > std::numeric_limits<time_t>::max()) {
-                    seconds = std::numeric_limits<time_t>::max();
-                }
-                uint64_t ns = timeoutMs % 1000;
-                ns *= 1000000;
-                struct timespec tm{.tv_sec = (time_t) seconds, .tv_nsec = (long) ns};
-                std::vector<pollfd> pollfds{};
-                {
-                    std::lock_guard lock{selfptr->pollingMtx};
-                    selfptr->results.clear();
-                    pollfds = selfptr->pollfds;
-                }
-                auto err = ppoll(pollfds.data(), pollfds.size(), &tm, &sigmask);
-                {
-                    std::lock_guard lock{selfptr->pollingMtx};
-                    if (err > 0) {
-                        for (const auto &fd: pollfds) {
-                            bool read = (fd.revents & readFlags) != 0;
-                            bool write = (fd.revents & writeFlags) != 0;
-                            bool err = (fd.revents & errFlagsReport) != 0;
-                            if (read || write || err) {
-                                auto tuple = std::make_tuple<bool, bool, bool>(read ? true : false,
-                                                                               write ? true : false,
-                                                                               err ? true : false);
-                                selfptr->results.insert_or_assign(fd.fd, tuple);
-                            }
-                        }
-                    }
-                }
-                selfptr = {};
-                callback(err);
-            });
-            selfptr = {};
+    PollerWait pollWait{.poller = *this, .timeoutMs = timeoutMs};
+    auto result = co_await pollWait;
+    co_return result;
+}
+
+bool Poller::Wait() {
+    std::coroutine_handle<> waiter{};
+    PollerResult *waiterResult;
+    uint64_t timeoutMs;
+    {
+        std::unique_lock lock{waitMutex};
+        waitCond.wait(lock, [this] () { return pendingPoll || stopped; });
+        if (!pendingPoll) {
+            return false;
         }
-        runQueueSemaphore.release();
-    }};
-    int err = co_await pollSyscall;
+        waiter = pendingPoll;
+        waiterResult = pendingResult;
+        pendingPoll = {};
+        timeoutMs = pendingTimeoutMs;
+    }
+    sigset_t sigmask{};
+    sigprocmask(0, NULL, &sigmask);
+    uint64_t seconds = timeoutMs / 1000;
+    if (seconds > std::numeric_limits<time_t>::max()) {
+        seconds = std::numeric_limits<time_t>::max();
+    }
+    uint64_t ns = timeoutMs % 1000;
+    ns *= 1000000;
+    struct timespec tm{.tv_sec = (time_t) seconds, .tv_nsec = (long) ns};
+    auto &pollfds = waitPollfds;
+    {
+        std::lock_guard lock{pollingMtx};
+        results.clear();
+        pollfds.reserve(this->pollfds.size() + 1);
+        pollfds = this->pollfds;
+        waiting = true;
+    }
+    pollfds.emplace_back(pollfd{.fd = wakeupMonitor, .events = readFlags, .revents = 0});
+    auto err = ppoll(pollfds.data(), pollfds.size(), &tm, &sigmask);
+    waiting = false;
+    PollerResult result{err > 0 ? PollerResult::OK : err == 0 ? PollerResult::TIMEOUT : PollerResult::ERROR};
     if (err > 0) {
-        co_return PollerResult::OK;
-    } else if (err == 0) {
-        co_return PollerResult::TIMEOUT;
-    } else {
-        co_return PollerResult::ERROR;
+        if (pollfds.back().revents != 0) {
+            auto &drain = wakeupDrain;
+            drain.resize(64);
+            try {
+                while (wakeupMonitor.Read(drain) == drain.size()) {
+                }
+            } catch (const FdException &e) {
+            }
+            if (err == 1) {
+                result = PollerResult::INTERRUPTED;
+            }
+        }
+        pollfds.pop_back();
+        std::lock_guard lock{pollingMtx};
+        for (const auto &fd: pollfds) {
+            bool read = (fd.revents & readFlags) != 0;
+            bool write = (fd.revents & writeFlags) != 0;
+            bool err = (fd.revents & errFlagsReport) != 0;
+            if (read || write || err) {
+                auto tuple = std::make_tuple<bool, bool, bool>(read ? true : false,
+                                                               write ? true : false,
+                                                               err ? true : false);
+                results.insert_or_assign(fd.fd, tuple);
+            }
+        }
+    }
+    *waiterResult = result;
+    Post([waiter] () {
+        waiter.resume();
+    });
+    return true;
+}
+
+void Poller::Post(const std::function<void ()> &func) {
+    {
+        std::lock_guard lock{runQueueMutex};
+        runQueue.emplace_back(func);
     }
+    runQueueCond.notify_one();
+}
+
+task<void> Poller::Schedule() {
+    auto selfptr = shared_from_this();
+    func_task<void> schedule{[selfptr] (const std::function<void ()> &callback) {
+        selfptr->Post(callback);
+    }};
+    co_await schedule;
 }
 
 void Poller::Runner() {
-    runQueueSemaphore.acquire();
-    std::vector<std::function<void ()>> runUnlocked{};
+    std::function<void ()> func{};
     {
-        std::lock_guard lg{runQueueMutex};
-        for (const auto &f: runQueue) {
-            runUnlocked.emplace_back(f);
+        std::unique_lock lock{runQueueMutex};
+        runQueueCond.wait(lock, [this] () { return !runQueue.empty() || stopped; });
+        if (runQueue.empty()) {
+            return;
         }
-        runQueue.clear();
+        func = std::move(runQueue.front());
+        runQueue.pop_front();
     }
-    for (const auto &f : runUnlocked) {
-        f();
+    func();
+}
+
+void Poller::Stop() {
+    {
+        std::lock_guard waitLock{waitMutex};
+        std::lock_guard runLock{runQueueMutex};
+        stopped = true;
     }
-}
\ No newline at end of file
+    waitCond.notify_all();
+    runQueueCond.notify_all();
+    Interrupt();
+}
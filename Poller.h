@@ -6,38 +6,89 @@
 #define LIBHTTPTOOLING_POLLER_H
 
 #include <vector>
+#include <deque>
 #include <memory>
 #include <map>
-#include <semaphore>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include "include/task.h"
+#include "Fd.h"
 
 extern "C" {
     #include <poll.h>
 };
 
 enum class PollerResult {
-    OK, TIMEOUT, ERROR
+    OK, TIMEOUT, ERROR, INTERRUPTED
 };
 
+class Poller;
+
+/*
+ * Awaiting hands the suspended coroutine to the wait thread, which stores the result
+ * and posts the resumption to the run queue.
+ */
+struct PollerWait {
+    Poller &poller;
+    uint64_t timeoutMs;
+    PollerResult result{PollerResult::ERROR};
+    bool await_ready() const noexcept {
+        return false;
+    }
+    void await_suspend(std::coroutine_handle<> h);
+    PollerResult await_resume() const noexcept {
+        return result;
+    }
+};
+
+/*
+ * The blocking ppoll() runs in Wait() on a dedicated thread, and the continuation of
+ * Poll() is posted to the run queue. The run queue is drained by one or more threads
+ * calling Runner(), so continuations never wait behind the poll timeout. Changing the
+ * fd set while a wait is in progress, or stopping, interrupts the wait through an
+ * internal pipe. The fd set is indexed by fd number, so updating or removing an fd
+ * does not scan the set.
+ */
 class Poller : public std::enable_shared_from_this<Poller> {
+    friend PollerWait;
 private:
     std::vector<struct pollfd> pollfds{};
+    std::vector<size_t> pollfdIndex{};
+    std::vector<struct pollfd> waitPollfds{};
+    std::string wakeupDrain{};
     std::map<decltype(pollfds[0].fd),std::tuple<bool,bool,bool>> results{};
-    std::vector<std::function<void ()>> runQueue{};
-    std::counting_semaphore<16384> runQueueSemaphore{0};
+    std::deque<std::function<void ()>> runQueue{};
+    std::condition_variable runQueueCond{};
     std::mutex runQueueMutex{};
     std::mutex pollingMtx{};
-    Poller() = default;
+    std::coroutine_handle<> pendingPoll{};
+    PollerResult *pendingResult{nullptr};
+    uint64_t pendingTimeoutMs{0};
+    std::condition_variable waitCond{};
+    std::mutex waitMutex{};
+    Fd wakeupInput{};
+    Fd wakeupMonitor{};
+    std::atomic<bool> waiting{false};
+    std::atomic<bool> stopped{false};
+    Poller();
+    void Interrupt();
+    void AddIndexed(const struct pollfd &pfd);
+    struct pollfd *FindIndexed(int fd);
 public:
     static std::shared_ptr<Poller> Create();
     void AddFd(int fd, bool read, bool write, bool err);
+    void AddFds(const std::vector<int> &fds, bool read, bool write, bool err);
     void UpdateFd(int fd, bool read, bool write);
     void RemoveFd(int fd);
     void ClearFds();
     std::tuple<bool,bool,bool> GetResults(int fd);
     task<PollerResult> Poll(uint64_t timeoutMs);
+    void Post(const std::function<void ()> &func);
+    task<void> Schedule();
+    bool Wait();
     void Runner();
+    void Stop();
 };
 
 
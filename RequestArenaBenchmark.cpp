@@ -0,0 +1,162 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <string>
+#include <atomic>
+#include <new>
+#include <cstdlib>
+#include "Http1Protocol.h"
+#include "HttpHeaders.h"
+#include "HttpRequestArena.h"
+#include "HttpRequestImpl.h"
+#include "include/object_pool.h"
+
+/*
+ * Parses header-heavy request heads and keeps the request data the way the request
+ * object does, once with each value copied into its own string and once with the head
+ * copied into a request arena. Both look up a few headers and release everything.
+ */
+
+static std::atomic<uint64_t> heapAllocations{0};
+
+void *operator new(std::size_t size) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = std::malloc(size > 0 ? size : 1);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void *operator new(std::size_t size, std::align_val_t align) {
+    heapAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *ptr = std::aligned_alloc((std::size_t) align, ((size + (std::size_t) align - 1) / (std::size_t) align) * (std::size_t) align);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void operator delete(void *ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+    std::free(ptr);
+}
+
+static volatile size_t sink{0};
+
+static std::string HeaderHeavyRequest(int headers) {
+    std::string request{"GET /api/v1/resource/12345?expand=comments&limit=50 HTTP/1.1\r\nHost: www.example.com\r\n"};
+    const char *common[] = {
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64; rv:131.0) Gecko/20100101 Firefox/131.0",
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,*/*;q=0.8",
+        "Accept-Language: en-US,en;q=0.5",
+        "Accept-Encoding: gzip, deflate, br, zstd",
+        "Referer: https://www.example.com/api/v1/resource/12345",
+        "Connection: keep-alive",
+        "Cookie: session=8f2a6c1e9b7d4f3a2c1b0e9d8c7b6a5f; theme=dark; consent=1",
+        "Upgrade-Insecure-Requests: 1",
+        "Sec-Fetch-Dest: document",
+        "Sec-Fetch-Mode: navigate",
+        "Sec-Fetch-Site: same-origin",
+        "Priority: u=0, i"
+    };
+    for (int i = 0; i < headers; i++) {
+        if (i < (int) (sizeof(common) / sizeof(common[0]))) {
+            request.append(common[i]);
+        } else {
+            request.append("X-Trace-Attribute-" + std::to_string(i) + ": value-" + std::to_string(i * 7919) + "-abcdefghijklmnop");
+        }
+        request.append("\r\n");
+    }
+    request.append("\r\n");
+    return request;
+}
+
+struct OwnedRequestData {
+    std::string method{};
+    std::string path{};
+    std::vector<Http1HeaderLine> headers{};
+};
+
+static std::string OwnedHeader(const OwnedRequestData &data, const std::string &name) {
+    for (const auto &header : data.headers) {
+        auto headerName = header.GetHeader();
+        if (HttpEqualsIgnoreCase(headerName, name)) {
+            return header.GetValue();
+        }
+    }
+    return {};
+}
+
+/*
+ * The request data as it was kept before the request arena.
+ */
+static size_t DefaultAllocator(std::string_view input) {
+    Http1RequestParser parser{input};
+    if (!parser.IsValid()) {
+        return 0;
+    }
+    Http1Request requestHead{parser.operator Http1Request()};
+    HttpHeaderValues hdrValues{requestHead};
+    size_t contentLength = hdrValues.ContentLength;
+    OwnedRequestData data{.method = requestHead.GetRequest().GetMethod(), .path = requestHead.GetRequest().GetPath(), .headers = requestHead.GetHeader()};
+    return contentLength + OwnedHeader(data, "Host").size() + OwnedHeader(data, "Cookie").size() + OwnedHeader(data, "X-Missing").size() + data.path.size();
+}
+
+static size_t Arena(std::string_view input, std::vector<Http1HeaderView> &headerLines) {
+    Http1RequestHeadParser parser{input, headerLines};
+    if (!parser.IsValid()) {
+        return 0;
+    }
+    size_t contentLength = HttpHeaderContentLength(headerLines);
+    std::shared_ptr<HttpServerResponseContainer> container{};
+    auto request = object_pool_make_shared<HttpRequestImpl>(nullptr, container, parser, input.substr(0, parser.GetParsedInputCharacters()), headerLines, false);
+    return contentLength + request->GetHeader("Host").size() + request->GetHeader("Cookie").size() + request->GetHeader("X-Missing").size() + request->GetPath().size();
+}
+
+template <class F> static std::pair<double,double> Measure(size_t iterations, F func) {
+    for (size_t i = 0; i < 1000; i++) {
+        sink = sink + func();
+    }
+    auto allocationsStart = heapAllocations.load();
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        sink = sink + func();
+    }
+    auto elapsed = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - start).count();
+    return {elapsed / iterations, (double) (heapAllocations.load() - allocationsStart) / iterations};
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 200000;
+    bool failed{false};
+    std::vector<Http1HeaderView> headerLines{};
+    for (int headers : {8, 32, 64}) {
+        auto request = HeaderHeavyRequest(headers);
+        if (DefaultAllocator(request) != Arena(request, headerLines) || DefaultAllocator(request) == 0) {
+            std::cerr << "The request data differs between the allocators\n";
+            failed = true;
+        }
+        auto defaultResult = Measure(iterations, [&request] () { return DefaultAllocator(request); });
+        auto arenaResult = Measure(iterations, [&request, &headerLines] () { return Arena(request, headerLines); });
+        std::cout << headers << " headers, " << request.size() << " bytes: default allocator " << defaultResult.first << " ns, "
+                  << defaultResult.second << " allocations, arena " << arenaResult.first << " ns, " << arenaResult.second
+                  << " allocations per request\n";
+    }
+    return failed ? 1 : 0;
+}
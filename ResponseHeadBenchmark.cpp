@@ -0,0 +1,47 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "Http1Protocol.h"
+#include "Http1ResponseHead.h"
+
+static volatile size_t sink{0};
+
+template <class F> static double NsPerOp(size_t iterations, F func) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        func(i);
+    }
+    auto elapsed = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / iterations;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 10000000;
+    HttpHeaderTemplate headerTemplate{{"Server", "libhttptooling"}, {"Cache-Control", "no-cache"}};
+    std::string description{"OK"};
+    std::string contentType{"application/json"};
+    std::vector<char> buffer{};
+    buffer.resize(Http1ResponseHeadWriter::MaxSize(description, contentType, &headerTemplate));
+
+    auto legacy = NsPerOp(iterations / 10, [&description, &contentType] (size_t i) {
+        std::vector<Http1HeaderLine> hdrLns{};
+        hdrLns.emplace_back("Content-Type", contentType);
+        hdrLns.emplace_back("Content-Length", std::to_string(i & 0xFFFF));
+        hdrLns.emplace_back("Server", "libhttptooling");
+        hdrLns.emplace_back("Cache-Control", "no-cache");
+        Http1Response responseHead{{"HTTP/1.1", 200, description}, hdrLns};
+        sink = sink + responseHead.operator std::string().size();
+    });
+    auto writer = NsPerOp(iterations, [&description, &contentType, &headerTemplate, &buffer] (size_t i) {
+        sink = sink + Http1ResponseHeadWriter::Write(buffer.data(), 200, description, contentType, i & 0xFFFF, &headerTemplate);
+    });
+    std::cout << "Http1Response head:        " << legacy << " ns/op\n";
+    std::cout << "Http1ResponseHeadWriter:   " << writer << " ns/op\n";
+    std::cout << std::string(buffer.data(), Http1ResponseHeadWriter::Write(buffer.data(), 200, description, contentType, 1234, &headerTemplate));
+    return writer < 100.0 ? 0 : 1;
+}
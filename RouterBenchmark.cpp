@@ -0,0 +1,126 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <chrono>
+#include <iostream>
+#include <vector>
+#include <string>
+#include "HttpRouter.h"
+
+static volatile size_t sink{0};
+
+template <class F> static double NsPerOp(size_t iterations, F func) {
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < iterations; i++) {
+        func(i);
+    }
+    auto elapsed = std::chrono::duration<double,std::nano>(std::chrono::steady_clock::now() - start).count();
+    return elapsed / iterations;
+}
+
+static task<void> NoopHandler(std::shared_ptr<HttpRequest>, HttpRouteParams) {
+    co_return;
+}
+
+struct Routes {
+    HttpRouter router{};
+    std::vector<std::pair<std::string,std::string>> patterns{};
+    std::vector<std::pair<std::string,std::string>> requests{};
+};
+
+static void CreateRoutes(Routes &routes, int count) {
+    for (int i = 0; routes.router.GetRouteCount() < (size_t) count; i++) {
+        auto resource = "/api/v1/resource" + std::to_string(i);
+        std::pair<std::string,std::string> added[] = {
+            {"GET", resource + "/{id}"},
+            {"POST", resource + "/{id}/comments"},
+            {"GET", "/static/page" + std::to_string(i)},
+            {"DELETE", resource + "/{id}"}
+        };
+        std::pair<std::string,std::string> requested[] = {
+            {"GET", resource + "/12345"},
+            {"POST", resource + "/12345/comments"},
+            {"GET", "/static/page" + std::to_string(i)},
+            {"DELETE", resource + "/9?force=true"}
+        };
+        for (int j = 0; j < 4 && routes.router.GetRouteCount() < (size_t) count; j++) {
+            routes.router.Add(added[j].first, added[j].second, NoopHandler);
+            routes.patterns.emplace_back(added[j]);
+            routes.requests.emplace_back(requested[j]);
+        }
+    }
+}
+
+static bool LinearMatch(std::string_view pattern, std::string_view path) {
+    path = path.substr(0, path.find('?'));
+    while (!pattern.empty() && !path.empty()) {
+        auto patternEnd = pattern.find('/', 1);
+        auto pathEnd = path.find('/', 1);
+        auto patternSegment = pattern.substr(0, patternEnd);
+        auto pathSegment = path.substr(0, pathEnd);
+        if (!patternSegment.starts_with("/{") && patternSegment != pathSegment) {
+            return false;
+        }
+        pattern = patternEnd == std::string_view::npos ? std::string_view() : pattern.substr(patternEnd);
+        path = pathEnd == std::string_view::npos ? std::string_view() : path.substr(pathEnd);
+    }
+    return pattern.empty() && path.empty();
+}
+
+static bool CheckRouter() {
+    HttpRouter router{};
+    router.Add("GET", "/users/{user}/posts/{post}", NoopHandler);
+    router.Add("GET", "/users/me/posts/{post}", NoopHandler);
+    router.Add("PUT", "/users/{user}", NoopHandler);
+    router.Add("GET", "/", NoopHandler);
+    const HttpRouteHandler *handler{nullptr};
+    HttpRouteParams params{};
+    bool ok = router.Match("GET", "/users/alice/posts/42?x=1", handler, params) == HttpRouteMatch::FOUND &&
+              params.Get("user") == "alice" && params.Get("post") == "42";
+    params = {};
+    ok = ok && router.Match("GET", "/users/me/posts/7", handler, params) == HttpRouteMatch::FOUND &&
+         params.Get("user").empty() && params.Get("post") == "7";
+    params = {};
+    ok = ok && router.Match("GET", "/users/alice", handler, params) == HttpRouteMatch::METHOD_NOT_ALLOWED;
+    params = {};
+    ok = ok && router.Match("HEAD", "/", handler, params) == HttpRouteMatch::FOUND;
+    params = {};
+    ok = ok && router.Match("GET", "/users", handler, params) == HttpRouteMatch::NOT_FOUND;
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    size_t iterations = argc > 1 ? std::stoul(argv[1]) : 2000000;
+    bool failed = !CheckRouter();
+    if (failed) {
+        std::cout << "Router match check failed\n";
+    }
+    double trieSmall{0};
+    double trieLarge{0};
+    for (int count : {10, 100, 1000}) {
+        Routes routes{};
+        CreateRoutes(routes, count);
+        auto trie = NsPerOp(iterations, [&routes] (size_t i) {
+            const auto &request = routes.requests[(i * 7919) % routes.requests.size()];
+            const HttpRouteHandler *handler{nullptr};
+            HttpRouteParams params{};
+            sink = sink + (size_t) routes.router.Match(request.first, request.second, handler, params) + params.Size();
+        });
+        auto linear = NsPerOp(iterations / 10, [&routes] (size_t i) {
+            const auto &request = routes.requests[(i * 7919) % routes.requests.size()];
+            for (const auto &pattern : routes.patterns) {
+                if (pattern.first == request.first && LinearMatch(pattern.second, request.second)) {
+                    sink = sink + 1;
+                    break;
+                }
+            }
+        });
+        std::cout << count << " routes: trie " << trie << " ns/lookup, linear scan " << linear << " ns/lookup\n";
+        if (count == 10) {
+            trieSmall = trie;
+        }
+        trieLarge = trie;
+    }
+    return failed || trieLarge > (trieSmall * 3.0) ? 1 : 0;
+}
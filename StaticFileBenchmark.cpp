@@ -0,0 +1,287 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <filesystem>
+#include "HttpServer.h"
+#include "HttpStaticFileResponder.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+}
+
+static std::shared_ptr<HttpServer> server{};
+static std::shared_ptr<HttpStaticFileResponder> responder{};
+static std::string root{};
+static bool copyMode{false};
+static std::mutex workMtx{};
+static std::condition_variable workCond{};
+static std::deque<std::shared_ptr<HttpRequest>> workQueue{};
+static bool workStop{false};
+
+constexpr int smallFiles = 64;
+constexpr size_t smallFileSize = 4096;
+constexpr int largeFiles = 4;
+constexpr size_t largeFileSize = 8 * 1024 * 1024;
+
+task<void> HttpServerLoop() {
+    while (true) {
+        auto req = co_await server->NextRequest();
+        {
+            std::lock_guard lock{workMtx};
+            workQueue.emplace_back(req);
+        }
+        workCond.notify_one();
+    }
+}
+
+static void RespondCopy(const std::shared_ptr<HttpRequest> &req) {
+    std::ifstream input{root + req->GetPath(), std::ios::binary};
+    if (!input) {
+        req->Respond(std::make_shared<HttpResponse>(404, "Not Found"));
+        return;
+    }
+    std::string content{std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent(std::move(content), "application/octet-stream");
+    req->Respond(response);
+}
+
+static void Worker() {
+    while (true) {
+        std::shared_ptr<HttpRequest> req{};
+        {
+            std::unique_lock lock{workMtx};
+            workCond.wait(lock, [] () { return workStop || !workQueue.empty(); });
+            if (workQueue.empty()) {
+                return;
+            }
+            req = workQueue.front();
+            workQueue.pop_front();
+        }
+        if (copyMode) {
+            RespondCopy(req);
+        } else {
+            responder->Respond(req);
+        }
+    }
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+struct FetchResult {
+    std::string head{};
+    uint64_t bodySize{0};
+    bool failed{false};
+};
+
+static FetchResult Fetch(int fd, const std::string &path, const std::string &extraHeaders, std::string &input, std::string &buf) {
+    FetchResult result{};
+    std::string request{"GET "};
+    request.append(path);
+    request.append(" HTTP/1.1\r\nHost: localhost\r\n");
+    request.append(extraHeaders);
+    request.append("\r\n");
+    size_t offset{0};
+    while (offset < request.size()) {
+        auto wr = write(fd, request.data() + offset, request.size() - offset);
+        if (wr <= 0) {
+            result.failed = true;
+            return result;
+        }
+        offset += wr;
+    }
+    std::string::size_type headEnd{std::string::npos};
+    while ((headEnd = input.find("\r\n\r\n")) == std::string::npos) {
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            result.failed = true;
+            return result;
+        }
+        input.append(buf.data(), rd);
+    }
+    result.head = input.substr(0, headEnd + 4);
+    input.erase(0, headEnd + 4);
+    auto lengthPos = result.head.find("Content-Length: ");
+    uint64_t contentLength = lengthPos != std::string::npos ? std::stoull(result.head.substr(lengthPos + 16)) : 0;
+    while (input.size() < contentLength) {
+        result.bodySize += input.size();
+        contentLength -= input.size();
+        input.clear();
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            result.failed = true;
+            return result;
+        }
+        input.append(buf.data(), rd);
+    }
+    result.bodySize += contentLength;
+    input.erase(0, contentLength);
+    return result;
+}
+
+struct LoadResult {
+    uint64_t responses{0};
+    uint64_t bytes{0};
+    bool failed{false};
+};
+
+static LoadResult RunConnection(int port, int seed, std::chrono::steady_clock::time_point until) {
+    LoadResult result{};
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        result.failed = true;
+        return result;
+    }
+    std::string input{};
+    std::string buf{};
+    buf.resize(256 * 1024);
+    uint64_t n = seed;
+    while (std::chrono::steady_clock::now() < until) {
+        ++n;
+        bool large = (n % 16) == 0;
+        std::string path = large ? "/large" + std::to_string(n % largeFiles) : "/small" + std::to_string(n % smallFiles);
+        auto fetched = Fetch(fd, path, "", input, buf);
+        if (fetched.failed || fetched.bodySize != (large ? largeFileSize : smallFileSize)) {
+            result.failed = true;
+            break;
+        }
+        ++result.responses;
+        result.bytes += fetched.bodySize;
+    }
+    close(fd);
+    return result;
+}
+
+static bool CheckProtocol(int port) {
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        return false;
+    }
+    std::string input{};
+    std::string buf{};
+    buf.resize(65536);
+    bool ok{true};
+    auto full = Fetch(fd, "/small1", "", input, buf);
+    auto etagPos = full.head.find("ETag: ");
+    ok = ok && !full.failed && full.head.starts_with("HTTP/1.1 200 ") && etagPos != std::string::npos;
+    if (ok) {
+        auto etag = full.head.substr(etagPos + 6, full.head.find("\r\n", etagPos) - etagPos - 6);
+        auto notModified = Fetch(fd, "/small1", "If-None-Match: " + etag + "\r\n", input, buf);
+        ok = ok && !notModified.failed && notModified.head.starts_with("HTTP/1.1 304 ") && notModified.bodySize == 0;
+    }
+    auto partial = Fetch(fd, "/large0", "Range: bytes=100-199\r\n", input, buf);
+    ok = ok && !partial.failed && partial.head.starts_with("HTTP/1.1 206 ") && partial.bodySize == 100 &&
+         partial.head.find("Content-Range: bytes 100-199/" + std::to_string(largeFileSize)) != std::string::npos;
+    auto unsatisfiable = Fetch(fd, "/small1", "Range: bytes=999999-\r\n", input, buf);
+    ok = ok && !unsatisfiable.failed && unsatisfiable.head.starts_with("HTTP/1.1 416 ");
+    auto missing = Fetch(fd, "/../etc/passwd", "", input, buf);
+    ok = ok && !missing.failed && missing.head.starts_with("HTTP/1.1 400 ");
+    auto linked = Fetch(fd, "/linked", "", input, buf);
+    ok = ok && !linked.failed && linked.head.starts_with("HTTP/1.1 200 ") && linked.bodySize == smallFileSize;
+    auto escaped = Fetch(fd, "/escape/etc/passwd", "", input, buf);
+    ok = ok && !escaped.failed && escaped.head.starts_with("HTTP/1.1 404 ");
+    close(fd);
+    return ok;
+}
+
+static void CreateFiles() {
+    std::string content{};
+    for (int i = 0; i < smallFiles; i++) {
+        content.assign(smallFileSize, (char) ('a' + (i % 26)));
+        std::ofstream{root + "/small" + std::to_string(i), std::ios::binary} << content;
+    }
+    for (int i = 0; i < largeFiles; i++) {
+        content.assign(largeFileSize, (char) ('A' + i));
+        std::ofstream{root + "/large" + std::to_string(i), std::ios::binary} << content;
+    }
+    std::filesystem::create_symlink("small1", root + "/linked");
+    std::filesystem::create_symlink("/", root + "/escape");
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8091;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    constexpr int connections = 4;
+    constexpr int workers = 4;
+    root = (std::filesystem::temp_directory_path() / ("httptooling-static-" + std::to_string(getpid()))).string();
+    std::filesystem::create_directories(root);
+    CreateFiles();
+    responder = std::make_shared<HttpStaticFileResponder>(root);
+    server = HttpServer::Create(port);
+    FireAndForget<task<void>>([] () { return HttpServerLoop(); });
+    std::vector<std::thread> workerThreads{};
+    for (int i = 0; i < workers; i++) {
+        workerThreads.emplace_back(Worker);
+    }
+    std::thread serverThread{[] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    bool failed = !CheckProtocol(port);
+    if (failed) {
+        std::cout << "Static file responder protocol check failed\n";
+    }
+    for (bool copy : {true, false}) {
+        copyMode = copy;
+        auto start = std::chrono::steady_clock::now();
+        auto until = start + std::chrono::seconds(seconds);
+        std::vector<LoadResult> results{};
+        results.resize(connections);
+        std::vector<std::thread> clients{};
+        for (int i = 0; i < connections; i++) {
+            clients.emplace_back([&results, i, port, until] () {
+                results[i] = RunConnection(port, i * 7, until);
+            });
+        }
+        for (auto &client : clients) {
+            client.join();
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        uint64_t responses{0};
+        uint64_t bytes{0};
+        for (const auto &result : results) {
+            responses += result.responses;
+            bytes += result.bytes;
+            failed = failed || result.failed;
+        }
+        std::cout << (copy ? "read into string: " : "sendfile:         ") << (uint64_t) (responses / elapsed) << " req/s, "
+                  << (uint64_t) (bytes / elapsed / (1024 * 1024)) << " MiB/s\n";
+    }
+    server->Stop();
+    serverThread.join();
+    {
+        std::lock_guard lock{workMtx};
+        workStop = true;
+    }
+    workCond.notify_all();
+    for (auto &worker : workerThreads) {
+        worker.join();
+    }
+    server = {};
+    std::filesystem::remove_all(root);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,235 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <algorithm>
+#include <functional>
+#include <cstring>
+#include "HttpServer.h"
+#include "HttpClient.h"
+#include "HttpRouter.h"
+#include "include/sync_coroutine.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <stddef.h>
+}
+
+static task<void> Hello(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent("ok", "text/plain");
+    request->Respond(response);
+    co_return;
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    int noDelay{1};
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    return fd;
+}
+
+static int ConnectUnix(const std::string &path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    struct sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    memcpy(addr.sun_path, path.data(), path.size());
+    socklen_t len = sizeof(addr);
+    if (path.starts_with('@')) {
+        addr.sun_path[0] = '\0';
+        len = offsetof(struct sockaddr_un, sun_path) + path.size();
+    }
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, len) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+static bool ReadResponse(int fd, std::string &input, std::string &body) {
+    std::string buf{};
+    buf.resize(65536);
+    while (true) {
+        auto headEnd = input.find("\r\n\r\n");
+        if (headEnd != std::string::npos) {
+            auto lengthPos = input.find("Content-Length: ");
+            size_t contentLength{0};
+            if (lengthPos != std::string::npos && lengthPos < headEnd) {
+                contentLength = std::stoul(input.substr(lengthPos + 16));
+            }
+            if (input.size() >= headEnd + 4 + contentLength) {
+                body = input.substr(headEnd + 4, contentLength);
+                input.erase(0, headEnd + 4 + contentLength);
+                return true;
+            }
+        }
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        input.append(buf.data(), rd);
+    }
+}
+
+struct TransportResult {
+    double p50{0};
+    double p99{0};
+    double requestsPerSecond{0};
+    bool failed{false};
+};
+
+static TransportResult Measure(const std::function<int ()> &connectFn, int seconds) {
+    constexpr int connections = 4;
+    constexpr int depth = 8;
+    TransportResult result{};
+    {
+        int fd = connectFn();
+        if (fd < 0) {
+            result.failed = true;
+            return result;
+        }
+        std::string request{"GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+        std::string input{};
+        std::string body{};
+        std::vector<double> latencies{};
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        while (std::chrono::steady_clock::now() < until) {
+            auto start = std::chrono::steady_clock::now();
+            if (write(fd, request.data(), request.size()) != (ssize_t) request.size() || !ReadResponse(fd, input, body) || body != "ok") {
+                result.failed = true;
+                break;
+            }
+            latencies.emplace_back(std::chrono::duration<double,std::micro>(std::chrono::steady_clock::now() - start).count());
+        }
+        close(fd);
+        if (latencies.empty()) {
+            result.failed = true;
+            return result;
+        }
+        std::sort(latencies.begin(), latencies.end());
+        result.p50 = latencies[latencies.size() / 2];
+        result.p99 = latencies[(latencies.size() * 99) / 100];
+    }
+    std::vector<uint64_t> responses{};
+    responses.resize(connections);
+    auto start = std::chrono::steady_clock::now();
+    auto until = start + std::chrono::seconds(seconds);
+    std::vector<std::thread> clients{};
+    for (int i = 0; i < connections; i++) {
+        clients.emplace_back([&responses, &connectFn, i, until] () {
+            int fd = connectFn();
+            if (fd < 0) {
+                return;
+            }
+            std::string requests{};
+            for (int j = 0; j < depth; j++) {
+                requests.append("GET /hello HTTP/1.1\r\nHost: localhost\r\n\r\n");
+            }
+            std::string input{};
+            std::string body{};
+            while (std::chrono::steady_clock::now() < until) {
+                if (write(fd, requests.data(), requests.size()) != (ssize_t) requests.size()) {
+                    break;
+                }
+                for (int j = 0; j < depth && ReadResponse(fd, input, body); j++) {
+                    ++responses[i];
+                }
+            }
+            close(fd);
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint64_t total{0};
+    for (auto count : responses) {
+        total += count;
+    }
+    result.requestsPerSecond = total / elapsed;
+    result.failed = result.failed || total == 0;
+    return result;
+}
+
+static std::shared_ptr<HttpServer> StartServer(const std::shared_ptr<HttpServer> &server, std::vector<std::thread> &threads) {
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/hello", Hello);
+    server->SetRouter(router);
+    threads.emplace_back([server] () { server->Run(); });
+    return server;
+}
+
+static task<void> ClientRequest(std::shared_ptr<HttpClient> client, std::string path, bool *ok) {
+    auto response = co_await client->ExecuteUnix(path, client->Request("GET", "/hello"));
+    if (response.has_value() && response.value()) {
+        auto body = co_await response.value()->ResponseBody();
+        *ok = response.value()->GetCode() == 200 && body.success && body.body == "ok";
+    }
+    client->Stop();
+}
+
+static bool CheckClient(const std::string &path) {
+    bool ok{false};
+    auto client = HttpClient::Create();
+    FireAndForget<task<void>>([client, path, &ok] () { return ClientRequest(client, path, &ok); });
+    client->Run();
+    return ok;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8096;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    std::string abstractPath{"@libhttptooling-bench-" + std::to_string(getpid())};
+    std::string filePath{"/tmp/libhttptooling-bench-" + std::to_string(getpid()) + ".sock"};
+
+    std::vector<std::thread> threads{};
+    auto tcpServer = StartServer(HttpServer::Create(port), threads);
+    auto abstractServer = StartServer(HttpServer::CreateUnix(abstractPath), threads);
+    auto fileServer = StartServer(HttpServer::CreateUnix(filePath), threads);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    bool failed{false};
+    if (!CheckClient(abstractPath) || !CheckClient(filePath)) {
+        std::cout << "HttpClient over unix socket failed\n";
+        failed = true;
+    }
+    std::pair<std::string,std::function<int ()>> transports[] = {
+        {"tcp loopback", [port] () { return ConnectLoopback(port); }},
+        {"unix abstract", [abstractPath] () { return ConnectUnix(abstractPath); }},
+        {"unix path", [filePath] () { return ConnectUnix(filePath); }}
+    };
+    for (const auto &transport : transports) {
+        auto result = Measure(transport.second, seconds);
+        std::cout << transport.first << ": round trip p50 " << result.p50 << " us, p99 " << result.p99 << " us, "
+                  << (uint64_t) result.requestsPerSecond << " req/s pipelined\n";
+        failed = failed || result.failed;
+    }
+    tcpServer->Stop();
+    abstractServer->Stop();
+    fileServer->Stop();
+    for (auto &thread : threads) {
+        thread.join();
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,196 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <iostream>
+#include <string>
+#include "HttpServer.h"
+#include "HttpRouter.h"
+#include "Metrics.h"
+#include "NetwServer.h"
+extern "C" {
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <pthread.h>
+#include <time.h>
+}
+
+constexpr size_t bodySize = 4 * 1024 * 1024;
+
+static std::shared_ptr<const std::string> largeBody{};
+
+static task<void> Large(std::shared_ptr<HttpRequest> request, HttpRouteParams) {
+    auto response = std::make_shared<HttpResponse>(200, "OK");
+    response->SetContent(*largeBody, "application/octet-stream");
+    request->Respond(response);
+    co_return;
+}
+
+static int ConnectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd < 0 || connect(fd, (struct sockaddr *) &addr, sizeof(addr)) != 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        return -1;
+    }
+    return fd;
+}
+
+/*
+ * Reads a response and discards the body without keeping it, so the client side costs
+ * as little as possible.
+ */
+static bool ReadResponse(int fd, std::string &buf, size_t &bodyLength) {
+    std::string head{};
+    size_t headEnd{std::string::npos};
+    size_t buffered{0};
+    while (headEnd == std::string::npos) {
+        auto rd = read(fd, buf.data(), buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        head.append(buf.data(), rd);
+        headEnd = head.find("\r\n\r\n");
+    }
+    auto lengthPos = head.find("Content-Length: ");
+    if (lengthPos == std::string::npos || lengthPos > headEnd) {
+        return false;
+    }
+    bodyLength = std::stoul(head.substr(lengthPos + 16));
+    buffered = head.size() - (headEnd + 4);
+    auto remaining = bodyLength - buffered;
+    while (remaining > 0) {
+        auto rd = read(fd, buf.data(), remaining < buf.size() ? remaining : buf.size());
+        if (rd <= 0) {
+            return false;
+        }
+        remaining -= rd;
+    }
+    return true;
+}
+
+static uint64_t RunConnection(int port, std::chrono::steady_clock::time_point until, bool &failed) {
+    int fd = ConnectLoopback(port);
+    if (fd < 0) {
+        failed = true;
+        return 0;
+    }
+    std::string request{"GET /large HTTP/1.1\r\nHost: localhost\r\n\r\n"};
+    std::string buf{};
+    buf.resize(256 * 1024);
+    uint64_t bytes{0};
+    while (std::chrono::steady_clock::now() < until) {
+        size_t bodyLength{0};
+        if (write(fd, request.data(), request.size()) != (ssize_t) request.size() || !ReadResponse(fd, buf, bodyLength) || bodyLength != bodySize) {
+            failed = true;
+            break;
+        }
+        bytes += bodyLength;
+    }
+    close(fd);
+    return bytes;
+}
+
+static double ThreadCpuSeconds(pthread_t thread) {
+    clockid_t clock{};
+    struct timespec ts{};
+    if (pthread_getcpuclockid(thread, &clock) != 0 || clock_gettime(clock, &ts) != 0) {
+        return 0;
+    }
+    return ts.tv_sec + (ts.tv_nsec / 1e9);
+}
+
+static double MetricValue(const std::shared_ptr<MetricsRegistry> &metrics, const std::string &name) {
+    for (const auto &value : metrics->Snapshot()) {
+        if (value.name == name) {
+            return value.value;
+        }
+    }
+    return 0;
+}
+
+struct ZeroCopyResult {
+    double gibPerSecond{0};
+    double cpuSecondsPerGib{0};
+    double zeroCopySends{0};
+    double copiedSends{0};
+    bool failed{false};
+};
+
+static ZeroCopyResult RunTransfer(int port, int seconds, size_t zeroCopyThreshold) {
+    constexpr int connections = 2;
+    ZeroCopyResult result{};
+    NetwSocketOptions socketOptions{};
+    socketOptions.zeroCopyThreshold = zeroCopyThreshold;
+    auto server = HttpServer::Create(port, socketOptions);
+    auto router = std::make_shared<HttpRouter>();
+    router->Add("GET", "/large", Large);
+    server->SetRouter(router);
+    std::thread serverThread{[server] () { server->Run(); }};
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+    auto start = std::chrono::steady_clock::now();
+    auto serverCpuStart = ThreadCpuSeconds(serverThread.native_handle());
+    auto until = start + std::chrono::seconds(seconds);
+    std::vector<uint64_t> bytes{};
+    bytes.resize(connections);
+    bool failedConnections[connections]{};
+    std::vector<std::thread> clients{};
+    for (int i = 0; i < connections; i++) {
+        clients.emplace_back([&bytes, &failedConnections, i, port, until] () {
+            bytes[i] = RunConnection(port, until, failedConnections[i]);
+        });
+    }
+    for (auto &client : clients) {
+        client.join();
+    }
+    auto serverCpu = ThreadCpuSeconds(serverThread.native_handle()) - serverCpuStart;
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    result.zeroCopySends = MetricValue(server->GetMetrics(), "netw_zerocopy_completed_total");
+    result.copiedSends = MetricValue(server->GetMetrics(), "netw_zerocopy_copied_total");
+    server->Stop();
+    serverThread.join();
+
+    uint64_t total{0};
+    for (int i = 0; i < connections; i++) {
+        total += bytes[i];
+        result.failed = result.failed || failedConnections[i];
+    }
+    if (total == 0) {
+        result.failed = true;
+        return result;
+    }
+    auto gib = total / (1024.0 * 1024.0 * 1024.0);
+    result.gibPerSecond = gib / elapsed;
+    result.cpuSecondsPerGib = serverCpu / gib;
+    return result;
+}
+
+int main(int argc, char **argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 8096;
+    int seconds = argc > 2 ? std::stoi(argv[2]) : 2;
+    largeBody = std::make_shared<std::string>(bodySize, 'x');
+    bool failed{false};
+    for (size_t threshold : {(size_t) 0, (size_t) 64 * 1024}) {
+        auto result = RunTransfer(port++, seconds, threshold);
+        std::cout << (threshold > 0 ? "MSG_ZEROCOPY: " : "copy: ") << result.gibPerSecond << " GiB/s, "
+                  << result.cpuSecondsPerGib << " server cpu s per GiB, " << (uint64_t) result.zeroCopySends
+                  << " zero copy sends completed, " << (uint64_t) result.copiedSends << " copied by the kernel\n";
+        failed = failed || result.failed;
+        if (threshold > 0 && result.zeroCopySends == 0) {
+            failed = true;
+        }
+    }
+    return failed ? 1 : 0;
+}
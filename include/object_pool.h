@@ -0,0 +1,119 @@
+//
+// Created by sigsegv on 10/19/26.
+//
+
+#ifndef LIBHTTPTOOLING_OBJECT_POOL_H
+#define LIBHTTPTOOLING_OBJECT_POOL_H
+
+#include <memory>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <new>
+
+/*
+ * Per-thread recycling of fixed size blocks for framework objects, connections,
+ * requests and coroutine frames. Sizes are rounded up to size classes of
+ * object_pool_granularity bytes. A freed block goes to the free list of the freeing
+ * thread, so objects that are created on one thread and dropped on another move
+ * between the threads instead of piling up. Each thread keeps at most
+ * object_pool_max_cached bytes, the rest is returned to the heap. Every allocation
+ * that goes to the heap is counted, so steady state can be checked to have none.
+ */
+constexpr size_t object_pool_granularity = 16;
+constexpr size_t object_pool_max_size = 4096;
+constexpr size_t object_pool_classes = object_pool_max_size / object_pool_granularity;
+constexpr size_t object_pool_max_cached = 4 * 1024 * 1024;
+
+inline std::atomic<uint64_t> object_pool_heap_allocations{0};
+
+struct object_pool_block {
+    object_pool_block *next;
+};
+
+struct object_pool_cache {
+    std::array<object_pool_block *,object_pool_classes> free{};
+    size_t cached{0};
+    ~object_pool_cache();
+};
+
+inline thread_local bool object_pool_cache_destroyed{false};
+inline thread_local object_pool_cache object_pool_thread_cache{};
+
+inline object_pool_cache::~object_pool_cache() {
+    object_pool_cache_destroyed = true;
+    for (auto *block : free) {
+        while (block != nullptr) {
+            auto *next = block->next;
+            ::operator delete(block);
+            block = next;
+        }
+    }
+}
+
+inline void *object_pool_allocate(size_t size) {
+    if (size == 0 || size > object_pool_max_size || object_pool_cache_destroyed) {
+        object_pool_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+        return ::operator new(size);
+    }
+    auto sizeClass = (size - 1) / object_pool_granularity;
+    auto &cache = object_pool_thread_cache;
+    auto *block = cache.free[sizeClass];
+    if (block != nullptr) {
+        cache.free[sizeClass] = block->next;
+        cache.cached -= (sizeClass + 1) * object_pool_granularity;
+        return block;
+    }
+    object_pool_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+    return ::operator new((sizeClass + 1) * object_pool_granularity);
+}
+
+inline void object_pool_deallocate(void *ptr, size_t size) {
+    if (size == 0 || size > object_pool_max_size || object_pool_cache_destroyed) {
+        ::operator delete(ptr);
+        return;
+    }
+    auto sizeClass = (size - 1) / object_pool_granularity;
+    auto blockSize = (sizeClass + 1) * object_pool_granularity;
+    auto &cache = object_pool_thread_cache;
+    if (cache.cached + blockSize > object_pool_max_cached) {
+        ::operator delete(ptr);
+        return;
+    }
+    auto *block = static_cast<object_pool_block *>(ptr);
+    block->next = cache.free[sizeClass];
+    cache.free[sizeClass] = block;
+    cache.cached += blockSize;
+}
+
+inline uint64_t object_pool_heap_allocation_count() {
+    return object_pool_heap_allocations.load(std::memory_order_relaxed);
+}
+
+/*
+ * Allocator for std::allocate_shared, which puts the object and the reference counts
+ * in one pooled block.
+ */
+template <typename T> struct object_pool_allocator {
+    static_assert(alignof(T) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+    typedef T value_type;
+    object_pool_allocator() noexcept = default;
+    template <typename U> object_pool_allocator(const object_pool_allocator<U> &) noexcept {
+    }
+    T *allocate(size_t n) {
+        return static_cast<T *>(object_pool_allocate(n * sizeof(T)));
+    }
+    void deallocate(T *ptr, size_t n) noexcept {
+        object_pool_deallocate(ptr, n * sizeof(T));
+    }
+    template <typename U> bool operator ==(const object_pool_allocator<U> &) const noexcept {
+        return true;
+    }
+};
+
+template <typename T, typename... Args> std::shared_ptr<T> object_pool_make_shared(Args &&... args) {
+    return std::allocate_shared<T>(object_pool_allocator<T>{}, std::forward<Args>(args)...);
+}
+
+#endif //LIBHTTPTOOLING_OBJECT_POOL_H
@@ -41,11 +41,13 @@ template <class T, class RV> co_interface<RV> SyncRunner(completion_token<RV> *c
     co_return ct;
 }
 
-template <class T> T FireAndForget(const std::function<T ()> &taskIncoming) {
-    T *task = new T();
-    *task = taskIncoming();
-    co_await *task;
-    delete task;
+/*
+ * The callable is kept in the coroutine frame, so starting a task does not allocate
+ * anything else than the frames.
+ */
+template <class T, class F> T FireAndForget(F taskIncoming) {
+    T incoming{taskIncoming()};
+    co_await incoming;
     co_return;
 }
 
@@ -9,6 +9,7 @@
 #include <coroutine>
 #include <exception>
 #include <atomic>
+#include "object_pool.h"
 
 //#define DEBUG_LF_MAG 0xF1F21234
 
@@ -104,198 +105,177 @@ public:
     }
 };
 
-template <typename T> struct task {
-    struct promise_type {
-        std::function<void ()> callback_;
-        std::atomic_bool callCallback{false};
-        std::atomic_bool returnedCall{false};
-        T value_;
-        std::suspend_never initial_suspend() noexcept {
-            return {};
+/*
+ * A task runs eagerly and stays suspended at the final suspend point, so the result
+ * can be read after the coroutine has returned, also when it returned before it was
+ * awaited. The task object destroys the frame, unless the task was dropped while the
+ * coroutine was still running, in which case the coroutine destroys itself when it
+ * returns. Awaiting a task that already returned does not suspend.
+ */
+enum class task_state {
+    RUNNING,
+    AWAITED,
+    DETACHED,
+    FINISHED
+};
+
+template <typename Promise> struct task_final_awaiter {
+    bool await_ready() noexcept {
+        return false;
+    }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> h) noexcept {
+        auto &promise = h.promise();
+        auto continuation = promise.continuation_;
+        auto previous = promise.state_.exchange(task_state::FINISHED);
+        if (previous == task_state::AWAITED) {
+            return continuation;
         }
-        std::suspend_never final_suspend() noexcept {
-            return {};
+        if (previous == task_state::DETACHED) {
+            h.destroy();
         }
+        return std::noop_coroutine();
+    }
+    void await_resume() noexcept {
+    }
+};
+
+template <typename T> struct task;
+
+/*
+ * Coroutine frames are recycled through the per-thread object pool.
+ */
+template <typename Promise> struct task_promise_base {
+    std::coroutine_handle<> continuation_{};
+    std::atomic<task_state> state_{task_state::RUNNING};
+    static void *operator new(std::size_t size) {
+        return object_pool_allocate(size);
+    }
+    static void operator delete(void *ptr, std::size_t size) {
+        object_pool_deallocate(ptr, size);
+    }
+    std::suspend_never initial_suspend() noexcept {
+        return {};
+    }
+    task_final_awaiter<Promise> final_suspend() noexcept {
+        return {};
+    }
+    void unhandled_exception() {
+        std::terminate();
+    }
+};
+
+template <typename T> struct task_promise {
+    struct type : task_promise_base<type> {
+        T value_;
         task<T> get_return_object() {
-            return {std::coroutine_handle<promise_type>::from_promise(*this)};
-        }
-        void unhandled_exception() {
-            std::terminate();
+            return {std::coroutine_handle<type>::from_promise(*this)};
         }
         void return_value(T rv) {
             value_ = rv;
-            returnedCall.store(true);
-            if (callCallback) {
-                callback_();
-            }
         }
     };
-private:
-    std::coroutine_handle<promise_type> handle;
-    std::atomic_bool resumed{false};
+};
+
+template <> struct task_promise<void> {
+    struct type : task_promise_base<type> {
+        task<void> get_return_object();
+        void return_void() {
+        }
+    };
+};
+
+template <typename Promise> class task_base {
+protected:
+    std::coroutine_handle<Promise> handle{};
     bool hasHandle{false};
 #ifdef DEBUG_LF_MAG
     uint32_t magic{DEBUG_LF_MAG};
 #endif
-public:
-    task(std::coroutine_handle<promise_type> h) : handle(h), hasHandle(true) {
-    }
-    task(task &&mv) : handle(std::move(mv.handle)), hasHandle(mv.hasHandle) {
-        mv.hasHandle = false;
-    }
-    ~task() {
-#ifdef DEBUG_LF_MAG
-        if (magic != DEBUG_LF_MAG) {
-            std::terminate();
+    void Release() {
+        if (!hasHandle) {
+            return;
         }
-        magic = 0;
-#endif
         hasHandle = false;
-    }
-
-    bool await_ready() {
-        return false;
-    }
-    void await_suspend(std::coroutine_handle<> h) noexcept {
-#ifdef DEBUG_LF_MAG
-        if (magic != DEBUG_LF_MAG) {
-            std::terminate();
-        }
-#endif
-        auto &promise = handle.promise();
-        resumed.store(false);
-        promise.callback_ = [this, h] () {
-#ifdef DEBUG_LF_MAG
-            if (magic != DEBUG_LF_MAG) {
-                std::terminate();
-            }
-#endif
-            bool expect{false};
-            if (resumed.compare_exchange_strong(expect, true)) {
-                h.resume();
-            }
-        };
-        if (promise.returnedCall.load()) {
-            bool expect{false};
-            if (resumed.compare_exchange_strong(expect, true)) {
-                h.resume();
-            }
-        } else {
-            promise.callCallback.store(true);
-            if (promise.returnedCall.load()) {
-                bool expect{false};
-                if (resumed.compare_exchange_strong(expect, true)) {
-                    h.resume();
-                }
+        auto &state = handle.promise().state_;
+        auto current = state.load();
+        while (current != task_state::FINISHED) {
+            if (state.compare_exchange_weak(current, task_state::DETACHED)) {
+                return;
             }
         }
+        handle.destroy();
     }
-    T await_resume() noexcept {
+    void Check() const {
 #ifdef DEBUG_LF_MAG
         if (magic != DEBUG_LF_MAG) {
             std::terminate();
         }
 #endif
-        return handle.promise().value_;
     }
-};
-
-template <> struct task<void> {
-    struct promise_type {
-        std::function<void ()> callback_;
-        std::atomic_bool callCallback{false};
-        std::atomic_bool returnedCall{false};
-        std::suspend_never initial_suspend() noexcept {
-            return {};
-        }
-        std::suspend_never final_suspend() noexcept {
-            return {};
-        }
-        task<void> get_return_object() {
-            return {std::coroutine_handle<promise_type>::from_promise(*this)};
-        }
-        void unhandled_exception() {
-            std::terminate();
-        }
-        void return_void() {
-            returnedCall.store(true);
-            if (callCallback) {
-                callback_();
-            }
-        }
-    };
-private:
-    std::coroutine_handle<promise_type> handle;
-    std::atomic_bool resumed{false};
-    bool handlePresent{false};
-#ifdef DEBUG_LF_MAG
-    uint32_t magic{DEBUG_LF_MAG};
-#endif
 public:
-    task(std::coroutine_handle<promise_type> h) : handle(h), handlePresent(true) {
+    task_base() {
+    }
+    task_base(std::coroutine_handle<Promise> h) : handle(h), hasHandle(true) {
     }
-    task(task &&mv) : handle(std::move(mv.handle)), handlePresent(mv.handlePresent) {
-        mv.handlePresent = false;
+    task_base(task_base &&mv) : handle(mv.handle), hasHandle(mv.hasHandle) {
+        mv.hasHandle = false;
     }
-    task &operator =(task &&mv) {
+    task_base &operator =(task_base &&mv) {
         if (this == &mv) {
             return *this;
         }
-        handle = std::move(mv.handle);
-        handlePresent = mv.handlePresent;
-        mv.handlePresent = false;
+        Release();
+        handle = mv.handle;
+        hasHandle = mv.hasHandle;
+        mv.hasHandle = false;
         return *this;
     }
-    task() {
-    }
-    ~task() {
+    ~task_base() {
+        Check();
 #ifdef DEBUG_LF_MAG
-        if (magic != DEBUG_LF_MAG) {
-            std::terminate();
-        }
         magic = 0;
 #endif
+        Release();
     }
 
     bool await_ready() {
-        return false;
+        Check();
+        return handle.promise().state_.load() == task_state::FINISHED;
     }
-    void await_suspend(std::coroutine_handle<> h) noexcept {
-#ifdef DEBUG_LF_MAG
-        if (magic != DEBUG_LF_MAG) {
-            std::terminate();
-        }
-#endif
+    bool await_suspend(std::coroutine_handle<> h) noexcept {
+        Check();
         auto &promise = handle.promise();
-        resumed.store(false);
-        promise.callback_ = [this, h] () {
-#ifdef DEBUG_LF_MAG
-            if (magic != DEBUG_LF_MAG) {
-                std::terminate();
-            }
-#endif
-            bool expect{false};
-            if (resumed.compare_exchange_strong(expect, true)) {
-                h.resume();
-            }
-        };
-        if (promise.returnedCall.load()) {
-            bool expect{false};
-            if (resumed.compare_exchange_strong(expect, true)) {
-                h.resume();
-            }
-        } else {
-            promise.callCallback.store(true);
-            if (promise.returnedCall.load()) {
-                bool expect{false};
-                if (resumed.compare_exchange_strong(expect, true)) {
-                    h.resume();
-                }
-            }
-        }
+        promise.continuation_ = h;
+        auto expect = task_state::RUNNING;
+        return promise.state_.compare_exchange_strong(expect, task_state::AWAITED);
+    }
+};
+
+template <typename T> struct task : task_base<typename task_promise<T>::type> {
+    using promise_type = typename task_promise<T>::type;
+    task() {
+    }
+    task(std::coroutine_handle<promise_type> h) : task_base<promise_type>(h) {
+    }
+    T await_resume() noexcept {
+        this->Check();
+        return this->handle.promise().value_;
+    }
+};
+
+template <> struct task<void> : task_base<task_promise<void>::type> {
+    using promise_type = task_promise<void>::type;
+    task() {
+    }
+    task(std::coroutine_handle<promise_type> h) : task_base<promise_type>(h) {
     }
     void await_resume() noexcept {
+        Check();
     }
 };
 
+inline task<void> task_promise<void>::type::get_return_object() {
+    return {std::coroutine_handle<type>::from_promise(*this)};
+}
+
 #endif //LIBHTTPTOOLING_TASK_H